@@ -3,6 +3,7 @@
 #include <memory>
 #include <cmath>
 #include <functional>
+#include <mutex>
 #include "LiVM/Value/Value.hpp"
 #include "LiVM/LiVM.hpp"
 #include "../config.hpp"
@@ -17,8 +18,13 @@ namespace Linh
     {
         using MathFunction = std::function<Value(const Value&)>;
         static std::unordered_map<std::string, std::unordered_map<std::string, Value>> default_packages;
+        // Slot đã resolve: trỏ thẳng vào phần tử của package (node unordered_map không đổi địa chỉ)
+        static std::vector<const Value*> constant_slots;
+        static std::unordered_map<std::string, int64_t> constant_slot_index; // "package.constant" -> slot
+        // Semantic có thể gọi get_package/package_exists từ worker của ThreadPool, nên chỉ nạp một lần qua call_once
+        static std::once_flag default_packages_once;
 
-        void initialize_default_packages()
+        static void load_default_packages()
         {
             for (const auto& pkg : linh_packages) {
                 if (pkg == "math") {
@@ -43,12 +49,14 @@ namespace Linh
             }
         }
 
+        void initialize_default_packages()
+        {
+            std::call_once(default_packages_once, load_default_packages);
+        }
+
         const std::unordered_map<std::string, Value>* get_package(const std::string& package_name)
         {
-            if (default_packages.empty())
-            {
-                initialize_default_packages();
-            }
+            initialize_default_packages();
             auto it = default_packages.find(package_name);
             if (it != default_packages.end())
             {
@@ -71,21 +79,47 @@ namespace Linh
             return Value{}; // Return sol if not found
         }
 
+        bool is_immutable_constant(const std::string& package_name, const std::string& constant_name)
+        {
+            // math chỉ gồm hằng số; time.time thì có thể thay đổi
+            return package_name == "math" && get_constant(package_name, constant_name).index() != 0;
+        }
+
+        int64_t resolve_constant_slot(const std::string& package_name, const std::string& constant_name)
+        {
+            std::string full_name = package_name + "." + constant_name;
+            auto cached = constant_slot_index.find(full_name);
+            if (cached != constant_slot_index.end())
+                return cached->second;
+            const auto* package = get_package(package_name);
+            if (!package)
+                return -1;
+            auto it = package->find(constant_name);
+            if (it == package->end())
+                return -1;
+            int64_t slot = static_cast<int64_t>(constant_slots.size());
+            constant_slots.push_back(&it->second);
+            constant_slot_index[full_name] = slot;
+            return slot;
+        }
+
+        const Value& constant_at(int64_t slot)
+        {
+            static const Value sol{};
+            if (slot < 0 || slot >= static_cast<int64_t>(constant_slots.size()))
+                return sol;
+            return *constant_slots[slot];
+        }
+
         bool package_exists(const std::string& package_name)
         {
-            if (default_packages.empty())
-            {
-                initialize_default_packages();
-            }
+            initialize_default_packages();
             return default_packages.find(package_name) != default_packages.end();
         }
 
         std::vector<std::string> get_available_packages()
         {
-            if (default_packages.empty())
-            {
-                initialize_default_packages();
-            }
+            initialize_default_packages();
             std::vector<std::string> package_names;
             for (const auto& pair : default_packages)
             {
@@ -3,6 +3,7 @@
 #include <vector>
 #include <unordered_map>
 #include <functional>
+#include <cstdint>
 #include "../LiVM/Value/Value.hpp"
 
 namespace Linh
@@ -12,7 +13,7 @@ namespace Linh
         // Function type for math functions
         using MathFunction = std::function<Value(const Value&)>;
         
-        // Initialize default packages
+        // Initialize default packages (runs once; safe to call from several threads)
         void initialize_default_packages();
 
         // Get a package by name
@@ -21,6 +22,15 @@ namespace Linh
         // Get a specific constant from a package
         Value get_constant(const std::string& package_name, const std::string& constant_name);
 
+        // Constant never changes after package init (math.*): compiler may inline its value
+        bool is_immutable_constant(const std::string& package_name, const std::string& constant_name);
+
+        // Resolve a package value to a fixed slot once (compile time); -1 if it does not exist
+        int64_t resolve_constant_slot(const std::string& package_name, const std::string& constant_name);
+
+        // Current value of a resolved slot (sol if the slot is unknown)
+        const Value& constant_at(int64_t slot);
+
         // Get a math function by name
         MathFunction get_math_function(const std::string& function_name);
 
@@ -2,6 +2,7 @@
 #include "LiVM/LiVM.hpp"
 #include "LinhC/Bytecode/Bytecode.hpp"
 #include <iostream>
+#include <algorithm>
 
 namespace Linh {
     // Tạo function object
@@ -13,50 +14,125 @@ namespace Linh {
         return fn;
     }
 
+    // Frame map được tái sử dụng: giữ nguyên key (node) và bucket, chỉ reset giá trị về sol
+    std::unordered_map<int, Value> LiVM::acquire_frame() {
+        if (frame_pool.empty())
+            return {};
+        std::unordered_map<int, Value> frame = std::move(frame_pool.back());
+        frame_pool.pop_back();
+        return frame;
+    }
+
+    void LiVM::release_frame(std::unordered_map<int, Value>&& frame) {
+        if (frame_pool.size() >= FRAME_POOL_LIMIT)
+            return;
+        for (auto& slot : frame)
+            slot.second = Value(); // Nhả array/map/string mà frame cũ đang giữ
+        frame_pool.push_back(std::move(frame));
+    }
+
     // Gọi function object
-    Value call_function(FunctionPtr fn, const std::vector<Value>& args, LiVM& vm) {
-        // Kiểm tra số lượng tham số
-        if (args.size() != fn->params.size()) {
-            std::cerr << "Error: Function " << fn->name << " expects "
-                      << fn->params.size() << " arguments, but got " << args.size() << std::endl;
+    Value call_function(const FunctionPtr& fn, size_t argc, LiVM& vm) {
+        const FunctionObject& proto = fn->prototype();
+        // Kiểm tra số lượng tham số (một lần, so với params của prototype)
+        if (argc != proto.params.size() || vm.stack.size() < argc) {
+            std::cerr << "Error: Function " << proto.name << " expects "
+                      << proto.params.size() << " arguments, but got "
+                      << std::min(argc, vm.stack.size()) << std::endl;
+            vm.stack.resize(vm.stack.size() - std::min(argc, vm.stack.size()));
             return Value(); // Trả về giá trị mặc định
         }
 
-        // Lưu trạng thái hiện tại của VM
-        auto original_stack = vm.stack;
-        auto original_vars = vm.variables;
-        auto original_call_stack = vm.call_stack;
+        // Arguments nằm sẵn trên đỉnh stack (trái -> phải), frame của caller bắt đầu từ stack_base
+        size_t stack_base = vm.stack.size() - argc;
         auto original_ip = vm.ip; // Save original IP
 
-        // Tạo môi trường local cho function
-        vm.variables.clear();
+        // Tạo môi trường local cho function từ map đã dùng trước đó (giữ sẵn bucket/node, không cấp phát lại).
+        // Dùng swap thay vì chép: slot của caller giữ nguyên địa chỉ nên upvalue đang mở vẫn hợp lệ
+        std::unordered_map<int, Value> caller_vars = vm.acquire_frame();
+        caller_vars.swap(vm.variables);
+        size_t upvalue_base = vm.open_upvalues.size();
+        auto caller_upvalues = vm.active_upvalues;
+        vm.active_upvalues = &fn->upvalues;
 
-        // Bind tham số với giá trị
-        for (size_t i = 0; i < fn->params.size(); ++i) {
-            // TODO: Thêm type checking cho static parameters (vas)
-            vm.variables[i] = args[i];
-        }
+        // Bind tham số: chuyển thẳng từ đỉnh stack vào slot 0..n-1 của frame.
+        // Tham số vas không kiểm tra kiểu ở đây: kiểu khai báo chỉ giúp emitter chọn opcode có kiểu (ADD_I64, ...),
+        // và opcode đó tự quay về bản thường khi giá trị sai kiểu; bản inline của hàm cũng không đi qua đây.
+        auto bind_arguments = [&](size_t n) {
+            size_t first = vm.stack.size() - n;
+            for (size_t i = 0; i < n; ++i)
+                vm.variables[static_cast<int>(i)] = std::move(vm.stack[first + i]);
+            vm.stack.resize(stack_base);
+        };
+        bind_arguments(argc);
 
-        // Lưu return address
-        vm.call_stack.push_back({vm.ip + 1, vm.variables});
+        // Khôi phục trạng thái VM; biến local bị closure capture được chuyển sang ô đóng trước khi bỏ frame
+        auto restore_frame = [&]() {
+            vm.close_upvalues(upvalue_base);
+            vm.active_upvalues = caller_upvalues;
+            vm.variables.swap(caller_vars);
+            vm.release_frame(std::move(caller_vars)); // Sau swap, caller_vars là map của callee
+            vm.call_stack.pop_back();
+            vm.ip = original_ip; // Restore original IP
+        };
 
-        // Thực thi thân hàm
-        vm.ip = 0; // Reset IP for function's own chunk
-        vm.run_chunk(fn->body);
+        // Lưu return address (locals của caller đã được giữ trong caller_vars)
+        vm.call_stack.push_back({vm.ip + 1, {}});
 
-        // Lấy kết quả từ stack
-        Value result = Value(); // Default value
-        if (!vm.stack.empty()) {
-            result = vm.stack.back();
-            vm.stack.pop_back();
+        // Thực thi thân hàm bằng vòng dispatch chính (đủ mọi opcode).
+        // TAIL_CALL dừng dispatch và để lại hàm cần gọi trong pending_tail_call: frame hiện tại
+        // được dùng lại ngay tại đây nên đệ quy đuôi chạy với stack C++ cố định.
+        FunctionPtr current = fn;
+        try {
+            for (;;) {
+                vm.ip = 0; // Reset IP for function's own chunk
+                for (;;) {
+                    try {
+                        vm.dispatch(current->prototype().body);
+                        break;
+                    } catch (const std::exception& ex) {
+                        // Lỗi trong thân hàm: tra bảng exception của hàm, không có catch thì để caller tra tiếp
+                        // (restore_frame đặt lại ip = lệnh CALL của caller)
+                        if (!vm.unwind_to_handler(current->prototype().body, current->prototype().handlers, ex.what(), stack_base))
+                            throw;
+                    }
+                }
+                if (!vm.pending_tail_call)
+                    break;
+
+                FunctionPtr next = std::move(vm.pending_tail_call);
+                vm.pending_tail_call.reset();
+                size_t next_argc = vm.pending_tail_argc;
+                if (next_argc != next->prototype().params.size() || vm.stack.size() < stack_base + next_argc) {
+                    // Như kiểm tra ở đầu hàm: báo lỗi, bỏ đối số và trả về sol
+                    std::cerr << "Error: Function " << next->prototype().name << " expects "
+                              << next->prototype().params.size() << " arguments, but got "
+                              << std::min(next_argc, vm.stack.size() - stack_base) << std::endl;
+                    vm.stack.resize(stack_base);
+                    break;
+                }
+                vm.close_upvalues(upvalue_base);
+                for (auto& slot : vm.variables)
+                    slot.second = Value();
+                bind_arguments(next_argc);
+                current = std::move(next);
+                vm.active_upvalues = &current->upvalues;
+            }
+        } catch (...) {
+            vm.pending_tail_call.reset();
+            vm.stack.resize(stack_base);
+            restore_frame();
+            throw;
         }
 
-        // Khôi phục trạng thái VM
-        vm.stack = original_stack;
-        vm.variables = original_vars;
-        vm.call_stack = original_call_stack;
-        vm.ip = original_ip; // Restore original IP
+        // Lấy kết quả từ stack, bỏ phần còn thừa của frame
+        Value result = Value(); // Default value
+        if (vm.stack.size() > stack_base) {
+            result = std::move(vm.stack.back());
+        }
+        vm.stack.resize(stack_base);
 
+        restore_frame();
         return result;
     }
 }
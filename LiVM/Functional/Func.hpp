@@ -10,6 +10,8 @@ namespace Linh {
     class LiVM;
     using BytecodeChunk = std::vector<struct Instruction>;
     struct Instruction;
+    struct ExceptionHandler;
+    using ExceptionTable = std::vector<ExceptionHandler>;
 }
 
 namespace Linh {
@@ -23,17 +25,51 @@ namespace Linh {
             : name(n), type(t), is_static(static_) {}
     };
 
+    // Ô chứa biến bị closure capture (upvalue).
+    // Khi frame định nghĩa còn sống, location trỏ thẳng vào slot biến của frame đó (ô "mở"),
+    // nên closure và frame cùng thấy một giá trị. Khi frame kết thúc, giá trị được chép vào
+    // closed và location trỏ sang closed (ô "đóng").
+    struct UpvalueCell {
+        Value *location = nullptr;
+        Value closed;
+
+        explicit UpvalueCell(Value *slot) : location(slot) {}
+        void close() {
+            closed = *location;
+            location = &closed;
+        }
+    };
+
+    using UpvaluePtr = std::shared_ptr<UpvalueCell>;
+
+    // Mô tả một upvalue lúc compile: lấy từ biến local của hàm bao ngoài (from_enclosing_local)
+    // hoặc từ upvalue của chính hàm bao ngoài
+    struct UpvalueDesc {
+        bool from_enclosing_local;
+        int index;
+    };
+
+    struct FunctionObject;
+    using FunctionPtr = std::shared_ptr<FunctionObject>;
+
     struct FunctionObject {
         std::string name;
         std::vector<FunctionParameter> params;
         BytecodeChunk body; // Thân hàm dưới dạng bytecode
-        // TODO: Thêm trường cho closure/environment nếu cần
-    };
+        ExceptionTable handlers; // Vùng try/catch trong thân hàm (ip theo body)
+        std::vector<UpvalueDesc> upvalue_descs; // Biến tự do, do emitter phân tích
 
-    using FunctionPtr = std::shared_ptr<FunctionObject>;
+        // Closure: chỉ giữ prototype và các ô đã capture, không chép thân hàm hay môi trường
+        FunctionPtr proto;
+        std::vector<UpvaluePtr> upvalues;
+
+        const FunctionObject &prototype() const { return proto ? *proto : *this; }
+    };
 
     // Tạo function object
     FunctionPtr create_function(const std::string& name, const std::vector<FunctionParameter>& params, const BytecodeChunk& body);
-    // Gọi function object
-    Value call_function(FunctionPtr fn, const std::vector<Value>& args, LiVM& vm);
+    // Gọi function object với argc arguments đang nằm trên đỉnh stack của VM
+    Value call_function(const FunctionPtr& fn, size_t argc, LiVM& vm);
+    // Tạo closure từ prototype, capture biến tự do của frame hiện tại (Lambda.cpp)
+    FunctionPtr make_closure(const FunctionPtr& proto, LiVM& vm);
 } 
\ No newline at end of file
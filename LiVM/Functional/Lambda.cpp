@@ -0,0 +1,68 @@
+#include "Func.hpp"
+#include "LiVM/LiVM.hpp"
+#include "LinhC/Bytecode/Bytecode.hpp"
+#include <iostream>
+
+namespace Linh {
+    // Tạo closure từ prototype: mỗi upvalue lấy ô của biến local trong frame hiện tại
+    // hoặc dùng lại ô mà closure đang chạy đã capture
+    FunctionPtr make_closure(const FunctionPtr& proto, LiVM& vm) {
+        auto closure = std::make_shared<FunctionObject>();
+        closure->proto = proto;
+        closure->upvalues.reserve(proto->upvalue_descs.size());
+        for (const auto& desc : proto->upvalue_descs) {
+            if (desc.from_enclosing_local) {
+                closure->upvalues.push_back(vm.capture_upvalue(desc.index));
+            } else if (vm.active_upvalues && desc.index < static_cast<int>(vm.active_upvalues->size())) {
+                closure->upvalues.push_back((*vm.active_upvalues)[desc.index]);
+            } else {
+                std::cerr << "VM: closure " << proto->name << " captures unknown upvalue " << desc.index << std::endl;
+                auto empty = std::make_shared<UpvalueCell>(nullptr);
+                empty->location = &empty->closed;
+                closure->upvalues.push_back(std::move(empty));
+            }
+        }
+        return closure;
+    }
+
+    UpvaluePtr LiVM::capture_upvalue(int slot) {
+        // Slot của unordered_map không đổi địa chỉ khi rehash/swap => ô mở trỏ thẳng vào slot
+        Value* location = &variables[slot];
+        for (const auto& open : open_upvalues) {
+            if (open->location == location)
+                return open; // Nhiều closure cùng capture 1 biến thì dùng chung 1 ô
+        }
+        auto cell = std::make_shared<UpvalueCell>(location);
+        open_upvalues.push_back(cell);
+        return cell;
+    }
+
+    // Biến toàn cục của REPL: ô upvalue mở trỏ thẳng vào node của map, nên không gán cả map (huỷ hết node).
+    // Slot còn trong vars được ghi đè tại chỗ; slot bị bỏ thì đóng ô đang trỏ vào nó trước khi xoá
+    void LiVM::set_global_variables(const std::unordered_map<int, Value>& vars) {
+        for (auto it = variables.begin(); it != variables.end();) {
+            if (vars.count(it->first)) {
+                ++it;
+                continue;
+            }
+            Value* location = &it->second;
+            for (size_t i = 0; i < open_upvalues.size();) {
+                if (open_upvalues[i]->location == location) {
+                    open_upvalues[i]->close();
+                    open_upvalues.erase(open_upvalues.begin() + static_cast<std::ptrdiff_t>(i));
+                } else {
+                    ++i;
+                }
+            }
+            it = variables.erase(it);
+        }
+        for (const auto& [slot, value] : vars)
+            variables[slot] = value;
+    }
+
+    void LiVM::close_upvalues(size_t from) {
+        for (size_t i = from; i < open_upvalues.size(); ++i)
+            open_upvalues[i]->close();
+        open_upvalues.resize(from);
+    }
+}
@@ -39,16 +39,6 @@ static void debug_print_vars(const std::unordered_map<int, Linh::Value>& vars, s
 }
 #endif
 
-struct TryFrame
-{
-    size_t catch_ip;
-    size_t finally_ip;
-    size_t end_ip;
-    std::string error_var;
-    TryFrame(size_t c, size_t f, size_t e, std::string err = "error")
-        : catch_ip(c), finally_ip(f), end_ip(e), error_var(std::move(err)) {}
-};
-
 namespace Linh
 {
 
@@ -142,6 +132,11 @@ namespace Linh
         stack.push_back(val);
     }
 
+    void LiVM::push(Value &&val)
+    {
+        stack.push_back(std::move(val));
+    }
+
     Value LiVM::pop()
     {
         if (stack.empty())
@@ -149,7 +144,7 @@ namespace Linh
             std::cerr << "ERROR [Line: 0, Col: 0] RuntimeError : VM stack underflow" << std::endl;
             return Value{}; // trả về sol
         }
-        auto val = stack.back();
+        Value val = std::move(stack.back());
         stack.pop_back();
         return val;
     }
@@ -257,6 +252,68 @@ namespace Linh
             return "ID";
         case OpCode::LOAD_PACKAGE_CONST:
             return "LOAD_PACKAGE_CONST";
+        case OpCode::CONCAT_N:
+            return "CONCAT_N";
+        case OpCode::READ_ALL:
+            return "READ_ALL";
+        case OpCode::READ_LINE:
+            return "READ_LINE";
+        case OpCode::READ_BYTES:
+            return "READ_BYTES";
+        case OpCode::READ_EOF:
+            return "READ_EOF";
+        case OpCode::FOR_RANGE:
+            return "FOR_RANGE";
+        case OpCode::FOR_ITER:
+            return "FOR_ITER";
+        case OpCode::CLOSURE:
+            return "CLOSURE";
+        case OpCode::LOAD_UPVALUE:
+            return "LOAD_UPVALUE";
+        case OpCode::STORE_UPVALUE:
+            return "STORE_UPVALUE";
+        case OpCode::TAIL_CALL:
+            return "TAIL_CALL";
+        case OpCode::SAME_FUNCTION:
+            return "SAME_FUNCTION";
+        case OpCode::ADD_I64:
+            return "ADD_I64";
+        case OpCode::SUB_I64:
+            return "SUB_I64";
+        case OpCode::MUL_I64:
+            return "MUL_I64";
+        case OpCode::EQ_I64:
+            return "EQ_I64";
+        case OpCode::NEQ_I64:
+            return "NEQ_I64";
+        case OpCode::LT_I64:
+            return "LT_I64";
+        case OpCode::GT_I64:
+            return "GT_I64";
+        case OpCode::LTE_I64:
+            return "LTE_I64";
+        case OpCode::GTE_I64:
+            return "GTE_I64";
+        case OpCode::ADD_F64:
+            return "ADD_F64";
+        case OpCode::SUB_F64:
+            return "SUB_F64";
+        case OpCode::MUL_F64:
+            return "MUL_F64";
+        case OpCode::DIV_F64:
+            return "DIV_F64";
+        case OpCode::EQ_F64:
+            return "EQ_F64";
+        case OpCode::NEQ_F64:
+            return "NEQ_F64";
+        case OpCode::LT_F64:
+            return "LT_F64";
+        case OpCode::GT_F64:
+            return "GT_F64";
+        case OpCode::LTE_F64:
+            return "LTE_F64";
+        case OpCode::GTE_F64:
+            return "GTE_F64";
         case OpCode::PUSH_ARRAY:
             return "PUSH_ARRAY";
         case OpCode::PUSH_MAP:
@@ -355,7 +412,7 @@ namespace Linh
     static void handle_PRINT(LiVM& vm, const Instruction& instr, const BytecodeChunk&, size_t&) {
         if (vm.stack.empty()) vm.stack.push_back(std::monostate{});
         auto val = vm.pop();
-        LinhIO::linh_print(val);
+        LinhIO::linh_print(vm.output, val);
     }
     static void handle_NOP(LiVM&, const Instruction&, const BytecodeChunk&, size_t&) {}
 
@@ -365,18 +422,14 @@ namespace Linh
             std::cerr << "ERROR [Line " << instr.line << ", Col " << instr.col << "] RuntimeError : VM stack underflow for PRINT_MULTIPLE" << std::endl;
             return;
         }
-        std::vector<std::string> strings;
-        for (int i = 0; i < count; i++) {
-            auto val = vm.pop();
-            strings.push_back(Linh::to_str(val));
-        }
-        std::reverse(strings.begin(), strings.end());
-        std::string result;
-        for (size_t i = 0; i < strings.size(); i++) {
-            if (i > 0) result += " ";
-            result += strings[i];
+        // Ghi thẳng từng giá trị vào buffer output, cách nhau bởi dấu cách
+        size_t first = vm.stack.size() - static_cast<size_t>(count);
+        for (size_t i = first; i < vm.stack.size(); i++) {
+            if (i > first) vm.output.put(' ');
+            vm.output.write_value(vm.stack[i]);
         }
-        LinhIO::linh_print(Value(result));
+        vm.output.end_line();
+        vm.stack.resize(first);
     }
     static void handle_PRINTF(LiVM& vm, const Instruction& instr, const BytecodeChunk&, size_t&) {
         if (vm.stack.empty()) {
@@ -384,7 +437,7 @@ namespace Linh
             return;
         }
         auto val = vm.pop();
-        LinhIO::linh_printf(val);
+        LinhIO::linh_printf(vm.output, val);
     }
 
     static void handle_POP(LiVM& vm, const Instruction&, const BytecodeChunk&, size_t&) {
@@ -413,6 +466,30 @@ namespace Linh
     static void handle_PUSH_BOOL(LiVM& vm, const Instruction& instr, const BytecodeChunk&, size_t&) {
         vm.push(std::get<bool>(instr.operand));
     }
+    static void handle_CLOSURE(LiVM& vm, const Instruction& instr, const BytecodeChunk&, size_t&) {
+        vm.push(Value(make_closure(std::get<FunctionPtr>(instr.operand), vm)));
+    }
+    static void handle_LOAD_UPVALUE(LiVM& vm, const Instruction& instr, const BytecodeChunk&, size_t&) {
+        size_t idx = static_cast<size_t>(std::get<int64_t>(instr.operand));
+        if (!vm.active_upvalues || idx >= vm.active_upvalues->size() || !(*vm.active_upvalues)[idx]->location) {
+            std::cerr << "VM: LOAD_UPVALUE unknown upvalue index " << idx << std::endl;
+            vm.push(std::monostate{});
+            return;
+        }
+        vm.push(*(*vm.active_upvalues)[idx]->location);
+    }
+    static void handle_STORE_UPVALUE(LiVM& vm, const Instruction& instr, const BytecodeChunk&, size_t&) {
+        size_t idx = static_cast<size_t>(std::get<int64_t>(instr.operand));
+        if (vm.stack.empty()) {
+            vm.stack.push_back(std::monostate{});
+        }
+        if (!vm.active_upvalues || idx >= vm.active_upvalues->size() || !(*vm.active_upvalues)[idx]->location) {
+            std::cerr << "VM: STORE_UPVALUE unknown upvalue index " << idx << std::endl;
+            vm.pop();
+            return;
+        }
+        *(*vm.active_upvalues)[idx]->location = vm.pop();
+    }
     static void handle_PUSH_FUNCTION(LiVM& vm, const Instruction& instr, const BytecodeChunk&, size_t&) {
         try {
 #ifdef _DEBUG
@@ -439,11 +516,18 @@ namespace Linh
     }
 
     static void handle_LOAD_PACKAGE_CONST(LiVM& vm, const Instruction& instr, const BytecodeChunk&, size_t&) {
-        // Giả sử operand là tên hằng số package (string)
-        std::string const_name = std::get<std::string>(instr.operand);
-        // Nếu bạn có cơ chế lưu package constants, hãy lấy giá trị ở đây
-        // Ở đây chỉ demo: push tên hằng số lên stack
-        vm.push(const_name);
+        // Operand là slot đã resolve (int) hoặc "package.constant" (string)
+        if (std::holds_alternative<int64_t>(instr.operand)) {
+            vm.push(Linh::LiPM::constant_at(std::get<int64_t>(instr.operand)));
+            return;
+        }
+        const std::string& full_name = std::get<std::string>(instr.operand);
+        auto dot_pos = full_name.find('.');
+        if (dot_pos == std::string::npos) {
+            vm.push(Value{});
+            return;
+        }
+        vm.push(Linh::LiPM::get_constant(full_name.substr(0, dot_pos), full_name.substr(dot_pos + 1)));
     }
 
     // Jump table for opcodes (partial, expand as needed)
@@ -514,8 +598,10 @@ namespace Linh
         return table;
     }();
 
-    void LiVM::run(const BytecodeChunk &chunk)
+    void LiVM::run(const BytecodeChunk &chunk, const ExceptionTable &handlers)
     {
+        // Output của print được gom trong buffer, luôn flush khi run() kết thúc (kể cả return sớm)
+        LinhIO::ScopedFlush flush_output_on_exit{output};
 
 #ifdef _DEBUG
         std::cerr << "[DEBUG] VM::run() started with " << chunk.size() << " instructions" << std::endl;
@@ -523,7 +609,6 @@ namespace Linh
         auto start_time = std::chrono::high_resolution_clock::now();
         
         ip = 0;
-        std::vector<TryFrame> try_stack;
         
         // Reset performance counters
         instruction_count = 0;
@@ -558,6 +643,70 @@ namespace Linh
         std::cerr << "=== End Bytecode Dump ===" << std::endl;
 #endif
 
+        // Không bọc try/catch quanh từng lệnh: chỉ khi có lỗi mới tra bảng exception tĩnh
+        // để tìm catch rồi chạy tiếp vòng dispatch từ đó
+        size_t stack_base = stack.size();
+        for (;;)
+        {
+            try
+            {
+                dispatch(chunk);
+                break;
+            }
+            catch (const std::exception &ex)
+            {
+#ifdef _DEBUG
+                std::cerr << "[DEBUG][EXCEPTION] " << ex.what() << " at ip=" << ip << std::endl;
+#endif
+                if (!unwind_to_handler(chunk, handlers, ex.what(), stack_base))
+                {
+                    std::cerr << "ERROR [Line: " << std::max(error_line, 0) << ", Col: " << error_col << "] VM: " << ex.what() << std::endl;
+                    error_line = -1;
+                    return;
+                }
+            }
+        }
+        // Ô còn mở lúc này chỉ trỏ vào biến top-level (frame của hàm đã tự đóng khi return):
+        // để mở cho closure thấy biến toàn cục đổi ở lần nhập REPL sau (set_global_variables giữ nguyên node)
+        
+        // Performance tracking end
+        auto end_time = std::chrono::high_resolution_clock::now();
+        execution_time_ms = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time).count();
+        
+        // Optimize stack after execution
+        if (stack_optimization_enabled) {
+            optimize_stack();
+        }
+    }
+
+    bool LiVM::unwind_to_handler(const BytecodeChunk &chunk, const ExceptionTable &handlers, const std::string &message, size_t stack_base)
+    {
+        // Lỗi đi ngược qua các frame: chỉ frame trong cùng (lệnh thật sự gây lỗi) ghi vị trí
+        if (error_line < 0 && ip < chunk.size())
+        {
+            error_line = chunk[ip].line;
+            error_col = chunk[ip].col;
+        }
+        // Vùng try trong nằm trước vùng ngoài => dòng đầu tiên chứa ip là catch gần nhất
+        for (const auto &handler : handlers)
+        {
+            if (static_cast<int64_t>(ip) >= handler.start_ip && static_cast<int64_t>(ip) < handler.end_ip)
+            {
+                // Bỏ các giá trị biểu thức đang tính dở trong try (vd. 1 trong '1 + (10/0)')
+                size_t depth = stack_base + static_cast<size_t>(handler.stack_depth);
+                if (stack.size() > depth)
+                    stack.resize(depth);
+                variables[static_cast<int>(handler.error_slot)] = message;
+                ip = static_cast<size_t>(handler.handler_ip);
+                error_line = -1;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void LiVM::dispatch(const BytecodeChunk &chunk)
+    {
         while (ip < chunk.size())
         {
             const auto &instr = chunk[ip];
@@ -580,1108 +729,863 @@ namespace Linh
                 continue;
             }
             
-            try
-            {
 #ifdef _DEBUG
-                // Debug: In thông tin opcode, operand, stack size
-                std::cerr << "[DEBUG][ip=" << ip << "] OpCode: " << static_cast<int>(instr.opcode)
-                          << " (" << opcode_name(instr.opcode) << ")"
-                          << ", Operand index: ";
-                if (std::holds_alternative<int64_t>(instr.operand))
-                    std::cerr << std::get<int64_t>(instr.operand);
-                else if (std::holds_alternative<double>(instr.operand))
-                    std::cerr << std::get<double>(instr.operand);
-                else if (std::holds_alternative<std::string>(instr.operand))
-                    std::cerr << std::get<std::string>(instr.operand);
-                else if (std::holds_alternative<bool>(instr.operand))
-                    std::cerr << (std::get<bool>(instr.operand) ? "true" : "false");
-                else
-                    std::cerr << "(tuple/other)";
-                std::cerr << ", Stack size: " << stack.size() << std::endl;
+            // Debug: In thông tin opcode, operand, stack size
+            std::cerr << "[DEBUG][ip=" << ip << "] OpCode: " << static_cast<int>(instr.opcode)
+                      << " (" << opcode_name(instr.opcode) << ")"
+                      << ", Operand index: ";
+            if (std::holds_alternative<int64_t>(instr.operand))
+                std::cerr << std::get<int64_t>(instr.operand);
+            else if (std::holds_alternative<double>(instr.operand))
+                std::cerr << std::get<double>(instr.operand);
+            else if (std::holds_alternative<std::string>(instr.operand))
+                std::cerr << std::get<std::string>(instr.operand);
+            else if (std::holds_alternative<bool>(instr.operand))
+                std::cerr << (std::get<bool>(instr.operand) ? "true" : "false");
+            else
+                std::cerr << "(tuple/other)";
+            std::cerr << ", Stack size: " << stack.size() << std::endl;
 #endif
-                switch (instr.opcode)
-                {
+            switch (instr.opcode)
+            {
 #ifdef _DEBUG
-                std::cerr << "[DEBUG] Entering switch case for opcode: " << opcode_name(instr.opcode) << std::endl;
+            std::cerr << "[DEBUG] Entering switch case for opcode: " << opcode_name(instr.opcode) << std::endl;
 #endif
-                case OpCode::PUSH_INT:
-                    push(std::get<int64_t>(instr.operand));
+            case OpCode::PUSH_INT:
+                push(std::get<int64_t>(instr.operand));
 #ifdef _DEBUG
-                    std::cerr << "[DEBUG] PUSH_INT: stack size = " << stack.size() << ", top index = " << stack.back().index() << std::endl;
+                std::cerr << "[DEBUG] PUSH_INT: stack size = " << stack.size() << ", top index = " << stack.back().index() << std::endl;
 #endif
-                    break;
-                case OpCode::PUSH_UINT:
-                    // Hỗ trợ uint64_t
-                    push(std::get<uint64_t>(instr.operand));
-                    break;
-                case OpCode::PUSH_FLOAT:
-                    // If you want to support float128, check here
-                    // For now, always push double
-                    push(std::get<double>(instr.operand));
-                    break;
-                case OpCode::PUSH_STR:
-                    push(std::get<std::string>(instr.operand));
-                    break;
-                case OpCode::PUSH_BOOL:
-                    push(std::get<bool>(instr.operand));
-                    break;
-                case OpCode::PUSH_FUNCTION:
+                break;
+            case OpCode::PUSH_UINT:
+                // Hỗ trợ uint64_t
+                push(std::get<uint64_t>(instr.operand));
+                break;
+            case OpCode::PUSH_FLOAT:
+                // If you want to support float128, check here
+                // For now, always push double
+                push(std::get<double>(instr.operand));
+                break;
+            case OpCode::PUSH_STR:
+                push(std::get<std::string>(instr.operand));
+                break;
+            case OpCode::PUSH_BOOL:
+                push(std::get<bool>(instr.operand));
+                break;
+            case OpCode::PUSH_FUNCTION:
 #ifdef _DEBUG
-                    std::cerr << "[DEBUG] PUSH_FUNCTION case reached" << std::endl;
+                std::cerr << "[DEBUG] PUSH_FUNCTION case reached" << std::endl;
 #endif
-                    handle_PUSH_FUNCTION(*this, instr, chunk, ip);
-                    break;
-                case OpCode::POP:
-                    pop();
-                    break;
-                case OpCode::SWAP:
-                    if (stack.size() < 2)
-                    {
-                        std::cerr << "VM stack underflow for SWAP" << std::endl;
-                        break;
-                    }
-                    std::swap(stack[stack.size() - 1], stack[stack.size() - 2]);
-                    break;
-                case OpCode::ADD:
-                case OpCode::SUB:
-                case OpCode::MUL:
-                case OpCode::DIV:
-                case OpCode::MOD:
-                case OpCode::HASH:
-                case OpCode::AMP:
-                case OpCode::PIPE:
-                case OpCode::CARET:
-                case OpCode::LT_LT:
-                case OpCode::GT_GT:
-                    Linh::math_binary_op(*this, instr);
-                    break;
-                case OpCode::AND:
-                case OpCode::OR:
+                handle_PUSH_FUNCTION(*this, instr, chunk, ip);
+                break;
+            case OpCode::CLOSURE:
+                handle_CLOSURE(*this, instr, chunk, ip);
+                break;
+            case OpCode::SAME_FUNCTION:
+            {
+                // So địa chỉ: PUSH_FUNCTION đẩy chính prototype, gán/chép giá trị hàm chỉ chép con trỏ
+                const auto &expected = std::get<FunctionPtr>(instr.operand);
+                auto val = pop();
+                push(std::holds_alternative<FunctionPtr>(val) && std::get<FunctionPtr>(val).get() == expected.get());
+                break;
+            }
+            case OpCode::LOAD_UPVALUE:
+                handle_LOAD_UPVALUE(*this, instr, chunk, ip);
+                break;
+            case OpCode::STORE_UPVALUE:
+                handle_STORE_UPVALUE(*this, instr, chunk, ip);
+                break;
+            case OpCode::POP:
+                pop();
+                break;
+            case OpCode::SWAP:
+                if (stack.size() < 2)
                 {
-                    auto b = pop();
-                    auto a = pop();
-                    if (std::holds_alternative<bool>(a) && std::holds_alternative<bool>(b))
-                    {
-                        bool av = std::get<bool>(a);
-                        bool bv = std::get<bool>(b);
-                        if (instr.opcode == OpCode::AND)
-                            push(av && bv);
-                        else
-                            push(av || bv);
-                    }
-                    else
-                    {
-                        std::cerr << "ERROR [Line: 0, Col: 0] RuntimeError: AND/OR only supports bool" << std::endl;
-                        push(false);
-                    }
+                    std::cerr << "VM stack underflow for SWAP" << std::endl;
                     break;
                 }
-                case OpCode::NOT:
+                std::swap(stack[stack.size() - 1], stack[stack.size() - 2]);
+                break;
+            case OpCode::ADD:
+            case OpCode::SUB:
+            case OpCode::MUL:
+            case OpCode::DIV:
+            case OpCode::MOD:
+            case OpCode::HASH:
+            case OpCode::AMP:
+            case OpCode::PIPE:
+            case OpCode::CARET:
+            case OpCode::LT_LT:
+            case OpCode::GT_GT:
+                Linh::math_binary_op(*this, instr);
+                break;
+            case OpCode::ADD_I64:
+            case OpCode::SUB_I64:
+            case OpCode::MUL_I64:
+            case OpCode::EQ_I64:
+            case OpCode::NEQ_I64:
+            case OpCode::LT_I64:
+            case OpCode::GT_I64:
+            case OpCode::LTE_I64:
+            case OpCode::GTE_I64:
+            case OpCode::ADD_F64:
+            case OpCode::SUB_F64:
+            case OpCode::MUL_F64:
+            case OpCode::DIV_F64:
+            case OpCode::EQ_F64:
+            case OpCode::NEQ_F64:
+            case OpCode::LT_F64:
+            case OpCode::GT_F64:
+            case OpCode::LTE_F64:
+            case OpCode::GTE_F64:
+                Linh::typed_binary_op(*this, instr);
+                break;
+            case OpCode::AND:
+            case OpCode::OR:
+            {
+                auto b = pop();
+                auto a = pop();
+                if (std::holds_alternative<bool>(a) && std::holds_alternative<bool>(b))
                 {
-                    auto a = pop();
-                    if (std::holds_alternative<bool>(a))
-                        push(!std::get<bool>(a));
-                    else if (std::holds_alternative<int64_t>(a))
-                        push(~std::get<int64_t>(a)); // bitwise NOT
-                    else {
-                        std::cerr << "VM: NOT only supports bool or int" << std::endl;
-                        push(false);
-                    }
-                    break;
+                    bool av = std::get<bool>(a);
+                    bool bv = std::get<bool>(b);
+                    if (instr.opcode == OpCode::AND)
+                        push(av && bv);
+                    else
+                        push(av || bv);
                 }
-                case OpCode::EQ:
-                case OpCode::NEQ:
-                case OpCode::LT:
-                case OpCode::GT:
-                case OpCode::LTE:
-                case OpCode::GTE:
+                else
                 {
+                    std::cerr << "ERROR [Line: 0, Col: 0] RuntimeError: AND/OR only supports bool" << std::endl;
+                    push(false);
+                }
+                break;
+            }
+            case OpCode::NOT:
+            {
+                auto a = pop();
+                if (std::holds_alternative<bool>(a))
+                    push(!std::get<bool>(a));
+                else if (std::holds_alternative<int64_t>(a))
+                    push(~std::get<int64_t>(a)); // bitwise NOT
+                else {
+                    std::cerr << "VM: NOT only supports bool or int" << std::endl;
+                    push(false);
+                }
+                break;
+            }
+            case OpCode::EQ:
+            case OpCode::NEQ:
+            case OpCode::LT:
+            case OpCode::GT:
+            case OpCode::LTE:
+            case OpCode::GTE:
+            {
 #ifdef _DEBUG
-                    std::cerr << "[DEBUG] Before comparison: ";
-                    debug_print_stack(stack);
+                std::cerr << "[DEBUG] Before comparison: ";
+                debug_print_stack(stack);
 #endif
-                    auto b = pop();
-                    auto a = pop();
+                auto b = pop();
+                auto a = pop();
 #ifdef _DEBUG
-                    std::cerr << "[DEBUG] Compare a="; debug_print_value(a); std::cerr << ", b="; debug_print_value(b); std::cerr << std::endl;
+                std::cerr << "[DEBUG] Compare a="; debug_print_value(a); std::cerr << ", b="; debug_print_value(b); std::cerr << std::endl;
 #endif
-                    bool result = false;
-                    // If either is string, compare as string
-                                                                    if (std::holds_alternative<std::string>(a) || std::holds_alternative<std::string>(b)) {
-                            std::string sa = std::holds_alternative<std::string>(a) ? std::get<std::string>(a) : Linh::to_str(a);
-                            std::string sb = std::holds_alternative<std::string>(b) ? std::get<std::string>(b) : Linh::to_str(b);
-                        switch (instr.opcode) {
-                            case OpCode::EQ: result = (sa == sb); break;
-                            case OpCode::NEQ: result = (sa != sb); break;
-                            case OpCode::LT: result = (sa < sb); break;
-                            case OpCode::GT: result = (sa > sb); break;
-                            case OpCode::LTE: result = (sa <= sb); break;
-                            case OpCode::GTE: result = (sa >= sb); break;
-                            default: result = false; break;
-                        }
-                        push(result);
-                        break;
-                    }
-                    // If both are bool
-                    if (std::holds_alternative<bool>(a) && std::holds_alternative<bool>(b)) {
-                        bool av = std::get<bool>(a);
-                        bool bv = std::get<bool>(b);
-                        switch (instr.opcode) {
-                            case OpCode::EQ: result = (av == bv); break;
-                            case OpCode::NEQ: result = (av != bv); break;
-                            case OpCode::LT: result = (!av && bv); break;
-                            case OpCode::GT: result = (av && !bv); break;
-                            case OpCode::LTE: result = (!av || bv); break;
-                            case OpCode::GTE: result = (av || !bv); break;
-                            default: result = false; break;
-                        }
-                        push(result);
-                        break;
-                    }
-                    // If both are numbers (int/double/uint)
-                    if ((std::holds_alternative<int64_t>(a) || std::holds_alternative<double>(a) || std::holds_alternative<uint64_t>(a)) &&
-                        (std::holds_alternative<int64_t>(b) || std::holds_alternative<double>(b) || std::holds_alternative<uint64_t>(b))) {
-                        double av = std::holds_alternative<int64_t>(a) ? static_cast<double>(std::get<int64_t>(a)) :
-                                    (std::holds_alternative<uint64_t>(a) ? static_cast<double>(std::get<uint64_t>(a)) : std::get<double>(a));
-                        double bv = std::holds_alternative<int64_t>(b) ? static_cast<double>(std::get<int64_t>(b)) :
-                                    (std::holds_alternative<uint64_t>(b) ? static_cast<double>(std::get<uint64_t>(b)) : std::get<double>(b));
-                        switch (instr.opcode) {
-                            case OpCode::EQ: result = (av == bv); break;
-                            case OpCode::NEQ: result = (av != bv); break;
-                            case OpCode::LT: result = (av < bv); break;
-                            case OpCode::GT: result = (av > bv); break;
-                            case OpCode::LTE: result = (av <= bv); break;
-                            case OpCode::GTE: result = (av >= bv); break;
-                            default: result = false; break;
-                        }
-                        push(result);
-                        break;
-                    }
-                    // Fallback: compare as string
-                    std::string sa = Linh::to_str(a);
-                    std::string sb = Linh::to_str(b);
-                    switch (instr.opcode) {
-                        case OpCode::EQ: result = (sa == sb); break;
-                        case OpCode::NEQ: result = (sa != sb); break;
-                        case OpCode::LT: result = (sa < sb); break;
-                        case OpCode::GT: result = (sa > sb); break;
-                        case OpCode::LTE: result = (sa <= sb); break;
-                        case OpCode::GTE: result = (sa >= sb); break;
-                        default: result = false; break;
-                    }
-                    push(result);
-                    break;
-                }
-                case OpCode::LOAD_VAR:
-                {
-                    int idx = std::get<int64_t>(instr.operand);
+                push(compare_values(a, b, instr.opcode));
+                break;
+            }
+            case OpCode::LOAD_VAR:
+            {
+                int idx = std::get<int64_t>(instr.operand);
 #ifdef _DEBUG
-                    std::cerr << "[DEBUG] LOAD_VAR: loading variable index " << idx << std::endl;
-                    std::cerr << "[DEBUG] LOAD_VAR: variables.size() = " << variables.size() << std::endl;
+                std::cerr << "[DEBUG] LOAD_VAR: loading variable index " << idx << std::endl;
+                std::cerr << "[DEBUG] LOAD_VAR: variables.size() = " << variables.size() << std::endl;
 #endif
-                    if (variables.count(idx)) {
-                        auto value = variables[idx];
+                if (variables.count(idx)) {
+                    auto value = variables[idx];
 #ifdef _DEBUG
-                        std::cerr << "[DEBUG] LOAD_VAR: loaded value index = " << value.index() << std::endl;
+                    std::cerr << "[DEBUG] LOAD_VAR: loaded value index = " << value.index() << std::endl;
 #endif
-                        push(value);
+                    push(value);
 #ifdef _DEBUG
-                        std::cerr << "[DEBUG] LOAD_VAR: after push, stack size = " << stack.size() << ", top index = " << stack.back().index() << std::endl;
+                    std::cerr << "[DEBUG] LOAD_VAR: after push, stack size = " << stack.size() << ", top index = " << stack.back().index() << std::endl;
 #endif
+                } else {
+                    // Nếu tên biến là error.message và error tồn tại, trả về error
+                    if (idx == 3 && variables.count(2)) {
+                        push(variables[2]);
                     } else {
-                        // Nếu tên biến là error.message và error tồn tại, trả về error
-                        if (idx == 3 && variables.count(2)) {
-                            push(variables[2]);
-                        } else {
-                            std::cerr << "VM: LOAD_VAR unknown variable index " << idx << std::endl;
-                            push(int64_t(0));
-                        }
+                        std::cerr << "VM: LOAD_VAR unknown variable index " << idx << std::endl;
+                        push(int64_t(0));
                     }
-                    break;
                 }
-                case OpCode::STORE_VAR:
+                break;
+            }
+            case OpCode::STORE_VAR:
+            {
+                int idx = std::get<int64_t>(instr.operand);
+                if (stack.empty())
                 {
-                    int idx = std::get<int64_t>(instr.operand);
-                    if (stack.empty())
-                    {
-                        stack.push_back(std::monostate{});
-                    }
-                    variables[idx] = pop();
-                    break;
+                    stack.push_back(std::monostate{});
                 }
-                case OpCode::PRINT:
-                {
-#ifdef _DEBUG
-                    std::cerr << "[DEBUG] PRINT opcode executed" << std::endl;
-#endif
-                    if (stack.empty())
-                    {
-                        // Nếu stack rỗng, tự động push sol để không lỗi underflow
-                        stack.push_back(std::monostate{});
-                    }
-                    auto val = pop();
+                variables[idx] = pop();
+                break;
+            }
+            case OpCode::PRINT:
+            {
 #ifdef _DEBUG
-                    std::cerr << "[DEBUG] PRINT: about to print: " << Linh::to_str(val) << std::endl;
+                std::cerr << "[DEBUG] PRINT opcode executed" << std::endl;
 #endif
-                    LinhIO::linh_print(val);
-                    break;
-                }
-                case OpCode::PRINT_MULTIPLE:
+                if (stack.empty())
                 {
+                    // Nếu stack rỗng, tự động push sol để không lỗi underflow
+                    stack.push_back(std::monostate{});
+                }
+                auto val = pop();
 #ifdef _DEBUG
-                    std::cerr << "[DEBUG] PRINT_MULTIPLE in second switch case" << std::endl;
+                std::cerr << "[DEBUG] PRINT: about to print: " << Linh::to_str(val) << std::endl;
 #endif
-                    int64_t count = std::get<int64_t>(instr.operand);
+                LinhIO::linh_print(output, val);
+                break;
+            }
+            case OpCode::PRINT_MULTIPLE:
+            {
 #ifdef _DEBUG
-                    std::cerr << "[DEBUG] PRINT_MULTIPLE: count=" << count << ", stack_size=" << stack.size() << std::endl;
+                std::cerr << "[DEBUG] PRINT_MULTIPLE in second switch case" << std::endl;
 #endif
-                    if (stack.size() < static_cast<size_t>(count))
-                    {
-                        std::cerr << "ERROR [Line " << instr.line << ", Col " << instr.col << "] RuntimeError : VM stack underflow for PRINT_MULTIPLE" << std::endl;
-                        break;
-                    }
-                    // Pop all values and convert them to strings
-                    std::vector<std::string> strings;
-                    for (int i = 0; i < count; i++) {
-                        auto val = pop();
+                int64_t count = std::get<int64_t>(instr.operand);
 #ifdef _DEBUG
-                        std::cerr << "[DEBUG] PRINT_MULTIPLE: popped value " << i << ": " << Linh::to_str(val) << std::endl;
+                std::cerr << "[DEBUG] PRINT_MULTIPLE: count=" << count << ", stack_size=" << stack.size() << std::endl;
 #endif
-                        strings.push_back(Linh::to_str(val));
-                    }
-                    // Reverse the strings to get correct order
-                    std::reverse(strings.begin(), strings.end());
-                    // Join strings with space separator (like Python's print)
-                    std::string result;
-                    for (size_t i = 0; i < strings.size(); i++) {
-                        if (i > 0) result += " ";
-                        result += strings[i];
-                    }
+                if (stack.size() < static_cast<size_t>(count))
+                {
+                    std::cerr << "ERROR [Line " << instr.line << ", Col " << instr.col << "] RuntimeError : VM stack underflow for PRINT_MULTIPLE" << std::endl;
+                    break;
+                }
+                // Ghi thẳng các giá trị (theo đúng thứ tự trên stack) vào buffer output,
+                // cách nhau bởi dấu cách (like Python's print)
+                size_t first = stack.size() - static_cast<size_t>(count);
+                for (size_t i = first; i < stack.size(); i++) {
 #ifdef _DEBUG
-                    std::cerr << "[DEBUG] PRINT_MULTIPLE: final result: '" << result << "'" << std::endl;
+                    std::cerr << "[DEBUG] PRINT_MULTIPLE: value " << (i - first) << ": " << Linh::to_str(stack[i]) << std::endl;
 #endif
-                    LinhIO::linh_print(Value(result));
+                    if (i > first) output.put(' ');
+                    output.write_value(stack[i]);
+                }
+                output.end_line();
+                stack.resize(first);
+                break;
+            }
+            case OpCode::PRINTF:
+            {
+                if (stack.empty())
+                {
+                    std::cerr << "ERROR [Line " << instr.line << ", Col " << instr.col << "] RuntimeError : VM stack underflow" << std::endl;
                     break;
                 }
-                case OpCode::PRINTF:
+                auto val = pop();
+                LinhIO::linh_printf(output, val);
+                break;
+            }
+            case OpCode::INPUT:
+            {
+                auto prompt = pop();
+                std::string prompt_str;
+                if (std::holds_alternative<std::string>(prompt))
+                    prompt_str = std::get<std::string>(prompt);
+                else
+                    prompt_str = "";
+                auto input_val = LinhIO::linh_input(output, input, prompt_str);
+                push(input_val);
+                break;
+            }
+            case OpCode::TYPEOF:
+            {
+                if (stack.empty())
                 {
-                    if (stack.empty())
+                    std::cerr << "ERROR [Line " << instr.line << ", Col " << instr.col << "] RuntimeError : VM stack underflow" << std::endl;
+                    break;
+                }
+                auto val = pop();
+                std::string type_str = "sol";
+                if (std::holds_alternative<int64_t>(val))
+                    type_str = "int";
+                else if (std::holds_alternative<uint64_t>(val))
+                    type_str = "uint";
+                else if (std::holds_alternative<double>(val))
+                    type_str = "float";
+                else if (std::holds_alternative<std::string>(val))
+                    type_str = "str";
+                else if (std::holds_alternative<bool>(val))
+                    type_str = "bool";
+                else if (std::holds_alternative<Array>(val))
+                    type_str = "array";
+                else if (std::holds_alternative<Map>(val))
+                    type_str = "map";
+                else if (std::holds_alternative<FunctionPtr>(val))
+                    type_str = "function";
+                push(type_str); // Đẩy lại kết quả lên stack để PRINT lấy ra
+                break;
+            }
+            case OpCode::HALT:
+                return;
+            case OpCode::JMP:
+            case OpCode::JMP_IF_FALSE:
+            case OpCode::JMP_IF_TRUE:
+            case OpCode::FOR_RANGE:
+            case OpCode::FOR_ITER:
+                handle_loop_opcode(*this, instr, chunk, ip);
+                continue;
+            case OpCode::TAIL_CALL:
+                // Đang trong thân hàm và gọi function object: trả về cho call_function để dùng lại frame.
+                // Ngược lại (builtin theo tên, top-level) thì chạy như CALL, lệnh RET phía sau sẽ trả kết quả.
+                if (!call_stack.empty() && !stack.empty() && std::holds_alternative<FunctionPtr>(stack.back()))
+                {
+                    pending_tail_call = std::get<FunctionPtr>(std::move(stack.back()));
+                    pending_tail_argc = static_cast<size_t>(std::get<0>(std::get<std::tuple<int64_t, int64_t, int64_t, std::string>>(instr.operand)));
+                    stack.pop_back();
+                    return;
+                }
+                [[fallthrough]];
+            case OpCode::CALL:
+            {
+                // Get function name và số đối số caller đã đẩy lên stack
+                const auto &[call_argc, unused1, unused2, fname] = std::get<std::tuple<int64_t, int64_t, int64_t, std::string>>(instr.operand);
+                // --- Thêm hỗ trợ hàm pow ---
+                if (fname == "pow")
+                {
+                    auto b = pop();
+                    auto a = pop();
+                    double av = 0, bv = 0;
+                    if (std::holds_alternative<int64_t>(a))
+                        av = static_cast<double>(std::get<int64_t>(a));
+                    else if (std::holds_alternative<double>(a))
+                        av = std::get<double>(a);
+                    else
+                        av = 0;
+                    if (std::holds_alternative<int64_t>(b))
+                        bv = static_cast<double>(std::get<int64_t>(b));
+                    else if (std::holds_alternative<double>(b))
+                        bv = std::get<double>(b);
+                    else
+                        bv = 0;
+                    push(std::pow(av, bv));
+                    break;
+                }
+                // --- Built-in conversion functions ---
+                if (fname == "sol")
+                {
+                    // Bất kỳ giá trị nào truyền vào cũng trả về sol (std::monostate)
+                    if (!stack.empty())
+                        pop();
+                    push(std::monostate{});
+                    break;
+                }
+                if (fname == "str")
+                {
+                    auto val = pop();
+                    push(Linh::to_str(val));
+                    break;
+                }
+                if (fname == "uint")
+                {
+                    auto val = pop();
+                    push(static_cast<uint64_t>(Linh::to_uint(val)));
+                    break;
+                }
+                if (fname == "float")
+                {
+                    auto val = pop();
+                    push(Linh::to_float(val));
+                    break;
+                }
+                if (fname == "int")
+                {
+                    auto val = pop();
+                    push(Linh::to_int(val));
+                    break;
+                }
+                if (fname == "bool")
+                {
+                    auto val = pop();
+                    push(Linh::to_bool(val));
+                    break;
+                }
+                if (fname == "len")
+                {
+                    auto val = pop();
+                    int64_t result = Linh::len(val);
+                    push(result);
+                    break; // Đổi từ return sang break để tiếp tục thực thi opcode tiếp theo
+                }
+                // --- Math functions support ---
+                if (fname == "pow")
+                {
+                    // pow requires 2 arguments
+                    if (stack.size() < 2)
                     {
-                        std::cerr << "ERROR [Line " << instr.line << ", Col " << instr.col << "] RuntimeError : VM stack underflow" << std::endl;
+                        std::cerr << "VM: Math function 'pow' requires 2 arguments\n";
+                        push(Value{}); // Return sol
                         break;
                     }
-                    auto val = pop();
-                    LinhIO::linh_printf(val);
+                    auto exponent = pop();
+                    auto base = pop();
+                    double basev = 0, exponentv = 0;
+                    
+                    if (std::holds_alternative<int64_t>(base))
+                        basev = static_cast<double>(std::get<int64_t>(base));
+                    else if (std::holds_alternative<double>(base))
+                        basev = std::get<double>(base);
+                    else
+                        basev = 0;
+                        
+                    if (std::holds_alternative<int64_t>(exponent))
+                        exponentv = static_cast<double>(std::get<int64_t>(exponent));
+                    else if (std::holds_alternative<double>(exponent))
+                        exponentv = std::get<double>(exponent);
+                    else
+                        exponentv = 0;
+                        
+                    push(std::pow(basev, exponentv));
                     break;
                 }
-                case OpCode::INPUT:
+                else if (fname == "atan2")
                 {
-                    auto prompt = pop();
-                    std::string prompt_str;
-                    if (std::holds_alternative<std::string>(prompt))
-                        prompt_str = std::get<std::string>(prompt);
+                    // atan2 requires 2 arguments
+                    if (stack.size() < 2)
+                    {
+                        std::cerr << "VM: Math function 'atan2' requires 2 arguments\n";
+                        push(Value{}); // Return sol
+                        break;
+                    }
+                    auto y = pop();
+                    auto x = pop();
+                    double xv = 0, yv = 0;
+                    
+                    if (std::holds_alternative<int64_t>(x))
+                        xv = static_cast<double>(std::get<int64_t>(x));
+                    else if (std::holds_alternative<double>(x))
+                        xv = std::get<double>(x);
+                    else
+                        xv = 0;
+                        
+                    if (std::holds_alternative<int64_t>(y))
+                        yv = static_cast<double>(std::get<int64_t>(y));
+                    else if (std::holds_alternative<double>(y))
+                        yv = std::get<double>(y);
                     else
-                        prompt_str = "";
-                    auto input_val = LinhIO::linh_input(prompt_str);
-                    push(input_val);
+                        yv = 0;
+                        
+                    push(std::atan2(yv, xv));
                     break;
                 }
-                case OpCode::TYPEOF:
+                
+                auto math_func = Linh::LiPM::get_math_function(fname);
+                if (math_func)
                 {
                     if (stack.empty())
                     {
-                        std::cerr << "ERROR [Line " << instr.line << ", Col " << instr.col << "] RuntimeError : VM stack underflow" << std::endl;
+                        std::cerr << "VM: Math function '" << fname << "' requires an argument\n";
+                        push(Value{}); // Return sol
                         break;
                     }
                     auto val = pop();
-                    std::string type_str = "sol";
-                    if (std::holds_alternative<int64_t>(val))
-                        type_str = "int";
-                    else if (std::holds_alternative<uint64_t>(val))
-                        type_str = "uint";
-                    else if (std::holds_alternative<double>(val))
-                        type_str = "float";
-                    else if (std::holds_alternative<std::string>(val))
-                        type_str = "str";
-                    else if (std::holds_alternative<bool>(val))
-                        type_str = "bool";
-                    else if (std::holds_alternative<Array>(val))
-                        type_str = "array";
-                    else if (std::holds_alternative<Map>(val))
-                        type_str = "map";
-                    else if (std::holds_alternative<FunctionPtr>(val))
-                        type_str = "function";
-                    push(type_str); // Đẩy lại kết quả lên stack để PRINT lấy ra
+                    auto result = math_func(val);
+                    push(result);
                     break;
                 }
-                case OpCode::HALT:
-                    return;
-                case OpCode::JMP:
-                case OpCode::JMP_IF_FALSE:
-                case OpCode::JMP_IF_TRUE:
-                    handle_loop_opcode(*this, instr, chunk, ip);
-                    continue;
-                case OpCode::CALL:
+                // Kiểm tra xem có function object trên stack không
+#ifdef _DEBUG
+                std::cerr << "[DEBUG] CALL: checking for function object on stack, size=" << stack.size() << std::endl;
+                if (!stack.empty()) {
+                    std::cerr << "[DEBUG] CALL: top of stack index = " << stack.back().index() << std::endl;
+                }
+#endif
+                if (!stack.empty() && std::holds_alternative<FunctionPtr>(stack.back())) {
+#ifdef _DEBUG
+                    std::cerr << "[DEBUG] CALL: found function object, calling it" << std::endl;
+#endif
+                    // Gọi function object: arguments giữ nguyên trên stack, call_function chuyển thẳng vào frame mới
+                    FunctionPtr fn = std::get<FunctionPtr>(std::move(stack.back()));
+                    stack.pop_back(); // Pop function object
+#ifdef _DEBUG
+                    std::cerr << "[DEBUG] CALL: calling function " << fn->prototype().name << " with " << call_argc << " arguments" << std::endl;
+#endif
+                    push(call_function(fn, static_cast<size_t>(call_argc), *this));
+#ifdef _DEBUG
+                    std::cerr << "[DEBUG] CALL: function executed, result pushed to stack, ip=" << ip << std::endl;
+#endif
+                    break;
+                }
+                
+                if (!functions.count(fname))
                 {
-                    // Get function name
-                    std::string fname = std::get<std::string>(instr.operand);
-                    // --- Thêm hỗ trợ hàm pow ---
-                    if (fname == "pow")
-                    {
-                        auto b = pop();
-                        auto a = pop();
-                        double av = 0, bv = 0;
-                        if (std::holds_alternative<int64_t>(a))
-                            av = static_cast<double>(std::get<int64_t>(a));
-                        else if (std::holds_alternative<double>(a))
-                            av = std::get<double>(a);
-                        else
-                            av = 0;
-                        if (std::holds_alternative<int64_t>(b))
-                            bv = static_cast<double>(std::get<int64_t>(b));
-                        else if (std::holds_alternative<double>(b))
-                            bv = std::get<double>(b);
-                        else
-                            bv = 0;
-                        push(std::pow(av, bv));
-                        break;
-                    }
-                    // --- Built-in conversion functions ---
-                    if (fname == "sol")
-                    {
-                        // Bất kỳ giá trị nào truyền vào cũng trả về sol (std::monostate)
-                        if (!stack.empty())
-                            pop();
-                        push(std::monostate{});
-                        break;
-                    }
-                    if (fname == "str")
+                    std::cerr << "VM: Unknown function '" << fname << "'\n";
+                    break;
+                }
+                const auto &fn = functions[fname];
+                // Pop arguments in reverse order
+                std::vector<Value> args;
+                for (size_t i = 0; i < fn.param_names.size(); ++i)
+                    args.push_back(pop());
+                std::reverse(args.begin(), args.end());
+                // Save current frame: swap chứ không chép/clear, slot của caller giữ nguyên địa chỉ
+                // nên ô upvalue đang mở trỏ vào đó vẫn hợp lệ
+                CallFrame frame;
+                frame.return_ip = ip + 1;
+                frame.locals = acquire_frame();
+                call_stack.push_back(std::move(frame));
+                call_stack.back().locals.swap(variables);
+                size_t upvalue_base = open_upvalues.size();
+                // Set up new variables for function
+                for (size_t i = 0; i < fn.param_names.size(); ++i)
+                    variables[i] = args[i];
+                // Run function code
+                size_t saved_ip = ip;
+                size_t fn_ip = 0;
+                while (fn_ip < fn.code.size())
+                {
+                    const auto &finstr = fn.code[fn_ip];
+                    switch (finstr.opcode)
                     {
-                        auto val = pop();
-                        push(Linh::to_str(val));
+                    case OpCode::PUSH_INT:
+                        push(Value(std::get<int64_t>(finstr.operand)));
                         break;
-                    }
-                    if (fname == "uint")
-                    {
-                        auto val = pop();
-                        push(static_cast<uint64_t>(Linh::to_uint(val)));
+                    case OpCode::PUSH_UINT:
+                        push(Value(std::get<uint64_t>(finstr.operand)));
                         break;
-                    }
-                    if (fname == "float")
-                    {
-                        auto val = pop();
-                        push(Linh::to_float(val));
+                    case OpCode::PUSH_FLOAT:
+                        push(Value(std::get<double>(finstr.operand)));
                         break;
-                    }
-                    if (fname == "int")
-                    {
-                        auto val = pop();
-                        push(Linh::to_int(val));
+                    case OpCode::PUSH_STR:
+                        push(Value(std::get<std::string>(finstr.operand)));
                         break;
-                    }
-                    if (fname == "bool")
-                    {
-                        auto val = pop();
-                        push(Linh::to_bool(val));
+                    case OpCode::PUSH_BOOL:
+                        push(Value(std::get<bool>(finstr.operand)));
                         break;
-                    }
-                    if (fname == "len")
-                    {
-                        auto val = pop();
-                        int64_t result = Linh::len(val);
-                        push(result);
-                        break; // Đổi từ return sang break để tiếp tục thực thi opcode tiếp theo
-                    }
-                    // --- Math functions support ---
-                    if (fname == "pow")
-                    {
-                        // pow requires 2 arguments
-                        if (stack.size() < 2)
-                        {
-                            std::cerr << "VM: Math function 'pow' requires 2 arguments\n";
-                            push(Value{}); // Return sol
-                            break;
-                        }
-                        auto exponent = pop();
-                        auto base = pop();
-                        double basev = 0, exponentv = 0;
-                        
-                        if (std::holds_alternative<int64_t>(base))
-                            basev = static_cast<double>(std::get<int64_t>(base));
-                        else if (std::holds_alternative<double>(base))
-                            basev = std::get<double>(base);
-                        else
-                            basev = 0;
-                            
-                        if (std::holds_alternative<int64_t>(exponent))
-                            exponentv = static_cast<double>(std::get<int64_t>(exponent));
-                        else if (std::holds_alternative<double>(exponent))
-                            exponentv = std::get<double>(exponent);
-                        else
-                            exponentv = 0;
-                            
-                        push(std::pow(basev, exponentv));
+                    case OpCode::POP:
+                        pop();
                         break;
-                    }
-                    else if (fname == "atan2")
-                    {
-                        // atan2 requires 2 arguments
+                    case OpCode::SWAP:
                         if (stack.size() < 2)
                         {
-                            std::cerr << "VM: Math function 'atan2' requires 2 arguments\n";
-                            push(Value{}); // Return sol
+                            std::cerr << "VM stack underflow for SWAP" << std::endl;
                             break;
                         }
-                        auto y = pop();
-                        auto x = pop();
-                        double xv = 0, yv = 0;
-                        
-                        if (std::holds_alternative<int64_t>(x))
-                            xv = static_cast<double>(std::get<int64_t>(x));
-                        else if (std::holds_alternative<double>(x))
-                            xv = std::get<double>(x);
-                        else
-                            xv = 0;
-                            
-                        if (std::holds_alternative<int64_t>(y))
-                            yv = static_cast<double>(std::get<int64_t>(y));
-                        else if (std::holds_alternative<double>(y))
-                            yv = std::get<double>(y);
-                        else
-                            yv = 0;
-                            
-                        push(std::atan2(yv, xv));
+                        std::swap(stack[stack.size() - 1], stack[stack.size() - 2]);
                         break;
-                    }
-                    
-                    auto math_func = Linh::LiPM::get_math_function(fname);
-                    if (math_func)
+                    case OpCode::ADD:
+                    case OpCode::SUB:
+                    case OpCode::MUL:
+                    case OpCode::DIV:
+                    case OpCode::MOD:
+                    case OpCode::HASH:  // # (floor division)
+                    case OpCode::AMP:   // & (bitwise and)
+                    case OpCode::PIPE:  // | (bitwise or)
+                    case OpCode::CARET: // ^ (bitwise xor)
+                    case OpCode::LT_LT: // << (bitwise shift left)
+                    case OpCode::GT_GT: // >> (bitwise shift right)
                     {
-                        if (stack.empty())
-                        {
-                            std::cerr << "VM: Math function '" << fname << "' requires an argument\n";
-                            push(Value{}); // Return sol
-                            break;
-                        }
-                        auto val = pop();
-                        auto result = math_func(val);
-                        push(result);
-                        break;
-                    }
-                    // Kiểm tra xem có function object trên stack không
 #ifdef _DEBUG
-                    std::cerr << "[DEBUG] CALL: checking for function object on stack, size=" << stack.size() << std::endl;
-                    if (!stack.empty()) {
-                        std::cerr << "[DEBUG] CALL: top of stack index = " << stack.back().index() << std::endl;
-                    }
-#endif
-                    if (!stack.empty() && stack.back().index() == 8) { // FunctionPtr is at index 8 in Value
-#ifdef _DEBUG
-                        std::cerr << "[DEBUG] CALL: found function object, calling it" << std::endl;
-#endif
-                        // Gọi function object
-                        auto fn = std::get<8>(stack.back());
-                        pop(); // Pop function object
-                        
-                        // Thu thập arguments từ stack (arguments được push theo thứ tự ngược)
-                        std::vector<Value> args;
-                        size_t expected_args = fn->params.size();
-                        
-                        // Arguments được push theo thứ tự từ trái sang phải, nên trên stack sẽ ngược lại
-                        for (size_t i = 0; i < expected_args; ++i) {
-                            if (stack.empty()) {
-                                std::cerr << "Error: Not enough arguments for function " << fn->name << std::endl;
-                                push(Value()); // Push default value
-                                break;
-                            }
-                            args.insert(args.begin(), pop()); // Insert at beginning để giữ thứ tự đúng
+                        // Debug: In stack trước khi pop
+                        std::cerr << "[DEBUG] Stack before pop (size=" << stack.size() << "): ";
+                        for (const auto &v : stack)
+                        {
+                            if (std::holds_alternative<int64_t>(v))
+                                std::cerr << std::get<int64_t>(v) << " ";
+                            else if (std::holds_alternative<double>(v))
+                                std::cerr << std::get<double>(v) << " ";
+                            else if (std::holds_alternative<std::string>(v))
+                                std::cerr << "\"" << std::get<std::string>(v) << "\" ";
+                            else if (std::holds_alternative<bool>(v))
+                                std::cerr << (std::get<bool>(v) ? "true" : "false") << " ";
+                            else
+                                std::cerr << "(?) ";
                         }
-                        
-#ifdef _DEBUG
-                        std::cerr << "[DEBUG] CALL: calling function " << fn->name << " with " << args.size() << " arguments" << std::endl;
+                        std::cerr << std::endl;
 #endif
-                        
-                        // Gọi function object
-                        auto result = call_function(fn, args, *this);
-                        push(result);
+                        auto b = pop();
+                        auto a = pop();
 #ifdef _DEBUG
-                        std::cerr << "[DEBUG] CALL: function executed, result pushed to stack, ip=" << ip << std::endl;
+                        // Debug: In giá trị a, b
+                        std::cerr << "[DEBUG] a=";
+                        if (std::holds_alternative<int64_t>(a))
+                            std::cerr << std::get<int64_t>(a);
+                        else if (std::holds_alternative<double>(a))
+                            std::cerr << std::get<double>(a);
+                        else if (std::holds_alternative<std::string>(a))
+                            std::cerr << "\"" << std::get<std::string>(a) << "\"";
+                        else if (std::holds_alternative<bool>(a))
+                            std::cerr << (std::get<bool>(a) ? "true" : "false");
+                        else
+                            std::cerr << "(?)";
+                        std::cerr << ", b=";
+                        if (std::holds_alternative<int64_t>(b))
+                            std::cerr << std::get<int64_t>(b);
+                        else if (std::holds_alternative<double>(b))
+                            std::cerr << std::get<double>(b);
+                        else if (std::holds_alternative<std::string>(b))
+                            std::cerr << "\"" << std::get<std::string>(b) << "\"";
+                        else if (std::holds_alternative<bool>(b))
+                            std::cerr << (std::get<bool>(b) ? "true" : "false");
+                        else
+                            std::cerr << "(?)";
+                        std::cerr << std::endl;
 #endif
-                        break;
-                    }
-                    
-                    if (!functions.count(fname))
-                    {
-                        std::cerr << "VM: Unknown function '" << fname << "'\n";
-                        break;
-                    }
-                    const auto &fn = functions[fname];
-                    // Pop arguments in reverse order
-                    std::vector<Value> args;
-                    for (size_t i = 0; i < fn.param_names.size(); ++i)
-                        args.push_back(pop());
-                    std::reverse(args.begin(), args.end());
-                    // Save current frame
-                    CallFrame frame;
-                    frame.return_ip = ip + 1;
-                    frame.locals = variables;
-                    call_stack.push_back(frame);
-                    // Set up new variables for function
-                    variables.clear();
-                    for (size_t i = 0; i < fn.param_names.size(); ++i)
-                        variables[i] = args[i];
-                    // Run function code
-                    size_t saved_ip = ip;
-                    size_t fn_ip = 0;
-                    while (fn_ip < fn.code.size())
-                    {
-                        const auto &finstr = fn.code[fn_ip];
-                        switch (finstr.opcode)
+                        // --- HỖ TRỢ NỐI CHUỖI ---
+                        if (finstr.opcode == OpCode::ADD &&
+                            (std::holds_alternative<std::string>(a) || std::holds_alternative<std::string>(b)))
                         {
-                        case OpCode::PUSH_INT:
-                            push(Value(std::get<int64_t>(finstr.operand)));
-                            break;
-                        case OpCode::PUSH_UINT:
-                            push(Value(std::get<uint64_t>(finstr.operand)));
-                            break;
-                        case OpCode::PUSH_FLOAT:
-                            push(Value(std::get<double>(finstr.operand)));
-                            break;
-                        case OpCode::PUSH_STR:
-                            push(Value(std::get<std::string>(finstr.operand)));
-                            break;
-                        case OpCode::PUSH_BOOL:
-                            push(Value(std::get<bool>(finstr.operand)));
-                            break;
-                        case OpCode::POP:
-                            pop();
-                            break;
-                        case OpCode::SWAP:
-                            if (stack.size() < 2)
-                            {
-                                std::cerr << "VM stack underflow for SWAP" << std::endl;
-                                break;
-                            }
-                            std::swap(stack[stack.size() - 1], stack[stack.size() - 2]);
-                            break;
-                        case OpCode::ADD:
-                        case OpCode::SUB:
-                        case OpCode::MUL:
-                        case OpCode::DIV:
-                        case OpCode::MOD:
-                        case OpCode::HASH:  // # (floor division)
-                        case OpCode::AMP:   // & (bitwise and)
-                        case OpCode::PIPE:  // | (bitwise or)
-                        case OpCode::CARET: // ^ (bitwise xor)
-                        case OpCode::LT_LT: // << (bitwise shift left)
-                        case OpCode::GT_GT: // >> (bitwise shift right)
-                        {
-#ifdef _DEBUG
-                            // Debug: In stack trước khi pop
-                            std::cerr << "[DEBUG] Stack before pop (size=" << stack.size() << "): ";
-                            for (const auto &v : stack)
-                            {
-                                if (std::holds_alternative<int64_t>(v))
-                                    std::cerr << std::get<int64_t>(v) << " ";
-                                else if (std::holds_alternative<double>(v))
-                                    std::cerr << std::get<double>(v) << " ";
-                                else if (std::holds_alternative<std::string>(v))
-                                    std::cerr << "\"" << std::get<std::string>(v) << "\" ";
-                                else if (std::holds_alternative<bool>(v))
-                                    std::cerr << (std::get<bool>(v) ? "true" : "false") << " ";
-                                else
-                                    std::cerr << "(?) ";
-                            }
-                            std::cerr << std::endl;
-#endif
-                            auto b = pop();
-                            auto a = pop();
-#ifdef _DEBUG
-                            // Debug: In giá trị a, b
-                            std::cerr << "[DEBUG] a=";
-                            if (std::holds_alternative<int64_t>(a))
-                                std::cerr << std::get<int64_t>(a);
+                            std::string sa, sb;
+                            // Chuyển a về string
+                            if (std::holds_alternative<std::string>(a))
+                                sa = std::get<std::string>(a);
+                            else if (std::holds_alternative<int64_t>(a))
+                                sa = std::to_string(std::get<int64_t>(a));
                             else if (std::holds_alternative<double>(a))
-                                std::cerr << std::get<double>(a);
-                            else if (std::holds_alternative<std::string>(a))
-                                std::cerr << "\"" << std::get<std::string>(a) << "\"";
+                                sa = std::to_string(std::get<double>(a));
                             else if (std::holds_alternative<bool>(a))
-                                std::cerr << (std::get<bool>(a) ? "true" : "false");
-                            else
-                                std::cerr << "(?)";
-                            std::cerr << ", b=";
-                            if (std::holds_alternative<int64_t>(b))
-                                std::cerr << std::get<int64_t>(b);
+                                sa = std::get<bool>(a) ? "true" : "false";
+                            // Chuyển b về string
+                            if (std::holds_alternative<std::string>(b))
+                                sb = std::get<std::string>(b);
+                            else if (std::holds_alternative<int64_t>(b))
+                                sb = std::to_string(std::get<int64_t>(b));
                             else if (std::holds_alternative<double>(b))
-                                std::cerr << std::get<double>(b);
-                            else if (std::holds_alternative<std::string>(b))
-                                std::cerr << "\"" << std::get<std::string>(b) << "\"";
+                                sb = std::to_string(std::get<double>(b));
                             else if (std::holds_alternative<bool>(b))
-                                std::cerr << (std::get<bool>(b) ? "true" : "false");
-                            else
-                                std::cerr << "(?)";
-                            std::cerr << std::endl;
-#endif
-                            // --- HỖ TRỢ NỐI CHUỖI ---
-                            if (finstr.opcode == OpCode::ADD &&
-                                (std::holds_alternative<std::string>(a) || std::holds_alternative<std::string>(b)))
+                                sb = std::get<bool>(b) ? "true" : "false";
+                            push(sa + sb);
+                            break;
+                        }
+                        // --- KẾT THÚC HỖ TRỢ NỐI CHUỖI ---
+                        if (std::holds_alternative<int64_t>(a) && std::holds_alternative<int64_t>(b))
+                        {
+                            int64_t av = std::get<int64_t>(a);
+                            int64_t bv = std::get<int64_t>(b);
+                            switch (finstr.opcode)
                             {
-                                std::string sa, sb;
-                                // Chuyển a về string
-                                if (std::holds_alternative<std::string>(a))
-                                    sa = std::get<std::string>(a);
-                                else if (std::holds_alternative<int64_t>(a))
-                                    sa = std::to_string(std::get<int64_t>(a));
-                                else if (std::holds_alternative<double>(a))
-                                    sa = std::to_string(std::get<double>(a));
-                                else if (std::holds_alternative<bool>(a))
-                                    sa = std::get<bool>(a) ? "true" : "false";
-                                // Chuyển b về string
-                                if (std::holds_alternative<std::string>(b))
-                                    sb = std::get<std::string>(b);
-                                else if (std::holds_alternative<int64_t>(b))
-                                    sb = std::to_string(std::get<int64_t>(b));
-                                else if (std::holds_alternative<double>(b))
-                                    sb = std::to_string(std::get<double>(b));
-                                else if (std::holds_alternative<bool>(b))
-                                    sb = std::get<bool>(b) ? "true" : "false";
-                                push(sa + sb);
+                            case OpCode::ADD:
+                                push(av + bv);
                                 break;
-                            }
-                            // --- KẾT THÚC HỖ TRỢ NỐI CHUỖI ---
-                            if (std::holds_alternative<int64_t>(a) && std::holds_alternative<int64_t>(b))
-                            {
-                                int64_t av = std::get<int64_t>(a);
-                                int64_t bv = std::get<int64_t>(b);
-                                switch (finstr.opcode)
+                            case OpCode::SUB:
+                                push(av - bv);
+                                break;
+                            case OpCode::MUL:
+                                push(av * bv);
+                                break;
+                            case OpCode::DIV:
+                            case OpCode::MOD:
+                                if ((finstr.opcode == OpCode::DIV || finstr.opcode == OpCode::MOD) && bv == 0)
                                 {
-                                case OpCode::ADD:
-                                    push(av + bv);
-                                    break;
-                                case OpCode::SUB:
-                                    push(av - bv);
-                                    break;
-                                case OpCode::MUL:
-                                    push(av * bv);
-                                    break;
-                                case OpCode::DIV:
-                                case OpCode::MOD:
-                                    if ((finstr.opcode == OpCode::DIV || finstr.opcode == OpCode::MOD) && bv == 0)
-                                    {
-                                        std::string err_msg = "Division by zero (int)";
-#ifdef _DEBUG
-                                        std::cerr << "[DEBUG] Division by zero detected. try_stack size: " << try_stack.size() << std::endl;
-                                        if (!try_stack.empty()) {
-                                            std::cerr << "[DEBUG] catch_ip: " << try_stack.back().catch_ip << ", current ip: " << ip << std::endl;
-                                        }
-#endif
-                                        if (!try_stack.empty())
-                                        {
-                                            // Get the error variable index from the try frame
-                                            int error_var_index = 1; // Default to 1 for "error"
-                                            if (!try_stack.empty() && try_stack.back().error_var == "error")
-                                            {
-                                                error_var_index = 1; // "error" variable is at index 1
-                                            }
-                                            variables[error_var_index] = err_msg;
-                                            ip = try_stack.back().catch_ip;
-#ifdef _DEBUG
-                                            std::cerr << "[DEBUG] Jumping to catch block at ip: " << ip << std::endl;
-#endif
-                                            continue;
-                                        }
-                                        else
-                                        {
-                                            std::cerr << "ERROR [Line: " << instr.line << ", Col: " << instr.col << "] VM: " << err_msg << std::endl;
-                                            return;
-                                        }
-                                    }
-                                    if (finstr.opcode == OpCode::DIV)
-                                        push(av / bv);
-                                    else
-                                        push(av % bv);
-                                    break;
-                                case OpCode::HASH:
-                                    if (bv == 0)
-                                    {
-                                        std::string err_msg = "Floor division by zero (int)";
-                                        if (!try_stack.empty())
-                                        {
-                                            // Get the error variable index from the try frame
-                                            int error_var_index = 1; // Default to 1 for "error"
-                                            if (!try_stack.empty() && try_stack.back().error_var == "error")
-                                            {
-                                                error_var_index = 1; // "error" variable is at index 1
-                                            }
-                                            variables[error_var_index] = err_msg;
-                                            ip = try_stack.back().catch_ip;
-                                            continue;
-                                        }
-                                        else
-                                        {
-                                            std::cerr << "ERROR [Line: " << instr.line << ", Col: " << instr.col << "] VM: " << err_msg << std::endl;
-                                            return;
-                                        }
-                                    }
-                                    // Python-like floor division for int
-                                    if ((av < 0) != (bv < 0) && av % bv != 0)
-                                        push((av / bv) - 1);
-                                    else
-                                        push(av / bv);
-                                    break;
-                                case OpCode::AMP:
-                                    push(av & bv);
-                                    break;
-                                case OpCode::PIPE:
-                                    push(av | bv);
-                                    break;
-                                case OpCode::CARET:
-                                    push(av ^ bv);
-                                    break;
-                                case OpCode::LT_LT:
-                                    push(av << bv);
-                                    break;
-                                case OpCode::GT_GT:
-                                    push(av >> bv);
-                                    break;
-                                default:
-                                    break;
+                                    std::string err_msg = "Division by zero (int)";
+                                    throw std::runtime_error(err_msg); // VM::run tra bảng exception để tìm catch
                                 }
-                            }
-                            else if ((std::holds_alternative<int64_t>(a) || std::holds_alternative<double>(a)) &&
-                                     (std::holds_alternative<int64_t>(b) || std::holds_alternative<double>(b)))
-                            {
-                                double av = std::holds_alternative<int64_t>(a) ? static_cast<double>(std::get<int64_t>(a)) : std::get<double>(a);
-                                double bv = std::holds_alternative<int64_t>(b) ? static_cast<double>(std::get<int64_t>(b)) : std::get<double>(b);
-                                switch (finstr.opcode)
+                                if (finstr.opcode == OpCode::DIV)
+                                    push(av / bv);
+                                else
+                                    push(av % bv);
+                                break;
+                            case OpCode::HASH:
+                                if (bv == 0)
                                 {
-                                case OpCode::ADD:
-                                    push(av + bv);
-                                    break;
-                                case OpCode::SUB:
-                                    push(av - bv);
-                                    break;
-                                case OpCode::MUL:
-                                    push(av * bv);
-                                    break;
-                                case OpCode::DIV:
-                                    if (bv == 0.0)
-                                    {
-                                        std::string err_msg = "Division by zero (float)";
-                                        if (!try_stack.empty())
-                                        {
-                                            // Get the error variable index from the try frame
-                                            int error_var_index = 1; // Default to 1 for "error"
-                                            if (!try_stack.empty() && try_stack.back().error_var == "error")
-                                            {
-                                                error_var_index = 1; // "error" variable is at index 1
-                                            }
-                                            variables[error_var_index] = err_msg;
-                                            ip = try_stack.back().catch_ip;
-                                            continue;
-                                        }
-                                        else
-                                        {
-                                            std::cerr << "ERROR [Line: " << instr.line << ", Col: " << instr.col << "] VM: " << err_msg << std::endl;
-                                            return;
-                                        }
-                                    }
-                                    else
-                                    {
-                                        push(av / bv);
-                                    }
-                                    break;
-                                case OpCode::MOD:
-                                    if (bv == 0.0)
-                                    {
-                                        std::string err_msg = "Modulo by zero (float)";
-                                        if (!try_stack.empty())
-                                        {
-                                            // Get the error variable index from the try frame
-                                            int error_var_index = 1; // Default to 1 for "error"
-                                            if (!try_stack.empty() && try_stack.back().error_var == "error")
-                                            {
-                                                error_var_index = 1; // "error" variable is at index 1
-                                            }
-                                            variables[error_var_index] = err_msg;
-                                            ip = try_stack.back().catch_ip;
-                                            continue;
-                                        }
-                                        else
-                                        {
-                                            std::cerr << "ERROR [Line: " << instr.line << ", Col: " << instr.col << "] VM: " << err_msg << std::endl;
-                                            return;
-                                        }
-                                    }
-                                    else
-                                    {
-                                        push(std::fmod(av, bv));
-                                    }
-                                    break;
-                                case OpCode::HASH:
-                                    if (bv == 0.0)
-                                    {
-                                        std::string err_msg = "Floor division by zero (float)";
-                                        if (!try_stack.empty())
-                                        {
-                                            // Get the error variable index from the try frame
-                                            int error_var_index = 1; // Default to 1 for "error"
-                                            if (!try_stack.empty() && try_stack.back().error_var == "error")
-                                            {
-                                                error_var_index = 1; // "error" variable is at index 1
-                                            }
-                                            variables[error_var_index] = err_msg;
-                                            ip = try_stack.back().catch_ip;
-                                            continue;
-                                        }
-                                        else
-                                        {
-                                            std::cerr << "ERROR [Line: " << instr.line << ", Col: " << instr.col << "] VM: " << err_msg << std::endl;
-                                            return;
-                                        }
-                                    }
-                                    else
-                                    {
-                                        push(std::floor(av / bv));
-                                    }
-                                    break;
-                                default:
-                                    break;
+                                    std::string err_msg = "Floor division by zero (int)";
+                                    throw std::runtime_error(err_msg); // VM::run tra bảng exception để tìm catch
                                 }
-                            }
-                            else
-                            {
-                                std::cerr << "VM: ADD/SUB/MUL/DIV/MOD only supports int/float" << std::endl;
-                            }
-                            break;
-                        }
-                        case OpCode::AND:
-                        case OpCode::OR:
-                        {
-                            auto b = pop();
-                            auto a = pop();
-                            if (std::holds_alternative<bool>(a) && std::holds_alternative<bool>(b))
-                            {
-                                bool av = std::get<bool>(a);
-                                bool bv = std::get<bool>(b);
-                                if (finstr.opcode == OpCode::AND)
-                                    push(av && bv);
+                                // Python-like floor division for int
+                                if ((av < 0) != (bv < 0) && av % bv != 0)
+                                    push((av / bv) - 1);
                                 else
-                                    push(av || bv);
-                            }
-                            else
-                            {
-                                std::cerr << "VM: AND/OR only supports bool" << std::endl;
-                                push(false);
-                            }
-                            break;
-                        }
-                        case OpCode::NOT:
-                        {
-                            auto a = pop();
-                            if (std::holds_alternative<bool>(a))
-                                push(!std::get<bool>(a));
-                            else if (std::holds_alternative<int64_t>(a))
-                                push(~std::get<int64_t>(a)); // bitwise NOT
-                            else {
-                                std::cerr << "VM: NOT only supports bool or int" << std::endl;
-                                push(false);
+                                    push(av / bv);
+                                break;
+                            case OpCode::AMP:
+                                push(av & bv);
+                                break;
+                            case OpCode::PIPE:
+                                push(av | bv);
+                                break;
+                            case OpCode::CARET:
+                                push(av ^ bv);
+                                break;
+                            case OpCode::LT_LT:
+                                push(av << bv);
+                                break;
+                            case OpCode::GT_GT:
+                                push(av >> bv);
+                                break;
+                            default:
+                                break;
                             }
-                            break;
                         }
-                        case OpCode::EQ:
-                        case OpCode::NEQ:
-                        case OpCode::LT:
-                        case OpCode::GT:
-                        case OpCode::LTE:
-                        case OpCode::GTE:
+                        else if ((std::holds_alternative<int64_t>(a) || std::holds_alternative<double>(a)) &&
+                                 (std::holds_alternative<int64_t>(b) || std::holds_alternative<double>(b)))
                         {
-#ifdef _DEBUG
-                            // Debug: In stack trước khi pop
-                            std::cerr << "[DEBUG] Stack before pop (size=" << stack.size() << "): ";
-                            for (const auto &v : stack)
+                            double av = std::holds_alternative<int64_t>(a) ? static_cast<double>(std::get<int64_t>(a)) : std::get<double>(a);
+                            double bv = std::holds_alternative<int64_t>(b) ? static_cast<double>(std::get<int64_t>(b)) : std::get<double>(b);
+                            switch (finstr.opcode)
                             {
-                                if (std::holds_alternative<int64_t>(v))
-                                    std::cerr << std::get<int64_t>(v) << " ";
-                                else if (std::holds_alternative<double>(v))
-                                    std::cerr << std::get<double>(v) << " ";
-                                else if (std::holds_alternative<std::string>(v))
-                                    std::cerr << "\"" << std::get<std::string>(v) << "\" ";
-                                else if (std::holds_alternative<bool>(v))
-                                    std::cerr << (std::get<bool>(v) ? "true" : "false") << " ";
+                            case OpCode::ADD:
+                                push(av + bv);
+                                break;
+                            case OpCode::SUB:
+                                push(av - bv);
+                                break;
+                            case OpCode::MUL:
+                                push(av * bv);
+                                break;
+                            case OpCode::DIV:
+                                if (bv == 0.0)
+                                {
+                                    std::string err_msg = "Division by zero (float)";
+                                    throw std::runtime_error(err_msg); // VM::run tra bảng exception để tìm catch
+                                }
                                 else
-                                    std::cerr << "(?) ";
-                            }
-                            std::cerr << std::endl;
-#endif
-                            auto b = pop();
-                            auto a = pop();
-#ifdef _DEBUG
-                            // Debug: In giá trị a, b
-                            std::cerr << "[DEBUG] a=";
-                            if (std::holds_alternative<int64_t>(a))
-                                std::cerr << std::get<int64_t>(a);
-                            else if (std::holds_alternative<double>(a))
-                                std::cerr << std::get<double>(a);
-                            else if (std::holds_alternative<std::string>(a))
-                                std::cerr << "\"" << std::get<std::string>(a) << "\"";
-                            else if (std::holds_alternative<bool>(a))
-                                std::cerr << (std::get<bool>(a) ? "true" : "false");
-                            else
-                                std::cerr << "(?)";
-                            std::cerr << ", b=";
-                            if (std::holds_alternative<int64_t>(b))
-                                std::cerr << std::get<int64_t>(b);
-                            else if (std::holds_alternative<double>(b))
-                                std::cerr << std::get<double>(b);
-                            else if (std::holds_alternative<std::string>(b))
-                                std::cerr << "\"" << std::get<std::string>(b) << "\"";
-                            else if (std::holds_alternative<bool>(b))
-                                std::cerr << (std::get<bool>(b) ? "true" : "false");
-                            else
-                                std::cerr << "(?)";
-                            std::cerr << std::endl;
-#endif
-
-                            bool result = false;
-                            // So sánh chuỗi nếu một trong hai là string
-                            if (std::holds_alternative<std::string>(a) || std::holds_alternative<std::string>(b))
-                            {
-                                std::string sa, sb;
-                                if (std::holds_alternative<std::string>(a))
-                                    sa = std::get<std::string>(a);
-                                else if (std::holds_alternative<int64_t>(a))
-                                    sa = std::to_string(std::get<int64_t>(a));
-                                else if (std::holds_alternative<double>(a))
-                                    sa = std::to_string(std::get<double>(a));
-                                else if (std::holds_alternative<bool>(a))
-                                    sa = std::get<bool>(a) ? "true" : "false";
-                                if (std::holds_alternative<std::string>(b))
-                                    sb = std::get<std::string>(b);
-                                else if (std::holds_alternative<int64_t>(b))
-                                    sb = std::to_string(std::get<int64_t>(b));
-                                else if (std::holds_alternative<double>(b))
-                                    sb = std::to_string(std::get<double>(b));
-                                else if (std::holds_alternative<bool>(b))
-                                    sb = std::get<bool>(b) ? "true" : "false";
-                                // Do NOT push(sa + sb) for comparison ops!
-                                // Instead, compare as strings:
-                                switch (instr.opcode)
                                 {
-                                case OpCode::EQ:
-                                    result = (sa == sb);
-                                    break;
-                                case OpCode::NEQ:
-                                    result = (sa != sb);
-                                    break;
-                                case OpCode::LT:
-                                    result = (sa < sb);
-                                    break;
-                                case OpCode::GT:
-                                    result = (sa > sb);
-                                    break;
-                                case OpCode::LTE:
-                                    result = (sa <= sb);
-                                    break;
-                                case OpCode::GTE:
-                                    result = (sa >= sb);
-                                    break;
-                                default:
-                                    result = false;
-                                    break;
+                                    push(av / bv);
                                 }
-                                push(result);
                                 break;
-                            }
-                            // So sánh bool nếu cả hai là bool
-                            if (std::holds_alternative<bool>(a) && std::holds_alternative<bool>(b))
-                            {
-                                bool av = std::get<bool>(a);
-                                bool bv = std::get<bool>(b);
-                                switch (instr.opcode)
+                            case OpCode::MOD:
+                                if (bv == 0.0)
                                 {
-                                case OpCode::EQ:
-                                    result = (av == bv);
-                                    break;
-                                case OpCode::NEQ:
-                                    result = (av != bv);
-                                    break;
-                                case OpCode::LT:
-                                    result = (!av && bv);
-                                    break;
-                                case OpCode::GT:
-                                    result = (av && !bv);
-                                    break;
-                                case OpCode::LTE:
-                                    result = (!av || bv);
-                                    break;
-                                case OpCode::GTE:
-                                    result = (av || !bv);
-                                    break;
-                                default:
-                                    result = false;
-                                    break;
+                                    std::string err_msg = "Modulo by zero (float)";
+                                    throw std::runtime_error(err_msg); // VM::run tra bảng exception để tìm catch
+                                }
+                                else
+                                {
+                                    push(std::fmod(av, bv));
                                 }
-                                push(result);
                                 break;
-                            }
-                            // So sánh số nếu cả hai là số
-                            if ((std::holds_alternative<int64_t>(a) || std::holds_alternative<double>(a)) &&
-                                (std::holds_alternative<int64_t>(b) || std::holds_alternative<double>(b)))
-                            {
-                                double av = std::holds_alternative<int64_t>(a) ? static_cast<double>(std::get<int64_t>(a)) : std::get<double>(a);
-                                double bv = std::holds_alternative<int64_t>(b) ? static_cast<double>(std::get<int64_t>(b)) : std::get<double>(b);
-                                switch (instr.opcode)
+                            case OpCode::HASH:
+                                if (bv == 0.0)
                                 {
-                                case OpCode::EQ:
-                                    result = (av == bv);
-                                    break;
-                                case OpCode::NEQ:
-                                    result = (av != bv);
-                                    break;
-                                case OpCode::LT:
-                                    result = (av < bv);
-                                    break;
-                                case OpCode::GT:
-                                    result = (av > bv);
-                                    break;
-                                case OpCode::LTE:
-                                    result = (av <= bv);
-                                    break;
-                                case OpCode::GTE:
-                                    result = (av >= bv);
-                                    break;
-                                default:
-                                    result = false;
-                                    break;
+                                    std::string err_msg = "Floor division by zero (float)";
+                                    throw std::runtime_error(err_msg); // VM::run tra bảng exception để tìm catch
                                 }
-                                push(result);
+                                else
+                                {
+                                    push(std::floor(av / bv));
+                                }
+                                break;
+                            default:
                                 break;
                             }
-                            // Nếu kiểu không khớp, chuyển về chuỗi rồi so sánh
+                        }
+                        else
+                        {
+                            std::cerr << "VM: ADD/SUB/MUL/DIV/MOD only supports int/float" << std::endl;
+                        }
+                        break;
+                    }
+                    case OpCode::AND:
+                    case OpCode::OR:
+                    {
+                        auto b = pop();
+                        auto a = pop();
+                        if (std::holds_alternative<bool>(a) && std::holds_alternative<bool>(b))
+                        {
+                            bool av = std::get<bool>(a);
+                            bool bv = std::get<bool>(b);
+                            if (finstr.opcode == OpCode::AND)
+                                push(av && bv);
+                            else
+                                push(av || bv);
+                        }
+                        else
+                        {
+                            std::cerr << "VM: AND/OR only supports bool" << std::endl;
+                            push(false);
+                        }
+                        break;
+                    }
+                    case OpCode::NOT:
+                    {
+                        auto a = pop();
+                        if (std::holds_alternative<bool>(a))
+                            push(!std::get<bool>(a));
+                        else if (std::holds_alternative<int64_t>(a))
+                            push(~std::get<int64_t>(a)); // bitwise NOT
+                        else {
+                            std::cerr << "VM: NOT only supports bool or int" << std::endl;
+                            push(false);
+                        }
+                        break;
+                    }
+                    case OpCode::EQ:
+                    case OpCode::NEQ:
+                    case OpCode::LT:
+                    case OpCode::GT:
+                    case OpCode::LTE:
+                    case OpCode::GTE:
+                    {
+#ifdef _DEBUG
+                        // Debug: In stack trước khi pop
+                        std::cerr << "[DEBUG] Stack before pop (size=" << stack.size() << "): ";
+                        for (const auto &v : stack)
+                        {
+                            if (std::holds_alternative<int64_t>(v))
+                                std::cerr << std::get<int64_t>(v) << " ";
+                            else if (std::holds_alternative<double>(v))
+                                std::cerr << std::get<double>(v) << " ";
+                            else if (std::holds_alternative<std::string>(v))
+                                std::cerr << "\"" << std::get<std::string>(v) << "\" ";
+                            else if (std::holds_alternative<bool>(v))
+                                std::cerr << (std::get<bool>(v) ? "true" : "false") << " ";
+                            else
+                                std::cerr << "(?) ";
+                        }
+                        std::cerr << std::endl;
+#endif
+                        auto b = pop();
+                        auto a = pop();
+#ifdef _DEBUG
+                        // Debug: In giá trị a, b
+                        std::cerr << "[DEBUG] a=";
+                        if (std::holds_alternative<int64_t>(a))
+                            std::cerr << std::get<int64_t>(a);
+                        else if (std::holds_alternative<double>(a))
+                            std::cerr << std::get<double>(a);
+                        else if (std::holds_alternative<std::string>(a))
+                            std::cerr << "\"" << std::get<std::string>(a) << "\"";
+                        else if (std::holds_alternative<bool>(a))
+                            std::cerr << (std::get<bool>(a) ? "true" : "false");
+                        else
+                            std::cerr << "(?)";
+                        std::cerr << ", b=";
+                        if (std::holds_alternative<int64_t>(b))
+                            std::cerr << std::get<int64_t>(b);
+                        else if (std::holds_alternative<double>(b))
+                            std::cerr << std::get<double>(b);
+                        else if (std::holds_alternative<std::string>(b))
+                            std::cerr << "\"" << std::get<std::string>(b) << "\"";
+                        else if (std::holds_alternative<bool>(b))
+                            std::cerr << (std::get<bool>(b) ? "true" : "false");
+                        else
+                            std::cerr << "(?)";
+                        std::cerr << std::endl;
+#endif
+
+                        bool result = false;
+                        // So sánh chuỗi nếu một trong hai là string
+                        if (std::holds_alternative<std::string>(a) || std::holds_alternative<std::string>(b))
+                        {
                             std::string sa, sb;
-                            // a
-                            if (std::holds_alternative<int64_t>(a))
+                            if (std::holds_alternative<std::string>(a))
+                                sa = std::get<std::string>(a);
+                            else if (std::holds_alternative<int64_t>(a))
                                 sa = std::to_string(std::get<int64_t>(a));
                             else if (std::holds_alternative<double>(a))
                                 sa = std::to_string(std::get<double>(a));
                             else if (std::holds_alternative<bool>(a))
                                 sa = std::get<bool>(a) ? "true" : "false";
-                            else if (std::holds_alternative<std::string>(a))
-                                sa = std::get<std::string>(a);
-                            else
-                                sa = "";
-                            // b
-                            if (std::holds_alternative<int64_t>(b))
+                            if (std::holds_alternative<std::string>(b))
+                                sb = std::get<std::string>(b);
+                            else if (std::holds_alternative<int64_t>(b))
                                 sb = std::to_string(std::get<int64_t>(b));
                             else if (std::holds_alternative<double>(b))
                                 sb = std::to_string(std::get<double>(b));
                             else if (std::holds_alternative<bool>(b))
                                 sb = std::get<bool>(b) ? "true" : "false";
-                            else if (std::holds_alternative<std::string>(b))
-                                sb = std::get<std::string>(b);
-                            else
-                                sb = "";
+                            // Do NOT push(sa + sb) for comparison ops!
+                            // Instead, compare as strings:
                             switch (instr.opcode)
                             {
                             case OpCode::EQ:
@@ -1709,725 +1613,863 @@ namespace Linh
                             push(result);
                             break;
                         }
-                        case OpCode::LOAD_VAR:
+                        // So sánh bool nếu cả hai là bool
+                        if (std::holds_alternative<bool>(a) && std::holds_alternative<bool>(b))
                         {
-                            int idx = std::get<int64_t>(finstr.operand);
-#ifdef _DEBUG
-                            std::cerr << "[DEBUG] LOAD_VAR idx=" << idx << ", variables.size()=" << variables.size() << std::endl;
-#endif
-                            if (variables.count(idx))
-                                push(variables[idx]);
-                            else
+                            bool av = std::get<bool>(a);
+                            bool bv = std::get<bool>(b);
+                            switch (instr.opcode)
                             {
-                                std::cerr << "VM: LOAD_VAR unknown variable index " << idx << std::endl;
-                                push(int64_t(0));
+                            case OpCode::EQ:
+                                result = (av == bv);
+                                break;
+                            case OpCode::NEQ:
+                                result = (av != bv);
+                                break;
+                            case OpCode::LT:
+                                result = (!av && bv);
+                                break;
+                            case OpCode::GT:
+                                result = (av && !bv);
+                                break;
+                            case OpCode::LTE:
+                                result = (!av || bv);
+                                break;
+                            case OpCode::GTE:
+                                result = (av || !bv);
+                                break;
+                            default:
+                                result = false;
+                                break;
                             }
+                            push(result);
                             break;
                         }
-                        case OpCode::STORE_VAR:
+                        // So sánh số nếu cả hai là số
+                        if ((std::holds_alternative<int64_t>(a) || std::holds_alternative<double>(a)) &&
+                            (std::holds_alternative<int64_t>(b) || std::holds_alternative<double>(b)))
                         {
-                            int idx = std::get<int64_t>(finstr.operand);
-                            if (stack.empty())
+                            double av = std::holds_alternative<int64_t>(a) ? static_cast<double>(std::get<int64_t>(a)) : std::get<double>(a);
+                            double bv = std::holds_alternative<int64_t>(b) ? static_cast<double>(std::get<int64_t>(b)) : std::get<double>(b);
+                            switch (instr.opcode)
                             {
-                                stack.push_back(std::monostate{});
+                            case OpCode::EQ:
+                                result = (av == bv);
+                                break;
+                            case OpCode::NEQ:
+                                result = (av != bv);
+                                break;
+                            case OpCode::LT:
+                                result = (av < bv);
+                                break;
+                            case OpCode::GT:
+                                result = (av > bv);
+                                break;
+                            case OpCode::LTE:
+                                result = (av <= bv);
+                                break;
+                            case OpCode::GTE:
+                                result = (av >= bv);
+                                break;
+                            default:
+                                result = false;
+                                break;
                             }
-                            variables[idx] = pop();
+                            push(result);
                             break;
                         }
-                        case OpCode::PRINT:
+                        // Nếu kiểu không khớp, chuyển về chuỗi rồi so sánh
+                        std::string sa, sb;
+                        // a
+                        if (std::holds_alternative<int64_t>(a))
+                            sa = std::to_string(std::get<int64_t>(a));
+                        else if (std::holds_alternative<double>(a))
+                            sa = std::to_string(std::get<double>(a));
+                        else if (std::holds_alternative<bool>(a))
+                            sa = std::get<bool>(a) ? "true" : "false";
+                        else if (std::holds_alternative<std::string>(a))
+                            sa = std::get<std::string>(a);
+                        else
+                            sa = "";
+                        // b
+                        if (std::holds_alternative<int64_t>(b))
+                            sb = std::to_string(std::get<int64_t>(b));
+                        else if (std::holds_alternative<double>(b))
+                            sb = std::to_string(std::get<double>(b));
+                        else if (std::holds_alternative<bool>(b))
+                            sb = std::get<bool>(b) ? "true" : "false";
+                        else if (std::holds_alternative<std::string>(b))
+                            sb = std::get<std::string>(b);
+                        else
+                            sb = "";
+                        switch (instr.opcode)
                         {
-                            auto val = pop();
-                            LinhIO::linh_print(val);
+                        case OpCode::EQ:
+                            result = (sa == sb);
                             break;
-                        }
-                        case OpCode::PRINT_MULTIPLE:
-                        {
-                            std::cerr << "[DEBUG] PRINT_MULTIPLE in second switch case" << std::endl;
-                            int64_t count = std::get<int64_t>(finstr.operand);
-                            std::cerr << "[DEBUG] PRINT_MULTIPLE: count=" << count << ", stack_size=" << stack.size() << std::endl;
-                            if (stack.size() < static_cast<size_t>(count))
-                            {
-                                std::cerr << "ERROR [Line " << finstr.line << ", Col " << finstr.col << "] RuntimeError : VM stack underflow for PRINT_MULTIPLE" << std::endl;
-                                break;
-                            }
-                            
-                            // Pop all values and convert them to strings
-                            std::vector<std::string> strings;
-                            for (int i = 0; i < count; i++) {
-                                auto val = pop();
-                                std::cerr << "[DEBUG] PRINT_MULTIPLE: popped value " << i << ": " << Linh::to_str(val) << std::endl;
-                                strings.push_back(Linh::to_str(val));
-                            }
-                            
-                            // Reverse the strings to get correct order
-                            std::reverse(strings.begin(), strings.end());
-                            
-                            // Join strings with space separator (like Python's print)
-                            std::string result;
-                            for (size_t i = 0; i < strings.size(); i++) {
-                                if (i > 0) result += " ";
-                                result += strings[i];
-                            }
-                            
-                            std::cerr << "[DEBUG] PRINT_MULTIPLE: final result: '" << result << "'" << std::endl;
-                            LinhIO::linh_print(Value(result));
+                        case OpCode::NEQ:
+                            result = (sa != sb);
                             break;
-                        }
-                        case OpCode::PRINTF:
-                        {
-                            auto val = pop();
-                            LinhIO::linh_printf(val);
+                        case OpCode::LT:
+                            result = (sa < sb);
                             break;
-                        }
-                        case OpCode::INPUT:
-                        {
-                            auto prompt = pop();
-                            std::string prompt_str;
-                            if (std::holds_alternative<std::string>(prompt))
-                                prompt_str = std::get<std::string>(prompt);
-                            else
-                                prompt_str = "";
-                            auto input_val = LinhIO::linh_input(prompt_str);
-                            push(input_val);
+                        case OpCode::GT:
+                            result = (sa > sb);
                             break;
-                        }
-                        case OpCode::TYPEOF:
-                        {
-                            auto val = pop();
-                            if (std::holds_alternative<int64_t>(val))
-                                std::cout << "int" << std::endl;
-                            else if (std::holds_alternative<double>(val))
-                                std::cout << "float" << std::endl;
-                            else if (std::holds_alternative<std::string>(val))
-                                std::cout << "str" << std::endl;
-                            else if (std::holds_alternative<bool>(val))
-                                std::cout << "bool" << std::endl;
-                            else if (std::holds_alternative<Array>(val))
-                                std::cout << "array" << std::endl;
-                            else if (std::holds_alternative<Map>(val))
-                                std::cout << "map" << std::endl;
-                            else
-                                std::cout << "unknown" << std::endl;
+                        case OpCode::LTE:
+                            result = (sa <= sb);
+                            break;
+                        case OpCode::GTE:
+                            result = (sa >= sb);
                             break;
-                        }
-                        case OpCode::RET:
-                            // --- Fix: Always push a value to the stack before returning ---
-                            if (stack.empty())
-                            {
-                                stack.push_back(std::monostate{});
-                            }
-                            // Restore previous frame
-                            if (!call_stack.empty())
-                            {
-                                variables = call_stack.back().locals;
-                                ip = call_stack.back().return_ip;
-                                call_stack.pop_back();
-                            }
-                            else
-                            {
-                                ip = chunk.size(); // End program
-                            }
-                            goto function_returned;
                         default:
+                            result = false;
                             break;
                         }
-                        ++fn_ip;
-                    }
-                function_returned:
-                    continue;
-                }
-                case OpCode::RET:
-                    // --- Fix: Always push a value to the stack before returning from global code (should not happen, but for safety) ---
-                    if (stack.empty())
-                    {
-                        stack.push_back(std::monostate{});
-                    }
-                    return;
-                // --- Thêm xử lý TRY-CATCH-FINALLY ---
-                case OpCode::TRY:
-                {
-                    // operand = tuple (catch_ip, finally_ip, end_ip, error_var)
-                    const auto &info = std::get<std::tuple<int64_t, int64_t, int64_t, std::string>>(instr.operand);
-                    try_stack.emplace_back(
-                        static_cast<size_t>(std::get<0>(info)),
-                        static_cast<size_t>(std::get<1>(info)),
-                        static_cast<size_t>(std::get<2>(info)),
-                        std::get<3>(info));
-                    break;
-                }
-                case OpCode::END_TRY:
-                {
-                    if (!try_stack.empty())
-                        try_stack.pop_back();
-                    break;
-                }
-                case OpCode::DUP:
-#ifdef _DEBUG
-                    std::cerr << "[DEBUG] DUP stack size before: " << stack.size() << std::endl;
-#endif
-                    if (stack.empty())
-                    {
-                        std::cerr << "VM stack underflow for DUP" << std::endl;
+                        push(result);
                         break;
                     }
-                    stack.push_back(stack.back());
+                    case OpCode::LOAD_VAR:
+                    {
+                        int idx = std::get<int64_t>(finstr.operand);
 #ifdef _DEBUG
-                    std::cerr << "[DEBUG] DUP stack size after: " << stack.size() << std::endl;
+                        std::cerr << "[DEBUG] LOAD_VAR idx=" << idx << ", variables.size()=" << variables.size() << std::endl;
 #endif
-                    break;
-                case OpCode::PUSH_ARRAY:
-                {
-                    int64_t n = std::get<int64_t>(instr.operand);
-                    if (n < 0 || (size_t)n > stack.size())
-                    {
-                        std::cerr << "VM: Invalid array size for PUSH_ARRAY: " << n << std::endl;
-                        push(Value{}); // push uninit
-                        break;
-                    }
-                    Array arr = make_array();
-                    arr->reserve(n);
-                    // Pop n phần tử (theo thứ tự ngược lại)
-                    for (int64_t i = 0; i < n; ++i)
-                    {
-                        arr->push_back(pop());
-                    }
-                    // Đảo ngược lại để đúng thứ tự literal
-                    std::reverse(arr->begin(), arr->end());
-                    push(arr);
-                    break;
-                }
-                case OpCode::PUSH_MAP:
-                {
-                    int64_t n = std::get<int64_t>(instr.operand);
-                    if (n < 0 || (size_t)(2 * n) > stack.size())
-                    {
-                        std::cerr << "VM: Invalid map size for PUSH_MAP: " << n << std::endl;
-                        push(Value{}); // push uninit
-                        break;
-                    }
-                    Map map = make_map();
-                    // Pop n cặp (value trước, key sau)
-                    for (int64_t i = 0; i < n; ++i)
-                    {
-                        Value value = pop();
-                        Value key = pop();
-                        std::string key_str;
-                        if (std::holds_alternative<std::string>(key))
-                            key_str = std::get<std::string>(key);
-                        else if (std::holds_alternative<int64_t>(key))
-                            key_str = std::to_string(std::get<int64_t>(key));
-                        else if (std::holds_alternative<double>(key))
-                            key_str = std::to_string(std::get<double>(key));
-                        else if (std::holds_alternative<bool>(key))
-                            key_str = std::get<bool>(key) ? "true" : "false";
-                        else
-                            key_str = "";
-                        (*map)[key_str] = value;
-                    }
-                    push(map);
-                    break;
-                }
-                case OpCode::ARRAY_GET:
-                {
-                    if (stack.size() < 2)
-                    {
-                        std::cerr << "VM: ARRAY_GET stack underflow" << std::endl;
-                        push(Value{}); // push sol
-                        break;
-                    }
-                    Value idx = pop();
-                    Value obj = pop();
-                    // Nếu là array
-                    if (std::holds_alternative<Array>(obj))
-                    {
-                        const auto &arr = std::get<Array>(obj);
-                        int64_t i = 0;
-                        if (std::holds_alternative<int64_t>(idx))
-                            i = std::get<int64_t>(idx);
-                        else if (std::holds_alternative<double>(idx))
-                            i = static_cast<int64_t>(std::get<double>(idx));
+                        if (variables.count(idx))
+                            push(variables[idx]);
                         else
                         {
-                            push(Value{}); // sol
-                            break;
-                        }
-                        if (i < 0 || static_cast<size_t>(i) >= arr->size())
-                        {
-                            push(Value{}); // sol
-                        }
-                        else
-                        {
-                            push((*arr)[i]);
+                            std::cerr << "VM: LOAD_VAR unknown variable index " << idx << std::endl;
+                            push(int64_t(0));
                         }
+                        break;
                     }
-                    else if (std::holds_alternative<Map>(obj))
+                    case OpCode::STORE_VAR:
                     {
-                        const auto &map = std::get<Map>(obj);
-                        std::string key;
-                        if (std::holds_alternative<std::string>(idx))
-                            key = std::get<std::string>(idx);
-                        else if (std::holds_alternative<int64_t>(idx))
-                            key = std::to_string(std::get<int64_t>(idx));
-                        else if (std::holds_alternative<double>(idx))
-                            key = std::to_string(std::get<double>(idx));
-                        else if (std::holds_alternative<bool>(idx))
-                            key = std::get<bool>(idx) ? "true" : "false";
-                        else
-                        {
-                            push(Value{}); // sol
-                            break;
-                        }
-                        auto it = map->find(key);
-                        if (it != map->end())
-                        {
-                            push(it->second);
-                        }
-                        else
+                        int idx = std::get<int64_t>(finstr.operand);
+                        if (stack.empty())
                         {
-                            push(Value{}); // sol
+                            stack.push_back(std::monostate{});
                         }
+                        variables[idx] = pop();
+                        break;
                     }
-                    else
-                    {
-                        push(Value{}); // sol
-                    }
-                    break;
-                }
-                case OpCode::ID:
-                {
-                    if (stack.empty())
+                    case OpCode::PRINT:
                     {
-                        push("0x0");
+                        auto val = pop();
+                        LinhIO::linh_print(output, val);
+                        break;
                     }
-                    else
+                    case OpCode::PRINT_MULTIPLE:
                     {
-                        const Value &val = stack.back();
-                        std::string addr_str;
-                        // For Array/Map: use the address of the underlying object
-                        if (std::holds_alternative<Array>(val))
+                        std::cerr << "[DEBUG] PRINT_MULTIPLE in second switch case" << std::endl;
+                        int64_t count = std::get<int64_t>(finstr.operand);
+                        std::cerr << "[DEBUG] PRINT_MULTIPLE: count=" << count << ", stack_size=" << stack.size() << std::endl;
+                        if (stack.size() < static_cast<size_t>(count))
                         {
-                            const auto &arr = std::get<Array>(val);
-                            addr_str = fmt::format("0x{:x}", reinterpret_cast<uintptr_t>(arr.get()));
+                            std::cerr << "ERROR [Line " << finstr.line << ", Col " << finstr.col << "] RuntimeError : VM stack underflow for PRINT_MULTIPLE" << std::endl;
+                            break;
                         }
-                        else if (std::holds_alternative<Map>(val))
-                        {
-                            const auto &map = std::get<Map>(val);
-                            addr_str = fmt::format("0x{:x}", reinterpret_cast<uintptr_t>(map.get()));
+                        
+                        // Pop all values and convert them to strings
+                        std::vector<std::string> strings;
+                        for (int i = 0; i < count; i++) {
+                            auto val = pop();
+                            std::cerr << "[DEBUG] PRINT_MULTIPLE: popped value " << i << ": " << Linh::to_str(val) << std::endl;
+                            strings.push_back(Linh::to_str(val));
                         }
-                        else
-                        {
-                            // For primitives: use the address of the value in the stack
-                            addr_str = fmt::format("0x{:x}", reinterpret_cast<uintptr_t>(&val));
+                        
+                        // Reverse the strings to get correct order
+                        std::reverse(strings.begin(), strings.end());
+                        
+                        // Join strings with space separator (like Python's print)
+                        std::string result;
+                        for (size_t i = 0; i < strings.size(); i++) {
+                            if (i > 0) result += " ";
+                            result += strings[i];
                         }
-                        push(addr_str);
-                    }
-                    break;
-                }
-                case OpCode::ARRAY_APPEND:
-                {
-                    if (stack.size() < 2)
-                    {
-                        std::cerr << "VM: ARRAY_APPEND stack underflow" << std::endl;
-                        push(Value{}); // push sol
-                        break;
-                    }
-                    Value val = pop();
-                    Value arr_val = pop();
-                    if (std::holds_alternative<Array>(arr_val))
-                    {
-                        auto arr = std::get<Array>(arr_val);
-                        arr->push_back(val);
-                        push(arr); // push lại array
-                    }
-                    else
-                    {
-                        std::cerr << "VM: ARRAY_APPEND target is not array" << std::endl;
-                        push(Value{}); // push sol
-                    }
-                    break;
-                }
-                case OpCode::ARRAY_REMOVE:
-                {
-                    if (stack.size() < 2)
-                    {
-                        std::cerr << "VM: ARRAY_REMOVE stack underflow" << std::endl;
-                        push(Value{}); // push sol
-                        break;
-                    }
-                    Value val = pop();
-                    Value arr_val = pop();
-                    if (std::holds_alternative<Array>(arr_val))
-                    {
-                        auto arr = std::get<Array>(arr_val);
-                        // Tìm và xóa phần tử đầu tiên == val
-                        auto it = std::find_if(arr->begin(), arr->end(), [&](const Value &v)
-                                               {
-                            // So sánh giá trị (chỉ hỗ trợ int, uint, double, string, bool)
-                            if (v.index() != val.index()) return false;
-                            if (std::holds_alternative<int64_t>(v))
-                                return std::get<int64_t>(v) == std::get<int64_t>(val);
-                            if (std::holds_alternative<uint64_t>(v))
-                                return std::get<uint64_t>(v) == std::get<uint64_t>(val);
-                            if (std::holds_alternative<double>(v))
-                                return std::get<double>(v) == std::get<double>(val);
-                            if (std::holds_alternative<std::string>(v))
-                                return std::get<std::string>(v) == std::get<std::string>(val);
-                            if (std::holds_alternative<bool>(v))
-                                return std::get<bool>(v) == std::get<bool>(val);
-                            return false; });
-                        if (it != arr->end())
-                            arr->erase(it);
-                        push(arr); // push lại array
-                    }
-                    else
-                    {
-                        std::cerr << "VM: ARRAY_REMOVE target is not array" << std::endl;
-                        push(Value{}); // push sol
-                    }
-                    break;
-                }
-                case OpCode::ARRAY_CLEAR:
-                {
-                    if (stack.empty())
-                    {
-                        std::cerr << "VM: ARRAY_CLEAR stack underflow" << std::endl;
-                        push(Value{}); // push sol
-                        break;
-                    }
-                    Value arr_val = pop();
-                    if (std::holds_alternative<Array>(arr_val))
-                    {
-                        auto arr = std::get<Array>(arr_val);
-                        arr->clear();
-                        push(arr); // push lại array
-                    }
-                    else
-                    {
-                        std::cerr << "VM: ARRAY_CLEAR target is not array" << std::endl;
-                        push(Value{}); // push sol
-                    }
-                    break;
-                }
-                case OpCode::ARRAY_CLONE:
-                {
-                    if (stack.empty())
-                    {
-                        std::cerr << "VM: ARRAY_CLONE stack underflow" << std::endl;
-                        push(Value{}); // push sol
+                        
+                        std::cerr << "[DEBUG] PRINT_MULTIPLE: final result: '" << result << "'" << std::endl;
+                        LinhIO::linh_print(output, Value(result));
                         break;
                     }
-                    Value arr_val = pop();
-                    if (std::holds_alternative<Array>(arr_val))
+                    case OpCode::PRINTF:
                     {
-                        auto arr = std::get<Array>(arr_val);
-                        auto arr_clone = make_array();
-                        *arr_clone = *arr;
-                        push(arr_clone);
-                    }
-                    else
-                    {
-                        std::cerr << "VM: ARRAY_CLONE target is not array" << std::endl;
-                        push(Value{}); // push sol
-                    }
-                    break;
-                }
-                case OpCode::ARRAY_POP:
-                {
-                    if (stack.empty())
-                    {
-                        std::cerr << "VM: ARRAY_POP stack underflow" << std::endl;
-                        push(Value{}); // push sol
+                        auto val = pop();
+                        LinhIO::linh_printf(output, val);
                         break;
                     }
-                    Value maybe_idx_or_arr = pop();
-                    // Nếu trên stack tiếp theo là array thì đây là dạng a.pop(index)
-                    if (!stack.empty() && std::holds_alternative<Array>(stack.back()))
+                    case OpCode::INPUT:
                     {
-                        auto arr = std::get<Array>(pop());
-                        // Xác định index
-                        int64_t idx = -1;
-                        if (std::holds_alternative<int64_t>(maybe_idx_or_arr))
-                            idx = std::get<int64_t>(maybe_idx_or_arr);
-                        else if (std::holds_alternative<double>(maybe_idx_or_arr))
-                            idx = static_cast<int64_t>(std::get<double>(maybe_idx_or_arr));
+                        auto prompt = pop();
+                        std::string prompt_str;
+                        if (std::holds_alternative<std::string>(prompt))
+                            prompt_str = std::get<std::string>(prompt);
                         else
-                        {
-                            push(Value{}); // sol nếu index không hợp lệ
-                            break;
-                        }
-                        if (idx < 0 || static_cast<size_t>(idx) >= arr->size())
-                        {
-                            push(Value{}); // sol nếu index out of range
-                        }
+                            prompt_str = "";
+                        auto input_val = LinhIO::linh_input(output, input, prompt_str);
+                        push(input_val);
+                        break;
+                    }
+                    case OpCode::TYPEOF:
+                    {
+                        auto val = pop();
+                        if (std::holds_alternative<int64_t>(val))
+                            std::cout << "int" << std::endl;
+                        else if (std::holds_alternative<double>(val))
+                            std::cout << "float" << std::endl;
+                        else if (std::holds_alternative<std::string>(val))
+                            std::cout << "str" << std::endl;
+                        else if (std::holds_alternative<bool>(val))
+                            std::cout << "bool" << std::endl;
+                        else if (std::holds_alternative<Array>(val))
+                            std::cout << "array" << std::endl;
+                        else if (std::holds_alternative<Map>(val))
+                            std::cout << "map" << std::endl;
                         else
+                            std::cout << "unknown" << std::endl;
+                        break;
+                    }
+                    case OpCode::RET:
+                        // --- Fix: Always push a value to the stack before returning ---
+                        if (stack.empty())
                         {
-                            Value popped = (*arr)[idx];
-                            arr->erase(arr->begin() + idx);
-                            push(popped);
+                            stack.push_back(std::monostate{});
                         }
-                    }
-                    else if (std::holds_alternative<Array>(maybe_idx_or_arr))
-                    {
-                        // Dạng a.pop() không có index
-                        auto arr = std::get<Array>(maybe_idx_or_arr);
-                        if (!arr->empty())
+                        // Restore previous frame (đóng ô upvalue trỏ vào frame của hàm trước khi bỏ frame)
+                        if (!call_stack.empty())
                         {
-                            Value popped = arr->back();
-                            arr->pop_back();
-                            push(popped);
+                            close_upvalues(upvalue_base);
+                            variables.swap(call_stack.back().locals);
+                            release_frame(std::move(call_stack.back().locals)); // Sau swap là map của hàm vừa chạy
+                            ip = call_stack.back().return_ip;
+                            call_stack.pop_back();
                         }
                         else
                         {
-                            push(Value{}); // sol nếu mảng rỗng
+                            ip = chunk.size(); // End program
                         }
+                        goto function_returned;
+                    default:
+                        break;
                     }
-                    else
-                    {
-                        std::cerr << "VM: ARRAY_POP target is not array" << std::endl;
-                        push(Value{}); // push sol
-                    }
+                    ++fn_ip;
+                }
+            function_returned:
+                continue;
+            }
+            case OpCode::RET:
+                // --- Fix: Always push a value to the stack before returning from global code (should not happen, but for safety) ---
+                if (stack.empty())
+                {
+                    stack.push_back(std::monostate{});
+                }
+                return;
+            // --- TRY-CATCH-FINALLY ---
+            // Vùng try nằm trong bảng exception tĩnh (xem LiVM::run), TRY/END_TRY không còn làm gì
+            case OpCode::TRY:
+            case OpCode::END_TRY:
+                break;
+            case OpCode::DUP:
+#ifdef _DEBUG
+                std::cerr << "[DEBUG] DUP stack size before: " << stack.size() << std::endl;
+#endif
+                if (stack.empty())
+                {
+                    std::cerr << "VM stack underflow for DUP" << std::endl;
+                    break;
+                }
+                stack.push_back(stack.back());
+#ifdef _DEBUG
+                std::cerr << "[DEBUG] DUP stack size after: " << stack.size() << std::endl;
+#endif
+                break;
+            case OpCode::PUSH_ARRAY:
+            {
+                int64_t n = std::get<int64_t>(instr.operand);
+                if (n < 0 || (size_t)n > stack.size())
+                {
+                    std::cerr << "VM: Invalid array size for PUSH_ARRAY: " << n << std::endl;
+                    push(Value{}); // push uninit
                     break;
                 }
-                case OpCode::MAP_GET:
+                Array arr = make_array();
+                arr->reserve(n);
+                // Pop n phần tử (theo thứ tự ngược lại)
+                for (int64_t i = 0; i < n; ++i)
                 {
-                    if (stack.size() < 2)
-                    {
-                        std::cerr << "VM: MAP_GET stack underflow" << std::endl;
-                        push(Value{}); // push sol
-                        break;
-                    }
+                    arr->push_back(pop());
+                }
+                // Đảo ngược lại để đúng thứ tự literal
+                std::reverse(arr->begin(), arr->end());
+                push(arr);
+                break;
+            }
+            case OpCode::PUSH_MAP:
+            {
+                int64_t n = std::get<int64_t>(instr.operand);
+                if (n < 0 || (size_t)(2 * n) > stack.size())
+                {
+                    std::cerr << "VM: Invalid map size for PUSH_MAP: " << n << std::endl;
+                    push(Value{}); // push uninit
+                    break;
+                }
+                Map map = make_map();
+                // Pop n cặp (value trước, key sau)
+                for (int64_t i = 0; i < n; ++i)
+                {
+                    Value value = pop();
                     Value key = pop();
-                    Value map = pop();
-                    if (std::holds_alternative<Map>(map))
-                    {
-                        const auto &m = std::get<Map>(map);
-                        std::string key_str;
-                        if (std::holds_alternative<std::string>(key))
-                            key_str = std::get<std::string>(key);
-                        else if (std::holds_alternative<int64_t>(key))
-                            key_str = std::to_string(std::get<int64_t>(key));
-                        else if (std::holds_alternative<double>(key))
-                            key_str = std::to_string(std::get<double>(key));
-                        else if (std::holds_alternative<bool>(key))
-                            key_str = std::get<bool>(key) ? "true" : "false";
-                        else
-                            key_str = "";
-                        auto it = m->find(key_str);
-                        if (it != m->end())
-                            push(it->second);
-                        else
-                            push(Value{}); // sol
-                    }
+                    std::string key_str;
+                    if (std::holds_alternative<std::string>(key))
+                        key_str = std::get<std::string>(key);
+                    else if (std::holds_alternative<int64_t>(key))
+                        key_str = std::to_string(std::get<int64_t>(key));
+                    else if (std::holds_alternative<double>(key))
+                        key_str = std::to_string(std::get<double>(key));
+                    else if (std::holds_alternative<bool>(key))
+                        key_str = std::get<bool>(key) ? "true" : "false";
                     else
-                    {
-                        push(Value{}); // sol
-                    }
+                        key_str = "";
+                    (*map)[key_str] = value;
+                }
+                push(map);
+                break;
+            }
+            case OpCode::ARRAY_GET:
+            {
+                if (stack.size() < 2)
+                {
+                    std::cerr << "VM: ARRAY_GET stack underflow" << std::endl;
+                    push(Value{}); // push sol
                     break;
                 }
-                case OpCode::MAP_SET:
+                Value idx = pop();
+                Value obj = pop();
+                // Nếu là array
+                if (std::holds_alternative<Array>(obj))
                 {
-                    if (stack.size() < 3)
+                    const auto &arr = std::get<Array>(obj);
+                    int64_t i = 0;
+                    if (std::holds_alternative<int64_t>(idx))
+                        i = std::get<int64_t>(idx);
+                    else if (std::holds_alternative<double>(idx))
+                        i = static_cast<int64_t>(std::get<double>(idx));
+                    else
                     {
-                        std::cerr << "VM: MAP_SET stack underflow" << std::endl;
-                        push(Value{}); // push sol
+                        push(Value{}); // sol
                         break;
                     }
-                    Value value = pop();
-                    Value key = pop();
-                    Value map = pop();
-                    if (std::holds_alternative<Map>(map))
+                    if (i < 0 || static_cast<size_t>(i) >= arr->size())
                     {
-                        auto m = std::get<Map>(map);
-                        std::string key_str;
-                        if (std::holds_alternative<std::string>(key))
-                            key_str = std::get<std::string>(key);
-                        else if (std::holds_alternative<int64_t>(key))
-                            key_str = std::to_string(std::get<int64_t>(key));
-                        else if (std::holds_alternative<double>(key))
-                            key_str = std::to_string(std::get<double>(key));
-                        else if (std::holds_alternative<bool>(key))
-                            key_str = std::get<bool>(key) ? "true" : "false";
-                        else
-                            key_str = "";
-                        (*m)[key_str] = value;
-                        push(map); // push lại map
+                        push(Value{}); // sol
                     }
                     else
                     {
-                        std::cerr << "VM: MAP_SET target is not map" << std::endl;
-                        push(Value{}); // push sol
+                        push((*arr)[i]);
                     }
-                    break;
                 }
-                case OpCode::MAP_DELETE:
+                else if (std::holds_alternative<Map>(obj))
                 {
-                    if (stack.size() < 2)
+                    const auto &map = std::get<Map>(obj);
+                    std::string key;
+                    if (std::holds_alternative<std::string>(idx))
+                        key = std::get<std::string>(idx);
+                    else if (std::holds_alternative<int64_t>(idx))
+                        key = std::to_string(std::get<int64_t>(idx));
+                    else if (std::holds_alternative<double>(idx))
+                        key = std::to_string(std::get<double>(idx));
+                    else if (std::holds_alternative<bool>(idx))
+                        key = std::get<bool>(idx) ? "true" : "false";
+                    else
                     {
-                        std::cerr << "VM: MAP_DELETE stack underflow" << std::endl;
-                        push(Value{});
+                        push(Value{}); // sol
                         break;
                     }
-                    Value key_val = pop();
-                    Value map_val = pop();
-                    if (std::holds_alternative<Map>(map_val))
+                    auto it = map->find(key);
+                    if (it != map->end())
                     {
-                        auto map = std::get<Map>(map_val);
-                        std::string key;
-                        if (std::holds_alternative<std::string>(key_val))
-                            key = std::get<std::string>(key_val);
-                        else if (std::holds_alternative<int64_t>(key_val))
-                            key = std::to_string(std::get<int64_t>(key_val));
-                        else if (std::holds_alternative<double>(key_val))
-                            key = std::to_string(std::get<double>(key_val));
-                        else if (std::holds_alternative<bool>(key_val))
-                            key = std::get<bool>(key_val) ? "true" : "false";
-                        else
-                            key = "";
-                        map->erase(key);
-                        push(map);
+                        push(it->second);
                     }
                     else
                     {
-                        std::cerr << "VM: MAP_DELETE target is not map" << std::endl;
-                        push(Value{});
+                        push(Value{}); // sol
                     }
-                    break;
                 }
-                case OpCode::MAP_CLEAR:
+                else
+                {
+                    push(Value{}); // sol
+                }
+                break;
+            }
+            case OpCode::ID:
+            {
+                if (stack.empty())
+                {
+                    push("0x0");
+                }
+                else
                 {
-                    if (stack.empty())
+                    const Value &val = stack.back();
+                    std::string addr_str;
+                    // For Array/Map: use the address of the underlying object
+                    if (std::holds_alternative<Array>(val))
                     {
-                        std::cerr << "VM: MAP_CLEAR stack underflow" << std::endl;
-                        push(Value{});
-                        break;
+                        const auto &arr = std::get<Array>(val);
+                        addr_str = fmt::format("0x{:x}", reinterpret_cast<uintptr_t>(arr.get()));
                     }
-                    Value map_val = pop();
-                    if (std::holds_alternative<Map>(map_val))
+                    else if (std::holds_alternative<Map>(val))
                     {
-                        auto map = std::get<Map>(map_val);
-                        map->clear();
-                        push(map);
+                        const auto &map = std::get<Map>(val);
+                        addr_str = fmt::format("0x{:x}", reinterpret_cast<uintptr_t>(map.get()));
                     }
                     else
                     {
-                        std::cerr << "VM: MAP_CLEAR target is not map" << std::endl;
-                        push(Value{});
+                        // For primitives: use the address of the value in the stack
+                        addr_str = fmt::format("0x{:x}", reinterpret_cast<uintptr_t>(&val));
                     }
+                    push(addr_str);
+                }
+                break;
+            }
+            case OpCode::ARRAY_APPEND:
+            {
+                if (stack.size() < 2)
+                {
+                    std::cerr << "VM: ARRAY_APPEND stack underflow" << std::endl;
+                    push(Value{}); // push sol
                     break;
                 }
-                case OpCode::MAP_KEYS:
+                Value val = pop();
+                Value arr_val = pop();
+                if (std::holds_alternative<Array>(arr_val))
                 {
-                    if (stack.empty())
+                    auto arr = std::get<Array>(arr_val);
+                    arr->push_back(val);
+                    push(arr); // push lại array
+                }
+                else
+                {
+                    std::cerr << "VM: ARRAY_APPEND target is not array" << std::endl;
+                    push(Value{}); // push sol
+                }
+                break;
+            }
+            case OpCode::ARRAY_REMOVE:
+            {
+                if (stack.size() < 2)
+                {
+                    std::cerr << "VM: ARRAY_REMOVE stack underflow" << std::endl;
+                    push(Value{}); // push sol
+                    break;
+                }
+                Value val = pop();
+                Value arr_val = pop();
+                if (std::holds_alternative<Array>(arr_val))
+                {
+                    auto arr = std::get<Array>(arr_val);
+                    // Tìm và xóa phần tử đầu tiên == val
+                    auto it = std::find_if(arr->begin(), arr->end(), [&](const Value &v)
+                                           {
+                        // So sánh giá trị (chỉ hỗ trợ int, uint, double, string, bool)
+                        if (v.index() != val.index()) return false;
+                        if (std::holds_alternative<int64_t>(v))
+                            return std::get<int64_t>(v) == std::get<int64_t>(val);
+                        if (std::holds_alternative<uint64_t>(v))
+                            return std::get<uint64_t>(v) == std::get<uint64_t>(val);
+                        if (std::holds_alternative<double>(v))
+                            return std::get<double>(v) == std::get<double>(val);
+                        if (std::holds_alternative<std::string>(v))
+                            return std::get<std::string>(v) == std::get<std::string>(val);
+                        if (std::holds_alternative<bool>(v))
+                            return std::get<bool>(v) == std::get<bool>(val);
+                        return false; });
+                    if (it != arr->end())
+                        arr->erase(it);
+                    push(arr); // push lại array
+                }
+                else
+                {
+                    std::cerr << "VM: ARRAY_REMOVE target is not array" << std::endl;
+                    push(Value{}); // push sol
+                }
+                break;
+            }
+            case OpCode::ARRAY_CLEAR:
+            {
+                if (stack.empty())
+                {
+                    std::cerr << "VM: ARRAY_CLEAR stack underflow" << std::endl;
+                    push(Value{}); // push sol
+                    break;
+                }
+                Value arr_val = pop();
+                if (std::holds_alternative<Array>(arr_val))
+                {
+                    auto arr = std::get<Array>(arr_val);
+                    arr->clear();
+                    push(arr); // push lại array
+                }
+                else
+                {
+                    std::cerr << "VM: ARRAY_CLEAR target is not array" << std::endl;
+                    push(Value{}); // push sol
+                }
+                break;
+            }
+            case OpCode::ARRAY_CLONE:
+            {
+                if (stack.empty())
+                {
+                    std::cerr << "VM: ARRAY_CLONE stack underflow" << std::endl;
+                    push(Value{}); // push sol
+                    break;
+                }
+                Value arr_val = pop();
+                if (std::holds_alternative<Array>(arr_val))
+                {
+                    auto arr = std::get<Array>(arr_val);
+                    auto arr_clone = make_array();
+                    *arr_clone = *arr;
+                    push(arr_clone);
+                }
+                else
+                {
+                    std::cerr << "VM: ARRAY_CLONE target is not array" << std::endl;
+                    push(Value{}); // push sol
+                }
+                break;
+            }
+            case OpCode::ARRAY_POP:
+            {
+                if (stack.empty())
+                {
+                    std::cerr << "VM: ARRAY_POP stack underflow" << std::endl;
+                    push(Value{}); // push sol
+                    break;
+                }
+                Value maybe_idx_or_arr = pop();
+                // Nếu trên stack tiếp theo là array thì đây là dạng a.pop(index)
+                if (!stack.empty() && std::holds_alternative<Array>(stack.back()))
+                {
+                    auto arr = std::get<Array>(pop());
+                    // Xác định index
+                    int64_t idx = -1;
+                    if (std::holds_alternative<int64_t>(maybe_idx_or_arr))
+                        idx = std::get<int64_t>(maybe_idx_or_arr);
+                    else if (std::holds_alternative<double>(maybe_idx_or_arr))
+                        idx = static_cast<int64_t>(std::get<double>(maybe_idx_or_arr));
+                    else
                     {
-                        std::cerr << "VM: MAP_KEYS stack underflow" << std::endl;
-                        push(Value{});
+                        push(Value{}); // sol nếu index không hợp lệ
                         break;
                     }
-                    Value map_val = pop();
-                    if (std::holds_alternative<Map>(map_val))
+                    if (idx < 0 || static_cast<size_t>(idx) >= arr->size())
                     {
-                        auto map = std::get<Map>(map_val);
-                        Array arr = make_array();
-                        for (const auto &kv : *map)
-                        {
-                            arr->push_back(kv.first);
-                        }
-                        push(arr);
+                        push(Value{}); // sol nếu index out of range
                     }
                     else
                     {
-                        std::cerr << "VM: MAP_KEYS target is not map" << std::endl;
-                        push(Value{});
+                        Value popped = (*arr)[idx];
+                        arr->erase(arr->begin() + idx);
+                        push(popped);
                     }
-                    break;
                 }
-                case OpCode::MAP_VALUES:
+                else if (std::holds_alternative<Array>(maybe_idx_or_arr))
                 {
-                    if (stack.empty())
+                    // Dạng a.pop() không có index
+                    auto arr = std::get<Array>(maybe_idx_or_arr);
+                    if (!arr->empty())
                     {
-                        std::cerr << "VM: MAP_VALUES stack underflow" << std::endl;
-                        push(Value{});
-                        break;
-                    }
-                    Value map_val = pop();
-                    if (std::holds_alternative<Map>(map_val))
-                    {
-                        auto map = std::get<Map>(map_val);
-                        Array arr = make_array();
-                        for (const auto &kv : *map)
-                        {
-                            arr->push_back(kv.second);
-                        }
-                        push(arr);
+                        Value popped = arr->back();
+                        arr->pop_back();
+                        push(popped);
                     }
                     else
                     {
-                        std::cerr << "VM: MAP_VALUES target is not map" << std::endl;
-                        push(Value{});
+                        push(Value{}); // sol nếu mảng rỗng
                     }
+                }
+                else
+                {
+                    std::cerr << "VM: ARRAY_POP target is not array" << std::endl;
+                    push(Value{}); // push sol
+                }
+                break;
+            }
+            case OpCode::MAP_GET:
+            {
+                if (stack.size() < 2)
+                {
+                    std::cerr << "VM: MAP_GET stack underflow" << std::endl;
+                    push(Value{}); // push sol
                     break;
                 }
-                case OpCode::LOAD_PACKAGE_CONST:
+                Value key = pop();
+                Value map = pop();
+                if (std::holds_alternative<Map>(map))
                 {
-                    // Operand is a string: "package.constant"
-                    std::string full_name;
-                    if (std::holds_alternative<std::string>(instr.operand))
-                        full_name = std::get<std::string>(instr.operand);
+                    const auto &m = std::get<Map>(map);
+                    std::string key_str;
+                    if (std::holds_alternative<std::string>(key))
+                        key_str = std::get<std::string>(key);
+                    else if (std::holds_alternative<int64_t>(key))
+                        key_str = std::to_string(std::get<int64_t>(key));
+                    else if (std::holds_alternative<double>(key))
+                        key_str = std::to_string(std::get<double>(key));
+                    else if (std::holds_alternative<bool>(key))
+                        key_str = std::get<bool>(key) ? "true" : "false";
                     else
-                        full_name = "";
-                    auto dot_pos = full_name.find('.');
-                    if (dot_pos != std::string::npos)
-                    {
-                        std::string package = full_name.substr(0, dot_pos);
-                        std::string constant = full_name.substr(dot_pos + 1);
-                        auto val = Linh::LiPM::get_constant(package, constant);
-                        push(val);
-                    }
+                        key_str = "";
+                    auto it = m->find(key_str);
+                    if (it != m->end())
+                        push(it->second);
                     else
-                    {
                         push(Value{}); // sol
-                    }
+                }
+                else
+                {
+                    push(Value{}); // sol
+                }
+                break;
+            }
+            case OpCode::MAP_SET:
+            {
+                if (stack.size() < 3)
+                {
+                    std::cerr << "VM: MAP_SET stack underflow" << std::endl;
+                    push(Value{}); // push sol
                     break;
                 }
-                default:
-                    ++ip;
+                Value value = pop();
+                Value key = pop();
+                Value map = pop();
+                if (std::holds_alternative<Map>(map))
+                {
+                    auto m = std::get<Map>(map);
+                    std::string key_str;
+                    if (std::holds_alternative<std::string>(key))
+                        key_str = std::get<std::string>(key);
+                    else if (std::holds_alternative<int64_t>(key))
+                        key_str = std::to_string(std::get<int64_t>(key));
+                    else if (std::holds_alternative<double>(key))
+                        key_str = std::to_string(std::get<double>(key));
+                    else if (std::holds_alternative<bool>(key))
+                        key_str = std::get<bool>(key) ? "true" : "false";
+                    else
+                        key_str = "";
+                    (*m)[key_str] = value;
+                    push(map); // push lại map
+                }
+                else
+                {
+                    std::cerr << "VM: MAP_SET target is not map" << std::endl;
+                    push(Value{}); // push sol
+                }
+                break;
+            }
+            case OpCode::MAP_DELETE:
+            {
+                if (stack.size() < 2)
+                {
+                    std::cerr << "VM: MAP_DELETE stack underflow" << std::endl;
+                    push(Value{});
+                    break;
+                }
+                Value key_val = pop();
+                Value map_val = pop();
+                if (std::holds_alternative<Map>(map_val))
+                {
+                    auto map = std::get<Map>(map_val);
+                    std::string key;
+                    if (std::holds_alternative<std::string>(key_val))
+                        key = std::get<std::string>(key_val);
+                    else if (std::holds_alternative<int64_t>(key_val))
+                        key = std::to_string(std::get<int64_t>(key_val));
+                    else if (std::holds_alternative<double>(key_val))
+                        key = std::to_string(std::get<double>(key_val));
+                    else if (std::holds_alternative<bool>(key_val))
+                        key = std::get<bool>(key_val) ? "true" : "false";
+                    else
+                        key = "";
+                    map->erase(key);
+                    push(map);
+                }
+                else
+                {
+                    std::cerr << "VM: MAP_DELETE target is not map" << std::endl;
+                    push(Value{});
+                }
+                break;
+            }
+            case OpCode::MAP_CLEAR:
+            {
+                if (stack.empty())
+                {
+                    std::cerr << "VM: MAP_CLEAR stack underflow" << std::endl;
+                    push(Value{});
                     break;
                 }
+                Value map_val = pop();
+                if (std::holds_alternative<Map>(map_val))
+                {
+                    auto map = std::get<Map>(map_val);
+                    map->clear();
+                    push(map);
+                }
+                else
+                {
+                    std::cerr << "VM: MAP_CLEAR target is not map" << std::endl;
+                    push(Value{});
+                }
+                break;
             }
-            catch (const std::exception &ex)
+            case OpCode::MAP_KEYS:
             {
-#ifdef _DEBUG
-                std::cerr << "[DEBUG][EXCEPTION] " << ex.what() << " at ip=" << ip << std::endl;
-#endif
-                if (!try_stack.empty())
+                if (stack.empty())
+                {
+                    std::cerr << "VM: MAP_KEYS stack underflow" << std::endl;
+                    push(Value{});
+                    break;
+                }
+                Value map_val = pop();
+                if (std::holds_alternative<Map>(map_val))
                 {
-                    // Get the error variable index from the try frame
-                    int error_var_index = 1; // Default to 1 for "error"
-                    if (!try_stack.empty() && try_stack.back().error_var == "error")
+                    auto map = std::get<Map>(map_val);
+                    Array arr = make_array();
+                    for (const auto &kv : *map)
                     {
-                        error_var_index = 1; // "error" variable is at index 1
+                        arr->push_back(kv.first);
                     }
-                    variables[error_var_index] = std::string(ex.what());
-                    ip = try_stack.back().catch_ip;
-                    continue;
+                    push(arr);
                 }
                 else
                 {
-                    std::cerr << "VM Exception: " << ex.what() << std::endl;
-                    return;
+                    std::cerr << "VM: MAP_KEYS target is not map" << std::endl;
+                    push(Value{});
+                }
+                break;
+            }
+            case OpCode::MAP_VALUES:
+            {
+                if (stack.empty())
+                {
+                    std::cerr << "VM: MAP_VALUES stack underflow" << std::endl;
+                    push(Value{});
+                    break;
+                }
+                Value map_val = pop();
+                if (std::holds_alternative<Map>(map_val))
+                {
+                    auto map = std::get<Map>(map_val);
+                    Array arr = make_array();
+                    for (const auto &kv : *map)
+                    {
+                        arr->push_back(kv.second);
+                    }
+                    push(arr);
+                }
+                else
+                {
+                    std::cerr << "VM: MAP_VALUES target is not map" << std::endl;
+                    push(Value{});
+                }
+                break;
+            }
+            case OpCode::LOAD_PACKAGE_CONST:
+            {
+                // Operand int: slot đã resolve lúc biên dịch, chỉ cần đọc
+                if (std::holds_alternative<int64_t>(instr.operand))
+                {
+                    push(Linh::LiPM::constant_at(std::get<int64_t>(instr.operand)));
+                    break;
+                }
+                // Operand is a string: "package.constant"
+                std::string full_name;
+                if (std::holds_alternative<std::string>(instr.operand))
+                    full_name = std::get<std::string>(instr.operand);
+                else
+                    full_name = "";
+                auto dot_pos = full_name.find('.');
+                if (dot_pos != std::string::npos)
+                {
+                    std::string package = full_name.substr(0, dot_pos);
+                    std::string constant = full_name.substr(dot_pos + 1);
+                    auto val = Linh::LiPM::get_constant(package, constant);
+                    push(val);
+                }
+                else
+                {
+                    push(Value{}); // sol
+                }
+                break;
+            }
+            case OpCode::CONCAT_N:
+            {
+                // Operand là số phần cần nối, các phần nằm liên tiếp trên đỉnh stack theo đúng thứ tự
+                size_t count = static_cast<size_t>(std::get<int64_t>(instr.operand));
+                if (stack.size() < count)
+                {
+                    std::cerr << "ERROR [Line " << instr.line << ", Col " << instr.col << "] RuntimeError : VM stack underflow for CONCAT_N" << std::endl;
+                    break;
+                }
+                size_t first = stack.size() - count;
+                // Tính trước kích thước để chỉ cấp phát 1 lần cho cả chuỗi
+                size_t total = 0;
+                for (size_t i = first; i < stack.size(); ++i)
+                {
+                    if (std::holds_alternative<std::string>(stack[i]))
+                        total += std::get<std::string>(stack[i]).size();
+                    else
+                        total += 24; // đủ cho số nguyên / số thực dạng {:.6g}
                 }
+                std::string result;
+                result.reserve(total);
+                for (size_t i = first; i < stack.size(); ++i)
+                    Linh::format_value(result, stack[i]);
+                stack.resize(first);
+                push(Value(std::move(result))); // move => không đi qua string interner
+                break;
+            }
+            case OpCode::READ_ALL:
+            {
+                output.flush();
+                std::string data;
+                input.read_all(data);
+                push(Value(std::move(data)));
+                break;
+            }
+            case OpCode::READ_LINE:
+            {
+                // Hết input thì trả về "" như read_all/read_bytes; vòng lặp đọc kiểm tra read_eof()
+                output.flush();
+                std::string line;
+                input.read_line(line);
+                push(Value(std::move(line)));
+                break;
+            }
+            case OpCode::READ_BYTES:
+            {
+                auto count_val = pop();
+                int64_t count = Linh::to_int(count_val);
+                output.flush();
+                std::string data;
+                if (count > 0)
+                    input.read_bytes(data, static_cast<size_t>(count));
+                push(Value(std::move(data)));
+                break;
+            }
+            case OpCode::READ_EOF:
+            {
+                push(input.eof());
+                break;
+            }
+            default:
+                ++ip;
+                break;
             }
             ++ip;
         }
-        
-        // Performance tracking end
-        auto end_time = std::chrono::high_resolution_clock::now();
-        execution_time_ms = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time).count();
-        
-        // Optimize stack after execution
-        if (stack_optimization_enabled) {
-            optimize_stack();
-        }
     }
 
     void LiVM::type()
@@ -2500,43 +2542,25 @@ namespace Linh
         }
 #endif
         // Kiểm tra xem có function object trên stack không
-        if (!vm.stack.empty() && vm.stack.back().index() == 8) { // FunctionPtr is at index 8 in Value
+        if (!vm.stack.empty() && std::holds_alternative<FunctionPtr>(vm.stack.back())) {
 #ifdef _DEBUG
             std::cerr << "[DEBUG] CALL: found function object on stack" << std::endl;
 #endif
-            // Gọi function object
-            auto fn = std::get<8>(vm.stack.back());
-            vm.pop(); // Pop function object
-            
-            // Thu thập arguments từ stack (arguments được push theo thứ tự ngược)
-            std::vector<Value> args;
-            size_t expected_args = fn->params.size();
-            
-            // Arguments được push theo thứ tự từ trái sang phải, nên trên stack sẽ ngược lại
-            for (size_t i = 0; i < expected_args; ++i) {
-                if (vm.stack.empty()) {
-                    std::cerr << "Error: Not enough arguments for function " << fn->name << std::endl;
-                    vm.push(Value()); // Push default value
-                    ++ip;
-                    return;
-                }
-                args.insert(args.begin(), vm.pop()); // Insert at beginning để giữ thứ tự đúng
-            }
-            
+            // Gọi function object: arguments giữ nguyên trên stack, call_function chuyển thẳng vào frame mới
+            FunctionPtr fn = std::get<FunctionPtr>(std::move(vm.stack.back()));
+            vm.stack.pop_back(); // Pop function object
+            int64_t call_argc = std::get<0>(std::get<std::tuple<int64_t, int64_t, int64_t, std::string>>(instr.operand));
 #ifdef _DEBUG
-            std::cerr << "[DEBUG] CALL: calling function " << fn->name << " with " << args.size() << " arguments" << std::endl;
+            std::cerr << "[DEBUG] CALL: calling function " << fn->prototype().name << " with " << call_argc << " arguments" << std::endl;
 #endif
-            
-            // Gọi function object
-            auto result = call_function(fn, args, vm);
-            vm.push(result);
+            vm.push(call_function(fn, static_cast<size_t>(call_argc), vm));
             ++ip;
         } else {
 #ifdef _DEBUG
             std::cerr << "[DEBUG] CALL: no function object found, falling back to legacy call" << std::endl;
 #endif
             // Gọi function theo tên (legacy behavior)
-            std::string func_name = std::get<std::string>(instr.operand);
+            const std::string &func_name = std::get<3>(std::get<std::tuple<int64_t, int64_t, int64_t, std::string>>(instr.operand));
             auto it = vm.functions.find(func_name);
             if (it != vm.functions.end()) {
                 // Push return address
@@ -2634,7 +2658,7 @@ namespace Linh
             prompt_str = std::get<std::string>(prompt);
         else
             prompt_str = "";
-        auto input_val = LinhIO::linh_input(prompt_str);
+        auto input_val = LinhIO::linh_input(vm.output, vm.input, prompt_str);
         vm.push(input_val);
     }
     static void handle_TYPEOF(LiVM& vm, const Instruction& instr, const BytecodeChunk&, size_t&) {
@@ -2886,6 +2910,25 @@ namespace Linh
                 case OpCode::STORE_VAR:
                     handle_STORE_VAR(*this, instr, chunk, local_ip);
                     break;
+                case OpCode::POP:
+                    pop();
+                    break;
+                case OpCode::PUSH_FUNCTION:
+                    handle_PUSH_FUNCTION(*this, instr, chunk, local_ip);
+                    break;
+                case OpCode::CALL:
+                    // handle_CALL tự tăng local_ip
+                    handle_CALL(*this, instr, chunk, local_ip);
+                    continue;
+                case OpCode::CLOSURE:
+                    handle_CLOSURE(*this, instr, chunk, local_ip);
+                    break;
+                case OpCode::LOAD_UPVALUE:
+                    handle_LOAD_UPVALUE(*this, instr, chunk, local_ip);
+                    break;
+                case OpCode::STORE_UPVALUE:
+                    handle_STORE_UPVALUE(*this, instr, chunk, local_ip);
+                    break;
                 case OpCode::ADD:
                     handle_ADD(*this, instr, chunk, local_ip);
                     break;
@@ -1,6 +1,7 @@
 #pragma once
 #include "../LinhC/Bytecode/Bytecode.hpp"
 #include "Value/Value.hpp"
+#include "iostream/iostream.hpp"
 #include <vector>
 #include <unordered_map>
 #include <string>
@@ -15,13 +16,14 @@ namespace Linh
     {
     public:
         LiVM();
-        void run(const BytecodeChunk &chunk);
+        void run(const BytecodeChunk &chunk, const ExceptionTable &handlers = {});
         void run_chunk(const BytecodeChunk &chunk); // Thêm method này cho function execution
 
         void type();
 
         friend void handle_loop_opcode(LiVM &vm, const Instruction &instr, const BytecodeChunk &chunk, size_t &ip);
         friend void math_binary_op(LiVM &vm, const Instruction &instr); // Thêm dòng này
+        friend void typed_binary_op(LiVM &vm, const Instruction &instr);
         friend void handle_PUSH_INT(LiVM&, const Instruction&, const BytecodeChunk&, size_t&);
         friend void handle_PUSH_FLOAT(LiVM&, const Instruction&, const BytecodeChunk&, size_t&);
         friend void handle_ADD(LiVM&, const Instruction&, const BytecodeChunk&, size_t&);
@@ -83,7 +85,11 @@ namespace Linh
         friend void handle_PUSH_STR(LiVM&, const Instruction&, const BytecodeChunk&, size_t&);
         friend void handle_PUSH_BOOL(LiVM&, const Instruction&, const BytecodeChunk&, size_t&);
         friend void handle_PUSH_FUNCTION(LiVM&, const Instruction&, const BytecodeChunk&, size_t&);
-        friend Value call_function(FunctionPtr, const std::vector<Value>&, LiVM&);
+        friend void handle_CLOSURE(LiVM&, const Instruction&, const BytecodeChunk&, size_t&);
+        friend void handle_LOAD_UPVALUE(LiVM&, const Instruction&, const BytecodeChunk&, size_t&);
+        friend void handle_STORE_UPVALUE(LiVM&, const Instruction&, const BytecodeChunk&, size_t&);
+        friend Value call_function(const FunctionPtr&, size_t, LiVM&);
+        friend FunctionPtr make_closure(const FunctionPtr&, LiVM&);
         friend void handle_LOAD_PACKAGE_CONST(LiVM&, const Instruction&, const BytecodeChunk&, size_t&);
 
         // Optimization methods
@@ -120,12 +126,26 @@ namespace Linh
 
         // Getter/setter cho biến toàn cục REPL
         const std::unordered_map<int, Value> &get_global_variables() const { return variables; }
-        void set_global_variables(const std::unordered_map<int, Value> &vars) { variables = vars; }
+        void set_global_variables(const std::unordered_map<int, Value> &vars); // Ghi từng slot, giữ node mà upvalue đang trỏ vào
+
+        // Đẩy hết output print/printf đang nằm trong buffer ra stdout
+        void flush_output() { output.flush(); }
 
     private:
         std::vector<Value> stack;
         std::unordered_map<int, Value> variables;
         size_t ip = 0; // instruction pointer
+        LinhIO::OutputBuffer output; // Buffer stdout cho PRINT/PRINTF/PRINT_MULTIPLE
+        LinhIO::InputBuffer input;   // Buffer stdin cho INPUT và READ_*
+
+        // Closure: ô upvalue còn trỏ vào slot của frame đang sống, và upvalue của closure đang chạy
+        std::vector<UpvaluePtr> open_upvalues;
+        const std::vector<UpvaluePtr> *active_upvalues = nullptr;
+        FunctionPtr pending_tail_call; // Hàm được TAIL_CALL, call_function sẽ gọi tiếp trên frame hiện tại
+        size_t pending_tail_argc = 0;  // Số đối số TAIL_CALL đã đẩy lên stack
+
+        // Map biến của các frame đã return, giữ lại để lần gọi sau dùng tiếp (tránh cấp phát mỗi lần gọi hàm)
+        std::vector<std::unordered_map<int, Value>> frame_pool;
         
         // Optimization flags
         bool instruction_caching_enabled = false; // Tắt cache để đảm bảo các lệnh có side-effect hoạt động đúng
@@ -145,8 +165,10 @@ namespace Linh
         // Stack optimization
         static constexpr size_t STACK_RESERVE_SIZE = 1024;
         static constexpr size_t STACK_SHRINK_THRESHOLD = 512;
+        static constexpr size_t FRAME_POOL_LIMIT = 64; // Số frame map tối đa giữ lại (đệ quy sâu hơn thì cấp phát bình thường)
 
         void push(const Value &val);
+        void push(Value &&val);
         Value pop();
         Value peek();
         
@@ -155,5 +177,18 @@ namespace Linh
         void optimize_stack();
         void track_hot_path(size_t ip);
         void execute_cached_instruction(size_t ip);
+
+        // Vòng lặp thực thi chính; lỗi runtime được ném ra cho run() tra bảng exception
+        void dispatch(const BytecodeChunk &chunk);
+        // chunk: code đang chạy khi lỗi; lần tra đầu tiên ghi lại dòng/cột của lệnh lỗi để báo nếu không ai catch
+        bool unwind_to_handler(const BytecodeChunk &chunk, const ExceptionTable &handlers, const std::string &message, size_t stack_base);
+        int error_line = -1; // Vị trí lệnh gây lỗi đang được unwind (-1: chưa ghi)
+        int error_col = 0;
+
+        std::unordered_map<int, Value> acquire_frame();
+        void release_frame(std::unordered_map<int, Value> &&frame);
+
+        UpvaluePtr capture_upvalue(int slot);
+        void close_upvalues(size_t from); // Đóng các ô mở từ vị trí from trở đi (frame vừa kết thúc)
     };
 }
\ No newline at end of file
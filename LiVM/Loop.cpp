@@ -1,10 +1,13 @@
 #include "Loop.hpp"
 #include <variant>
+#include <algorithm>
+#include <iostream>
+#include "type.hpp"
 
 namespace Linh
 {
     // Hàm kiểm tra điều kiện cho JMP_IF_TRUE/FALSE
-    inline bool eval_condition(const Value& cond) {
+    bool eval_condition(const Value& cond) {
         return std::visit([](auto&& arg) -> bool {
             using T = std::decay_t<decltype(arg)>;
             if constexpr (std::is_same_v<T, bool>)
@@ -47,6 +50,109 @@ namespace Linh
                 ++ip;
             return;
         }
+        case OpCode::FOR_RANGE:
+        {
+            // [state] = giá trị kế tiếp, [state+1] = end, [state+2] = step
+            const auto &[var_idx, state_idx, exit_ip, unused] = std::get<std::tuple<int64_t, int64_t, int64_t, std::string>>(instr.operand);
+            Value &current = vm.variables[static_cast<int>(state_idx)];
+            const Value &end = vm.variables[static_cast<int>(state_idx + 1)];
+            const Value &step = vm.variables[static_cast<int>(state_idx + 2)];
+            // Đường nhanh: cả 3 đều là int
+            if (std::holds_alternative<int64_t>(current) && std::holds_alternative<int64_t>(end) && std::holds_alternative<int64_t>(step))
+            {
+                int64_t c = std::get<int64_t>(current), e = std::get<int64_t>(end), s = std::get<int64_t>(step);
+                if (s > 0 ? c >= e : (s == 0 || c <= e))
+                {
+                    if (s == 0)
+                        std::cerr << "ERROR [Line " << instr.line << ", Col " << instr.col << "] RuntimeError : range() step must not be 0" << std::endl;
+                    ip = static_cast<size_t>(exit_ip);
+                    return;
+                }
+                vm.variables[static_cast<int>(var_idx)] = c;
+                current = c + s;
+                ++ip;
+                return;
+            }
+            double c = to_float(current), e = to_float(end), s = to_float(step);
+            if (s > 0 ? c >= e : (s == 0 || c <= e))
+            {
+                if (s == 0)
+                    std::cerr << "ERROR [Line " << instr.line << ", Col " << instr.col << "] RuntimeError : range() step must not be 0" << std::endl;
+                ip = static_cast<size_t>(exit_ip);
+                return;
+            }
+            vm.variables[static_cast<int>(var_idx)] = c;
+            current = c + s;
+            ++ip;
+            return;
+        }
+        case OpCode::FOR_ITER:
+        {
+            // [state] = array/map/str đang duyệt, [state+1] = vị trí kế tiếp
+            const auto &[var_idx, state_idx, exit_ip, source] = std::get<std::tuple<int64_t, int64_t, int64_t, std::string>>(instr.operand);
+            if (source == "stdin")
+            {
+                // Đọc thẳng vào chuỗi biến lặp đang giữ: dùng lại bộ nhớ của dòng trước, không tạo Value mới mỗi dòng
+                Value &line = vm.variables[static_cast<int>(var_idx)];
+                if (!std::holds_alternative<std::string>(line))
+                    line = Value(std::string());
+                if (vm.input.is_interactive())
+                    vm.output.flush(); // Prompt phải hiện ra trước khi chờ người dùng gõ
+                if (!vm.input.read_line(std::get<std::string>(line)))
+                {
+                    ip = static_cast<size_t>(exit_ip);
+                    return;
+                }
+                ++ip;
+                return;
+            }
+            Value &target = vm.variables[static_cast<int>(state_idx)];
+            Value &pos_val = vm.variables[static_cast<int>(state_idx + 1)];
+            size_t pos = static_cast<size_t>(std::get<int64_t>(pos_val));
+            // Map: lần đầu chụp lại danh sách key, sau đó duyệt như array
+            if (std::holds_alternative<Map>(target))
+            {
+                const auto map = std::get<Map>(target);
+                auto keys = make_array();
+                keys->reserve(map->size());
+                for (const auto &kv : *map)
+                    keys->push_back(Value(kv.first));
+                target = keys;
+            }
+            if (std::holds_alternative<Array>(target))
+            {
+                const auto &arr = std::get<Array>(target);
+                if (pos >= arr->size())
+                {
+                    ip = static_cast<size_t>(exit_ip);
+                    return;
+                }
+                vm.variables[static_cast<int>(var_idx)] = (*arr)[pos];
+                pos_val = static_cast<int64_t>(pos + 1);
+                ++ip;
+                return;
+            }
+            if (std::holds_alternative<std::string>(target))
+            {
+                // Duyệt theo từng ký tự UTF-8
+                const auto &str = std::get<std::string>(target);
+                if (pos >= str.size())
+                {
+                    ip = static_cast<size_t>(exit_ip);
+                    return;
+                }
+                unsigned char lead = static_cast<unsigned char>(str[pos]);
+                size_t len = lead < 0x80 ? 1 : (lead >> 5) == 0x6 ? 2 : (lead >> 4) == 0xE ? 3 : (lead >> 3) == 0x1E ? 4 : 1;
+                len = std::min(len, str.size() - pos);
+                vm.variables[static_cast<int>(var_idx)] = Value(str.substr(pos, len));
+                pos_val = static_cast<int64_t>(pos + len);
+                ++ip;
+                return;
+            }
+            std::cerr << "ERROR [Line " << instr.line << ", Col " << instr.col << "] RuntimeError : for-in expects array, map, str or range()" << std::endl;
+            ip = static_cast<size_t>(exit_ip);
+            return;
+        }
         default:
             ++ip;
             break;
@@ -529,4 +529,177 @@ namespace Linh
             vm.push(std::monostate{});
         }
     }
+
+    bool compare_values(const Value &a, const Value &b, OpCode op)
+    {
+        // If either is string, compare as string
+        if (std::holds_alternative<std::string>(a) || std::holds_alternative<std::string>(b))
+        {
+            std::string sa = std::holds_alternative<std::string>(a) ? std::get<std::string>(a) : Linh::to_str(a);
+            std::string sb = std::holds_alternative<std::string>(b) ? std::get<std::string>(b) : Linh::to_str(b);
+            switch (op)
+            {
+            case OpCode::EQ: return sa == sb;
+            case OpCode::NEQ: return sa != sb;
+            case OpCode::LT: return sa < sb;
+            case OpCode::GT: return sa > sb;
+            case OpCode::LTE: return sa <= sb;
+            case OpCode::GTE: return sa >= sb;
+            default: return false;
+            }
+        }
+        // If both are bool
+        if (std::holds_alternative<bool>(a) && std::holds_alternative<bool>(b))
+        {
+            bool av = std::get<bool>(a);
+            bool bv = std::get<bool>(b);
+            switch (op)
+            {
+            case OpCode::EQ: return av == bv;
+            case OpCode::NEQ: return av != bv;
+            case OpCode::LT: return !av && bv;
+            case OpCode::GT: return av && !bv;
+            case OpCode::LTE: return !av || bv;
+            case OpCode::GTE: return av || !bv;
+            default: return false;
+            }
+        }
+        // If both are numbers (int/double/uint)
+        if ((std::holds_alternative<int64_t>(a) || std::holds_alternative<double>(a) || std::holds_alternative<uint64_t>(a)) &&
+            (std::holds_alternative<int64_t>(b) || std::holds_alternative<double>(b) || std::holds_alternative<uint64_t>(b)))
+        {
+            double av = std::holds_alternative<int64_t>(a) ? static_cast<double>(std::get<int64_t>(a)) : (std::holds_alternative<uint64_t>(a) ? static_cast<double>(std::get<uint64_t>(a)) : std::get<double>(a));
+            double bv = std::holds_alternative<int64_t>(b) ? static_cast<double>(std::get<int64_t>(b)) : (std::holds_alternative<uint64_t>(b) ? static_cast<double>(std::get<uint64_t>(b)) : std::get<double>(b));
+            switch (op)
+            {
+            case OpCode::EQ: return av == bv;
+            case OpCode::NEQ: return av != bv;
+            case OpCode::LT: return av < bv;
+            case OpCode::GT: return av > bv;
+            case OpCode::LTE: return av <= bv;
+            case OpCode::GTE: return av >= bv;
+            default: return false;
+            }
+        }
+        // Fallback: compare as string
+        std::string sa = Linh::to_str(a);
+        std::string sb = Linh::to_str(b);
+        switch (op)
+        {
+        case OpCode::EQ: return sa == sb;
+        case OpCode::NEQ: return sa != sb;
+        case OpCode::LT: return sa < sb;
+        case OpCode::GT: return sa > sb;
+        case OpCode::LTE: return sa <= sb;
+        case OpCode::GTE: return sa >= sb;
+        default: return false;
+        }
+    }
+
+    namespace
+    {
+        // Opcode thường tương ứng, dùng khi toán hạng không đúng kiểu đã suy ra
+        OpCode generic_opcode(OpCode op)
+        {
+            switch (op)
+            {
+            case OpCode::ADD_I64: case OpCode::ADD_F64: return OpCode::ADD;
+            case OpCode::SUB_I64: case OpCode::SUB_F64: return OpCode::SUB;
+            case OpCode::MUL_I64: case OpCode::MUL_F64: return OpCode::MUL;
+            case OpCode::DIV_F64: return OpCode::DIV;
+            case OpCode::EQ_I64: case OpCode::EQ_F64: return OpCode::EQ;
+            case OpCode::NEQ_I64: case OpCode::NEQ_F64: return OpCode::NEQ;
+            case OpCode::LT_I64: case OpCode::LT_F64: return OpCode::LT;
+            case OpCode::GT_I64: case OpCode::GT_F64: return OpCode::GT;
+            case OpCode::LTE_I64: case OpCode::LTE_F64: return OpCode::LTE;
+            case OpCode::GTE_I64: case OpCode::GTE_F64: return OpCode::GTE;
+            default: return op;
+            }
+        }
+
+        bool is_compare(OpCode op)
+        {
+            return op == OpCode::EQ || op == OpCode::NEQ || op == OpCode::LT || op == OpCode::GT || op == OpCode::LTE || op == OpCode::GTE;
+        }
+    }
+
+    void typed_binary_op(LiVM &vm, const Instruction &instr)
+    {
+        auto &stack = vm.stack;
+        if (stack.size() >= 2)
+        {
+            Value &a = stack[stack.size() - 2];
+            const Value &b = stack.back();
+            if (const int64_t *bi = std::get_if<int64_t>(&b))
+            {
+                if (const int64_t *ai = std::get_if<int64_t>(&a))
+                {
+                    int64_t av = *ai, bv = *bi;
+                    Value result;
+                    switch (instr.opcode)
+                    {
+                    case OpCode::ADD_I64: result = av + bv; break;
+                    case OpCode::SUB_I64: result = av - bv; break;
+                    case OpCode::MUL_I64: result = av * bv; break;
+                    // So sánh như compare_values (qua double): trên 2^53 hai int khác nhau có thể bằng nhau,
+                    // opcode có kiểu phải cho cùng kết quả với opcode thường
+                    case OpCode::EQ_I64: result = static_cast<double>(av) == static_cast<double>(bv); break;
+                    case OpCode::NEQ_I64: result = static_cast<double>(av) != static_cast<double>(bv); break;
+                    case OpCode::LT_I64: result = static_cast<double>(av) < static_cast<double>(bv); break;
+                    case OpCode::GT_I64: result = static_cast<double>(av) > static_cast<double>(bv); break;
+                    case OpCode::LTE_I64: result = static_cast<double>(av) <= static_cast<double>(bv); break;
+                    case OpCode::GTE_I64: result = static_cast<double>(av) >= static_cast<double>(bv); break;
+                    default: goto generic; // F64 với hai vế int: phép toán thường cho ra int
+                    }
+                    stack.pop_back();
+                    stack.back() = std::move(result);
+                    return;
+                }
+            }
+            // F64: một vế float, vế kia float hoặc int (giống nhánh số thực của phép toán thường)
+            const double *ad = std::get_if<double>(&a), *bd = std::get_if<double>(&b);
+            if ((ad || std::holds_alternative<int64_t>(a)) && (bd || std::holds_alternative<int64_t>(b)) && (ad || bd))
+            {
+                double av = ad ? *ad : static_cast<double>(std::get<int64_t>(a));
+                double bv = bd ? *bd : static_cast<double>(std::get<int64_t>(b));
+                Value result;
+                switch (instr.opcode)
+                {
+                case OpCode::ADD_F64: result = av + bv; break;
+                case OpCode::SUB_F64: result = av - bv; break;
+                case OpCode::MUL_F64: result = av * bv; break;
+                case OpCode::DIV_F64:
+                    if (bv == 0.0)
+                        goto generic; // Để phép chia thường ném lỗi như cũ
+                    result = av / bv;
+                    break;
+                case OpCode::EQ_F64: result = av == bv; break;
+                case OpCode::NEQ_F64: result = av != bv; break;
+                case OpCode::LT_F64: result = av < bv; break;
+                case OpCode::GT_F64: result = av > bv; break;
+                case OpCode::LTE_F64: result = av <= bv; break;
+                case OpCode::GTE_F64: result = av >= bv; break;
+                default: goto generic;
+                }
+                stack.pop_back();
+                stack.back() = std::move(result);
+                return;
+            }
+        }
+    generic:
+        OpCode op = generic_opcode(instr.opcode);
+        if (is_compare(op))
+        {
+            if (stack.size() < 2)
+            {
+                std::cerr << "VM stack underflow for binary operation" << std::endl;
+                return;
+            }
+            Value b = vm.pop();
+            Value a = vm.pop();
+            vm.push(compare_values(a, b, op));
+            return;
+        }
+        math_binary_op(vm, Instruction(op, instr.operand, instr.line, instr.col));
+    }
 }
@@ -4,4 +4,8 @@
 namespace Linh
 {
     void math_binary_op(LiVM &vm, const Instruction &instr);
+    // EQ/NEQ/LT/GT/LTE/GTE: chuỗi so theo chuỗi, bool theo bool, số (int/uint/float) theo double, còn lại theo to_str
+    bool compare_values(const Value &a, const Value &b, OpCode op);
+    // ADD_I64 ... GTE_F64: tính thẳng khi đúng kiểu, ngược lại chạy như opcode thường
+    void typed_binary_op(LiVM &vm, const Instruction &instr);
 }
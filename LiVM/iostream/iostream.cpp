@@ -1,26 +1,204 @@
-#include <fmt/format.h>
+#include "iostream.hpp"
 #include "../type.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
 
 namespace LinhIO
 {
 
-    void linh_print(const Linh::Value &val)
+    static bool stdout_is_terminal()
     {
-        fmt::print("{}\n", Linh::to_str(val));
+#ifdef _WIN32
+        return _isatty(_fileno(stdout)) != 0;
+#else
+        return isatty(fileno(stdout)) != 0;
+#endif
+    }
+
+    static bool stdin_is_terminal()
+    {
+#ifdef _WIN32
+        return _isatty(_fileno(stdin)) != 0;
+#else
+        return isatty(fileno(stdin)) != 0;
+#endif
+    }
+
+    OutputBuffer::OutputBuffer() : line_buffered(stdout_is_terminal())
+    {
+        buffer.reserve(capacity);
+    }
+
+    OutputBuffer::~OutputBuffer()
+    {
+        flush();
+    }
+
+    void OutputBuffer::write(std::string_view s)
+    {
+        buffer.append(s.data(), s.size());
+        flush_if_full();
+    }
+
+    void OutputBuffer::write_value(const Linh::Value &val)
+    {
+        Linh::format_value(buffer, val);
+        flush_if_full();
+    }
+
+    void OutputBuffer::put(char c)
+    {
+        buffer.push_back(c);
+        flush_if_full();
+    }
+
+    void OutputBuffer::end_line()
+    {
+        buffer.push_back('\n');
+        if (line_buffered)
+            flush();
+        else
+            flush_if_full();
+    }
+
+    void OutputBuffer::flush()
+    {
+        if (buffer.empty())
+            return;
+        // std::cout có buffer riêng (sync_with_stdio(false)), đẩy nó ra trước để giữ đúng thứ tự output
+        std::cout.flush();
+        std::fwrite(buffer.data(), 1, buffer.size(), stdout);
+        std::fflush(stdout);
+        buffer.clear();
+    }
+
+    InputBuffer::InputBuffer() : interactive(stdin_is_terminal())
+    {
+    }
+
+    bool InputBuffer::fill()
+    {
+        if (at_eof)
+            return false;
+        // Bỏ phần đã đọc để buffer không phình ra theo kích thước input
+        if (pos > 0)
+        {
+            buffer.erase(0, pos);
+            pos = 0;
+        }
+        if (interactive)
+        {
+            std::string line;
+            if (!std::getline(std::cin, line))
+            {
+                at_eof = true;
+                return false;
+            }
+            buffer += line;
+            if (!std::cin.eof())
+                buffer += '\n';
+            return true;
+        }
+        size_t old_size = buffer.size();
+        buffer.resize(old_size + CHUNK_SIZE);
+#ifdef _WIN32
+        int n = _read(_fileno(stdin), &buffer[old_size], static_cast<unsigned>(CHUNK_SIZE));
+#else
+        ssize_t n = ::read(fileno(stdin), &buffer[old_size], CHUNK_SIZE);
+#endif
+        if (n <= 0)
+        {
+            buffer.resize(old_size);
+            at_eof = true;
+            return false;
+        }
+        buffer.resize(old_size + static_cast<size_t>(n));
+        return true;
+    }
+
+    bool InputBuffer::read_line(std::string &out)
+    {
+        size_t scan = pos;
+        for (;;)
+        {
+            size_t nl = buffer.find('\n', scan);
+            if (nl != std::string::npos)
+            {
+                size_t end = (nl > pos && buffer[nl - 1] == '\r') ? nl - 1 : nl;
+                out.assign(buffer, pos, end - pos);
+                pos = nl + 1;
+                return true;
+            }
+            scan = buffer.size() - pos; // fill() dời dữ liệu về đầu buffer
+            if (!fill())
+                break;
+        }
+        // Dòng cuối không có '\n'
+        if (pos < buffer.size())
+        {
+            out.assign(buffer, pos, std::string::npos);
+            pos = buffer.size();
+            return true;
+        }
+        out.clear();
+        return false;
+    }
+
+    void InputBuffer::read_all(std::string &out)
+    {
+        while (fill())
+        {
+        }
+        buffer.erase(0, pos);
+        pos = 0;
+        out.swap(buffer);
+        buffer.clear();
+    }
+
+    void InputBuffer::read_bytes(std::string &out, size_t n)
+    {
+        while (buffer.size() - pos < n && fill())
+        {
+        }
+        size_t count = std::min(n, buffer.size() - pos);
+        out.assign(buffer, pos, count);
+        pos += count;
+    }
+
+    bool InputBuffer::eof()
+    {
+        return pos >= buffer.size() && !fill();
+    }
+
+    void linh_print(OutputBuffer &out, const Linh::Value &val)
+    {
+        out.write_value(val);
+        out.end_line();
         // print là print thông minh nên có xuống hàm tự động
     }
 
-    void linh_printf(const Linh::Value &val)
+    void linh_printf(OutputBuffer &out, const Linh::Value &val)
     {
-        fmt::print("{}", Linh::to_str(val));
+        out.write_value(val);
     }
 
-    std::string linh_input(const std::string &prompt)
+    std::string linh_input(OutputBuffer &out, InputBuffer &in, const std::string &prompt)
     {
         if (!prompt.empty())
-            fmt::print("{}\n", prompt);
+        {
+            out.write(prompt);
+            out.put('\n');
+        }
+        // Phải đẩy hết output đang chờ ra trước khi chờ người dùng nhập
+        out.flush();
         std::string input_val;
-        std::getline(std::cin, input_val);
+        in.read_line(input_val);
         return input_val;
     }
 
@@ -1,12 +1,78 @@
 #pragma once
 #include <string>
-#include "../type.hpp"
+#include <string_view>
 #include "../Value/Value.hpp"
-#include <fmt/format.h>
 
 namespace LinhIO
 {
-    void linh_print(const Linh::Value &val);
-    std::string linh_input(const std::string &prompt);
-    void linh_printf(const Linh::Value &val); // Thêm hàm printf không tự động xuống dòng
+    // Bộ đệm stdout do VM sở hữu: gom output của print/printf vào 1 buffer lớn rồi ghi 1 lần.
+    // Flush khi đầy, trước khi đọc input và khi VM chạy xong.
+    // Nếu stdout là terminal thì flush theo từng dòng để người dùng thấy output ngay.
+    class OutputBuffer
+    {
+    public:
+        static constexpr size_t DEFAULT_CAPACITY = 64 * 1024;
+
+        OutputBuffer();
+        ~OutputBuffer();
+        OutputBuffer(const OutputBuffer &) = delete;
+        OutputBuffer &operator=(const OutputBuffer &) = delete;
+
+        void write(std::string_view s);
+        void write_value(const Linh::Value &val); // Ghi giá trị theo dạng to_str, không tạo chuỗi tạm
+        void put(char c);
+        void end_line(); // Ghi '\n', flush nếu đang ở chế độ line-buffered
+        void flush();
+
+        void set_line_buffered(bool enable) { line_buffered = enable; }
+        bool is_line_buffered() const { return line_buffered; }
+
+    private:
+        std::string buffer;
+        size_t capacity = DEFAULT_CAPACITY;
+        bool line_buffered = false;
+
+        void flush_if_full()
+        {
+            if (buffer.size() >= capacity)
+                flush();
+        }
+    };
+
+    // Bộ đọc stdin theo từng khối lớn do VM sở hữu, dùng chung cho input() và các hàm read_*.
+    // Khi stdin là terminal thì chỉ đọc từng dòng (không đọc trước) để tương tác bình thường.
+    class InputBuffer
+    {
+    public:
+        static constexpr size_t CHUNK_SIZE = 64 * 1024;
+
+        InputBuffer();
+        InputBuffer(const InputBuffer &) = delete;
+        InputBuffer &operator=(const InputBuffer &) = delete;
+
+        bool read_line(std::string &out);            // Đọc 1 dòng (bỏ '\n', '\r\n'), trả về false khi đã hết input
+        void read_all(std::string &out);             // Đọc toàn bộ phần input còn lại
+        void read_bytes(std::string &out, size_t n); // Đọc tối đa n byte
+        bool eof();                                  // true khi không còn gì để đọc
+        bool is_interactive() const { return interactive; }
+
+    private:
+        std::string buffer;
+        size_t pos = 0; // vị trí byte chưa đọc đầu tiên trong buffer
+        bool at_eof = false;
+        bool interactive = false;
+
+        bool fill(); // Đọc thêm 1 khối vào buffer, false khi đã hết input
+    };
+
+    // Flush output khi rời khỏi phạm vi (kể cả return sớm)
+    struct ScopedFlush
+    {
+        OutputBuffer &out;
+        ~ScopedFlush() { out.flush(); }
+    };
+
+    void linh_print(OutputBuffer &out, const Linh::Value &val);
+    std::string linh_input(OutputBuffer &out, InputBuffer &in, const std::string &prompt);
+    void linh_printf(OutputBuffer &out, const Linh::Value &val); // Thêm hàm printf không tự động xuống dòng
 }
@@ -1,6 +1,8 @@
 #include "type.hpp"
 #include "Functional/Func.hpp"
 #include <fmt/core.h>
+#include <charconv>
+#include <iterator>
 
 namespace Linh
 {
@@ -104,67 +106,114 @@ namespace Linh
         return "unknown";
     }
 
-    std::string to_str(const Value &val)
+    // Số nguyên/số thực được ghi bằng std::to_chars vào buffer trên stack rồi nối vào out,
+    // mảng/map ghi đệ quy vào cùng out => cả giá trị chỉ dùng đúng 1 buffer
+    template <typename T>
+    static void format_number(FormatBuffer &out, T v)
+    {
+        char buf[32];
+        auto res = std::to_chars(buf, buf + sizeof(buf), v);
+        out.append(buf, res.ptr);
+    }
+
+    static void format_number(FormatBuffer &out, double v)
+    {
+        // Giống {:.6g} / printf("%.6g") như trước đây
+        char buf[32];
+        auto res = std::to_chars(buf, buf + sizeof(buf), v, std::chars_format::general, 6);
+        out.append(buf, res.ptr);
+    }
+
+    void format_value(FormatBuffer &out, const Value &val)
     {
         if (std::holds_alternative<int64_t>(val))
-            return std::to_string(std::get<int64_t>(val));
+        {
+            format_number(out, std::get<int64_t>(val));
+            return;
+        }
         if (std::holds_alternative<uint64_t>(val))
-            return std::to_string(std::get<uint64_t>(val));
+        {
+            format_number(out, std::get<uint64_t>(val));
+            return;
+        }
         if (std::holds_alternative<double>(val))
-            return fmt::format("{:.6g}", std::get<double>(val));
+        {
+            format_number(out, std::get<double>(val));
+            return;
+        }
         if (std::holds_alternative<std::string>(val))
-            return std::get<std::string>(val);
+        {
+            out += std::get<std::string>(val);
+            return;
+        }
         if (std::holds_alternative<bool>(val))
-            return std::get<bool>(val) ? "true" : "false";
+        {
+            out += std::get<bool>(val) ? "true" : "false";
+            return;
+        }
         if (std::holds_alternative<Array>(val))
         {
             const auto &arr = std::get<Array>(val);
-            std::string result = "[";
+            out.reserve(out.size() + 2 + arr->size() * 4); // ước lượng trước để hạn chế cấp phát lại
+            out += '[';
             for (size_t i = 0; i < arr->size(); ++i)
             {
                 if (i > 0)
-                    result += ", ";
-                result += to_str((*arr)[i]);
+                    out += ", ";
+                format_value(out, (*arr)[i]);
             }
-            result += "]";
-            return result;
+            out += ']';
+            return;
         }
         if (std::holds_alternative<Map>(val))
         {
             const auto &map = std::get<Map>(val);
-            std::string result = "{";
+            out += '{';
             bool first = true;
             for (const auto &[key, value] : *map)
             {
                 if (!first)
-                    result += ", ";
-                result += to_str(key) + ": " + to_str(value);
+                    out += ", ";
+                out += key;
+                out += ": ";
+                format_value(out, value);
                 first = false;
             }
-            result += "}";
-            return result;
+            out += '}';
+            return;
         }
         if (std::holds_alternative<FunctionPtr>(val))
         {
             const auto &fn = std::get<FunctionPtr>(val);
-            std::string result = fmt::format("<function {}(", fn->name);
-            
+            fmt::format_to(std::back_inserter(out), "<function {}(", fn->name);
+
             // Hiển thị tham số
             for (size_t i = 0; i < fn->params.size(); ++i) {
-                if (i > 0) result += ", ";
-                
+                if (i > 0) out += ", ";
+
                 const auto& param = fn->params[i];
-                if (param.is_static) result += "vas ";
-                result += param.name;
+                if (param.is_static) out += "vas ";
+                out += param.name;
                 if (param.type.has_value()) {
-                    result += ": " + param.type.value();
+                    out += ": ";
+                    out += param.type.value();
                 }
             }
-            
-            result += ")>";
-            return result;
+
+            out += ")>";
+            return;
         }
-        return "<unknown>";
+        out += "<unknown>";
+    }
+
+    std::string to_str(const Value &val)
+    {
+        // Chuỗi thì trả về luôn, tránh đi qua buffer trung gian
+        if (std::holds_alternative<std::string>(val))
+            return std::get<std::string>(val);
+        std::string result;
+        format_value(result, val);
+        return result;
     }
 
     int64_t to_int(const Value &val)
@@ -17,6 +17,12 @@ namespace Linh
 
     // Hàm chuyển đổi kiểu dữ liệu
     std::string to_str(const Value &val);
+    // Buffer cho các hàm format kiểu appender: luôn ghi nối vào cuối, không tạo chuỗi tạm
+    using FormatBuffer = std::string;
+
+    // Ghi dạng chuỗi của val (giống to_str) nối thẳng vào cuối out.
+    // to_str, str(), print và interpolated string đều đi qua hàm này
+    void format_value(FormatBuffer &out, const Value &val);
     int64_t to_int(const Value &val);
     double to_float(const Value &val);
     uint64_t to_uint(const Value &val);
@@ -61,7 +61,7 @@ namespace Linh
         JMP_IF_TRUE,
 
         // Function
-        CALL,
+        CALL, // operand: tuple(số đối số thật sự trên stack, 0, 0, tên hàm)
         RET,
         PUSH_FUNCTION, // Push function object lên stack
 
@@ -95,7 +95,53 @@ namespace Linh
         ID, // <--- Thêm opcode này cho hàm id()
         
         // --- LiPM Package Management ---
-        LOAD_PACKAGE_CONST // <--- Thêm opcode này cho package constants
+        LOAD_PACKAGE_CONST, // <--- Thêm opcode này cho package constants
+
+        // --- Chuỗi ---
+        CONCAT_N, // Nối n giá trị trên đỉnh stack thành 1 chuỗi (operand: n), dùng cho interpolated string
+
+        // --- Đọc stdin theo khối (read_all, read_line, read_bytes, read_eof) ---
+        READ_ALL,
+        READ_LINE,  // Trả về "" khi hết input (dùng read_eof() làm điều kiện vòng lặp)
+        READ_BYTES, // Đọc tối đa n byte (n lấy từ stack)
+        READ_EOF,
+
+        // --- Vòng lặp for-in (operand: tuple(var_slot, state_slot, exit_ip, nguồn)) ---
+        FOR_RANGE, // for x in range(...): so sánh + gán + tăng trong 1 lệnh, không tạo array
+        FOR_ITER,  // for x in array/map/str: lấy phần tử kế tiếp hoặc nhảy ra exit_ip; nguồn "stdin": đọc dòng kế tiếp
+
+        // --- Closure ---
+        CLOSURE,       // Tạo closure từ prototype (operand: FunctionPtr), capture theo upvalue_descs
+        LOAD_UPVALUE,  // operand: index upvalue của closure đang chạy
+        STORE_UPVALUE,
+
+        // --- Gọi đuôi: như CALL (cùng operand) nhưng dùng lại frame hiện tại (emitter luôn đặt RET ngay sau) ---
+        TAIL_CALL,
+
+        // --- Inline hàm: thân hàm chỉ đúng khi tên vẫn trỏ tới hàm đã chép (operand: FunctionPtr) ---
+        SAME_FUNCTION, // Pop 1 giá trị, push true nếu đó chính là function object trong operand
+
+        // --- Phép toán có kiểu: emitter chọn khi semantic suy ra kiểu hai vế (vas/const, literal) ---
+        // Đúng kiểu thì tính thẳng, sai kiểu (suy luận lệch) thì quay về opcode thường tương ứng
+        ADD_I64,
+        SUB_I64,
+        MUL_I64,
+        EQ_I64,
+        NEQ_I64,
+        LT_I64,
+        GT_I64,
+        LTE_I64,
+        GTE_I64,
+        ADD_F64, // F64: ít nhất một vế float, vế còn lại float hoặc int
+        SUB_F64,
+        MUL_F64,
+        DIV_F64,
+        EQ_F64,
+        NEQ_F64,
+        LT_F64,
+        GT_F64,
+        LTE_F64,
+        GTE_F64
     };
 
     using BytecodeValue = std::variant<
@@ -119,4 +165,18 @@ namespace Linh
     };
 
     using BytecodeChunk = std::vector<Instruction>;
+
+    // Một dòng trong bảng exception tĩnh: lỗi xảy ra tại ip thuộc [start_ip, end_ip)
+    // thì VM cắt stack về stack_depth (tính từ đáy frame), ghi thông báo lỗi vào error_slot rồi nhảy tới handler_ip.
+    // Các vùng try lồng nhau: vùng trong luôn đứng trước vùng ngoài trong bảng.
+    // Mỗi thân hàm có bảng riêng (FunctionObject::handlers), ip tính trong chunk của hàm đó.
+    struct ExceptionHandler
+    {
+        int64_t start_ip;
+        int64_t end_ip;
+        int64_t handler_ip;
+        int64_t error_slot;
+        int64_t stack_depth; // Số giá trị trên stack của frame lúc vào try
+    };
+    using ExceptionTable = std::vector<ExceptionHandler>;
 }
@@ -1,7 +1,11 @@
 #include "BytecodeEmitter.hpp"
+#include "BytecodeOptimizer.hpp"
+#include "LoopOptimizer.hpp"
+#include <algorithm>
 #include <unordered_set>
 #include <iostream>
 #include "../../LiVM/Value/Value.hpp" // Để sử dụng Value cho constant folding
+#include "../../LiPM/LiPM.hpp"
 
 namespace Linh
 {
@@ -16,97 +20,99 @@ namespace Linh
             return std::nullopt;
         }
         
-        // Get constant values
-        auto left_literal = dynamic_cast<AST::LiteralExpr*>(expr->left.get());
-        auto right_literal = dynamic_cast<AST::LiteralExpr*>(expr->right.get());
+        // Get constant values (literal hoặc hằng package đã resolve lúc biên dịch)
+        auto left_constant = constant_value(expr->left.get());
+        auto right_constant = constant_value(expr->right.get());
         
-        if (!left_literal || !right_literal) return std::nullopt;
+        if (!left_constant || !right_constant) return std::nullopt;
+        const LiteralValue &left_value = *left_constant;
+        const LiteralValue &right_value = *right_constant;
         
         // Perform constant folding based on operator
         switch (expr->op.type) {
             case TokenType::PLUS: {
-                if (std::holds_alternative<int64_t>(left_literal->value) && 
-                    std::holds_alternative<int64_t>(right_literal->value)) {
-                    return Value(std::get<int64_t>(left_literal->value) + std::get<int64_t>(right_literal->value));
+                if (std::holds_alternative<int64_t>(left_value) && 
+                    std::holds_alternative<int64_t>(right_value)) {
+                    return Value(std::get<int64_t>(left_value) + std::get<int64_t>(right_value));
                 }
-                if (std::holds_alternative<double>(left_literal->value) && 
-                    std::holds_alternative<double>(right_literal->value)) {
-                    return Value(std::get<double>(left_literal->value) + std::get<double>(right_literal->value));
+                if (std::holds_alternative<double>(left_value) && 
+                    std::holds_alternative<double>(right_value)) {
+                    return Value(std::get<double>(left_value) + std::get<double>(right_value));
                 }
                 break;
             }
             case TokenType::MINUS: {
-                if (std::holds_alternative<int64_t>(left_literal->value) && 
-                    std::holds_alternative<int64_t>(right_literal->value)) {
-                    return Value(std::get<int64_t>(left_literal->value) - std::get<int64_t>(right_literal->value));
+                if (std::holds_alternative<int64_t>(left_value) && 
+                    std::holds_alternative<int64_t>(right_value)) {
+                    return Value(std::get<int64_t>(left_value) - std::get<int64_t>(right_value));
                 }
-                if (std::holds_alternative<double>(left_literal->value) && 
-                    std::holds_alternative<double>(right_literal->value)) {
-                    return Value(std::get<double>(left_literal->value) - std::get<double>(right_literal->value));
+                if (std::holds_alternative<double>(left_value) && 
+                    std::holds_alternative<double>(right_value)) {
+                    return Value(std::get<double>(left_value) - std::get<double>(right_value));
                 }
                 break;
             }
             case TokenType::STAR: {
-                if (std::holds_alternative<int64_t>(left_literal->value) && 
-                    std::holds_alternative<int64_t>(right_literal->value)) {
-                    return Value(std::get<int64_t>(left_literal->value) * std::get<int64_t>(right_literal->value));
+                if (std::holds_alternative<int64_t>(left_value) && 
+                    std::holds_alternative<int64_t>(right_value)) {
+                    return Value(std::get<int64_t>(left_value) * std::get<int64_t>(right_value));
                 }
-                if (std::holds_alternative<double>(left_literal->value) && 
-                    std::holds_alternative<double>(right_literal->value)) {
-                    return Value(std::get<double>(left_literal->value) * std::get<double>(right_literal->value));
+                if (std::holds_alternative<double>(left_value) && 
+                    std::holds_alternative<double>(right_value)) {
+                    return Value(std::get<double>(left_value) * std::get<double>(right_value));
                 }
                 break;
             }
             case TokenType::SLASH: {
-                if (std::holds_alternative<int64_t>(left_literal->value) && 
-                    std::holds_alternative<int64_t>(right_literal->value)) {
-                    auto right_val = std::get<int64_t>(right_literal->value);
+                if (std::holds_alternative<int64_t>(left_value) && 
+                    std::holds_alternative<int64_t>(right_value)) {
+                    auto right_val = std::get<int64_t>(right_value);
                     if (right_val != 0) {
-                        return Value(std::get<int64_t>(left_literal->value) / right_val);
+                        return Value(std::get<int64_t>(left_value) / right_val);
                     }
                 }
-                if (std::holds_alternative<double>(left_literal->value) && 
-                    std::holds_alternative<double>(right_literal->value)) {
-                    auto right_val = std::get<double>(right_literal->value);
+                if (std::holds_alternative<double>(left_value) && 
+                    std::holds_alternative<double>(right_value)) {
+                    auto right_val = std::get<double>(right_value);
                     if (right_val != 0.0) {
-                        return Value(std::get<double>(left_literal->value) / right_val);
+                        return Value(std::get<double>(left_value) / right_val);
                     }
                 }
                 break;
             }
             case TokenType::EQ_EQ: {
-                if (left_literal->value == right_literal->value) {
+                if (left_value == right_value) {
                     return Value(true);
                 } else {
                     return Value(false);
                 }
             }
             case TokenType::NOT_EQ: {
-                if (left_literal->value != right_literal->value) {
+                if (left_value != right_value) {
                     return Value(true);
                 } else {
                     return Value(false);
                 }
             }
             case TokenType::LT: {
-                if (std::holds_alternative<int64_t>(left_literal->value) && 
-                    std::holds_alternative<int64_t>(right_literal->value)) {
-                    return Value(std::get<int64_t>(left_literal->value) < std::get<int64_t>(right_literal->value));
+                if (std::holds_alternative<int64_t>(left_value) && 
+                    std::holds_alternative<int64_t>(right_value)) {
+                    return Value(std::get<int64_t>(left_value) < std::get<int64_t>(right_value));
                 }
-                if (std::holds_alternative<double>(left_literal->value) && 
-                    std::holds_alternative<double>(right_literal->value)) {
-                    return Value(std::get<double>(left_literal->value) < std::get<double>(right_literal->value));
+                if (std::holds_alternative<double>(left_value) && 
+                    std::holds_alternative<double>(right_value)) {
+                    return Value(std::get<double>(left_value) < std::get<double>(right_value));
                 }
                 break;
             }
             case TokenType::GT: {
-                if (std::holds_alternative<int64_t>(left_literal->value) && 
-                    std::holds_alternative<int64_t>(right_literal->value)) {
-                    return Value(std::get<int64_t>(left_literal->value) > std::get<int64_t>(right_literal->value));
+                if (std::holds_alternative<int64_t>(left_value) && 
+                    std::holds_alternative<int64_t>(right_value)) {
+                    return Value(std::get<int64_t>(left_value) > std::get<int64_t>(right_value));
                 }
-                if (std::holds_alternative<double>(left_literal->value) && 
-                    std::holds_alternative<double>(right_literal->value)) {
-                    return Value(std::get<double>(left_literal->value) > std::get<double>(right_literal->value));
+                if (std::holds_alternative<double>(left_value) && 
+                    std::holds_alternative<double>(right_value)) {
+                    return Value(std::get<double>(left_value) > std::get<double>(right_value));
                 }
                 break;
             }
@@ -122,23 +128,24 @@ namespace Linh
             return std::nullopt;
         }
         
-        auto literal = dynamic_cast<AST::LiteralExpr*>(expr->right.get());
-        if (!literal) return std::nullopt;
+        auto constant = constant_value(expr->right.get());
+        if (!constant) return std::nullopt;
+        const LiteralValue &value = *constant;
         
         switch (expr->op.type) {
             case TokenType::MINUS: {
-                if (std::holds_alternative<int64_t>(literal->value)) {
-                    return Value(-std::get<int64_t>(literal->value));
+                if (std::holds_alternative<int64_t>(value)) {
+                    return Value(-std::get<int64_t>(value));
                 }
-                if (std::holds_alternative<double>(literal->value)) {
-                    return Value(-std::get<double>(literal->value));
+                if (std::holds_alternative<double>(value)) {
+                    return Value(-std::get<double>(value));
                 }
                 break;
             }
             case TokenType::NOT:
             case TokenType::NOT_KW: {
-                if (std::holds_alternative<bool>(literal->value)) {
-                    return Value(!std::get<bool>(literal->value));
+                if (std::holds_alternative<bool>(value)) {
+                    return Value(!std::get<bool>(value));
                 }
                 break;
             }
@@ -148,7 +155,67 @@ namespace Linh
     }
     
     bool BytecodeEmitter::is_constant_expression(AST::Expr* expr) {
-        return dynamic_cast<AST::LiteralExpr*>(expr) != nullptr;
+        return constant_value(expr).has_value();
+    }
+
+    std::optional<LiteralValue> BytecodeEmitter::constant_value(AST::Expr* expr) {
+        if (auto literal = AST::node_cast<AST::LiteralExpr>(expr))
+            return literal->value;
+        auto member = AST::node_cast<AST::MemberExpr>(expr);
+        std::string package, name;
+        if (!member || !package_member(member, package, name) || !LiPM::is_immutable_constant(package, name))
+            return std::nullopt;
+        Value constant = LiPM::get_constant(package, name);
+        if (std::holds_alternative<double>(constant))
+            return std::get<double>(constant);
+        if (std::holds_alternative<int64_t>(constant))
+            return std::get<int64_t>(constant);
+        if (std::holds_alternative<std::string>(constant))
+            return std::get<std::string>(constant);
+        if (std::holds_alternative<bool>(constant))
+            return std::get<bool>(constant);
+        return std::nullopt;
+    }
+
+    // math.pi, hoặc pkg.x khi semantic đã đánh dấu pkg là package
+    bool BytecodeEmitter::package_member(AST::MemberExpr *expr, std::string &package, std::string &name)
+    {
+        if (expr->is_package_constant)
+        {
+            package = expr->package_name;
+            name = expr->constant_name;
+            return true;
+        }
+        auto id = AST::node_cast<AST::IdentifierExpr>(expr->object.get());
+        if (!id || id->name.lexeme != "math")
+            return false;
+        package = id->name.lexeme;
+        name = expr->property_token.lexeme;
+        return true;
+    }
+
+    // Hằng bất biến thành PUSH_* luôn; giá trị có thể đổi thì resolve slot một lần, VM chỉ đọc theo slot
+    void BytecodeEmitter::emit_package_value(const std::string &package, const std::string &name, int line, int col)
+    {
+        if (LiPM::is_immutable_constant(package, name))
+        {
+            Value constant = LiPM::get_constant(package, name);
+            if (std::holds_alternative<double>(constant))
+            {
+                emit_instr(OpCode::PUSH_FLOAT, std::get<double>(constant), line, col);
+                return;
+            }
+            if (std::holds_alternative<int64_t>(constant))
+            {
+                emit_instr(OpCode::PUSH_INT, std::get<int64_t>(constant), line, col);
+                return;
+            }
+        }
+        int64_t slot = LiPM::resolve_constant_slot(package, name);
+        if (slot >= 0)
+            emit_instr(OpCode::LOAD_PACKAGE_CONST, slot, line, col);
+        else
+            emit_instr(OpCode::LOAD_PACKAGE_CONST, package + "." + name, line, col); // Không có: VM đẩy sol
     }
     
     bool BytecodeEmitter::is_dead_code(AST::Stmt* stmt) {
@@ -167,9 +234,9 @@ namespace Linh
             if (unreachable) continue;
             new_stmts.push_back(std::move(stmt));
             // Nếu là return, break, continue thì các statement sau đó là unreachable
-            if (dynamic_cast<AST::ReturnStmt*>(new_stmts.back().get()) ||
-                dynamic_cast<AST::BreakStmt*>(new_stmts.back().get()) ||
-                dynamic_cast<AST::ContinueStmt*>(new_stmts.back().get())) {
+            if (AST::node_cast<AST::ReturnStmt>(new_stmts.back().get()) ||
+                AST::node_cast<AST::BreakStmt>(new_stmts.back().get()) ||
+                AST::node_cast<AST::ContinueStmt>(new_stmts.back().get())) {
                 unreachable = true;
             }
         }
@@ -178,21 +245,45 @@ namespace Linh
 
     void BytecodeEmitter::emit(const AST::StmtList &stmts)
     {
-        chunk.clear();
+        begin_program();
         // --- Emit all statements including function definitions ---
 #ifdef _DEBUG
         std::cerr << "[DEBUG] BytecodeEmitter::emit: processing " << stmts.size() << " statements" << std::endl;
 #endif
+        for (const auto &stmt : stmts)
+            emit_statement(stmt.get());
+        end_program();
+    }
+
+    void BytecodeEmitter::begin_program()
+    {
+        chunk.clear();
+        exception_table.clear();
+    }
+
+    void BytecodeEmitter::predeclare_functions(const AST::StmtList &stmts)
+    {
         for (const auto &stmt : stmts)
         {
-            if (stmt) {
+            if (auto function = AST::node_cast<AST::FunctionDeclStmt>(stmt.get()))
+                get_var_index(function->name.lexeme);
+        }
+    }
+
+    void BytecodeEmitter::emit_statement(AST::Stmt *stmt)
+    {
+        if (stmt) {
 #ifdef _DEBUG
-                std::cerr << "[DEBUG] BytecodeEmitter::emit: processing statement type" << std::endl;
+            std::cerr << "[DEBUG] BytecodeEmitter::emit: processing statement type" << std::endl;
 #endif
-                stmt->accept(this);
-            }
+            visit(stmt);
         }
+    }
+
+    void BytecodeEmitter::end_program()
+    {
         emit_instr(OpCode::HALT);
+        optimize_chunk(chunk, exception_table);
     }
 
     void BytecodeEmitter::emit_instr(OpCode op, BytecodeValue val, int line, int col)
@@ -200,6 +291,12 @@ namespace Linh
         chunk.emplace_back(op, val, line, col);
     }
 
+    // CALL mang theo số đối số thật sự: VM kiểm tra với số tham số của hàm được gọi
+    void BytecodeEmitter::emit_call(const std::string &name, size_t argc, int line, int col)
+    {
+        emit_instr(OpCode::CALL, std::make_tuple(int64_t(argc), int64_t(0), int64_t(0), name), line, col);
+    }
+
     int BytecodeEmitter::get_var_index(const std::string &name)
     {
         auto it = var_table.find(name);
@@ -210,8 +307,457 @@ namespace Linh
         return idx;
     }
 
+    void BytecodeEmitter::begin_block_scope()
+    {
+        block_scopes.emplace_back();
+    }
+
+    // Biến của block chết khi ra khỏi block: khôi phục tên bị che và trả slot cho biến sau dùng lại
+    void BytecodeEmitter::end_block_scope()
+    {
+        auto &scope = block_scopes.back();
+        for (auto it = scope.rbegin(); it != scope.rend(); ++it)
+        {
+            release_slot(var_table[it->first]);
+            if (it->second >= 0)
+                var_table[it->first] = it->second;
+            else
+                var_table.erase(it->first);
+        }
+        block_scopes.pop_back();
+    }
+
+    // Khai báo biến mới trong scope hiện tại. Ở mức ngoài cùng của hàm/script giữ nguyên cách cũ
+    // (một tên một slot, REPL khai báo lại vẫn trúng slot cũ); trong block thì luôn cấp slot mới.
+    int BytecodeEmitter::declare_local(const std::string &name)
+    {
+        if (block_scopes.empty())
+            return get_var_index(name);
+        auto it = var_table.find(name);
+        block_scopes.back().emplace_back(name, it != var_table.end() ? it->second : -1);
+        int idx = alloc_slot();
+        var_table[name] = idx;
+        return idx;
+    }
+
+    int BytecodeEmitter::alloc_slot()
+    {
+        if (!free_slots.empty())
+        {
+            int idx = free_slots.back();
+            free_slots.pop_back();
+            return idx;
+        }
+        return next_var_index++;
+    }
+
+    void BytecodeEmitter::release_slot(int slot)
+    {
+        if (!captured_slots.count(slot))
+            free_slots.push_back(slot);
+    }
+
+    // Phân tích biến tự do: tên không khai báo trong hàm đang emit thì tìm ở các hàm bao ngoài.
+    // Trả về index upvalue, hoặc -1 nếu không phải biến của scope ngoài.
+    int BytecodeEmitter::resolve_upvalue(const std::string &name)
+    {
+        if (!enclosing)
+            return -1;
+        auto it = upvalue_table.find(name);
+        if (it != upvalue_table.end())
+            return it->second;
+
+        UpvalueDesc desc{};
+        auto local = enclosing->var_table.find(name);
+        if (local != enclosing->var_table.end())
+        {
+            desc = {true, local->second};
+            enclosing->captured_slots.insert(local->second);
+        }
+        else
+        {
+            int outer = enclosing->resolve_upvalue(name);
+            if (outer < 0)
+                return -1;
+            desc = {false, outer};
+        }
+        int idx = static_cast<int>(upvalues.size());
+        upvalues.push_back(desc);
+        upvalue_table[name] = idx;
+        return idx;
+    }
+
+    void BytecodeEmitter::emit_load_name(const std::string &name, int line, int col)
+    {
+        if (!var_table.count(name))
+        {
+            int up = resolve_upvalue(name);
+            if (up >= 0)
+            {
+                emit_instr(OpCode::LOAD_UPVALUE, up, line, col);
+                return;
+            }
+        }
+        emit_instr(OpCode::LOAD_VAR, get_var_index(name), line, col);
+    }
+
+    void BytecodeEmitter::emit_store_name(const std::string &name, int line, int col)
+    {
+        if (!var_table.count(name))
+        {
+            int up = resolve_upvalue(name);
+            if (up >= 0)
+            {
+                emit_instr(OpCode::STORE_UPVALUE, up, line, col);
+                return;
+            }
+        }
+        emit_instr(OpCode::STORE_VAR, get_var_index(name), line, col);
+    }
+
+    FunctionPtr BytecodeEmitter::compile_function(const std::string &name, const std::vector<FunctionParameter> &params,
+                                                  AST::BlockStmt *body, int line, int col,
+                                                  std::optional<InlineCandidate> *inline_out)
+    {
+        BytecodeEmitter body_emitter;
+        body_emitter.enclosing = this;
+        body_emitter.inlining_enabled = inlining_enabled;
+        body_emitter.inline_budget = inline_budget;
+        body_emitter.expr_types = expr_types;
+        // Tham số chiếm slot 0..n-1 đúng như call_function bind
+        for (const auto &param : params)
+            body_emitter.get_var_index(param.name);
+        if (body)
+        {
+            for (const auto &body_stmt : body->statements)
+            {
+                if (body_stmt)
+                    body_emitter.visit(body_stmt);
+            }
+        }
+        // Thêm RET instruction nếu không có return statement
+        if (body_emitter.chunk.empty() || body_emitter.chunk.back().opcode != OpCode::RET)
+            body_emitter.emit_instr(OpCode::RET, {}, line, col);
+        optimize_chunk(body_emitter.chunk, body_emitter.exception_table);
+
+        auto fn = create_function(name, params, body_emitter.chunk);
+        fn->handlers = std::move(body_emitter.exception_table);
+        fn->upvalue_descs = std::move(body_emitter.upvalues);
+
+        // Ứng viên inline: thân ngắn, không capture, mọi nhánh đều 'return <giá trị>' (câu lệnh cuối là return),
+        // chỉ gồm lệnh thuần tính toán/nhảy => không gọi hàm khác nên chắc chắn không đệ quy
+        if (inline_out)
+        {
+            inline_out->reset();
+            const auto &code = fn->body;
+            auto last_return = body && !body->statements.empty() ? AST::node_cast<AST::ReturnStmt>(body->statements.back().get()) : nullptr;
+            bool eligible = inlining_enabled && fn->upvalue_descs.empty() && fn->handlers.empty() &&
+                            body_emitter.valueless_returns == 0 && last_return && last_return->value &&
+                            code.size() - 1 <= inline_budget;
+            for (size_t i = 0; eligible && i < code.size(); ++i)
+            {
+                switch (code[i].opcode)
+                {
+                case OpCode::NOP:
+                case OpCode::PUSH_INT:
+                case OpCode::PUSH_UINT:
+                case OpCode::PUSH_FLOAT:
+                case OpCode::PUSH_STR:
+                case OpCode::PUSH_BOOL:
+                case OpCode::POP:
+                case OpCode::SWAP:
+                case OpCode::DUP:
+                case OpCode::ADD:
+                case OpCode::SUB:
+                case OpCode::MUL:
+                case OpCode::DIV:
+                case OpCode::MOD:
+                case OpCode::HASH:
+                case OpCode::AMP:
+                case OpCode::PIPE:
+                case OpCode::CARET:
+                case OpCode::LT_LT:
+                case OpCode::GT_GT:
+                case OpCode::AND:
+                case OpCode::OR:
+                case OpCode::NOT:
+                case OpCode::EQ:
+                case OpCode::NEQ:
+                case OpCode::LT:
+                case OpCode::GT:
+                case OpCode::LTE:
+                case OpCode::GTE:
+                case OpCode::ADD_I64:
+                case OpCode::SUB_I64:
+                case OpCode::MUL_I64:
+                case OpCode::EQ_I64:
+                case OpCode::NEQ_I64:
+                case OpCode::LT_I64:
+                case OpCode::GT_I64:
+                case OpCode::LTE_I64:
+                case OpCode::GTE_I64:
+                case OpCode::ADD_F64:
+                case OpCode::SUB_F64:
+                case OpCode::MUL_F64:
+                case OpCode::DIV_F64:
+                case OpCode::EQ_F64:
+                case OpCode::NEQ_F64:
+                case OpCode::LT_F64:
+                case OpCode::GT_F64:
+                case OpCode::LTE_F64:
+                case OpCode::GTE_F64:
+                case OpCode::LOAD_VAR:
+                case OpCode::STORE_VAR:
+                case OpCode::JMP:
+                case OpCode::JMP_IF_FALSE:
+                case OpCode::JMP_IF_TRUE:
+                case OpCode::RET:
+                case OpCode::CONCAT_N:
+                case OpCode::TYPEOF:
+                case OpCode::ARRAY_GET:
+                case OpCode::MAP_GET:
+                case OpCode::ARRAY_LEN:
+                    break;
+                default:
+                    eligible = false;
+                    break;
+                }
+            }
+            if (eligible)
+                *inline_out = InlineCandidate{code, params.size(), body_emitter.next_var_index, fn};
+        }
+        return fn;
+    }
+
+    void BytecodeEmitter::emit_function_object(const FunctionPtr &fn, int line, int col)
+    {
+        // Hàm không có biến tự do thì dùng thẳng prototype, khỏi tạo closure
+        emit_instr(fn->upvalue_descs.empty() ? OpCode::PUSH_FUNCTION : OpCode::CLOSURE, fn, line, col);
+    }
+
+    // Tên được tra như biến: nếu hàm đang emit có biến trùng tên thì nó che hàm ở scope ngoài
+    const BytecodeEmitter::InlineCandidate *BytecodeEmitter::find_inline_candidate(const std::string &name) const
+    {
+        if (var_table.count(name))
+        {
+            auto it = inline_candidates.find(name);
+            return it != inline_candidates.end() ? &it->second : nullptr;
+        }
+        return enclosing ? enclosing->find_inline_candidate(name) : nullptr;
+    }
+
+    // Biến mang tên hàm bị gán lại => không còn chắc là hàm đó, thôi inline
+    void BytecodeEmitter::forget_inline_candidate(const std::string &name)
+    {
+        if (var_table.count(name))
+            inline_candidates.erase(name);
+        else if (enclosing)
+            enclosing->forget_inline_candidate(name);
+    }
+
+    bool BytecodeEmitter::try_inline_call(AST::CallExpr *expr, const std::string &name)
+    {
+        const InlineCandidate *candidate = find_inline_candidate(name);
+        if (!candidate || candidate->param_count != expr->arguments.size())
+            return false;
+        int line = expr->getLine(), col = expr->getCol();
+
+        // Tên có thể bị gán lại lúc chạy (sau chỗ gọi này, hoặc trong hàm khác): chỉ chạy thân đã chép
+        // khi tên vẫn trỏ tới đúng hàm đó, không thì gọi như thường
+        //   LOAD f; SAME_FUNCTION; JMP_IF_FALSE call; <thân inline>; JMP end; call: <args>; LOAD f; CALL; end:
+        emit_load_name(name, line, col);
+        emit_instr(OpCode::SAME_FUNCTION, candidate->fn, line, col);
+        size_t call_jump = chunk.size();
+        emit_instr(OpCode::JMP_IF_FALSE, int64_t(-1), line, col);
+
+        // Slot của hàm được dời sang một dải slot mới của hàm gọi
+        int base = next_var_index;
+        next_var_index += candidate->slot_count;
+        for (auto &arg : expr->arguments)
+            if (arg)
+                visit(arg);
+        for (size_t i = candidate->param_count; i-- > 0;)
+            emit_instr(OpCode::STORE_VAR, int64_t(base + static_cast<int>(i)), expr->getLine(), expr->getCol());
+
+        // RET giữa thân hàm thành JMP tới cuối; RET cuối bị bỏ, giá trị trả về nằm lại trên stack
+        int64_t offset = static_cast<int64_t>(chunk.size());
+        int64_t end = offset + static_cast<int64_t>(candidate->body.size()) - 1;
+        for (size_t i = 0; i + 1 < candidate->body.size(); ++i)
+        {
+            Instruction instr = candidate->body[i];
+            switch (instr.opcode)
+            {
+            case OpCode::LOAD_VAR:
+            case OpCode::STORE_VAR:
+                instr.operand = int64_t(base + std::get<int64_t>(instr.operand));
+                break;
+            case OpCode::JMP:
+            case OpCode::JMP_IF_FALSE:
+            case OpCode::JMP_IF_TRUE:
+                instr.operand = offset + std::get<int64_t>(instr.operand);
+                break;
+            case OpCode::RET:
+                instr.opcode = OpCode::JMP;
+                instr.operand = end;
+                break;
+            default:
+                break;
+            }
+            chunk.push_back(std::move(instr));
+        }
+        // Dải slot luôn cấp mới (thân hàm có thể đọc slot chưa ghi), xong lời gọi thì biến đã chết
+        for (int i = 0; i < candidate->slot_count; ++i)
+            release_slot(base + i);
+
+        size_t end_jump = chunk.size();
+        emit_instr(OpCode::JMP, int64_t(-1), line, col);
+        chunk[call_jump].operand = int64_t(chunk.size());
+        for (auto &arg : expr->arguments)
+            if (arg)
+                visit(arg);
+        emit_load_name(name, line, col);
+        emit_call(name, expr->arguments.size(), line, col);
+        chunk[end_jump].operand = int64_t(chunk.size());
+        return true;
+    }
+
+    // Biểu thức đã được tính sẵn trước vòng lặp: chỉ cần đọc lại slot ẩn
+    bool BytecodeEmitter::emit_loop_temp(AST::Expr *expr, int line, int col)
+    {
+        auto it = loop_temps.find(expr);
+        if (it == loop_temps.end())
+            return false;
+        emit_instr(OpCode::LOAD_VAR, int64_t(it->second), line, col);
+        return true;
+    }
+
+    // Biến cảm ứng vừa được ghi: cộng dồn các slot v * k thay cho phép nhân
+    void BytecodeEmitter::emit_induction_updates(const std::string &name, int line, int col)
+    {
+        auto it = induction_updates.find(name);
+        if (it == induction_updates.end())
+            return;
+        for (const auto &[slot, delta] : it->second)
+        {
+            emit_instr(OpCode::LOAD_VAR, int64_t(slot), line, col);
+            emit_instr(OpCode::PUSH_INT, delta, line, col);
+            emit_instr(OpCode::ADD_I64, {}, line, col);
+            emit_instr(OpCode::STORE_VAR, int64_t(slot), line, col);
+        }
+    }
+
+    // while/do-while có biểu thức bất biến hoặc phép nhân theo biến cảm ứng:
+    //   [cond; JMP_IF_FALSE end]       (chỉ với while: preheader chỉ chạy khi thân chạy ít nhất 1 lần)
+    //   preheader: tính các biểu thức bất biến vào slot ẩn
+    //   [kiểm tra biến cảm ứng là int; không thì nhảy sang bản không giảm phép nhân]
+    //   (hai bản thân vòng lặp chỉ khi thân không quá max_specialized_loop_nodes node)
+    //   loop: body; cond; JMP_IF_TRUE loop
+    // Trả về false nếu không có gì để tối ưu (emit như cũ).
+    bool BytecodeEmitter::emit_optimized_loop(AST::Expr *condition, AST::Stmt *body, bool test_first, int line, int col)
+    {
+        if (!loop_optimization_enabled || !condition)
+            return false;
+        // Lời gọi hàm người dùng luôn coi là có thể ghi biến: kể cả hàm inline, tên có thể bị gán
+        // sang hàm khác lúc chạy và chỗ gọi khi đó rơi về CALL thường
+        LoopPlan plan = plan_loop(condition, body, [](const std::string &)
+                                  { return false; });
+        // Vòng lặp lồng: biểu thức đã được vòng ngoài tính sẵn thì dùng lại
+        plan.invariants.erase(std::remove_if(plan.invariants.begin(), plan.invariants.end(),
+                                             [this](AST::Expr *expr) { return loop_temps.count(expr) != 0; }),
+                              plan.invariants.end());
+        // Giảm phép nhân cần chép thân vòng lặp hai lần (bản int + bản thường): chỉ làm với thân nhỏ
+        if (plan.node_count > max_specialized_loop_nodes)
+            plan.inductions.clear();
+        if (plan.empty())
+            return false;
+
+        size_t guard_jump = 0;
+        if (test_first)
+        {
+            visit(condition);
+            guard_jump = chunk.size();
+            emit_instr(OpCode::JMP_IF_FALSE, int64_t(-1), line, col); // placeholder
+        }
+        for (auto *expr : plan.invariants)
+        {
+            visit(expr);
+            int slot = alloc_slot();
+            emit_instr(OpCode::STORE_VAR, int64_t(slot), line, col);
+            loop_temps[expr] = slot;
+        }
+
+        auto emit_loop = [&]()
+        {
+            size_t loop_start = chunk.size();
+            if (body)
+                visit(body);
+            visit(condition);
+            emit_instr(OpCode::JMP_IF_TRUE, int64_t(loop_start), line, col);
+        };
+
+        std::vector<size_t> exit_jumps;
+        if (plan.inductions.empty())
+        {
+            emit_loop();
+        }
+        else
+        {
+            // v * k == v0 * k + n * (step * k) chỉ đúng tuyệt đối khi v là int (float thì sai số cộng dồn)
+            std::vector<size_t> fallback_jumps;
+            for (const auto &iv : plan.inductions)
+            {
+                emit_load_name(iv.name, line, col);
+                emit_instr(OpCode::TYPEOF, {}, line, col);
+                emit_instr(OpCode::PUSH_STR, std::string("int"), line, col);
+                emit_instr(OpCode::EQ, {}, line, col);
+                fallback_jumps.push_back(chunk.size());
+                emit_instr(OpCode::JMP_IF_FALSE, int64_t(-1), line, col); // placeholder
+            }
+            for (const auto &iv : plan.inductions)
+            {
+                for (const auto &[mul, factor] : iv.multiplies)
+                {
+                    emit_load_name(iv.name, line, col);
+                    emit_instr(OpCode::PUSH_INT, factor, line, col);
+                    emit_instr(OpCode::MUL_I64, {}, line, col); // Đã kiểm tra là int ở trên
+                    int slot = alloc_slot();
+                    emit_instr(OpCode::STORE_VAR, int64_t(slot), line, col);
+                    loop_temps[mul] = slot;
+                    induction_updates[iv.name].emplace_back(slot, iv.step * factor);
+                }
+            }
+            emit_loop();
+            for (const auto &iv : plan.inductions)
+            {
+                for (const auto &mul : iv.multiplies)
+                {
+                    release_slot(loop_temps[mul.first]);
+                    loop_temps.erase(mul.first);
+                }
+                induction_updates.erase(iv.name);
+            }
+            exit_jumps.push_back(chunk.size());
+            emit_instr(OpCode::JMP, int64_t(-1), line, col); // placeholder
+            for (size_t jump : fallback_jumps)
+                chunk[jump].operand = int64_t(chunk.size());
+            emit_loop();
+        }
+
+        size_t end_pos = chunk.size();
+        if (test_first)
+            chunk[guard_jump].operand = int64_t(end_pos);
+        for (size_t jump : exit_jumps)
+            chunk[jump].operand = int64_t(end_pos);
+        for (auto *expr : plan.invariants)
+        {
+            release_slot(loop_temps[expr]);
+            loop_temps.erase(expr);
+        }
+        return true;
+    }
+
     // --- ExprVisitor ---
-    std::any BytecodeEmitter::visitLiteralExpr(AST::LiteralExpr *expr)
+    void BytecodeEmitter::visitLiteralExpr(AST::LiteralExpr *expr)
     {
         if (std::holds_alternative<int64_t>(expr->value))
             emit_instr(OpCode::PUSH_INT, std::get<int64_t>(expr->value), expr->getLine(), expr->getCol());
@@ -223,17 +769,68 @@ namespace Linh
             emit_instr(OpCode::PUSH_STR, std::get<std::string>(expr->value), expr->getLine(), expr->getCol());
         else if (std::holds_alternative<bool>(expr->value))
             emit_instr(OpCode::PUSH_BOOL, std::get<bool>(expr->value), expr->getLine(), expr->getCol());
-        return {};
+        return;
     }
 
-    std::any BytecodeEmitter::visitIdentifierExpr(AST::IdentifierExpr *expr)
+    void BytecodeEmitter::visitIdentifierExpr(AST::IdentifierExpr *expr)
     {
-        emit_instr(OpCode::LOAD_VAR, get_var_index(expr->name.lexeme), expr->getLine(), expr->getCol());
-        return {};
+        emit_load_name(expr->name.lexeme, expr->getLine(), expr->getCol());
+        return;
     }
 
-    std::any BytecodeEmitter::visitBinaryExpr(AST::BinaryExpr *expr)
+    std::string BytecodeEmitter::static_type_of(const AST::Expr *expr) const
     {
+        if (!expr_types || !expr)
+            return "";
+        auto it = expr_types->find(expr->id);
+        return it != expr_types->end() ? it->second : std::string();
+    }
+
+    // Cả hai vế có kiểu số biết trước: chọn opcode có kiểu (VM vẫn kiểm tra và lùi về bản generic nếu sai)
+    OpCode BytecodeEmitter::typed_binary_opcode(AST::BinaryExpr *expr, OpCode generic) const
+    {
+        std::string left_type = static_type_of(expr->left.get());
+        std::string right_type = static_type_of(expr->right.get());
+        bool left_num = left_type == "int" || left_type == "float";
+        bool right_num = right_type == "int" || right_type == "float";
+        if (!left_num || !right_num)
+            return generic;
+        if (left_type == "int" && right_type == "int")
+        {
+            switch (generic)
+            {
+            case OpCode::ADD: return OpCode::ADD_I64;
+            case OpCode::SUB: return OpCode::SUB_I64;
+            case OpCode::MUL: return OpCode::MUL_I64;
+            case OpCode::EQ: return OpCode::EQ_I64;
+            case OpCode::NEQ: return OpCode::NEQ_I64;
+            case OpCode::LT: return OpCode::LT_I64;
+            case OpCode::GT: return OpCode::GT_I64;
+            case OpCode::LTE: return OpCode::LTE_I64;
+            case OpCode::GTE: return OpCode::GTE_I64;
+            default: return generic; // DIV/MOD int giữ nguyên ngữ nghĩa của bản generic
+            }
+        }
+        switch (generic)
+        {
+        case OpCode::ADD: return OpCode::ADD_F64;
+        case OpCode::SUB: return OpCode::SUB_F64;
+        case OpCode::MUL: return OpCode::MUL_F64;
+        case OpCode::DIV: return OpCode::DIV_F64;
+        case OpCode::EQ: return OpCode::EQ_F64;
+        case OpCode::NEQ: return OpCode::NEQ_F64;
+        case OpCode::LT: return OpCode::LT_F64;
+        case OpCode::GT: return OpCode::GT_F64;
+        case OpCode::LTE: return OpCode::LTE_F64;
+        case OpCode::GTE: return OpCode::GTE_F64;
+        default: return generic;
+        }
+    }
+
+    void BytecodeEmitter::visitBinaryExpr(AST::BinaryExpr *expr)
+    {
+        if (emit_loop_temp(expr, expr->getLine(), expr->getCol()))
+            return;
         // Try constant folding first
         auto folded_result = try_constant_fold(expr);
         if (folded_result.has_value()) {
@@ -245,54 +842,54 @@ namespace Linh
             } else if (std::holds_alternative<bool>(*folded_result)) {
                 emit_instr(OpCode::PUSH_BOOL, std::get<bool>(*folded_result), expr->getLine(), expr->getCol());
             }
-            return {};
+            return;
         }
         
         // Evaluate left and right
         if (expr->left)
-            expr->left->accept(this);
+            visit(expr->left);
         if (expr->right)
-            expr->right->accept(this);
+            visit(expr->right);
 
         int line = expr->op.line;
         int col = expr->op.column_start;
         switch (expr->op.type)
         {
         case TokenType::PLUS:
-            emit_instr(OpCode::ADD, {}, line, col);
+            emit_instr(typed_binary_opcode(expr, OpCode::ADD), {}, line, col);
             break;
         case TokenType::MINUS:
-            emit_instr(OpCode::SUB, {}, line, col);
+            emit_instr(typed_binary_opcode(expr, OpCode::SUB), {}, line, col);
             break;
         case TokenType::STAR:
-            emit_instr(OpCode::MUL, {}, line, col);
+            emit_instr(typed_binary_opcode(expr, OpCode::MUL), {}, line, col);
             break;
         case TokenType::SLASH:
-            emit_instr(OpCode::DIV, {}, line, col);
+            emit_instr(typed_binary_opcode(expr, OpCode::DIV), {}, line, col);
             break;
         case TokenType::PERCENT:
             emit_instr(OpCode::MOD, {}, line, col);
             break;
         case TokenType::STAR_STAR:
-            emit_instr(OpCode::CALL, std::string("pow"), line, col);
+            emit_call("pow", 2, line, col);
             break;
         case TokenType::EQ_EQ:
-            emit_instr(OpCode::EQ, {}, line, col);
+            emit_instr(typed_binary_opcode(expr, OpCode::EQ), {}, line, col);
             break;
         case TokenType::NOT_EQ:
-            emit_instr(OpCode::NEQ, {}, line, col);
+            emit_instr(typed_binary_opcode(expr, OpCode::NEQ), {}, line, col);
             break;
         case TokenType::LT:
-            emit_instr(OpCode::LT, {}, line, col);
+            emit_instr(typed_binary_opcode(expr, OpCode::LT), {}, line, col);
             break;
         case TokenType::GT:
-            emit_instr(OpCode::GT, {}, line, col);
+            emit_instr(typed_binary_opcode(expr, OpCode::GT), {}, line, col);
             break;
         case TokenType::LT_EQ:
-            emit_instr(OpCode::LTE, {}, line, col);
+            emit_instr(typed_binary_opcode(expr, OpCode::LTE), {}, line, col);
             break;
         case TokenType::GT_EQ:
-            emit_instr(OpCode::GTE, {}, line, col);
+            emit_instr(typed_binary_opcode(expr, OpCode::GTE), {}, line, col);
             break;
         case TokenType::AND_LOGIC:
         case TokenType::AND_KW:
@@ -323,11 +920,13 @@ namespace Linh
         default:
             break;
         }
-        return {};
+        return;
     }
 
-    std::any BytecodeEmitter::visitUnaryExpr(AST::UnaryExpr *expr)
+    void BytecodeEmitter::visitUnaryExpr(AST::UnaryExpr *expr)
     {
+        if (emit_loop_temp(expr, expr->getLine(), expr->getCol()))
+            return;
         // Try constant folding first
         auto folded_result = try_constant_fold(expr);
         if (folded_result.has_value()) {
@@ -339,11 +938,11 @@ namespace Linh
             } else if (std::holds_alternative<bool>(*folded_result)) {
                 emit_instr(OpCode::PUSH_BOOL, std::get<bool>(*folded_result), expr->getLine(), expr->getCol());
             }
-            return {};
+            return;
         }
         
         if (expr->right)
-            expr->right->accept(this);
+            visit(expr->right);
         switch (expr->op.type)
         {
         case TokenType::MINUS:
@@ -361,17 +960,19 @@ namespace Linh
         default:
             break;
         }
-        return {};
+        return;
     }
 
-    std::any BytecodeEmitter::visitGroupingExpr(AST::GroupingExpr *expr)
+    void BytecodeEmitter::visitGroupingExpr(AST::GroupingExpr *expr)
     {
+        if (emit_loop_temp(expr))
+            return;
         if (expr->expression)
-            expr->expression->accept(this);
-        return {};
+            visit(expr->expression);
+        return;
     }
 
-    std::any BytecodeEmitter::visitAssignmentExpr(AST::AssignmentExpr *expr)
+    void BytecodeEmitter::visitAssignmentExpr(AST::AssignmentExpr *expr)
     {
 #ifdef _DEBUG
         std::cerr << "[DEBUG] visitAssignmentExpr: name=" << expr->name.lexeme << std::endl;
@@ -379,21 +980,24 @@ namespace Linh
         // Evaluate value and store to variable
         if (expr->value)
         {
-            expr->value->accept(this);
+            visit(expr->value);
         }
-        int idx = get_var_index(expr->name.lexeme);
-        emit_instr(OpCode::STORE_VAR, idx, expr->getLine(), expr->getCol());
+        forget_inline_candidate(expr->name.lexeme);
+        emit_store_name(expr->name.lexeme, expr->getLine(), expr->getCol());
+        emit_induction_updates(expr->name.lexeme, expr->getLine(), expr->getCol());
         // Không emit LOAD_VAR ở đây (tránh dư stack cho for-loop)
-        return {};
+        return;
     }
 
-    std::any BytecodeEmitter::visitLogicalExpr(AST::LogicalExpr *expr)
+    void BytecodeEmitter::visitLogicalExpr(AST::LogicalExpr *expr)
     {
+        if (emit_loop_temp(expr, expr->getLine(), expr->getCol()))
+            return;
         // Short-circuit logic not implemented, fallback to eager evaluation
         if (expr->left)
-            expr->left->accept(this);
+            visit(expr->left);
         if (expr->right)
-            expr->right->accept(this);
+            visit(expr->right);
         switch (expr->op.type)
         {
         case TokenType::AND_LOGIC:
@@ -407,7 +1011,7 @@ namespace Linh
         default:
             break;
         }
-        return {};
+        return;
     }
 
     void BytecodeEmitter::visitPrintStmt(AST::PrintStmt *stmt)
@@ -415,7 +1019,7 @@ namespace Linh
         // Emit code for all expressions
         for (const auto& expr : stmt->expressions) {
             if (expr) {
-                expr->accept(this);
+                visit(expr);
             }
         }
         
@@ -430,13 +1034,13 @@ namespace Linh
     void BytecodeEmitter::visitExpressionStmt(AST::ExpressionStmt *stmt)
     {
         if (stmt->expression)
-            stmt->expression->accept(this);
+            visit(stmt->expression);
 
         // --- Sửa tại đây: Không sinh POP nếu là print(...) hoặc là increment trong for-loop ---
-        auto call = dynamic_cast<AST::CallExpr *>(stmt->expression.get());
+        auto call = AST::node_cast<AST::CallExpr>(stmt->expression.get());
         if (call)
         {
-            auto id = dynamic_cast<AST::IdentifierExpr *>(call->callee.get());
+            auto id = AST::node_cast<AST::IdentifierExpr>(call->callee.get());
             if (id && id->name.lexeme == "print")
             {
                 // Không sinh POP cho print(...)
@@ -445,7 +1049,7 @@ namespace Linh
         }
         // Không sinh POP nếu expression là dạng a = a + 1 (increment trong for)
         // Đơn giản: nếu là AssignmentExpr thì không POP
-        if (dynamic_cast<AST::AssignmentExpr *>(stmt->expression.get()))
+        if (AST::node_cast<AST::AssignmentExpr>(stmt->expression.get()))
         {
             return;
         }
@@ -454,21 +1058,29 @@ namespace Linh
 
     void BytecodeEmitter::visitVarDeclStmt(AST::VarDeclStmt *stmt)
     {
-        int idx = get_var_index(stmt->name.lexeme);
+        // Tên mới chỉ có hiệu lực sau initializer ('var x = x + 1' trong block đọc x của scope ngoài),
+        // trừ khi initializer là hàm: hàm cần thấy chính tên đó để gọi đệ quy qua upvalue
+        bool self_visible = block_scopes.empty() || AST::node_cast<AST::FunctionExpr>(stmt->initializer.get()) != nullptr;
+        int idx = self_visible ? declare_local(stmt->name.lexeme) : -1;
+        inline_candidates.erase(stmt->name.lexeme);
         if (stmt->initializer)
-            stmt->initializer->accept(this);
+            visit(stmt->initializer);
         else
             emit_instr(OpCode::PUSH_INT, 0, stmt->getLine(), stmt->getCol()); // default 0
+        if (idx < 0)
+            idx = declare_local(stmt->name.lexeme);
         emit_instr(OpCode::STORE_VAR, idx, stmt->getLine(), stmt->getCol());
     }
 
     void BytecodeEmitter::visitBlockStmt(AST::BlockStmt *stmt)
     {
+        begin_block_scope();
         for (const auto &s : stmt->statements)
         {
             if (s)
-                s->accept(this);
+                visit(s);
         }
+        end_block_scope();
     }
 
     void BytecodeEmitter::visitIfStmt(AST::IfStmt *stmt)
@@ -484,7 +1096,7 @@ namespace Linh
 
         // Evaluate condition
         if (stmt->condition)
-            stmt->condition->accept(this);
+            visit(stmt->condition);
 
         // Placeholder for JMP_IF_FALSE to else branch
         size_t jmp_if_false_pos = chunk.size();
@@ -492,7 +1104,7 @@ namespace Linh
 
         // Emit then branch
         if (stmt->then_branch)
-            stmt->then_branch->accept(this);
+            visit(stmt->then_branch);
 
         // Jump to end (skip else branch)
         size_t jmp_to_end_pos = chunk.size();
@@ -501,7 +1113,7 @@ namespace Linh
         // Else branch position
         size_t else_pos = chunk.size();
         if (stmt->else_branch)
-            stmt->else_branch->accept(this);
+            visit(stmt->else_branch);
 
         // End position
         size_t end_pos = chunk.size();
@@ -516,7 +1128,7 @@ namespace Linh
     {
         // Tối ưu hóa: Nếu điều kiện là hằng false, bỏ qua body
         if (stmt->condition) {
-            auto literal = dynamic_cast<AST::LiteralExpr*>(stmt->condition.get());
+            auto literal = AST::node_cast<AST::LiteralExpr>(stmt->condition.get());
             if (literal) {
                 bool always_false = false;
                 if (std::holds_alternative<bool>(literal->value)) always_false = !std::get<bool>(literal->value);
@@ -529,14 +1141,17 @@ namespace Linh
                 }
             }
         }
+        // Có biểu thức bất biến / biến cảm ứng: emit dạng xoay vòng có preheader
+        if (emit_optimized_loop(stmt->condition.get(), stmt->body.get(), true, stmt->getLine(), stmt->getCol()))
+            return;
         // Bình thường
         size_t cond_pos = chunk.size();
         if (stmt->condition)
-            stmt->condition->accept(this);
+            visit(stmt->condition);
         size_t jmp_if_false_pos = chunk.size();
         emit_instr(OpCode::JMP_IF_FALSE, int64_t(-1), stmt->getLine(), stmt->getCol()); // placeholder
         if (stmt->body)
-            stmt->body->accept(this);
+            visit(stmt->body);
         emit_instr(OpCode::JMP, int64_t(cond_pos), stmt->getLine(), stmt->getCol());
         size_t end_pos = chunk.size();
         chunk[jmp_if_false_pos].operand = int64_t(end_pos);
@@ -544,24 +1159,95 @@ namespace Linh
 
     void BytecodeEmitter::visitDoWhileStmt(AST::DoWhileStmt *stmt)
     {
-        size_t loop_start = chunk.size();
-        if (stmt->body)
-            stmt->body->accept(this);
         // Tối ưu hóa: Nếu điều kiện là hằng false, không sinh JMP_IF_TRUE
+        bool always_false = false;
         if (stmt->condition) {
-            auto literal = dynamic_cast<AST::LiteralExpr*>(stmt->condition.get());
-            bool always_false = false;
+            auto literal = AST::node_cast<AST::LiteralExpr>(stmt->condition.get());
             if (literal) {
                 if (std::holds_alternative<bool>(literal->value)) always_false = !std::get<bool>(literal->value);
                 else if (std::holds_alternative<int64_t>(literal->value)) always_false = std::get<int64_t>(literal->value) == 0;
                 else if (std::holds_alternative<double>(literal->value)) always_false = std::get<double>(literal->value) == 0.0;
                 else if (std::holds_alternative<std::string>(literal->value)) always_false = std::get<std::string>(literal->value).empty();
             }
-            if (!always_false)
-                stmt->condition->accept(this);
-            if (!always_false)
-                emit_instr(OpCode::JMP_IF_TRUE, int64_t(loop_start), stmt->getLine(), stmt->getCol());
         }
+        // Thân luôn chạy ít nhất 1 lần: preheader đặt ngay trước thân
+        if (!always_false && emit_optimized_loop(stmt->condition.get(), stmt->body.get(), false, stmt->getLine(), stmt->getCol()))
+            return;
+        size_t loop_start = chunk.size();
+        if (stmt->body)
+            visit(stmt->body);
+        if (stmt->condition && !always_false) {
+            visit(stmt->condition);
+            emit_instr(OpCode::JMP_IF_TRUE, int64_t(loop_start), stmt->getLine(), stmt->getCol());
+        }
+    }
+
+    void BytecodeEmitter::visitForInStmt(AST::ForInStmt *stmt)
+    {
+        // Biến lặp + 3 slot ẩn liên tiếp cho trạng thái vòng lặp:
+        //   range: [state] = giá trị kế tiếp, [state+1] = end, [state+2] = step
+        //   iter : [state] = array/map/str, [state+1] = vị trí kế tiếp
+        //   stdin: không dùng slot trạng thái, FOR_ITER đọc thẳng dòng kế tiếp vào biến lặp
+        // Biến lặp thuộc scope của vòng lặp; 3 slot trạng thái phải liền nhau nên cấp mới ở cuối frame
+        int state_idx = next_var_index;
+        next_var_index += 3;
+        int line = stmt->getLine(), col = stmt->getCol();
+
+        OpCode loop_op;
+        std::string source; // "stdin" khi duyệt các dòng của stdin
+        if (auto range_call = stmt->as_range_call())
+        {
+            // range(end) | range(start, end) | range(start, end, step)
+            auto &args = range_call->arguments;
+            if (args.size() >= 2)
+                visit(args[0]);
+            else
+                emit_instr(OpCode::PUSH_INT, int64_t(0), line, col);
+            emit_instr(OpCode::STORE_VAR, state_idx, line, col);
+            if (args.size() == 1)
+                visit(args[0]);
+            else if (args.size() >= 2)
+                visit(args[1]);
+            else
+                emit_instr(OpCode::PUSH_INT, int64_t(0), line, col);
+            emit_instr(OpCode::STORE_VAR, state_idx + 1, line, col);
+            if (args.size() >= 3)
+                visit(args[2]);
+            else
+                emit_instr(OpCode::PUSH_INT, int64_t(1), line, col);
+            emit_instr(OpCode::STORE_VAR, state_idx + 2, line, col);
+            loop_op = OpCode::FOR_RANGE;
+        }
+        else if (stmt->iterates_stdin())
+        {
+            source = "stdin";
+            loop_op = OpCode::FOR_ITER;
+        }
+        else
+        {
+            if (stmt->iterable)
+                visit(stmt->iterable);
+            emit_instr(OpCode::STORE_VAR, state_idx, line, col);
+            emit_instr(OpCode::PUSH_INT, int64_t(0), line, col);
+            emit_instr(OpCode::STORE_VAR, state_idx + 1, line, col);
+            loop_op = OpCode::FOR_ITER;
+        }
+
+        // Đối số range/iterable được tính ở scope ngoài, trước khi biến lặp xuất hiện
+        begin_block_scope();
+        int var_idx = declare_local(stmt->var_name.lexeme);
+
+        // Đầu vòng lặp: 1 lệnh vừa so sánh, vừa gán biến lặp, vừa nhảy ra khi hết
+        size_t loop_start = chunk.size();
+        emit_instr(loop_op, std::make_tuple(int64_t(var_idx), int64_t(state_idx), int64_t(-1), source), line, col); // placeholder
+        if (stmt->body)
+            visit(stmt->body);
+        emit_instr(OpCode::JMP, int64_t(loop_start), line, col);
+        size_t end_pos = chunk.size();
+        chunk[loop_start].operand = std::make_tuple(int64_t(var_idx), int64_t(state_idx), int64_t(end_pos), source);
+        end_block_scope();
+        for (int i = 0; i < 3; ++i)
+            release_slot(state_idx + i);
     }
 
     void BytecodeEmitter::visitFunctionDeclStmt(AST::FunctionDeclStmt *stmt) {
@@ -580,46 +1266,40 @@ namespace Linh
             function_params.emplace_back(param.name.lexeme, param_type, param.is_static);
         }
         
-        // Tạo bytecode cho thân hàm
-        BytecodeChunk function_body;
-        {
-            BytecodeEmitter body_emitter;
-            if (stmt->body) {
-                for (const auto& body_stmt : stmt->body->statements) {
-                    if (body_stmt) {
-                        body_stmt->accept(&body_emitter);
-                    }
-                }
-            }
-            // Thêm RET instruction nếu không có return statement
-            if (body_emitter.chunk.empty() || body_emitter.chunk.back().opcode != OpCode::RET) {
-                body_emitter.emit_instr(OpCode::RET, {}, stmt->getLine(), stmt->getCol());
-            }
-            function_body = body_emitter.chunk; // Gán lại đúng
-        }
-        
-        // Tạo FunctionObject với thân hàm
-#ifdef _DEBUG
-        std::cerr << "[DEBUG] visitFunctionDeclStmt: function body has " << function_body.size() << " instructions" << std::endl;
-#endif
-        auto fn = create_function(stmt->name.lexeme, function_params, function_body);
-        
-        // Lưu function object vào biến
+        // Đăng ký tên hàm trước khi emit thân hàm để hàm đệ quy capture được chính nó
         int var_idx = get_var_index(stmt->name.lexeme);
-        
-        // Push function object lên stack
+        std::optional<InlineCandidate> inline_body;
+        auto fn = compile_function(stmt->name.lexeme, function_params, stmt->body.get(), stmt->getLine(), stmt->getCol(), &inline_body);
+        if (inline_body)
+            inline_candidates[stmt->name.lexeme] = std::move(*inline_body);
+        else
+            inline_candidates.erase(stmt->name.lexeme);
 #ifdef _DEBUG
-        std::cerr << "[DEBUG] visitFunctionDeclStmt: creating function object for " << stmt->name.lexeme << std::endl;
+        std::cerr << "[DEBUG] visitFunctionDeclStmt: function body has " << fn->body.size() << " instructions, "
+                  << fn->upvalue_descs.size() << " upvalues" << std::endl;
 #endif
-        emit_instr(OpCode::PUSH_FUNCTION, fn, stmt->getLine(), stmt->getCol());
-        
-        // Store vào biến
+
+        // Push function object (hoặc closure) lên stack rồi store vào biến
+        emit_function_object(fn, stmt->getLine(), stmt->getCol());
         emit_instr(OpCode::STORE_VAR, var_idx, stmt->getLine(), stmt->getCol());
     }
     void BytecodeEmitter::visitReturnStmt(AST::ReturnStmt *stmt)
     {
         if (stmt->value)
-            stmt->value->accept(this);
+            visit(stmt->value);
+        else
+            ++valueless_returns;
+        // return f(...) trong thân hàm => gọi đuôi, VM dùng lại frame thay vì lồng thêm 1 vòng dispatch.
+        // Vẫn giữ RET phía sau cho trường hợp VM phải gọi như CALL thường.
+        // Trong vùng try thì không: hàm gọi đuôi chạy sau khi rời thân hàm, nằm ngoài vùng try được bảo vệ.
+        auto call = AST::node_cast<AST::CallExpr>(stmt->value.get());
+        auto callee = call ? AST::node_cast<AST::IdentifierExpr>(call->callee.get()) : nullptr;
+        if (enclosing && open_try_blocks == 0 && callee && !chunk.empty() && chunk.back().opcode == OpCode::CALL)
+        {
+            const auto *target = std::get_if<std::tuple<int64_t, int64_t, int64_t, std::string>>(&chunk.back().operand);
+            if (target && std::get<3>(*target) == callee->name.lexeme)
+                chunk.back().opcode = OpCode::TAIL_CALL;
+        }
         emit_instr(OpCode::RET, {}, stmt->getLine(), stmt->getCol());
     }
     void BytecodeEmitter::visitBreakStmt(AST::BreakStmt *) {}
@@ -628,7 +1308,7 @@ namespace Linh
     {
         // --- Sinh bytecode cho switch-case ---
         if (stmt->expression_to_switch_on)
-            stmt->expression_to_switch_on->accept(this);
+            visit(stmt->expression_to_switch_on);
 
         size_t case_count = stmt->cases.size();
         std::vector<size_t> case_jump_addrs(case_count, 0);
@@ -649,7 +1329,7 @@ namespace Linh
             }
             emit_instr(OpCode::DUP);
             if (case_clause.case_value.has_value() && case_clause.case_value.value())
-                case_clause.case_value.value()->accept(this);
+                visit(case_clause.case_value.value());
             else
                 emit_instr(OpCode::PUSH_INT, 0);
 
@@ -678,7 +1358,7 @@ namespace Linh
                 if (s)
                 {
                     // Nếu là BreakStmt thì sinh JMP và lưu lại vị trí để sửa sau
-                    if (dynamic_cast<AST::BreakStmt *>(s.get()))
+                    if (AST::node_cast<AST::BreakStmt>(s.get()))
                     {
                         size_t break_jmp_addr = chunk.size();
                         emit_instr(OpCode::JMP, int64_t(-1));
@@ -686,7 +1366,7 @@ namespace Linh
                         // Sau break thì không sinh code cho các statement tiếp theo trong case
                         break;
                     }
-                    s->accept(this);
+                    visit(s);
                 }
             }
         }
@@ -702,14 +1382,14 @@ namespace Linh
             {
                 if (s)
                 {
-                    if (dynamic_cast<AST::BreakStmt *>(s.get()))
+                    if (AST::node_cast<AST::BreakStmt>(s.get()))
                     {
                         size_t break_jmp_addr = chunk.size();
                         emit_instr(OpCode::JMP, int64_t(-1));
                         break_jmp_addrs.push_back(break_jmp_addr);
                         break;
                     }
-                    s->accept(this);
+                    visit(s);
                 }
             }
         }
@@ -733,155 +1413,182 @@ namespace Linh
     void BytecodeEmitter::visitThrowStmt(AST::ThrowStmt *) {}
     void BytecodeEmitter::visitTryStmt(AST::TryStmt *stmt)
     {
-        // Đặt nhãn cho catch, finally, end
+        // Không sinh lệnh nào để "vào" try: vùng try được ghi vào bảng exception tĩnh,
+        // VM chỉ tra bảng khi thực sự có lỗi nên đường chạy không lỗi không tốn gì thêm
         size_t try_start = chunk.size();
-        size_t catch_pos = 0, finally_pos = 0, end_pos = 0;
 
-        // Đặt biến error_var đặc biệt (ở đây dùng index -9999)
+        // Biến nhận thông báo lỗi: tên trong catch (e), mặc định là "error"
         std::string error_var = "error";
-
-        // Đặt chỗ TRY, sẽ sửa operand sau
-        size_t try_instr_pos = chunk.size();
-        emit_instr(OpCode::TRY, std::make_tuple(int64_t(0), int64_t(0), int64_t(0), error_var), stmt->keyword_try.line, stmt->keyword_try.column_start);
+        if (!stmt->catch_clauses.empty() && stmt->catch_clauses[0].exception_variable.has_value())
+            error_var = stmt->catch_clauses[0].exception_variable->lexeme;
+        // catch (e): e chỉ sống trong catch; slot được cấp trước try_block để không trùng biến trong try
+        bool scoped_error = !stmt->catch_clauses.empty() && stmt->catch_clauses[0].exception_variable.has_value();
+        int error_slot = scoped_error ? alloc_slot() : get_var_index(error_var);
 
         // Sinh code cho try_block
+        ++open_try_blocks;
         if (stmt->try_block)
-            stmt->try_block->accept(this);
+            visit(stmt->try_block);
+        --open_try_blocks;
+        size_t try_end = chunk.size();
 
-        // Sau try_block, nhảy đến finally (nếu có), hoặc end
+        // Sau try_block, nhảy qua catch đến finally (nếu có), hoặc end
         size_t after_try = chunk.size();
         emit_instr(OpCode::JMP, int64_t(0), stmt->keyword_try.line, stmt->keyword_try.column_start); // placeholder
 
         // catch
-        catch_pos = chunk.size();
+        size_t catch_pos = chunk.size();
         if (!stmt->catch_clauses.empty())
         {
             // Chỉ lấy catch đầu tiên (giản lược)
             auto &catch_clause = stmt->catch_clauses[0];
-            // Gán biến error (index -9999)
-            // (Ở đây không sinh code, VM sẽ tự gán khi lỗi)
+            // (Không sinh code gán biến lỗi, VM tự ghi vào error_slot khi lỗi)
+            if (scoped_error)
+            {
+                begin_block_scope();
+                auto outer = var_table.find(error_var);
+                block_scopes.back().emplace_back(error_var, outer != var_table.end() ? outer->second : -1);
+                var_table[error_var] = error_slot;
+            }
             if (catch_clause.body)
-                catch_clause.body->accept(this);
+                visit(catch_clause.body);
+            if (scoped_error)
+                end_block_scope(); // trả luôn error_slot
         }
 
         // finally
-        finally_pos = chunk.size();
+        size_t finally_pos = chunk.size();
         if (stmt->finally_block.has_value() && stmt->finally_block.value())
         {
-            stmt->finally_block.value()->accept(this);
+            visit(stmt->finally_block.value());
         }
 
-        // end
-        end_pos = chunk.size();
-        emit_instr(OpCode::END_TRY, {}, stmt->keyword_try.line, stmt->keyword_try.column_start);
-
         // Sửa lại JMP sau try_block để nhảy qua catch đến finally/end
         chunk[after_try].operand = int64_t(finally_pos);
 
-        // Sửa lại TRY operand
-        chunk[try_instr_pos].operand = std::make_tuple(
-            int64_t(catch_pos),
-            int64_t(finally_pos),
-            int64_t(end_pos),
-            error_var);
+        // Vùng try lồng bên trong đã được thêm trước => vùng trong luôn được tra trước.
+        // Câu lệnh không giữ giá trị trên stack qua câu lệnh khác (switch pop giá trị trước khi vào case),
+        // nên lúc vào try stack của frame rỗng: khi lỗi, VM bỏ hết giá trị biểu thức đang tính dở.
+        exception_table.push_back({int64_t(try_start), int64_t(try_end), int64_t(catch_pos), int64_t(error_slot), int64_t(0)});
     }
 
-    std::any BytecodeEmitter::visitCallExpr(AST::CallExpr *expr)
+    void BytecodeEmitter::visitCallExpr(AST::CallExpr *expr)
     {
         // Special case: input(...), type(...), id(...), printf(...)
-        if (auto id = dynamic_cast<AST::IdentifierExpr *>(expr->callee.get()))
+        if (auto id = AST::node_cast<AST::IdentifierExpr>(expr->callee.get()))
         {
             if (id->name.lexeme == "input")
             {
                 if (!expr->arguments.empty())
-                    expr->arguments[0]->accept(this);
+                    visit(expr->arguments[0]);
                 else
                     emit_instr(OpCode::PUSH_STR, std::string(""), expr->getLine(), expr->getCol());
                 emit_instr(OpCode::INPUT, {}, expr->getLine(), expr->getCol());
-                return {};
+                return;
             }
             if (id->name.lexeme == "type")
             {
                 if (!expr->arguments.empty())
-                    expr->arguments[0]->accept(this);
+                    visit(expr->arguments[0]);
                 else
                     emit_instr(OpCode::PUSH_STR, std::string(""), expr->getLine(), expr->getCol());
                 emit_instr(OpCode::TYPEOF, {}, expr->getLine(), expr->getCol());
-                return {};
+                return;
             }
             if (id->name.lexeme == "id")
             {
                 if (!expr->arguments.empty())
-                    expr->arguments[0]->accept(this);
+                    visit(expr->arguments[0]);
                 else
                     emit_instr(OpCode::PUSH_STR, std::string(""), expr->getLine(), expr->getCol());
                 emit_instr(OpCode::ID, {}, expr->getLine(), expr->getCol());
-                return {};
+                return;
             }
             if (id->name.lexeme == "printf")
             {
                 if (!expr->arguments.empty())
-                    expr->arguments[0]->accept(this);
+                    visit(expr->arguments[0]);
                 else
                     emit_instr(OpCode::PUSH_STR, std::string(""), expr->getLine(), expr->getCol());
                 emit_instr(OpCode::PRINTF, {}, expr->getLine(), expr->getCol());
-                return {};
+                return;
+            }
+            // --- Đọc stdin: read_all(), read_line(), read_bytes(n), read_eof() ---
+            if (id->name.lexeme == "read_all" || id->name.lexeme == "read_line" || id->name.lexeme == "read_eof")
+            {
+                OpCode op = id->name.lexeme == "read_all" ? OpCode::READ_ALL
+                            : id->name.lexeme == "read_line" ? OpCode::READ_LINE
+                                                              : OpCode::READ_EOF;
+                emit_instr(op, {}, expr->getLine(), expr->getCol());
+                return;
+            }
+            if (id->name.lexeme == "read_bytes")
+            {
+                if (!expr->arguments.empty())
+                    visit(expr->arguments[0]);
+                else
+                    emit_instr(OpCode::PUSH_INT, int64_t(0), expr->getLine(), expr->getCol());
+                emit_instr(OpCode::READ_BYTES, {}, expr->getLine(), expr->getCol());
+                return;
             }
             // --- User-defined function call ---
+            // Hàm nhỏ, không đệ quy: chép thẳng thân hàm vào đây thay vì CALL
+            if (try_inline_call(expr, id->name.lexeme))
+                return;
             // Emit arguments trước
             for (auto &arg : expr->arguments)
                 if (arg)
-                    arg->accept(this);
+                    visit(arg);
             // Sau đó mới LOAD_VAR cho function object
-            emit_instr(OpCode::LOAD_VAR, get_var_index(id->name.lexeme), expr->getLine(), expr->getCol());
+            emit_load_name(id->name.lexeme, expr->getLine(), expr->getCol());
             // Cuối cùng CALL
-            emit_instr(OpCode::CALL, id->name.lexeme, expr->getLine(), expr->getCol());
-            return {};
+            emit_call(id->name.lexeme, expr->arguments.size(), expr->getLine(), expr->getCol());
+            return;
         }
         // Hỗ trợ a.append(x) và a.remove(x)
         // Nếu callee là MemberExpr (giả sử có AST::MemberExpr hoặc SubscriptExpr)
         // Đơn giản: Nếu callee là dạng a.append hoặc a.remove
-        if (auto member = dynamic_cast<AST::MemberExpr *>(expr->callee.get()))
+        if (auto member = AST::node_cast<AST::MemberExpr>(expr->callee.get()))
         {
             // member->object: biểu thức array, member->property: tên phương thức
             if (member->property == "append" && expr->arguments.size() == 1)
             {
                 // Đánh giá object (array)
                 if (member->object)
-                    member->object->accept(this);
+                    visit(member->object);
                 // Đánh giá argument (giá trị cần append)
-                expr->arguments[0]->accept(this);
+                visit(expr->arguments[0]);
                 emit_instr(OpCode::ARRAY_APPEND, {}, expr->getLine(), expr->getCol());
-                return {};
+                return;
             }
             if (member->property == "remove" && expr->arguments.size() == 1)
             {
                 // Đánh giá object (array)
                 if (member->object)
-                    member->object->accept(this);
+                    visit(member->object);
                 // Đánh giá argument (giá trị cần remove)
-                expr->arguments[0]->accept(this);
+                visit(expr->arguments[0]);
                 emit_instr(OpCode::ARRAY_REMOVE, {}, expr->getLine(), expr->getCol());
-                return {};
+                return;
             }
             if (member->property == "clear" && expr->arguments.empty())
             {
                 if (member->object)
-                    member->object->accept(this);
+                    visit(member->object);
                 emit_instr(OpCode::ARRAY_CLEAR, {}, expr->getLine(), expr->getCol());
-                return {};
+                return;
             }
             if (member->property == "clone" && expr->arguments.empty())
             {
                 if (member->object)
-                    member->object->accept(this);
+                    visit(member->object);
                 emit_instr(OpCode::ARRAY_CLONE, {}, expr->getLine(), expr->getCol());
-                return {};
+                return;
             }
             if (member->property == "pop")
             {
                 if (member->object)
-                    member->object->accept(this);
+                    visit(member->object);
                 if (expr->arguments.empty())
                 {
                     // a.pop()
@@ -890,57 +1597,56 @@ namespace Linh
                 else if (expr->arguments.size() == 1)
                 {
                     // a.pop(index)
-                    expr->arguments[0]->accept(this);
+                    visit(expr->arguments[0]);
                     emit_instr(OpCode::ARRAY_POP, {}, expr->getLine(), expr->getCol());
                 }
-                return {};
+                return;
             }
             if (member->property == "delete" && expr->arguments.size() == 1)
             {
                 // Đánh giá object (map)
                 if (member->object)
-                    member->object->accept(this);
+                    visit(member->object);
                 // Đánh giá argument (key)
-                expr->arguments[0]->accept(this);
+                visit(expr->arguments[0]);
                 emit_instr(OpCode::MAP_DELETE, {}, expr->getLine(), expr->getCol());
-                return {};
+                return;
             }
             if (member->property == "clear" && expr->arguments.empty())
             {
                 if (member->object)
-                    member->object->accept(this);
+                    visit(member->object);
                 emit_instr(OpCode::MAP_CLEAR, {}, expr->getLine(), expr->getCol());
-                return {};
+                return;
             }
             if (member->property == "keys" && expr->arguments.empty())
             {
                 if (member->object)
-                    member->object->accept(this);
+                    visit(member->object);
                 emit_instr(OpCode::MAP_KEYS, {}, expr->getLine(), expr->getCol());
-                return {};
+                return;
             }
             if (member->property == "values" && expr->arguments.empty())
             {
                 if (member->object)
-                    member->object->accept(this);
+                    visit(member->object);
                 emit_instr(OpCode::MAP_VALUES, {}, expr->getLine(), expr->getCol());
-                return {};
+                return;
             }
         }
         // Not implemented yet for other calls
-        return {};
+        return;
     }
 
-    std::any BytecodeEmitter::visitPostfixExpr(AST::PostfixExpr *expr)
+    void BytecodeEmitter::visitPostfixExpr(AST::PostfixExpr *expr)
     {
         // Hỗ trợ a++ và a--
         // Chỉ hỗ trợ cho IdentifierExpr
-        auto id = dynamic_cast<AST::IdentifierExpr *>(expr->operand.get());
+        auto id = AST::node_cast<AST::IdentifierExpr>(expr->operand.get());
         if (!id)
-            return {};
-        int idx = get_var_index(id->name.lexeme);
-        // LOAD_VAR idx
-        emit_instr(OpCode::LOAD_VAR, idx, expr->getLine(), expr->getCol());
+            return;
+        // LOAD_VAR idx (hoặc LOAD_UPVALUE nếu là biến của hàm bao ngoài)
+        emit_load_name(id->name.lexeme, expr->getLine(), expr->getCol());
         // PUSH_INT 1
         emit_instr(OpCode::PUSH_INT, 1, expr->getLine(), expr->getCol());
         if (expr->op_token.type == TokenType::PLUS_PLUS)
@@ -948,121 +1654,112 @@ namespace Linh
         else if (expr->op_token.type == TokenType::MINUS_MINUS)
             emit_instr(OpCode::SUB, {}, expr->getLine(), expr->getCol());
         // STORE_VAR idx
-        emit_instr(OpCode::STORE_VAR, idx, expr->getLine(), expr->getCol());
+        emit_store_name(id->name.lexeme, expr->getLine(), expr->getCol());
+        emit_induction_updates(id->name.lexeme, expr->getLine(), expr->getCol());
         // Optionally, load value back (for expression value)
-        emit_instr(OpCode::LOAD_VAR, idx, expr->getLine(), expr->getCol());
-        return {};
+        emit_load_name(id->name.lexeme, expr->getLine(), expr->getCol());
+        return;
     }
 
-    std::any BytecodeEmitter::visitUninitLiteralExpr(AST::UninitLiteralExpr *expr)
+    void BytecodeEmitter::visitUninitLiteralExpr(AST::UninitLiteralExpr *expr)
     {
         // Not implemented yet
-        return {};
+        return;
     }
 
-    std::any BytecodeEmitter::visitNewExpr(AST::NewExpr *expr)
+    void BytecodeEmitter::visitNewExpr(AST::NewExpr *expr)
     {
         // Not implemented yet
-        return {};
+        return;
     }
 
-    std::any BytecodeEmitter::visitThisExpr(AST::ThisExpr *expr)
+    void BytecodeEmitter::visitThisExpr(AST::ThisExpr *expr)
     {
         // Not implemented yet
-        return {};
+        return;
     }
 
-    std::any BytecodeEmitter::visitArrayLiteralExpr(AST::ArrayLiteralExpr *expr)
+    void BytecodeEmitter::visitArrayLiteralExpr(AST::ArrayLiteralExpr *expr)
     {
         // Emit code cho từng phần tử (theo thứ tự)
         for (const auto &elem : expr->elements)
         {
             if (elem)
-                elem->accept(this);
+                visit(elem);
         }
         // Sau đó emit PUSH_ARRAY với số lượng phần tử
         emit_instr(OpCode::PUSH_ARRAY, static_cast<int64_t>(expr->elements.size()), expr->getLine(), expr->getCol());
-        return {};
+        return;
     }
 
-    std::any BytecodeEmitter::visitMapLiteralExpr(AST::MapLiteralExpr *expr)
+    void BytecodeEmitter::visitMapLiteralExpr(AST::MapLiteralExpr *expr)
     {
         // Emit code cho từng key, value (theo thứ tự)
         for (const auto &entry : expr->entries)
         {
             if (entry.key)
-                entry.key->accept(this);
+                visit(entry.key);
             if (entry.value)
-                entry.value->accept(this);
+                visit(entry.value);
         }
         // Sau đó emit PUSH_MAP với số lượng cặp
         emit_instr(OpCode::PUSH_MAP, static_cast<int64_t>(expr->entries.size()), expr->l_brace.line, expr->l_brace.column_start);
-        return {};
+        return;
     }
 
-    std::any BytecodeEmitter::visitSubscriptExpr(AST::SubscriptExpr *expr)
+    void BytecodeEmitter::visitSubscriptExpr(AST::SubscriptExpr *expr)
     {
+        if (emit_loop_temp(expr, expr->l_bracket_token.line, expr->l_bracket_token.column_start))
+            return;
         // Đánh giá object và index
         if (expr->object)
-            expr->object->accept(this);
+            visit(expr->object);
         if (expr->index)
-            expr->index->accept(this);
+            visit(expr->index);
         // Sau khi object và index đã lên stack, quyết định loại truy cập ở runtime
         // Để đơn giản, luôn emit ARRAY_GET (VM sẽ tự kiểm tra type object)
         emit_instr(OpCode::ARRAY_GET, {}, expr->l_bracket_token.line, expr->l_bracket_token.column_start);
-        return {};
+        return;
     }
 
-    std::any BytecodeEmitter::visitInterpolatedStringExpr(AST::InterpolatedStringExpr *expr)
+    void BytecodeEmitter::visitInterpolatedStringExpr(AST::InterpolatedStringExpr *expr)
     {
         // Nếu chỉ có 1 phần là chuỗi thì PUSH_STR luôn
         if (expr->parts.size() == 1 && std::holds_alternative<std::string>(expr->parts[0]))
         {
             emit_instr(OpCode::PUSH_STR, std::get<std::string>(expr->parts[0]), expr->getLine(), expr->getCol());
-            return {};
+            return;
         }
-        // Duyệt từng phần, đẩy từng phần lên stack (dưới dạng string)
+        // Duyệt từng phần, đẩy từng phần lên stack theo đúng thứ tự, CONCAT_N sẽ tự chuyển sang string
+        int64_t pushed_parts = 0;
         for (const auto &part : expr->parts)
         {
             if (std::holds_alternative<std::string>(part))
             {
                 emit_instr(OpCode::PUSH_STR, std::get<std::string>(part), expr->getLine(), expr->getCol());
+                ++pushed_parts;
             }
             else
             {
-                // Phần là biểu thức, emit cho expr, rồi ép về string bằng cách nối với ""
+                // Phần là biểu thức, chỉ cần emit giá trị
                 auto *subexpr = std::get<AST::ExprPtr>(part).get();
                 if (subexpr)
                 {
-                    // Nếu là MemberExpr và là package constant, emit đúng LOAD_PACKAGE_CONST
-                    if (auto member = dynamic_cast<AST::MemberExpr *>(subexpr)) {
-                        if (member->is_package_constant) {
-                            std::string full_name = member->package_name + "." + member->constant_name;
-                            emit_instr(OpCode::LOAD_PACKAGE_CONST, full_name, member->getLine(), member->getCol());
-                        } else if (auto id = dynamic_cast<AST::IdentifierExpr *>(member->object.get())) {
-                            if (id->name.lexeme == "math") {
-                                std::string full_name = id->name.lexeme + "." + member->property_token.lexeme;
-                                emit_instr(OpCode::LOAD_PACKAGE_CONST, full_name, member->getLine(), member->getCol());
-                            } else {
-                                subexpr->accept(this);
-                            }
-                        } else {
-                            subexpr->accept(this);
-                        }
+                    // Nếu là MemberExpr và là package constant, emit giá trị package luôn
+                    auto member = AST::node_cast<AST::MemberExpr>(subexpr);
+                    std::string package, name;
+                    if (member && package_member(member, package, name)) {
+                        emit_package_value(package, name, member->getLine(), member->getCol());
                     } else {
-                        subexpr->accept(this);
+                        visit(subexpr);
                     }
-                    emit_instr(OpCode::PUSH_STR, std::string(""), expr->getLine(), expr->getCol());
-                    emit_instr(OpCode::ADD, {}, expr->getLine(), expr->getCol()); // ép về string
+                    ++pushed_parts;
                 }
             }
         }
-        // Nối tất cả lại thành một chuỗi (dùng toán tử +)
-        for (size_t i = 1; i < expr->parts.size(); ++i)
-        {
-            emit_instr(OpCode::ADD, {}, expr->getLine(), expr->getCol());
-        }
-        return {};
+        // Nối tất cả lại thành một chuỗi bằng 1 lệnh duy nhất
+        emit_instr(OpCode::CONCAT_N, pushed_parts, expr->getLine(), expr->getCol());
+        return;
     }
 
     void BytecodeEmitter::visitImportStmt(AST::ImportStmt * /*stmt*/)
@@ -1070,13 +1767,15 @@ namespace Linh
         // Không sinh bytecode cho import (hoặc xử lý import module ở đây nếu cần)
     }
 
-    std::any BytecodeEmitter::visitMemberExpr(AST::MemberExpr *expr)
+    void BytecodeEmitter::visitMemberExpr(AST::MemberExpr *expr)
     {
+        if (emit_loop_temp(expr, expr->getLine(), expr->getCol()))
+            return;
 #ifdef _DEBUG
         std::cerr << "[DEBUG] visitMemberExpr called!" << std::endl;
         std::cerr << "[DEBUG] MemberExpr: object=";
 #endif
-        if (auto id = dynamic_cast<AST::IdentifierExpr *>(expr->object.get())) {
+        if (auto id = AST::node_cast<AST::IdentifierExpr>(expr->object.get())) {
 #ifdef _DEBUG
             std::cerr << id->name.lexeme;
 #endif
@@ -1092,41 +1791,28 @@ namespace Linh
         std::cerr << "[DEBUG] is_package_constant: " << (expr->is_package_constant ? "true" : "false") << std::endl;
 #endif
         
-        // Kiểm tra xem có phải package constant không
-        if (expr->is_package_constant) {
-            std::string full_name = expr->package_name + "." + expr->constant_name;
+        // Package constant (đã đánh dấu bởi semantic, hoặc math.* mặc định): resolve ngay lúc biên dịch
+        std::string package, name;
+        if (package_member(expr, package, name)) {
 #ifdef _DEBUG
-            std::cerr << "[DEBUG] Emitting LOAD_PACKAGE_CONST: " << full_name << std::endl;
+            std::cerr << "[DEBUG] Emitting package value: " << package << "." << name << std::endl;
 #endif
-            emit_instr(OpCode::LOAD_PACKAGE_CONST, full_name, expr->getLine(), expr->getCol());
-            return {};
-        }
-        
-        // Fallback: Nếu object là IdentifierExpr và là package mặc định, sinh LOAD_PACKAGE_CONST
-        auto id = dynamic_cast<AST::IdentifierExpr *>(expr->object.get());
-        if (id) {
-            // Luôn xử lý math.* như package constant
-            if (id->name.lexeme == "math") {
-                // Sinh opcode LOAD_PACKAGE_CONST với operand "package.property"
-                std::string full_name = id->name.lexeme + "." + expr->property_token.lexeme;
-#ifdef _DEBUG
-                std::cerr << "[DEBUG] Emitting LOAD_PACKAGE_CONST (fallback): " << full_name << std::endl;
-#endif
-                emit_instr(OpCode::LOAD_PACKAGE_CONST, full_name, expr->getLine(), expr->getCol());
-                return {};
-            }
+            emit_package_value(package, name, expr->getLine(), expr->getCol());
+            return;
         }
         // Nếu không phải package, xử lý như cũ (truy cập thuộc tính của map/object)
         if (expr->object)
-            expr->object->accept(this);
+            visit(expr->object);
         // Không sinh bytecode cho property ở đây (xử lý trong visitCallExpr nếu là method)
-        return {};
+        return;
     }
 
-    std::any BytecodeEmitter::visitMethodCallExpr(AST::MethodCallExpr *expr)
+    void BytecodeEmitter::visitMethodCallExpr(AST::MethodCallExpr *expr)
     {
+        if (emit_loop_temp(expr, expr->getLine(), expr->getCol()))
+            return;
         // Math package methods: abs, ceil, floor, round, trunc
-        auto id = dynamic_cast<AST::IdentifierExpr *>(expr->object.get());
+        auto id = AST::node_cast<AST::IdentifierExpr>(expr->object.get());
         if (id && id->name.lexeme == "math")
         {
             // Check if it's a math function
@@ -1144,28 +1830,28 @@ namespace Linh
                  expr->method_name == "log10" || expr->method_name == "log2") && expr->arguments.size() == 1)
             {
                 // Emit the argument first
-                expr->arguments[0]->accept(this);
+                visit(expr->arguments[0]);
                 // Then emit the function call
-                emit_instr(OpCode::CALL, expr->method_name, expr->getLine(), expr->getCol());
-                return {};
+                emit_call(expr->method_name, expr->arguments.size(), expr->getLine(), expr->getCol());
+                return;
             }
             else if (expr->method_name == "atan2" && expr->arguments.size() == 2)
             {
                 // Emit the arguments in reverse order (y first, then x)
-                expr->arguments[1]->accept(this); // y
-                expr->arguments[0]->accept(this); // x
+                visit(expr->arguments[1]); // y
+                visit(expr->arguments[0]); // x
                 // Then emit the function call
-                emit_instr(OpCode::CALL, expr->method_name, expr->getLine(), expr->getCol());
-                return {};
+                emit_call(expr->method_name, expr->arguments.size(), expr->getLine(), expr->getCol());
+                return;
             }
             else if (expr->method_name == "pow" && expr->arguments.size() == 2)
             {
                 // Emit the arguments in reverse order (exponent first, then base)
-                expr->arguments[1]->accept(this); // exponent
-                expr->arguments[0]->accept(this); // base
+                visit(expr->arguments[1]); // exponent
+                visit(expr->arguments[0]); // base
                 // Then emit the function call
-                emit_instr(OpCode::CALL, expr->method_name, expr->getLine(), expr->getCol());
-                return {};
+                emit_call(expr->method_name, expr->arguments.size(), expr->getLine(), expr->getCol());
+                return;
             }
         }
         
@@ -1173,43 +1859,43 @@ namespace Linh
         if (expr->method_name == "delete" && expr->arguments.size() == 1)
         {
             if (expr->object)
-                expr->object->accept(this);
-            expr->arguments[0]->accept(this);
+                visit(expr->object);
+            visit(expr->arguments[0]);
             emit_instr(OpCode::MAP_DELETE, {}, expr->getLine(), expr->getCol());
-            return {};
+            return;
         }
         if (expr->method_name == "clear" && expr->arguments.empty())
         {
             if (expr->object)
-                expr->object->accept(this);
+                visit(expr->object);
             emit_instr(OpCode::MAP_CLEAR, {}, expr->getLine(), expr->getCol());
-            return {};
+            return;
         }
         if (expr->method_name == "keys" && expr->arguments.empty())
         {
             if (expr->object)
-                expr->object->accept(this);
+                visit(expr->object);
             emit_instr(OpCode::MAP_KEYS, {}, expr->getLine(), expr->getCol());
-            return {};
+            return;
         }
         if (expr->method_name == "values" && expr->arguments.empty())
         {
             if (expr->object)
-                expr->object->accept(this);
+                visit(expr->object);
             emit_instr(OpCode::MAP_VALUES, {}, expr->getLine(), expr->getCol());
-            return {};
+            return;
         }
         // You can add array methods here if needed
         // Default: just visit object and arguments (no-op)
         if (expr->object)
-            expr->object->accept(this);
+            visit(expr->object);
         for (const auto &arg : expr->arguments)
             if (arg)
-                arg->accept(this);
-        return {};
+                visit(arg);
+        return;
     }
 
-    std::any BytecodeEmitter::visitFunctionExpr(AST::FunctionExpr *expr) {
+    void BytecodeEmitter::visitFunctionExpr(AST::FunctionExpr *expr) {
         // Tạo function object không tên (anonymous)
         std::vector<FunctionParameter> function_params;
         for (const auto &param : expr->params) {
@@ -1220,14 +1906,9 @@ namespace Linh
             }
             function_params.emplace_back(param.name.lexeme, param_type, param.is_static);
         }
-        BytecodeChunk function_body;
-        BytecodeEmitter body_emitter;
-        body_emitter.var_table = var_table; // inherit outer var table for closure (tạm thời)
-        if (expr->body) expr->body->accept(&body_emitter);
-        function_body = body_emitter.chunk;
-        // Tên hàm rỗng cho anonymous
-        auto fn = create_function("", function_params, function_body);
-        emit_instr(OpCode::PUSH_FUNCTION, fn, expr->getLine(), expr->getCol());
-        return {};
+        // Tên hàm rỗng cho anonymous; biến của scope ngoài được capture qua upvalue
+        auto fn = compile_function("", function_params, expr->body.get(), expr->getLine(), expr->getCol());
+        emit_function_object(fn, expr->getLine(), expr->getCol());
+        return;
     }
 }
\ No newline at end of file
@@ -2,13 +2,14 @@
 #include "../Parsing/AST/ASTNode.hpp"
 #include "Bytecode.hpp"
 #include <unordered_map>
+#include <unordered_set>
 #include <string>
 #include <optional>
 #include "../../LiVM/Value/Value.hpp"
 
 namespace Linh
 {
-    class BytecodeEmitter : public AST::ExprVisitor, public AST::StmtVisitor
+    class BytecodeEmitter : public AST::TypedVisitor<BytecodeEmitter>
     {
     public:
         struct FunctionInfo
@@ -19,7 +20,16 @@ namespace Linh
 
         BytecodeEmitter();
         void emit(const AST::StmtList &stmts);
+        // Emit kiểu streaming: begin_program(), emit_statement() cho từng câu lệnh cấp cao nhất, end_program()
+        // (thêm HALT rồi tối ưu chunk). emit(stmts) là ba bước này trên cả danh sách.
+        void begin_program();
+        void emit_statement(AST::Stmt *stmt);
+        void end_program();
+        // Cấp slot trước cho mọi hàm cấp cao nhất, để thân hàm gọi được hàm khai báo sau nó
+        // (phân tích song song cho phép điều này; streaming thì không biết trước các câu lệnh sau)
+        void predeclare_functions(const AST::StmtList &stmts);
         const BytecodeChunk &get_chunk() const { return chunk; }
+        const ExceptionTable &get_exception_table() const { return exception_table; }
 
         // Getter for function table
         const std::unordered_map<std::string, FunctionInfo> &get_functions() const { return functions; }
@@ -28,50 +38,92 @@ namespace Linh
         // Optimization methods
         void enable_constant_folding(bool enable = true) { constant_folding_enabled = enable; }
         void enable_dead_code_elimination(bool enable = true) { dead_code_elimination_enabled = enable; }
+        void enable_inlining(bool enable = true, size_t budget = 12)
+        {
+            inlining_enabled = enable;
+            inline_budget = budget;
+        }
+        void enable_loop_optimization(bool enable = true) { loop_optimization_enabled = enable; }
+        // Kiểu biểu thức do SemanticAnalyzer suy ra; có thì emit opcode số có kiểu (ADD_I64, LT_F64, ...)
+        void set_expr_types(const std::unordered_map<AST::ExprId, std::string> *types) { expr_types = types; }
         
-        // ExprVisitor
-        std::any visitBinaryExpr(AST::BinaryExpr *expr) override;
-        std::any visitUnaryExpr(AST::UnaryExpr *expr) override;
-        std::any visitLiteralExpr(AST::LiteralExpr *expr) override;
-        std::any visitGroupingExpr(AST::GroupingExpr *expr) override;
-        std::any visitIdentifierExpr(AST::IdentifierExpr *expr) override;
-        std::any visitAssignmentExpr(AST::AssignmentExpr *expr) override;
-        std::any visitLogicalExpr(AST::LogicalExpr *expr) override;
-        std::any visitCallExpr(AST::CallExpr *expr) override;
-        std::any visitPostfixExpr(AST::PostfixExpr *expr) override;
-        std::any visitUninitLiteralExpr(AST::UninitLiteralExpr *expr) override;
-        std::any visitNewExpr(AST::NewExpr *expr) override;
-        std::any visitThisExpr(AST::ThisExpr *expr) override;
-        std::any visitArrayLiteralExpr(AST::ArrayLiteralExpr *expr) override;
-        std::any visitMapLiteralExpr(AST::MapLiteralExpr *expr) override;
-        std::any visitSubscriptExpr(AST::SubscriptExpr *expr) override;
-        std::any visitInterpolatedStringExpr(AST::InterpolatedStringExpr *expr) override;
-        std::any visitMemberExpr(AST::MemberExpr *expr) override;         // Khai báo visitMemberExpr
-        std::any visitMethodCallExpr(AST::MethodCallExpr *expr) override; // Khai báo visitMethodCallExpr
-        std::any visitFunctionExpr(AST::FunctionExpr *expr) override;
+        // Expr visitors (gọi qua TypedVisitor::visit, không qua accept)
+        void visitBinaryExpr(AST::BinaryExpr *expr);
+        void visitUnaryExpr(AST::UnaryExpr *expr);
+        void visitLiteralExpr(AST::LiteralExpr *expr);
+        void visitGroupingExpr(AST::GroupingExpr *expr);
+        void visitIdentifierExpr(AST::IdentifierExpr *expr);
+        void visitAssignmentExpr(AST::AssignmentExpr *expr);
+        void visitLogicalExpr(AST::LogicalExpr *expr);
+        void visitCallExpr(AST::CallExpr *expr);
+        void visitPostfixExpr(AST::PostfixExpr *expr);
+        void visitUninitLiteralExpr(AST::UninitLiteralExpr *expr);
+        void visitNewExpr(AST::NewExpr *expr);
+        void visitThisExpr(AST::ThisExpr *expr);
+        void visitArrayLiteralExpr(AST::ArrayLiteralExpr *expr);
+        void visitMapLiteralExpr(AST::MapLiteralExpr *expr);
+        void visitSubscriptExpr(AST::SubscriptExpr *expr);
+        void visitInterpolatedStringExpr(AST::InterpolatedStringExpr *expr);
+        void visitMemberExpr(AST::MemberExpr *expr);         // Khai báo visitMemberExpr
+        void visitMethodCallExpr(AST::MethodCallExpr *expr); // Khai báo visitMethodCallExpr
+        void visitFunctionExpr(AST::FunctionExpr *expr);
 
-        // StmtVisitor
-        void visitExpressionStmt(AST::ExpressionStmt *stmt) override;
-        void visitPrintStmt(AST::PrintStmt *stmt) override;
-        void visitVarDeclStmt(AST::VarDeclStmt *stmt) override;
-        void visitBlockStmt(AST::BlockStmt *stmt) override;
-        void visitIfStmt(AST::IfStmt *stmt) override;
-        void visitWhileStmt(AST::WhileStmt *stmt) override;
-        void visitDoWhileStmt(AST::DoWhileStmt *stmt) override;
-        void visitFunctionDeclStmt(AST::FunctionDeclStmt *stmt) override;
-        void visitReturnStmt(AST::ReturnStmt *stmt) override;
-        void visitBreakStmt(AST::BreakStmt *stmt) override;
-        void visitContinueStmt(AST::ContinueStmt *stmt) override;
-        void visitSwitchStmt(AST::SwitchStmt *stmt) override;
-        void visitDeleteStmt(AST::DeleteStmt *stmt) override;
-        void visitThrowStmt(AST::ThrowStmt *stmt) override;
-        void visitTryStmt(AST::TryStmt *stmt) override;
-        void visitImportStmt(AST::ImportStmt *stmt) override;
+        // Stmt visitors
+        void visitExpressionStmt(AST::ExpressionStmt *stmt);
+        void visitPrintStmt(AST::PrintStmt *stmt);
+        void visitVarDeclStmt(AST::VarDeclStmt *stmt);
+        void visitBlockStmt(AST::BlockStmt *stmt);
+        void visitIfStmt(AST::IfStmt *stmt);
+        void visitWhileStmt(AST::WhileStmt *stmt);
+        void visitDoWhileStmt(AST::DoWhileStmt *stmt);
+        void visitForInStmt(AST::ForInStmt *stmt);
+        void visitFunctionDeclStmt(AST::FunctionDeclStmt *stmt);
+        void visitReturnStmt(AST::ReturnStmt *stmt);
+        void visitBreakStmt(AST::BreakStmt *stmt);
+        void visitContinueStmt(AST::ContinueStmt *stmt);
+        void visitSwitchStmt(AST::SwitchStmt *stmt);
+        void visitDeleteStmt(AST::DeleteStmt *stmt);
+        void visitThrowStmt(AST::ThrowStmt *stmt);
+        void visitTryStmt(AST::TryStmt *stmt);
+        void visitImportStmt(AST::ImportStmt *stmt);
 
     private:
         BytecodeChunk chunk;
-        std::unordered_map<std::string, int> var_table; // tên biến -> index (giản lược)
-        int next_var_index = 0;
+        ExceptionTable exception_table; // Vùng try -> catch, VM chỉ tra khi có lỗi
+        int open_try_blocks = 0;        // Số try_block đang emit bao quanh (trong đó không gọi đuôi)
+        std::unordered_map<std::string, int> var_table; // tên biến -> index (các tên đang thấy được)
+        int next_var_index = 0;                         // Số slot đã cấp (mức cao nhất của frame)
+
+        // --- Slot theo scope: biến khai báo trong block được cấp slot riêng, ra khỏi block thì trả slot ---
+        // Mỗi scope ghi (tên, slot mà tên đó trỏ tới trước khi bị che, -1 nếu chưa có) để khôi phục khi ra
+        std::vector<std::vector<std::pair<std::string, int>>> block_scopes;
+        std::vector<int> free_slots;          // Slot đã chết (ra khỏi scope), cấp lại cho biến sau
+        std::unordered_set<int> captured_slots; // Slot bị closure capture: ô upvalue mở trỏ vào, không cấp lại
+        void begin_block_scope();
+        void end_block_scope();
+        int declare_local(const std::string &name);
+        int alloc_slot();
+        void release_slot(int slot);
+
+        // --- Closure: emitter của hàm bao ngoài và các biến tự do đã capture ---
+        BytecodeEmitter *enclosing = nullptr;
+        std::vector<UpvalueDesc> upvalues;
+        std::unordered_map<std::string, int> upvalue_table; // tên biến -> index upvalue
+
+        // --- Inline hàm nhỏ: thân hàm (đã bỏ RET cuối) được chép vào chỗ gọi, slot được dời ---
+        struct InlineCandidate
+        {
+            BytecodeChunk body;
+            size_t param_count = 0;
+            int slot_count = 0;
+            FunctionPtr fn; // Hàm gốc: chỗ gọi kiểm tra tên vẫn trỏ tới nó, không thì CALL như thường
+        };
+        std::unordered_map<std::string, InlineCandidate> inline_candidates; // tên hàm -> thân hàm inline được
+        int valueless_returns = 0; // Số lệnh 'return' không có giá trị đã emit
+
+        // --- Tối ưu vòng lặp: biểu thức tính sẵn trước vòng lặp (bất biến, hoặc v * k của biến cảm ứng) -> slot ẩn ---
+        std::unordered_map<AST::Expr *, int> loop_temps;
+        std::unordered_map<std::string, std::vector<std::pair<int, int64_t>>> induction_updates; // biến cảm ứng -> (slot v * k, lượng cộng mỗi lần v đổi)
 
         // --- Add for function support ---
         std::unordered_map<std::string, FunctionInfo> functions;
@@ -81,6 +133,9 @@ namespace Linh
         std::optional<Value> try_constant_fold(AST::BinaryExpr* expr);
         std::optional<Value> try_constant_fold(AST::UnaryExpr* expr);
         bool is_constant_expression(AST::Expr* expr);
+        std::optional<LiteralValue> constant_value(AST::Expr* expr); // Literal hoặc hằng package bất biến (math.pi)
+        static bool package_member(AST::MemberExpr *expr, std::string &package, std::string &name);
+        void emit_package_value(const std::string &package, const std::string &name, int line, int col);
         
         // Dead code elimination helper
         bool is_dead_code(AST::Stmt* stmt);
@@ -89,8 +144,29 @@ namespace Linh
         // Optimization flags
         bool constant_folding_enabled = true;
         bool dead_code_elimination_enabled = true;
+        bool inlining_enabled = true;
+        size_t inline_budget = 12; // Số lệnh tối đa của thân hàm (không tính RET cuối) để được inline
+        bool loop_optimization_enabled = true;
+        size_t max_specialized_loop_nodes = 48; // Thân vòng lặp lớn hơn thì không giảm phép nhân (tránh chép thân hai lần)
+        const std::unordered_map<AST::ExprId, std::string> *expr_types = nullptr;
+        std::string static_type_of(const AST::Expr *expr) const;
+        OpCode typed_binary_opcode(AST::BinaryExpr *expr, OpCode generic) const;
 
         int get_var_index(const std::string &name);
+        int resolve_upvalue(const std::string &name);
+        void emit_load_name(const std::string &name, int line, int col);
+        void emit_store_name(const std::string &name, int line, int col);
+        void emit_call(const std::string &name, size_t argc, int line, int col);
+        FunctionPtr compile_function(const std::string &name, const std::vector<FunctionParameter> &params,
+                                     AST::BlockStmt *body, int line, int col,
+                                     std::optional<InlineCandidate> *inline_out = nullptr);
+        void emit_function_object(const FunctionPtr &fn, int line, int col);
+        const InlineCandidate *find_inline_candidate(const std::string &name) const;
+        void forget_inline_candidate(const std::string &name);
+        bool try_inline_call(AST::CallExpr *expr, const std::string &name);
+        bool emit_loop_temp(AST::Expr *expr, int line = 0, int col = 0);
+        void emit_induction_updates(const std::string &name, int line, int col);
+        bool emit_optimized_loop(AST::Expr *condition, AST::Stmt *body, bool test_first, int line, int col);
         void emit_instr(OpCode op, BytecodeValue val = {}, int line = 0, int col = 0);
     };
 }
@@ -0,0 +1,413 @@
+#include "BytecodeOptimizer.hpp"
+#include <algorithm>
+#include <deque>
+#include <optional>
+#include <unordered_map>
+
+namespace Linh
+{
+    namespace
+    {
+        // Địa chỉ nhảy của lệnh (nếu có): JMP*, và exit_ip của FOR_RANGE/FOR_ITER
+        std::optional<int64_t> jump_target(const Instruction &instr)
+        {
+            switch (instr.opcode)
+            {
+            case OpCode::JMP:
+            case OpCode::JMP_IF_FALSE:
+            case OpCode::JMP_IF_TRUE:
+                if (auto target = std::get_if<int64_t>(&instr.operand))
+                    return *target;
+                return std::nullopt;
+            case OpCode::FOR_RANGE:
+            case OpCode::FOR_ITER:
+                if (auto loop = std::get_if<std::tuple<int64_t, int64_t, int64_t, std::string>>(&instr.operand))
+                    return std::get<2>(*loop);
+                return std::nullopt;
+            default:
+                return std::nullopt;
+            }
+        }
+
+        void set_jump_target(Instruction &instr, int64_t target)
+        {
+            if (instr.opcode == OpCode::FOR_RANGE || instr.opcode == OpCode::FOR_ITER)
+                std::get<2>(std::get<std::tuple<int64_t, int64_t, int64_t, std::string>>(instr.operand)) = target;
+            else
+                instr.operand = target;
+        }
+
+        // Lệnh không chạy tiếp xuống lệnh kế tiếp
+        bool ends_flow(OpCode op)
+        {
+            return op == OpCode::JMP || op == OpCode::RET || op == OpCode::HALT;
+        }
+
+        // Hằng mà một slot đang giữ, dưới dạng lệnh PUSH_* tương ứng
+        struct Constant
+        {
+            OpCode push_op;
+            BytecodeValue value;
+            bool operator==(const Constant &other) const { return push_op == other.push_op && value == other.value; }
+        };
+        using SlotConstants = std::unordered_map<int64_t, Constant>;
+
+        // Giao của hai trạng thái: chỉ giữ slot mà cả hai nhánh cùng biết là một hằng
+        void meet(SlotConstants &into, const SlotConstants &other)
+        {
+            for (auto it = into.begin(); it != into.end();)
+            {
+                auto found = other.find(it->first);
+                if (found == other.end() || !(found->second == it->second))
+                    it = into.erase(it);
+                else
+                    ++it;
+            }
+        }
+
+        // Chạy thử một khối trên stack trừu tượng (mỗi phần tử là hằng hoặc "không biết").
+        // Lệnh không rõ hiệu ứng lên stack thì xóa stack trừu tượng: giá trị lấy ra sau đó là "không biết".
+        // Hằng của slot chỉ được giữ qua các opcode liệt kê ở đây; opcode khác (kể cả opcode thêm sau này) xóa hết.
+        // rewrite = true: thay LOAD_VAR của slot đang giữ hằng bằng PUSH_* tương ứng.
+        void transfer(BytecodeChunk &chunk, const BasicBlock &block, SlotConstants &slots, bool rewrite)
+        {
+            std::vector<std::optional<Constant>> stack;
+            auto pop = [&]() -> std::optional<Constant> {
+                if (stack.empty())
+                    return std::nullopt;
+                auto top = std::move(stack.back());
+                stack.pop_back();
+                return top;
+            };
+
+            for (size_t ip = block.start; ip < block.end; ++ip)
+            {
+                Instruction &instr = chunk[ip];
+                switch (instr.opcode)
+                {
+                case OpCode::PUSH_INT:
+                case OpCode::PUSH_UINT:
+                case OpCode::PUSH_FLOAT:
+                case OpCode::PUSH_STR:
+                case OpCode::PUSH_BOOL:
+                    stack.push_back(Constant{instr.opcode, instr.operand});
+                    break;
+                case OpCode::LOAD_VAR:
+                {
+                    auto known = slots.find(std::get<int64_t>(instr.operand));
+                    if (known == slots.end())
+                    {
+                        stack.push_back(std::nullopt);
+                        break;
+                    }
+                    stack.push_back(known->second);
+                    if (rewrite)
+                    {
+                        instr.opcode = known->second.push_op;
+                        instr.operand = known->second.value;
+                    }
+                    break;
+                }
+                case OpCode::STORE_VAR:
+                {
+                    auto value = pop();
+                    int64_t slot = std::get<int64_t>(instr.operand);
+                    if (value)
+                        slots[slot] = std::move(*value);
+                    else
+                        slots.erase(slot);
+                    break;
+                }
+                case OpCode::POP:
+                case OpCode::JMP_IF_FALSE:
+                case OpCode::JMP_IF_TRUE:
+                case OpCode::STORE_UPVALUE:
+                    pop();
+                    break;
+                case OpCode::DUP:
+                    stack.push_back(stack.empty() ? std::nullopt : stack.back());
+                    break;
+                case OpCode::SWAP:
+                    if (stack.size() >= 2)
+                        std::swap(stack[stack.size() - 1], stack[stack.size() - 2]);
+                    else
+                        stack.clear();
+                    break;
+                case OpCode::ADD:
+                case OpCode::SUB:
+                case OpCode::MUL:
+                case OpCode::DIV:
+                case OpCode::MOD:
+                case OpCode::HASH:
+                case OpCode::AMP:
+                case OpCode::PIPE:
+                case OpCode::CARET:
+                case OpCode::LT_LT:
+                case OpCode::GT_GT:
+                case OpCode::AND:
+                case OpCode::OR:
+                case OpCode::EQ:
+                case OpCode::NEQ:
+                case OpCode::LT:
+                case OpCode::GT:
+                case OpCode::LTE:
+                case OpCode::GTE:
+                case OpCode::ADD_I64:
+                case OpCode::SUB_I64:
+                case OpCode::MUL_I64:
+                case OpCode::EQ_I64:
+                case OpCode::NEQ_I64:
+                case OpCode::LT_I64:
+                case OpCode::GT_I64:
+                case OpCode::LTE_I64:
+                case OpCode::GTE_I64:
+                case OpCode::ADD_F64:
+                case OpCode::SUB_F64:
+                case OpCode::MUL_F64:
+                case OpCode::DIV_F64:
+                case OpCode::EQ_F64:
+                case OpCode::NEQ_F64:
+                case OpCode::LT_F64:
+                case OpCode::GT_F64:
+                case OpCode::LTE_F64:
+                case OpCode::GTE_F64:
+                    pop();
+                    pop();
+                    stack.push_back(std::nullopt);
+                    break;
+                case OpCode::NOT:
+                    pop();
+                    stack.push_back(std::nullopt);
+                    break;
+                case OpCode::LOAD_UPVALUE:
+                    stack.push_back(std::nullopt);
+                    break;
+                case OpCode::JMP:
+                case OpCode::NOP:
+                    break;
+                case OpCode::CALL:
+                case OpCode::TAIL_CALL:
+                case OpCode::FOR_RANGE:
+                case OpCode::FOR_ITER:
+                    // Ghi slot: FOR_* ghi biến lặp/trạng thái, hàm được gọi có thể ghi qua upvalue
+                    slots.clear();
+                    stack.clear();
+                    break;
+                case OpCode::PUSH_FUNCTION:
+                case OpCode::PUSH_ARRAY:
+                case OpCode::PUSH_MAP:
+                case OpCode::ARRAY_GET:
+                case OpCode::MAP_GET:
+                case OpCode::ARRAY_LEN:
+                case OpCode::TYPEOF:
+                case OpCode::SAME_FUNCTION:
+                case OpCode::CONCAT_N:
+                case OpCode::PRINT:
+                case OpCode::PRINT_MULTIPLE:
+                    // Không ghi slot nào, chỉ không theo dõi hiệu ứng lên stack
+                    stack.clear();
+                    break;
+                default:
+                    // Opcode chưa được xác nhận là an toàn: coi như có thể ghi bất kỳ slot nào
+                    slots.clear();
+                    stack.clear();
+                    break;
+                }
+            }
+        }
+    }
+
+    ControlFlowGraph::ControlFlowGraph(const BytecodeChunk &chunk, const ExceptionTable &handlers)
+    {
+        const size_t size = chunk.size();
+        std::vector<bool> leader(size + 1, false);
+        std::vector<bool> entry(size + 1, false);
+        leader[0] = entry[0] = true;
+        for (size_t ip = 0; ip < size; ++ip)
+        {
+            auto target = jump_target(chunk[ip]);
+            if (target && *target >= 0 && static_cast<size_t>(*target) < size)
+                leader[*target] = true;
+            if (target || ends_flow(chunk[ip].opcode))
+                leader[ip + 1] = true;
+        }
+        for (const auto &handler : handlers)
+        {
+            for (int64_t ip : {handler.start_ip, handler.end_ip, handler.handler_ip})
+                if (ip >= 0 && static_cast<size_t>(ip) <= size)
+                    leader[ip] = true;
+            if (handler.handler_ip >= 0 && static_cast<size_t>(handler.handler_ip) <= size)
+                entry[handler.handler_ip] = true;
+        }
+
+        block_index.assign(size, 0);
+        for (size_t ip = 0; ip < size; ++ip)
+        {
+            if (leader[ip])
+            {
+                BasicBlock block;
+                block.start = ip;
+                block.is_entry = entry[ip];
+                block_list.push_back(block);
+            }
+            block_list.back().end = ip + 1;
+            block_index[ip] = block_list.size() - 1;
+        }
+
+        for (size_t b = 0; b < block_list.size(); ++b)
+        {
+            auto &block = block_list[b];
+            const Instruction &last = chunk[block.end - 1];
+            auto target = jump_target(last);
+            if (target && *target >= 0 && static_cast<size_t>(*target) < size)
+                block.successors.push_back(block_index[*target]);
+            if (!ends_flow(last.opcode) && block.end < size)
+                block.successors.push_back(b + 1);
+            for (size_t succ : block.successors)
+                block_list[succ].predecessors.push_back(b);
+        }
+    }
+
+    void optimize_chunk(BytecodeChunk &chunk, ExceptionTable &handlers)
+    {
+        if (chunk.empty())
+            return;
+
+        // 1. Nối tắt chuỗi JMP: nhảy tới một JMP thì nhảy thẳng tới đích cuối
+        for (auto &instr : chunk)
+        {
+            auto target = jump_target(instr);
+            if (!target)
+                continue;
+            int64_t final_target = *target;
+            for (int hops = 0; hops < 16 && final_target >= 0 && static_cast<size_t>(final_target) < chunk.size() &&
+                               chunk[final_target].opcode == OpCode::JMP && chunk[final_target].operand.index() == 0;
+                 ++hops)
+                final_target = std::get<int64_t>(chunk[final_target].operand);
+            if (final_target != *target)
+                set_jump_target(instr, final_target);
+        }
+
+        ControlFlowGraph cfg(chunk, handlers);
+        const auto &blocks = cfg.blocks();
+
+        // 2. Khối tới được từ điểm vào (đầu chunk, các catch)
+        std::vector<bool> reachable(blocks.size(), false);
+        std::deque<size_t> work;
+        for (size_t b = 0; b < blocks.size(); ++b)
+            if (blocks[b].is_entry)
+            {
+                reachable[b] = true;
+                work.push_back(b);
+            }
+        while (!work.empty())
+        {
+            size_t b = work.front();
+            work.pop_front();
+            for (size_t succ : blocks[b].successors)
+                if (!reachable[succ])
+                {
+                    reachable[succ] = true;
+                    work.push_back(succ);
+                }
+        }
+
+        // 3. Lan truyền hằng (forward dataflow, lặp tới điểm bất động)
+        std::vector<std::optional<SlotConstants>> block_out(blocks.size());
+        auto block_in = [&](size_t b) {
+            SlotConstants in;
+            if (blocks[b].is_entry)
+                return in; // Biến toàn cục REPL / biến catch: không biết gì
+            bool first = true;
+            for (size_t pred : blocks[b].predecessors)
+            {
+                if (!reachable[pred] || !block_out[pred])
+                    continue; // Chưa tính tới: bỏ qua, vòng lặp sau sẽ giao lại
+                if (first)
+                {
+                    in = *block_out[pred];
+                    first = false;
+                }
+                else
+                    meet(in, *block_out[pred]);
+            }
+            return in;
+        };
+        for (size_t b = 0; b < blocks.size(); ++b)
+            if (reachable[b])
+                work.push_back(b);
+        while (!work.empty())
+        {
+            size_t b = work.front();
+            work.pop_front();
+            SlotConstants state = block_in(b);
+            transfer(chunk, blocks[b], state, false);
+            if (block_out[b] && *block_out[b] == state)
+                continue;
+            block_out[b] = std::move(state);
+            for (size_t succ : blocks[b].successors)
+                if (reachable[succ] && std::find(work.begin(), work.end(), succ) == work.end())
+                    work.push_back(succ);
+        }
+        for (size_t b = 0; b < blocks.size(); ++b)
+        {
+            if (!reachable[b])
+                continue;
+            SlotConstants state = block_in(b);
+            transfer(chunk, blocks[b], state, true);
+        }
+
+        // 4. Hạ lại thành chunk tuyến tính: bỏ khối chết và JMP tới ngay lệnh kế tiếp còn giữ lại
+        std::vector<bool> keep(chunk.size(), false);
+        for (size_t ip = 0; ip < chunk.size(); ++ip)
+            keep[ip] = reachable[cfg.block_of(ip)];
+        for (size_t ip = 0; ip < chunk.size(); ++ip)
+        {
+            if (!keep[ip] || chunk[ip].opcode != OpCode::JMP)
+                continue;
+            int64_t target = std::get<int64_t>(chunk[ip].operand);
+            if (target <= static_cast<int64_t>(ip))
+                continue;
+            bool skips_nothing = true;
+            for (size_t k = ip + 1; k < static_cast<size_t>(target) && k < chunk.size(); ++k)
+                if (keep[k])
+                {
+                    skips_nothing = false;
+                    break;
+                }
+            if (skips_nothing)
+                keep[ip] = false;
+        }
+        if (std::all_of(keep.begin(), keep.end(), [](bool k) { return k; }))
+            return;
+
+        // new_index[ip] = vị trí mới của lệnh còn giữ đầu tiên tính từ ip
+        std::vector<int64_t> new_index(chunk.size() + 1, 0);
+        for (size_t ip = 0; ip < chunk.size(); ++ip)
+            new_index[ip + 1] = new_index[ip] + (keep[ip] ? 1 : 0);
+        auto remap = [&](int64_t ip) {
+            if (ip < 0)
+                return ip;
+            return new_index[std::min(static_cast<size_t>(ip), chunk.size())];
+        };
+
+        BytecodeChunk lowered;
+        lowered.reserve(static_cast<size_t>(new_index.back()));
+        for (size_t ip = 0; ip < chunk.size(); ++ip)
+        {
+            if (!keep[ip])
+                continue;
+            Instruction instr = std::move(chunk[ip]);
+            if (auto target = jump_target(instr))
+                set_jump_target(instr, remap(*target));
+            lowered.push_back(std::move(instr));
+        }
+        for (auto &handler : handlers)
+        {
+            handler.start_ip = remap(handler.start_ip);
+            handler.end_ip = remap(handler.end_ip);
+            handler.handler_ip = remap(handler.handler_ip);
+        }
+        chunk = std::move(lowered);
+    }
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include "Bytecode.hpp"
+#include <vector>
+#include <cstddef>
+
+namespace Linh
+{
+    // Khối cơ bản: các lệnh [start, end) chạy liền nhau, chỉ vào ở lệnh đầu và ra ở lệnh cuối
+    struct BasicBlock
+    {
+        size_t start = 0;
+        size_t end = 0;
+        std::vector<size_t> successors;
+        std::vector<size_t> predecessors;
+        bool is_entry = false; // Lệnh đầu chunk hoặc điểm vào catch: không biết gì về biến khi vào
+    };
+
+    // Đồ thị luồng điều khiển dựng trên bytecode đã emit (JMP*, FOR_*, RET, HALT và bảng exception)
+    class ControlFlowGraph
+    {
+    public:
+        ControlFlowGraph(const BytecodeChunk &chunk, const ExceptionTable &handlers);
+
+        const std::vector<BasicBlock> &blocks() const { return block_list; }
+        size_t block_of(size_t ip) const { return block_index[ip]; }
+
+    private:
+        std::vector<BasicBlock> block_list;
+        std::vector<size_t> block_index; // ip -> index khối chứa nó
+    };
+
+    // Tối ưu toàn cục trên CFG rồi hạ lại thành chunk tuyến tính:
+    //   - nối tắt JMP trỏ vào JMP, bỏ JMP tới ngay lệnh kế tiếp
+    //   - bỏ khối không tới được
+    //   - lan truyền hằng giữa các khối: LOAD_VAR của slot chắc chắn đang giữ hằng thành PUSH_*
+    // Địa chỉ nhảy, exit_ip của FOR_* và bảng exception được cập nhật theo chunk mới.
+    void optimize_chunk(BytecodeChunk &chunk, ExceptionTable &handlers);
+}
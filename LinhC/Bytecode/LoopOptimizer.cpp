@@ -0,0 +1,538 @@
+#include "LoopOptimizer.hpp"
+#include <unordered_map>
+#include <unordered_set>
+
+namespace Linh
+{
+    namespace
+    {
+        std::optional<int64_t> int_literal(AST::Expr *expr)
+        {
+            while (auto group = AST::node_cast<AST::GroupingExpr>(expr))
+                expr = group->expression.get();
+            auto literal = AST::node_cast<AST::LiteralExpr>(expr);
+            if (literal && std::holds_alternative<int64_t>(literal->value))
+                return std::get<int64_t>(literal->value);
+            return std::nullopt;
+        }
+
+        const std::string *identifier_name(AST::Expr *expr)
+        {
+            while (auto group = AST::node_cast<AST::GroupingExpr>(expr))
+                expr = group->expression.get();
+            auto id = AST::node_cast<AST::IdentifierExpr>(expr);
+            return id ? &id->name.lexeme : nullptr;
+        }
+
+        bool is_mutating_method(const std::string &name)
+        {
+            return name == "append" || name == "remove" || name == "clear" || name == "pop" || name == "delete";
+        }
+
+        bool is_builtin_call(const std::string &name)
+        {
+            return name == "input" || name == "type" || name == "id" || name == "printf" ||
+                   name == "read_all" || name == "read_line" || name == "read_bytes" || name == "read_eof";
+        }
+
+        // Hàm math.* emit thành CALL "<tên>" không qua function object: thuần, không ném lỗi
+        bool is_math_method(AST::MethodCallExpr *call)
+        {
+            auto pkg = AST::node_cast<AST::IdentifierExpr>(call->object.get());
+            if (!pkg || pkg->name.lexeme != "math")
+                return false;
+            static const std::unordered_set<std::string> unary = {
+                "abs", "ceil", "floor", "round", "trunc", "sin", "cos", "tan", "asin", "acos", "atan", "radians",
+                "sinh", "cosh", "tanh", "asinh", "acosh", "atanh", "sqrt", "cbrt", "exp", "expm1",
+                "log", "log1p", "log10", "log2"};
+            if (unary.count(call->method_name))
+                return call->arguments.size() == 1;
+            return (call->method_name == "atan2" || call->method_name == "pow") && call->arguments.size() == 2;
+        }
+
+        bool is_package_constant(AST::MemberExpr *member)
+        {
+            if (member->is_package_constant)
+                return true;
+            auto pkg = AST::node_cast<AST::IdentifierExpr>(member->object.get());
+            return pkg && pkg->name.lexeme == "math";
+        }
+
+        class LoopScanner
+        {
+        public:
+            explicit LoopScanner(const std::function<bool(const std::string &)> &is_pure_call) : is_pure_call(is_pure_call) {}
+
+            // Lượt 1: biến bị ghi, lời gọi không rõ tác dụng, thao tác sửa array/map
+            void scan(AST::Stmt *stmt)
+            {
+                if (!stmt || opaque)
+                    return;
+                ++plan.node_count;
+                if (auto s = AST::node_cast<AST::ExpressionStmt>(stmt))
+                    scan(s->expression.get());
+                else if (auto s = AST::node_cast<AST::PrintStmt>(stmt))
+                {
+                    for (auto &e : s->expressions)
+                        scan(e.get());
+                }
+                else if (auto s = AST::node_cast<AST::VarDeclStmt>(stmt))
+                {
+                    scan(s->initializer.get());
+                    write(s->name.lexeme, std::nullopt);
+                }
+                else if (auto s = AST::node_cast<AST::BlockStmt>(stmt))
+                {
+                    for (auto &child : s->statements)
+                        scan(child.get());
+                }
+                else if (auto s = AST::node_cast<AST::IfStmt>(stmt))
+                {
+                    scan(s->condition.get());
+                    scan(s->then_branch.get());
+                    scan(s->else_branch.get());
+                }
+                else if (auto s = AST::node_cast<AST::WhileStmt>(stmt))
+                {
+                    scan(s->condition.get());
+                    scan(s->body.get());
+                }
+                else if (auto s = AST::node_cast<AST::DoWhileStmt>(stmt))
+                {
+                    scan(s->body.get());
+                    scan(s->condition.get());
+                }
+                else if (auto s = AST::node_cast<AST::ForInStmt>(stmt))
+                {
+                    scan(s->iterable.get());
+                    write(s->var_name.lexeme, std::nullopt);
+                    scan(s->body.get());
+                }
+                else if (auto s = AST::node_cast<AST::ReturnStmt>(stmt))
+                    scan(s->value.get());
+                else if (AST::node_cast<AST::BreakStmt>(stmt) || AST::node_cast<AST::ContinueStmt>(stmt) ||
+                         AST::node_cast<AST::ImportStmt>(stmt))
+                    return;
+                else if (auto s = AST::node_cast<AST::SwitchStmt>(stmt))
+                {
+                    scan(s->expression_to_switch_on.get());
+                    for (auto &clause : s->cases)
+                    {
+                        if (clause.case_value)
+                            scan(clause.case_value->get());
+                        for (auto &child : clause.statements)
+                            scan(child.get());
+                    }
+                }
+                else if (auto s = AST::node_cast<AST::DeleteStmt>(stmt))
+                {
+                    mutates_containers = true;
+                    scan(s->expression_to_delete.get());
+                }
+                else if (auto s = AST::node_cast<AST::ThrowStmt>(stmt))
+                    scan(s->expression.get());
+                else if (auto s = AST::node_cast<AST::TryStmt>(stmt))
+                {
+                    scan(s->try_block.get());
+                    for (auto &clause : s->catch_clauses)
+                    {
+                        if (clause.exception_variable)
+                            write(clause.exception_variable->lexeme, std::nullopt);
+                        scan(clause.body.get());
+                    }
+                    if (s->finally_block)
+                        scan(s->finally_block->get());
+                }
+                else
+                    opaque = true; // Khai báo hàm lồng trong vòng lặp, node lạ: không đoán
+            }
+
+            void scan(AST::Expr *expr)
+            {
+                if (!expr || opaque)
+                    return;
+                ++plan.node_count;
+                if (AST::node_cast<AST::LiteralExpr>(expr) || AST::node_cast<AST::IdentifierExpr>(expr) ||
+                    AST::node_cast<AST::UninitLiteralExpr>(expr))
+                    return;
+                if (auto e = AST::node_cast<AST::GroupingExpr>(expr))
+                    scan(e->expression.get());
+                else if (auto e = AST::node_cast<AST::UnaryExpr>(expr))
+                    scan(e->right.get());
+                else if (auto e = AST::node_cast<AST::BinaryExpr>(expr))
+                {
+                    scan(e->left.get());
+                    scan(e->right.get());
+                }
+                else if (auto e = AST::node_cast<AST::LogicalExpr>(expr))
+                {
+                    scan(e->left.get());
+                    scan(e->right.get());
+                }
+                else if (auto e = AST::node_cast<AST::AssignmentExpr>(expr))
+                {
+                    scan(e->value.get());
+                    write(e->name.lexeme, update_step(e->name.lexeme, e->value.get()));
+                }
+                else if (auto e = AST::node_cast<AST::PostfixExpr>(expr))
+                {
+                    if (auto name = identifier_name(e->operand.get()))
+                        write(*name, e->op_token.type == TokenType::PLUS_PLUS ? std::optional<int64_t>(1)
+                                     : e->op_token.type == TokenType::MINUS_MINUS ? std::optional<int64_t>(-1)
+                                                                                  : std::nullopt);
+                }
+                else if (auto e = AST::node_cast<AST::CallExpr>(expr))
+                {
+                    for (auto &arg : e->arguments)
+                        scan(arg.get());
+                    if (auto id = AST::node_cast<AST::IdentifierExpr>(e->callee.get()))
+                    {
+                        if (!is_builtin_call(id->name.lexeme) && !is_pure_call(id->name.lexeme))
+                            opaque = true;
+                    }
+                    else if (auto member = AST::node_cast<AST::MemberExpr>(e->callee.get()))
+                    {
+                        if (is_mutating_method(member->property))
+                            mutates_containers = true;
+                        scan(member->object.get());
+                    }
+                    else
+                        opaque = true;
+                }
+                else if (auto e = AST::node_cast<AST::MethodCallExpr>(expr))
+                {
+                    if (is_mutating_method(e->method_name))
+                        mutates_containers = true;
+                    scan(e->object.get());
+                    for (auto &arg : e->arguments)
+                        scan(arg.get());
+                }
+                else if (auto e = AST::node_cast<AST::MemberExpr>(expr))
+                    scan(e->object.get());
+                else if (auto e = AST::node_cast<AST::SubscriptExpr>(expr))
+                {
+                    scan(e->object.get());
+                    scan(e->index.get());
+                }
+                else if (auto e = AST::node_cast<AST::ArrayLiteralExpr>(expr))
+                {
+                    for (auto &element : e->elements)
+                        scan(element.get());
+                }
+                else if (auto e = AST::node_cast<AST::MapLiteralExpr>(expr))
+                {
+                    for (auto &entry : e->entries)
+                    {
+                        scan(entry.key.get());
+                        scan(entry.value.get());
+                    }
+                }
+                else if (auto e = AST::node_cast<AST::InterpolatedStringExpr>(expr))
+                {
+                    for (auto &part : e->parts)
+                        if (auto sub = std::get_if<AST::ExprPtr>(&part))
+                            scan(sub->get());
+                }
+                else
+                    opaque = true; // FunctionExpr (closure có thể ghi biến qua upvalue), new, this
+            }
+
+            // Lượt 2: gom biểu thức bất biến lớn nhất và các phép nhân theo biến cảm ứng
+            void collect(AST::Stmt *stmt)
+            {
+                if (!stmt)
+                    return;
+                if (auto s = AST::node_cast<AST::ExpressionStmt>(stmt))
+                    collect(s->expression.get());
+                else if (auto s = AST::node_cast<AST::PrintStmt>(stmt))
+                {
+                    for (auto &e : s->expressions)
+                        collect(e.get());
+                }
+                else if (auto s = AST::node_cast<AST::VarDeclStmt>(stmt))
+                    collect(s->initializer.get());
+                else if (auto s = AST::node_cast<AST::BlockStmt>(stmt))
+                {
+                    for (auto &child : s->statements)
+                        collect(child.get());
+                }
+                else if (auto s = AST::node_cast<AST::IfStmt>(stmt))
+                {
+                    collect(s->condition.get());
+                    collect(s->then_branch.get());
+                    collect(s->else_branch.get());
+                }
+                else if (auto s = AST::node_cast<AST::WhileStmt>(stmt))
+                {
+                    collect(s->condition.get());
+                    collect(s->body.get());
+                }
+                else if (auto s = AST::node_cast<AST::DoWhileStmt>(stmt))
+                {
+                    collect(s->body.get());
+                    collect(s->condition.get());
+                }
+                else if (auto s = AST::node_cast<AST::ForInStmt>(stmt))
+                    collect(s->body.get()); // iterable được emit đặc biệt (range), để nguyên
+                else if (auto s = AST::node_cast<AST::ReturnStmt>(stmt))
+                    collect(s->value.get());
+                else if (auto s = AST::node_cast<AST::SwitchStmt>(stmt))
+                {
+                    collect(s->expression_to_switch_on.get());
+                    for (auto &clause : s->cases)
+                        for (auto &child : clause.statements)
+                            collect(child.get());
+                }
+                else if (auto s = AST::node_cast<AST::ThrowStmt>(stmt))
+                    collect(s->expression.get());
+                else if (auto s = AST::node_cast<AST::TryStmt>(stmt))
+                {
+                    collect(s->try_block.get());
+                    for (auto &clause : s->catch_clauses)
+                        collect(clause.body.get());
+                    if (s->finally_block)
+                        collect(s->finally_block->get());
+                }
+            }
+
+            void collect(AST::Expr *expr)
+            {
+                if (!expr)
+                    return;
+                if (is_pure(expr) && !is_trivial(expr))
+                {
+                    plan.invariants.push_back(expr);
+                    return;
+                }
+                if (auto e = AST::node_cast<AST::BinaryExpr>(expr))
+                {
+                    if (e->op.type == TokenType::STAR && record_multiply(e))
+                        return;
+                    collect(e->left.get());
+                    collect(e->right.get());
+                }
+                else if (auto e = AST::node_cast<AST::GroupingExpr>(expr))
+                    collect(e->expression.get());
+                else if (auto e = AST::node_cast<AST::UnaryExpr>(expr))
+                    collect(e->right.get());
+                else if (auto e = AST::node_cast<AST::LogicalExpr>(expr))
+                {
+                    collect(e->left.get());
+                    collect(e->right.get());
+                }
+                else if (auto e = AST::node_cast<AST::AssignmentExpr>(expr))
+                    collect(e->value.get());
+                else if (auto e = AST::node_cast<AST::CallExpr>(expr))
+                {
+                    for (auto &arg : e->arguments)
+                        collect(arg.get());
+                }
+                else if (auto e = AST::node_cast<AST::MethodCallExpr>(expr))
+                {
+                    for (auto &arg : e->arguments)
+                        collect(arg.get());
+                }
+                else if (auto e = AST::node_cast<AST::SubscriptExpr>(expr))
+                {
+                    collect(e->object.get());
+                    collect(e->index.get());
+                }
+                else if (auto e = AST::node_cast<AST::ArrayLiteralExpr>(expr))
+                {
+                    for (auto &element : e->elements)
+                        collect(element.get());
+                }
+                else if (auto e = AST::node_cast<AST::MapLiteralExpr>(expr))
+                {
+                    for (auto &entry : e->entries)
+                    {
+                        collect(entry.key.get());
+                        collect(entry.value.get());
+                    }
+                }
+            }
+
+            LoopPlan finish()
+            {
+                for (auto &[name, iv] : inductions)
+                    if (!iv.multiplies.empty())
+                        plan.inductions.push_back(std::move(iv));
+                return std::move(plan);
+            }
+
+            bool opaque = false;
+
+        private:
+            struct WriteInfo
+            {
+                int count = 0;
+                std::optional<int64_t> step;
+            };
+
+            const std::function<bool(const std::string &)> &is_pure_call;
+            std::unordered_map<std::string, WriteInfo> writes;
+            bool mutates_containers = false;
+            std::unordered_map<std::string, InductionVariable> inductions;
+            LoopPlan plan;
+
+            void write(const std::string &name, std::optional<int64_t> step)
+            {
+                auto &info = writes[name];
+                ++info.count;
+                info.step = step;
+            }
+
+            // v = v + c | v = c + v | v = v - c (c là hằng int)
+            static std::optional<int64_t> update_step(const std::string &name, AST::Expr *value)
+            {
+                while (auto group = AST::node_cast<AST::GroupingExpr>(value))
+                    value = group->expression.get();
+                auto bin = AST::node_cast<AST::BinaryExpr>(value);
+                if (!bin)
+                    return std::nullopt;
+                auto left = identifier_name(bin->left.get());
+                auto right = identifier_name(bin->right.get());
+                if (bin->op.type == TokenType::PLUS)
+                {
+                    if (left && *left == name)
+                        return int_literal(bin->right.get());
+                    if (right && *right == name)
+                        return int_literal(bin->left.get());
+                }
+                else if (bin->op.type == TokenType::MINUS && left && *left == name)
+                {
+                    if (auto c = int_literal(bin->right.get()))
+                        return -*c;
+                }
+                return std::nullopt;
+            }
+
+            bool is_assigned(const std::string &name) const { return writes.count(name) != 0; }
+
+            const WriteInfo *induction_info(const std::string &name) const
+            {
+                auto it = writes.find(name);
+                if (it == writes.end() || it->second.count != 1 || !it->second.step)
+                    return nullptr;
+                return &it->second;
+            }
+
+            // v * k hoặc k * v với v là biến cảm ứng, k hằng int
+            bool record_multiply(AST::BinaryExpr *mul)
+            {
+                const std::string *name = identifier_name(mul->left.get());
+                std::optional<int64_t> factor = int_literal(mul->right.get());
+                if (!name || !factor)
+                {
+                    name = identifier_name(mul->right.get());
+                    factor = int_literal(mul->left.get());
+                }
+                if (!name || !factor)
+                    return false;
+                auto info = induction_info(*name);
+                if (!info)
+                    return false;
+                auto &iv = inductions[*name];
+                iv.name = *name;
+                iv.step = *info->step;
+                iv.multiplies.emplace_back(mul, *factor);
+                return true;
+            }
+
+            // Thuần và không ném lỗi: tính sớm một lần trước vòng lặp cho cùng kết quả
+            bool is_pure(AST::Expr *expr) const
+            {
+                if (!expr)
+                    return false;
+                if (AST::node_cast<AST::LiteralExpr>(expr))
+                    return true;
+                if (auto e = AST::node_cast<AST::IdentifierExpr>(expr))
+                    return !is_assigned(e->name.lexeme);
+                if (auto e = AST::node_cast<AST::GroupingExpr>(expr))
+                    return is_pure(e->expression.get());
+                if (auto e = AST::node_cast<AST::MemberExpr>(expr))
+                    return is_package_constant(e);
+                if (auto e = AST::node_cast<AST::UnaryExpr>(expr))
+                    return e->op.type != TokenType::TILDE && is_pure(e->right.get());
+                if (auto e = AST::node_cast<AST::LogicalExpr>(expr))
+                    return is_pure(e->left.get()) && is_pure(e->right.get());
+                if (auto e = AST::node_cast<AST::SubscriptExpr>(expr))
+                    return !mutates_containers && is_pure(e->object.get()) && is_pure(e->index.get());
+                if (auto e = AST::node_cast<AST::MethodCallExpr>(expr))
+                {
+                    if (!is_math_method(e))
+                        return false;
+                    for (auto &arg : e->arguments)
+                        if (!is_pure(arg.get()))
+                            return false;
+                    return true;
+                }
+                if (auto e = AST::node_cast<AST::BinaryExpr>(expr))
+                {
+                    switch (e->op.type)
+                    {
+                    case TokenType::SLASH:
+                    case TokenType::PERCENT:
+                    case TokenType::HASH:
+                    {
+                        // Chia cho 0 ném lỗi: chỉ chấp nhận số chia là hằng khác 0
+                        auto divisor = AST::node_cast<AST::LiteralExpr>(e->right.get());
+                        bool nonzero = divisor && ((std::holds_alternative<int64_t>(divisor->value) && std::get<int64_t>(divisor->value) != 0) ||
+                                                   (std::holds_alternative<double>(divisor->value) && std::get<double>(divisor->value) != 0.0));
+                        if (!nonzero)
+                            return false;
+                        break;
+                    }
+                    case TokenType::STAR_STAR: // CALL "pow" tra theo tên, có thể trúng hàm người dùng
+                        return false;
+                    default:
+                        break;
+                    }
+                    return is_pure(e->left.get()) && is_pure(e->right.get());
+                }
+                return false;
+            }
+
+            // Không đáng để hoist: hằng, tên biến, hoặc biểu thức chỉ gồm hằng (constant folding đã lo)
+            static bool is_trivial(AST::Expr *expr)
+            {
+                if (AST::node_cast<AST::LiteralExpr>(expr) || AST::node_cast<AST::IdentifierExpr>(expr))
+                    return true;
+                if (auto e = AST::node_cast<AST::GroupingExpr>(expr))
+                    return is_trivial(e->expression.get());
+                return !has_runtime_leaf(expr);
+            }
+
+            static bool has_runtime_leaf(AST::Expr *expr)
+            {
+                if (!expr || AST::node_cast<AST::LiteralExpr>(expr))
+                    return false;
+                if (AST::node_cast<AST::IdentifierExpr>(expr) || AST::node_cast<AST::MemberExpr>(expr) ||
+                    AST::node_cast<AST::SubscriptExpr>(expr) || AST::node_cast<AST::MethodCallExpr>(expr))
+                    return true;
+                if (auto e = AST::node_cast<AST::GroupingExpr>(expr))
+                    return has_runtime_leaf(e->expression.get());
+                if (auto e = AST::node_cast<AST::UnaryExpr>(expr))
+                    return has_runtime_leaf(e->right.get());
+                if (auto e = AST::node_cast<AST::BinaryExpr>(expr))
+                    return has_runtime_leaf(e->left.get()) || has_runtime_leaf(e->right.get());
+                if (auto e = AST::node_cast<AST::LogicalExpr>(expr))
+                    return has_runtime_leaf(e->left.get()) || has_runtime_leaf(e->right.get());
+                return true;
+            }
+        };
+    }
+
+    LoopPlan plan_loop(AST::Expr *condition, AST::Stmt *body,
+                       const std::function<bool(const std::string &)> &is_pure_call)
+    {
+        LoopScanner scanner(is_pure_call);
+        scanner.scan(condition);
+        scanner.scan(body);
+        if (scanner.opaque)
+            return {};
+        scanner.collect(condition);
+        scanner.collect(body);
+        return scanner.finish();
+    }
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include "../Parsing/AST/ASTNode.hpp"
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace Linh
+{
+    // Biến cảm ứng: trong vòng lặp chỉ bị ghi đúng một chỗ, dạng v = v + c, v = v - c, v++ hoặc v--
+    struct InductionVariable
+    {
+        std::string name;
+        int64_t step = 0;
+        std::vector<std::pair<AST::BinaryExpr *, int64_t>> multiplies; // Các biểu thức v * k (k là hằng int)
+    };
+
+    // Kế hoạch tối ưu một vòng lặp while/do-while, dựng trên AST trước khi emit
+    struct LoopPlan
+    {
+        std::vector<AST::Expr *> invariants;       // Biểu thức bất biến lớn nhất, không tác dụng phụ, không ném lỗi
+        std::vector<InductionVariable> inductions; // Chỉ giữ biến có ít nhất một phép nhân cần giảm
+        size_t node_count = 0;                     // Số node AST của điều kiện + thân (ước lượng cỡ bytecode)
+
+        bool empty() const { return invariants.empty() && inductions.empty(); }
+    };
+
+    // is_pure_call(name): gọi hàm người dùng 'name' không thể ghi biến của vòng lặp
+    // (ví dụ ứng viên inline: không upvalue, không gọi tiếp). Gặp lời gọi khác thì không tối ưu vòng lặp.
+    LoopPlan plan_loop(AST::Expr *condition, AST::Stmt *body,
+                       const std::function<bool(const std::string &)> &is_pure_call);
+}
@@ -0,0 +1,70 @@
+#include "ASTNode.hpp"
+#include <algorithm>
+#include <new>
+
+namespace Linh
+{
+    namespace AST
+    {
+        namespace
+        {
+            thread_local Arena *current_arena = nullptr;
+            thread_local ExprId expr_id_counter = 0;
+
+            // Mỗi node có một header nhỏ phía trước để operator delete biết vùng nhớ thuộc arena hay heap
+            // (thread phân tích song song không mở ArenaScope nên vẫn cấp từ heap)
+            constexpr size_t header_size = alignof(std::max_align_t);
+            enum : unsigned char
+            {
+                FROM_HEAP = 0,
+                FROM_ARENA = 1
+            };
+        }
+
+        Arena::~Arena()
+        {
+            for (char *block : blocks)
+                ::operator delete(block);
+        }
+
+        void *Arena::allocate(size_t size)
+        {
+            size = (size + header_size - 1) / header_size * header_size; // Giữ alignment cho node kế tiếp
+            if (static_cast<size_t>(limit - cursor) < size)
+            {
+                size_t bytes = std::max(block_size, size);
+                cursor = static_cast<char *>(::operator new(bytes));
+                limit = cursor + bytes;
+                blocks.push_back(cursor);
+            }
+            void *result = cursor;
+            cursor += size;
+            used += size;
+            return result;
+        }
+
+        ExprId allocate_expr_id() { return expr_id_counter++; }
+
+        ArenaScope::ArenaScope(Arena &arena) : previous(current_arena) { current_arena = &arena; }
+        ArenaScope::~ArenaScope() { current_arena = previous; }
+
+        void *ArenaNode::operator new(std::size_t size)
+        {
+            size_t total = size + header_size;
+            char *base = current_arena ? static_cast<char *>(current_arena->allocate(total))
+                                       : static_cast<char *>(::operator new(total));
+            base[0] = current_arena ? FROM_ARENA : FROM_HEAP;
+            return base + header_size;
+        }
+
+        void ArenaNode::operator delete(void *ptr, std::size_t) noexcept
+        {
+            if (!ptr)
+                return;
+            char *base = static_cast<char *>(ptr) - header_size;
+            if (base[0] == FROM_HEAP)
+                ::operator delete(base);
+            // FROM_ARENA: vùng nhớ được trả cùng lúc khi Arena bị huỷ
+        }
+    }
+}
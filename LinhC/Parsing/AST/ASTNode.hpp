@@ -7,6 +7,8 @@
 #include <memory>
 #include <any>
 #include <optional>
+#include <cstddef>
+#include <cstdint>
 #include "../Lexer/Lexer.hpp"
 
 namespace Linh
@@ -18,6 +20,7 @@ namespace Linh
         struct IfStmt;
         struct WhileStmt;
         struct DoWhileStmt;
+        struct ForInStmt;
         struct FunctionDeclStmt;
         struct ReturnStmt;
         struct BreakStmt;
@@ -42,11 +45,129 @@ namespace Linh
         struct FuncParamNode;
         struct FunctionExpr;
 
-        struct Stmt
+        // --- Arena cho node AST: cấp phát kiểu bump trong các khối lớn, trả lại cả khối một lần ---
+        // Mỗi lần biên dịch tạo một Arena và mở ArenaScope trước khi parse; mọi node tạo ra trong lúc
+        // scope còn sống (cùng thread) nằm trong arena đó. Arena phải sống lâu hơn AST.
+        class Arena
         {
+        public:
+            explicit Arena(size_t block_size = 64 * 1024) : block_size(block_size) {}
+            ~Arena();
+            Arena(const Arena &) = delete;
+            Arena &operator=(const Arena &) = delete;
+
+            void *allocate(size_t size);
+            size_t bytes_used() const { return used; }
+
+        private:
+            std::vector<char *> blocks;
+            char *cursor = nullptr;
+            char *limit = nullptr;
+            size_t block_size;
+            size_t used = 0;
+        };
+
+        class ArenaScope
+        {
+        public:
+            explicit ArenaScope(Arena &arena);
+            ~ArenaScope();
+            ArenaScope(const ArenaScope &) = delete;
+            ArenaScope &operator=(const ArenaScope &) = delete;
+
+        private:
+            Arena *previous;
+        };
+
+        // Base của Expr/Stmt/TypeNode: new/delete đi qua arena hiện tại (không có scope thì dùng heap).
+        // unique_ptr vẫn gọi destructor như cũ, chỉ có vùng nhớ là không trả từng node.
+        struct ArenaNode
+        {
+            static void *operator new(std::size_t size);
+            static void operator delete(void *ptr, std::size_t size) noexcept;
+        };
+
+        // --- Tag loại node: mỗi node mang kind cố định từ lúc tạo, thay cho dynamic_cast/RTTI ---
+        enum class ExprKind : uint8_t
+        {
+            Binary,
+            Unary,
+            Literal,
+            Grouping,
+            Identifier,
+            Assignment,
+            Logical,
+            Call,
+            Postfix,
+            UninitLiteral,
+            New,
+            This,
+            ArrayLiteral,
+            MapLiteral,
+            Subscript,
+            InterpolatedString,
+            Member,
+            MethodCall,
+            Function
+        };
+
+        enum class StmtKind : uint8_t
+        {
+            Print,
+            Expression,
+            VarDecl,
+            Block,
+            If,
+            While,
+            DoWhile,
+            ForIn,
+            FunctionDecl,
+            Return,
+            Break,
+            Continue,
+            Switch,
+            Delete,
+            Throw,
+            Try,
+            Import
+        };
+
+        enum class TypeKind : uint8_t
+        {
+            Base,
+            SizedInteger,
+            SizedFloat,
+            Map,
+            Array,
+            Union
+        };
+
+        // node_cast<T>(node): như dynamic_cast<T *> nhưng chỉ so sánh tag (null-safe, giữ const)
+        template <typename T, typename Base>
+        inline T *node_cast(Base *node)
+        {
+            return node && node->kind == T::node_kind ? static_cast<T *>(node) : nullptr;
+        }
+        template <typename T, typename Base>
+        inline const T *node_cast(const Base *node)
+        {
+            return node && node->kind == T::node_kind ? static_cast<const T *>(node) : nullptr;
+        }
+
+        struct Stmt : ArenaNode
+        {
+            const StmtKind kind;
+            explicit Stmt(StmtKind k) : kind(k) {}
             virtual ~Stmt() = default;
             virtual void accept(class StmtVisitor *) = 0;
         }; // Định nghĩa rỗng
+        // Base của từng loại Stmt cụ thể: gắn tag K lúc dựng, node_kind dùng cho node_cast
+        template <StmtKind K>
+        struct StmtNode : Stmt
+        {
+            static constexpr StmtKind node_kind = K;
+            StmtNode() : Stmt(K) {}
+        };
         class StmtVisitor
         {
         public:
@@ -58,6 +179,7 @@ namespace Linh
             virtual void visitIfStmt(IfStmt *stmt) = 0;
             virtual void visitWhileStmt(WhileStmt *stmt) = 0;
             virtual void visitDoWhileStmt(DoWhileStmt *stmt) = 0;
+            virtual void visitForInStmt(ForInStmt *stmt) = 0;
             virtual void visitFunctionDeclStmt(FunctionDeclStmt *stmt) = 0;
             virtual void visitReturnStmt(ReturnStmt *stmt) = 0;
             virtual void visitBreakStmt(BreakStmt *stmt) = 0;
@@ -93,19 +215,27 @@ namespace Linh
             virtual std::string visitArrayTypeNode(ArrayTypeNode *type_node) = 0;
             virtual std::string visitUnionTypeNode(UnionTypeNode *type_node) = 0;
         };
-        struct TypeNode
+        struct TypeNode : ArenaNode
         {
+            const TypeKind kind;
+            explicit TypeNode(TypeKind k) : kind(k) {}
             virtual ~TypeNode() = default;
             virtual std::string accept(TypeVisitor *visitor) = 0;
         };
-        struct BaseTypeNode : TypeNode
+        template <TypeKind K>
+        struct TypeNodeOf : TypeNode
+        {
+            static constexpr TypeKind node_kind = K;
+            TypeNodeOf() : TypeNode(K) {}
+        };
+        struct BaseTypeNode : TypeNodeOf<TypeKind::Base>
         {
             Token type_keyword_token;
             std::optional<int> template_arg; // <--- thêm dòng này
             BaseTypeNode(Token token) : type_keyword_token(std::move(token)), template_arg(std::nullopt) {}
             std::string accept(TypeVisitor *visitor) override { return visitor->visitBaseTypeNode(this); }
         };
-        struct SizedIntegerTypeNode : TypeNode
+        struct SizedIntegerTypeNode : TypeNodeOf<TypeKind::SizedInteger>
         {
             Token base_type_keyword_token;
             Token size_token;
@@ -124,7 +254,7 @@ namespace Linh
             }
             std::string accept(TypeVisitor *visitor) override { return visitor->visitSizedIntegerTypeNode(this); }
         };
-        struct SizedFloatTypeNode : TypeNode
+        struct SizedFloatTypeNode : TypeNodeOf<TypeKind::SizedFloat>
         {
             Token base_type_keyword_token;
             Token size_token;
@@ -143,7 +273,7 @@ namespace Linh
             }
             std::string accept(TypeVisitor *visitor) override { return visitor->visitSizedFloatTypeNode(this); }
         };
-        struct MapTypeNode : TypeNode
+        struct MapTypeNode : TypeNodeOf<TypeKind::Map>
         {
             Token map_keyword_token;
             TypeNodePtr key_type;
@@ -152,7 +282,7 @@ namespace Linh
                 : map_keyword_token(std::move(map_kw_tok)), key_type(std::move(k_type)), value_type(std::move(v_type)) {}
             std::string accept(TypeVisitor *visitor) override { return visitor->visitMapTypeNode(this); }
         };
-        struct ArrayTypeNode : TypeNode
+        struct ArrayTypeNode : TypeNodeOf<TypeKind::Array>
         {
             std::optional<Token> array_keyword_token;
             TypeNodePtr element_type;
@@ -163,7 +293,7 @@ namespace Linh
                 : array_keyword_token(std::move(arr_kw_tok)), element_type(std::move(el_type_for_array_kw)), r_bracket_token(std::move(dummy_r_bracket_for_consistency)) {}
             std::string accept(TypeVisitor *visitor) override { return visitor->visitArrayTypeNode(this); }
         };
-        struct UnionTypeNode : TypeNode
+        struct UnionTypeNode : TypeNodeOf<TypeKind::Union>
         {
             std::vector<TypeNodePtr> types;
             Token l_angle_token, r_angle_token;
@@ -217,14 +347,28 @@ namespace Linh
             virtual std::any visitMethodCallExpr(MethodCallExpr *expr) = 0;                 // MỚI
             virtual std::any visitFunctionExpr(FunctionExpr *expr) = 0;
         };
-        struct Expr
+        // Id của biểu thức: cấp tăng dần theo thứ tự tạo node (đếm riêng từng thread). Dùng làm khoá thay cho địa chỉ
+        // node, vì arena của từng câu lệnh cấp cao nhất được giải phóng rồi dùng lại địa chỉ cho câu sau.
+        using ExprId = uint32_t;
+        ExprId allocate_expr_id();
+
+        struct Expr : ArenaNode
         {
+            const ExprKind kind;
+            const ExprId id;
+            explicit Expr(ExprKind k) : kind(k), id(allocate_expr_id()) {}
             virtual ~Expr() = default;
             virtual std::any accept(ExprVisitor *visitor) = 0;
         };
+        template <ExprKind K>
+        struct ExprNode : Expr
+        {
+            static constexpr ExprKind node_kind = K;
+            ExprNode() : Expr(K) {}
+        };
         using ExprPtr = std::unique_ptr<Expr>;
 
-        struct LiteralExpr : Expr
+        struct LiteralExpr : ExprNode<ExprKind::Literal>
         {
             LiteralValue value;
             Token token; // Thêm trường này để lưu token gốc
@@ -235,7 +379,7 @@ namespace Linh
             int getCol() const { return token.column_start; }
         };
 
-        struct IdentifierExpr : Expr
+        struct IdentifierExpr : ExprNode<ExprKind::Identifier>
         {
             Token name;
             IdentifierExpr(Token n) : name(std::move(n)) {}
@@ -244,7 +388,7 @@ namespace Linh
             int getCol() const { return name.column_start; }
         };
 
-        struct UnaryExpr : Expr
+        struct UnaryExpr : ExprNode<ExprKind::Unary>
         {
             Token op;
             ExprPtr right;
@@ -254,7 +398,7 @@ namespace Linh
             int getCol() const { return op.column_start; }
         };
 
-        struct PostfixExpr : Expr
+        struct PostfixExpr : ExprNode<ExprKind::Postfix>
         {
             ExprPtr operand;
             Token op_token;
@@ -264,7 +408,7 @@ namespace Linh
             int getCol() const { return op_token.column_start; }
         };
 
-        struct BinaryExpr : Expr
+        struct BinaryExpr : ExprNode<ExprKind::Binary>
         {
             ExprPtr left;
             Token op;
@@ -275,7 +419,7 @@ namespace Linh
             int getCol() const { return op.column_start; }
         };
 
-        struct LogicalExpr : Expr
+        struct LogicalExpr : ExprNode<ExprKind::Logical>
         {
             ExprPtr left;
             Token op;
@@ -286,7 +430,7 @@ namespace Linh
             int getCol() const { return op.column_start; }
         };
 
-        struct AssignmentExpr : Expr
+        struct AssignmentExpr : ExprNode<ExprKind::Assignment>
         {
             Token name;
             ExprPtr value;
@@ -296,7 +440,7 @@ namespace Linh
             int getCol() const { return name.column_start; }
         };
 
-        struct CallExpr : Expr
+        struct CallExpr : ExprNode<ExprKind::Call>
         {
             ExprPtr callee;
             Token paren;
@@ -307,7 +451,7 @@ namespace Linh
             int getCol() const { return paren.column_start; }
         };
 
-        struct InterpolatedStringExpr : Expr
+        struct InterpolatedStringExpr : ExprNode<ExprKind::InterpolatedString>
         {
             std::vector<std::variant<std::string, ExprPtr>> parts;
             Token first_token; // Thêm trường này để lưu vị trí
@@ -317,7 +461,7 @@ namespace Linh
             int getCol() const { return first_token.column_start; }
         };
 
-        struct MemberExpr : Expr
+        struct MemberExpr : ExprNode<ExprKind::Member>
         {
             ExprPtr object;
             std::string property;
@@ -335,7 +479,7 @@ namespace Linh
             int getCol() const { return dot_token.column_start; }
         };
 
-        struct MethodCallExpr : Expr
+        struct MethodCallExpr : ExprNode<ExprKind::MethodCall>
         {
             ExprPtr object;
             std::string method_name;
@@ -352,7 +496,7 @@ namespace Linh
         };
 
         // --- Statement nodes ---
-        struct PrintStmt : Stmt
+        struct PrintStmt : StmtNode<StmtKind::Print>
         {
             Token keyword;
             std::vector<ExprPtr> expressions;
@@ -362,7 +506,7 @@ namespace Linh
             int getCol() const { return keyword.column_start; }
         };
 
-        struct ExpressionStmt : Stmt
+        struct ExpressionStmt : StmtNode<StmtKind::Expression>
         {
             ExprPtr expression;
             Token first_token; // Thêm trường này nếu muốn lưu vị trí
@@ -372,7 +516,7 @@ namespace Linh
             int getCol() const { return first_token.column_start; }
         };
 
-        struct VarDeclStmt : Stmt
+        struct VarDeclStmt : StmtNode<StmtKind::VarDecl>
         {
             Token keyword;
             Token name;
@@ -387,7 +531,7 @@ namespace Linh
             int getCol() const { return keyword.column_start; }
         };
 
-        struct WhileStmt : Stmt
+        struct WhileStmt : StmtNode<StmtKind::While>
         {
             Token keyword_while;
             ExprPtr condition;
@@ -398,7 +542,7 @@ namespace Linh
             int getCol() const { return keyword_while.column_start; }
         };
 
-        struct DoWhileStmt : Stmt
+        struct DoWhileStmt : StmtNode<StmtKind::DoWhile>
         {
             Token keyword_do;
             StmtPtr body;
@@ -410,7 +554,37 @@ namespace Linh
             int getCol() const { return keyword_do.column_start; }
         };
 
-        struct ReturnStmt : Stmt
+        // for x in range(a, b, step) / for x in array|map|str
+        struct ForInStmt : StmtNode<StmtKind::ForIn>
+        {
+            Token keyword_for;
+            Token var_name;
+            ExprPtr iterable; // range(...) và stdin được emitter nhận diện riêng, không tạo array
+            StmtPtr body;
+            ForInStmt(Token kw, Token name, ExprPtr iter, StmtPtr b) : keyword_for(std::move(kw)), var_name(std::move(name)), iterable(std::move(iter)), body(std::move(b)) {}
+            void accept(StmtVisitor *visitor) override { visitor->visitForInStmt(this); }
+            int getLine() const { return keyword_for.line; }
+            int getCol() const { return keyword_for.column_start; }
+
+            // Trả về CallExpr nếu iterable có dạng range(...), ngược lại nullptr
+            CallExpr *as_range_call() const
+            {
+                auto call = node_cast<CallExpr>(iterable.get());
+                if (!call)
+                    return nullptr;
+                auto callee = node_cast<IdentifierExpr>(call->callee.get());
+                return (callee && callee->name.lexeme == "range") ? call : nullptr;
+            }
+
+            // for line in stdin: đọc từng dòng của stdin (stdin chỉ có nghĩa ở đây)
+            bool iterates_stdin() const
+            {
+                auto id = node_cast<IdentifierExpr>(iterable.get());
+                return id && id->name.lexeme == "stdin";
+            }
+        };
+
+        struct ReturnStmt : StmtNode<StmtKind::Return>
         {
             Token keyword_return;
             ExprPtr value;
@@ -420,7 +594,7 @@ namespace Linh
             int getCol() const { return keyword_return.column_start; }
         };
 
-        struct BreakStmt : Stmt
+        struct BreakStmt : StmtNode<StmtKind::Break>
         {
             Token keyword;
             BreakStmt(Token kw) : keyword(std::move(kw)) {}
@@ -428,7 +602,7 @@ namespace Linh
             int getLine() const { return keyword.line; }
             int getCol() const { return keyword.column_start; }
         };
-        struct ContinueStmt : Stmt
+        struct ContinueStmt : StmtNode<StmtKind::Continue>
         {
             Token keyword;
             ContinueStmt(Token kw) : keyword(std::move(kw)) {}
@@ -461,7 +635,7 @@ namespace Linh
             {
             }
         };
-        struct SwitchStmt : Stmt
+        struct SwitchStmt : StmtNode<StmtKind::Switch>
         {
             Token keyword_switch;
             ExprPtr expression_to_switch_on;
@@ -470,14 +644,14 @@ namespace Linh
             SwitchStmt(Token kw, ExprPtr expr, std::vector<CaseClause> cls, Token brace) : keyword_switch(std::move(kw)), expression_to_switch_on(std::move(expr)), cases(std::move(cls)), opening_brace(std::move(brace)) {}
             void accept(StmtVisitor *visitor) override { visitor->visitSwitchStmt(this); }
         };
-        struct DeleteStmt : Stmt
+        struct DeleteStmt : StmtNode<StmtKind::Delete>
         {
             Token keyword_delete;
             ExprPtr expression_to_delete;
             DeleteStmt(Token kw, ExprPtr expr) : keyword_delete(std::move(kw)), expression_to_delete(std::move(expr)) {}
             void accept(StmtVisitor *visitor) override { visitor->visitDeleteStmt(this); }
         };
-        struct ThrowStmt : Stmt
+        struct ThrowStmt : StmtNode<StmtKind::Throw>
         {
             Token keyword;
             ExprPtr expression;
@@ -493,7 +667,7 @@ namespace Linh
             CatchClauseNode(Token kw, Token var_name, std::unique_ptr<BlockStmt> b) : keyword_catch(std::move(kw)), exception_variable(std::move(var_name)), body(std::move(b)) {}
             CatchClauseNode(Token kw, std::unique_ptr<BlockStmt> b) : keyword_catch(std::move(kw)), exception_variable(std::nullopt), body(std::move(b)) {}
         };
-        struct TryStmt : Stmt
+        struct TryStmt : StmtNode<StmtKind::Try>
         {
             Token keyword_try;
             std::unique_ptr<BlockStmt> try_block;
@@ -503,7 +677,7 @@ namespace Linh
             TryStmt(Token kw_try, std::unique_ptr<BlockStmt> try_b, std::vector<CatchClauseNode> catches, std::optional<std::unique_ptr<BlockStmt>> finally_b = std::nullopt, std::optional<Token> kw_finally_opt = std::nullopt) : keyword_try(std::move(kw_try)), try_block(std::move(try_b)), catch_clauses(std::move(catches)), finally_block(std::move(finally_b)), keyword_finally(kw_finally_opt) {}
             void accept(StmtVisitor *visitor) override { visitor->visitTryStmt(this); }
         };
-        struct ImportStmt : Stmt // <--- Thêm node mới
+        struct ImportStmt : StmtNode<StmtKind::Import> // <--- Thêm node mới
         {
             Token import_kw;
             std::vector<Token> names; // rỗng nếu chỉ import module
@@ -528,7 +702,7 @@ namespace Linh
 
         // --- Definitions for all AST nodes (add after forward declarations) ---
 
-        struct BlockStmt : Stmt
+        struct BlockStmt : StmtNode<StmtKind::Block>
         {
             StmtList statements;
             Token opening_brace;
@@ -536,7 +710,7 @@ namespace Linh
             void accept(StmtVisitor *visitor) override { visitor->visitBlockStmt(this); }
         };
 
-        struct IfStmt : Stmt
+        struct IfStmt : StmtNode<StmtKind::If>
         {
             Token keyword_if;
             ExprPtr condition;
@@ -549,14 +723,14 @@ namespace Linh
             int getCol() const { return keyword_if.column_start; }
         };
 
-        struct UninitLiteralExpr : Expr
+        struct UninitLiteralExpr : ExprNode<ExprKind::UninitLiteral>
         {
             Token keyword;
             UninitLiteralExpr(Token kw) : keyword(std::move(kw)) {}
             std::any accept(ExprVisitor *visitor) override { return visitor->visitUninitLiteralExpr(this); }
         };
 
-        struct NewExpr : Expr
+        struct NewExpr : ExprNode<ExprKind::New>
         {
             Token keyword_new;
             ExprPtr class_constructor_call;
@@ -564,21 +738,21 @@ namespace Linh
             std::any accept(ExprVisitor *visitor) override { return visitor->visitNewExpr(this); }
         };
 
-        struct ThisExpr : Expr
+        struct ThisExpr : ExprNode<ExprKind::This>
         {
             Token keyword_this;
             ThisExpr(Token kw) : keyword_this(std::move(kw)) {}
             std::any accept(ExprVisitor *visitor) override { return visitor->visitThisExpr(this); }
         };
 
-        struct GroupingExpr : Expr
+        struct GroupingExpr : ExprNode<ExprKind::Grouping>
         {
             ExprPtr expression;
             GroupingExpr(ExprPtr expr) : expression(std::move(expr)) {}
             std::any accept(ExprVisitor *visitor) override { return visitor->visitGroupingExpr(this); }
         };
 
-        struct ArrayLiteralExpr : Expr
+        struct ArrayLiteralExpr : ExprNode<ExprKind::ArrayLiteral>
         {
             Token l_bracket;
             std::vector<ExprPtr> elements;
@@ -590,7 +764,7 @@ namespace Linh
             int getCol() const { return l_bracket.column_start; }
         };
 
-        struct MapLiteralExpr : Expr
+        struct MapLiteralExpr : ExprNode<ExprKind::MapLiteral>
         {
             Token l_brace;
             std::vector<MapEntryNode> entries;
@@ -600,7 +774,7 @@ namespace Linh
             std::any accept(ExprVisitor *visitor) override { return visitor->visitMapLiteralExpr(this); }
         };
 
-        struct SubscriptExpr : Expr
+        struct SubscriptExpr : ExprNode<ExprKind::Subscript>
         {
             ExprPtr object;
             Token l_bracket_token;
@@ -621,7 +795,7 @@ namespace Linh
                 : name(std::move(n)), type(std::move(t)), is_static(static_) {}
         };
 
-        struct FunctionDeclStmt : Stmt
+        struct FunctionDeclStmt : StmtNode<StmtKind::FunctionDecl>
         {
             Token keyword_func;
             Token name;
@@ -635,7 +809,7 @@ namespace Linh
             int getCol() const { return keyword_func.column_start; }
         };
 
-        struct FunctionExpr : Expr {
+        struct FunctionExpr : ExprNode<ExprKind::Function> {
             Token keyword_func;
             std::vector<FuncParamNode> params;
             std::optional<TypeNodePtr> return_type;
@@ -647,6 +821,102 @@ namespace Linh
             int getCol() const { return keyword_func.column_start; }
         };
 
+        // Visitor tĩnh (CRTP) cho emitter/analyzer: visit() switch theo kind rồi gọi thẳng Derived::visitXxx,
+        // không qua vtable của accept() và không trả std::any. Derived khai báo đủ visitXxx (trả void), không override.
+        template <typename Derived>
+        class TypedVisitor
+        {
+        public:
+            void visit(Expr *expr)
+            {
+                Derived &self = static_cast<Derived &>(*this);
+                switch (expr->kind)
+                {
+                case ExprKind::Binary:
+                    return self.visitBinaryExpr(static_cast<BinaryExpr *>(expr));
+                case ExprKind::Unary:
+                    return self.visitUnaryExpr(static_cast<UnaryExpr *>(expr));
+                case ExprKind::Literal:
+                    return self.visitLiteralExpr(static_cast<LiteralExpr *>(expr));
+                case ExprKind::Grouping:
+                    return self.visitGroupingExpr(static_cast<GroupingExpr *>(expr));
+                case ExprKind::Identifier:
+                    return self.visitIdentifierExpr(static_cast<IdentifierExpr *>(expr));
+                case ExprKind::Assignment:
+                    return self.visitAssignmentExpr(static_cast<AssignmentExpr *>(expr));
+                case ExprKind::Logical:
+                    return self.visitLogicalExpr(static_cast<LogicalExpr *>(expr));
+                case ExprKind::Call:
+                    return self.visitCallExpr(static_cast<CallExpr *>(expr));
+                case ExprKind::Postfix:
+                    return self.visitPostfixExpr(static_cast<PostfixExpr *>(expr));
+                case ExprKind::UninitLiteral:
+                    return self.visitUninitLiteralExpr(static_cast<UninitLiteralExpr *>(expr));
+                case ExprKind::New:
+                    return self.visitNewExpr(static_cast<NewExpr *>(expr));
+                case ExprKind::This:
+                    return self.visitThisExpr(static_cast<ThisExpr *>(expr));
+                case ExprKind::ArrayLiteral:
+                    return self.visitArrayLiteralExpr(static_cast<ArrayLiteralExpr *>(expr));
+                case ExprKind::MapLiteral:
+                    return self.visitMapLiteralExpr(static_cast<MapLiteralExpr *>(expr));
+                case ExprKind::Subscript:
+                    return self.visitSubscriptExpr(static_cast<SubscriptExpr *>(expr));
+                case ExprKind::InterpolatedString:
+                    return self.visitInterpolatedStringExpr(static_cast<InterpolatedStringExpr *>(expr));
+                case ExprKind::Member:
+                    return self.visitMemberExpr(static_cast<MemberExpr *>(expr));
+                case ExprKind::MethodCall:
+                    return self.visitMethodCallExpr(static_cast<MethodCallExpr *>(expr));
+                case ExprKind::Function:
+                    return self.visitFunctionExpr(static_cast<FunctionExpr *>(expr));
+                }
+            }
+            void visit(Stmt *stmt)
+            {
+                Derived &self = static_cast<Derived &>(*this);
+                switch (stmt->kind)
+                {
+                case StmtKind::Print:
+                    return self.visitPrintStmt(static_cast<PrintStmt *>(stmt));
+                case StmtKind::Expression:
+                    return self.visitExpressionStmt(static_cast<ExpressionStmt *>(stmt));
+                case StmtKind::VarDecl:
+                    return self.visitVarDeclStmt(static_cast<VarDeclStmt *>(stmt));
+                case StmtKind::Block:
+                    return self.visitBlockStmt(static_cast<BlockStmt *>(stmt));
+                case StmtKind::If:
+                    return self.visitIfStmt(static_cast<IfStmt *>(stmt));
+                case StmtKind::While:
+                    return self.visitWhileStmt(static_cast<WhileStmt *>(stmt));
+                case StmtKind::DoWhile:
+                    return self.visitDoWhileStmt(static_cast<DoWhileStmt *>(stmt));
+                case StmtKind::ForIn:
+                    return self.visitForInStmt(static_cast<ForInStmt *>(stmt));
+                case StmtKind::FunctionDecl:
+                    return self.visitFunctionDeclStmt(static_cast<FunctionDeclStmt *>(stmt));
+                case StmtKind::Return:
+                    return self.visitReturnStmt(static_cast<ReturnStmt *>(stmt));
+                case StmtKind::Break:
+                    return self.visitBreakStmt(static_cast<BreakStmt *>(stmt));
+                case StmtKind::Continue:
+                    return self.visitContinueStmt(static_cast<ContinueStmt *>(stmt));
+                case StmtKind::Switch:
+                    return self.visitSwitchStmt(static_cast<SwitchStmt *>(stmt));
+                case StmtKind::Delete:
+                    return self.visitDeleteStmt(static_cast<DeleteStmt *>(stmt));
+                case StmtKind::Throw:
+                    return self.visitThrowStmt(static_cast<ThrowStmt *>(stmt));
+                case StmtKind::Try:
+                    return self.visitTryStmt(static_cast<TryStmt *>(stmt));
+                case StmtKind::Import:
+                    return self.visitImportStmt(static_cast<ImportStmt *>(stmt));
+                }
+            }
+            template <typename T>
+            void visit(const std::unique_ptr<T> &node) { visit(node.get()); }
+        };
+
     } // namespace AST
 } // namespace Linh
 #endif // LINH_AST_NODE_HPP
@@ -357,6 +357,29 @@ namespace Linh
             m_builder << ")\n";
         }
 
+        void ASTPrinter::visitForInStmt(ForInStmt *stmt)
+        {
+            indent();
+            m_builder << "(ForIn var:" << stmt->var_name.lexeme << " " << print_expr(stmt->iterable.get()) << "\n";
+            m_indent_level++;
+            indent();
+            m_builder << "(Body\n";
+            m_indent_level++;
+            if (stmt->body)
+                stmt->body->accept(this);
+            else
+            {
+                indent();
+                m_builder << "(EmptyBody)\n";
+            }
+            m_indent_level--;
+            indent();
+            m_builder << ")\n";
+            m_indent_level--;
+            indent();
+            m_builder << ")\n";
+        }
+
         void ASTPrinter::visitFunctionDeclStmt(FunctionDeclStmt *stmt)
         {
             std::string params_str;
@@ -46,6 +46,7 @@ namespace Linh
             void visitIfStmt(IfStmt *stmt) override;
             void visitWhileStmt(WhileStmt *stmt) override;
             void visitDoWhileStmt(DoWhileStmt *stmt) override;
+            void visitForInStmt(ForInStmt *stmt) override;
             void visitFunctionDeclStmt(FunctionDeclStmt *stmt) override;
             void visitReturnStmt(ReturnStmt *stmt) override;
             void visitBreakStmt(BreakStmt *stmt) override;
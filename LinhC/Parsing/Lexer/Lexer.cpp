@@ -3,13 +3,351 @@
 #include <utility>
 #include <stdexcept>
 #include <cctype>
+#include <charconv>
+#include <cstring>
 #include <string>
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define LINH_LEXER_AVX2 1
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define LINH_LEXER_SSE2 1
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
 namespace Linh
 {
-    const std::unordered_map<std::string, TokenType> Lexer::s_keywords = {
-        {"var", TokenType::VAR_KW}, {"vas", TokenType::VAS_KW}, {"const", TokenType::CONST_KW}, {"if", TokenType::IF_KW}, {"else", TokenType::ELSE_KW}, {"for", TokenType::FOR_KW}, {"while", TokenType::WHILE_KW}, {"func", TokenType::FUNC_KW}, {"return", TokenType::RETURN_KW}, {"true", TokenType::TRUE_KW}, {"false", TokenType::FALSE_KW}, {"int", TokenType::INT_KW}, {"uint", TokenType::UINT_KW}, {"str", TokenType::STR_KW}, {"bool", TokenType::BOOL_KW}, {"float", TokenType::FLOAT_KW}, {"map", TokenType::MAP_KW}, {"array", TokenType::ARRAY_KW}, {"void", TokenType::VOID_KW}, {"any", TokenType::ANY_KW}, {"print", TokenType::PRINT_KW}, {"break", TokenType::BREAK_KW}, {"continue", TokenType::CONTINUE_KW}, {"skip", TokenType::SKIP_KW}, {"switch", TokenType::SWITCH_KW}, {"case", TokenType::CASE_KW}, {"default", TokenType::DEFAULT_KW}, {"other", TokenType::OTHER_KW}, {"type", TokenType::TYPE_KW}, {"sol", TokenType::SOL_KW}, {"is", TokenType::IS_KW}, {"not", TokenType::NOT_KW}, {"and", TokenType::AND_KW}, {"or", TokenType::OR_KW}, {"do", TokenType::DO_KW}, {"new", TokenType::NEW_KW}, {"delete", TokenType::DELETE_KW}, {"this", TokenType::THIS_KW}, {"throw", TokenType::THROW_KW}, {"try", TokenType::TRY_KW}, {"catch", TokenType::CATCH_KW}, {"finally", TokenType::FINALLY_KW}, {"import", TokenType::IMPORT_KW}, {"from", TokenType::FROM_KW}, {"id", TokenType::IDENTIFIER} // Thêm dòng này để id luôn là identifier (không phải keyword, nhưng nhận diện được)
-    };
+    // --- Quét nhanh theo khối: AVX2 32 byte / SSE2 16 byte một lần, phần đuôi (và máy không có SIMD) quét từng byte ---
+    namespace
+    {
+        inline unsigned first_set_bit(uint32_t mask)
+        {
+#ifdef _MSC_VER
+            unsigned long index;
+            _BitScanForward(&index, mask);
+            return static_cast<unsigned>(index);
+#else
+            return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+        }
+
+        inline bool is_identifier_byte(unsigned char c)
+        {
+            return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+        }
+
+#ifdef LINH_LEXER_SSE2
+        // Byte nằm trong [lo, hi] (so sánh không dấu): (x - lo) bão hoà trừ (hi - lo) == 0
+        inline __m128i in_range(__m128i x, char lo, char hi)
+        {
+            __m128i shifted = _mm_sub_epi8(x, _mm_set1_epi8(lo));
+            return _mm_cmpeq_epi8(_mm_subs_epu8(shifted, _mm_set1_epi8(static_cast<char>(hi - lo))), _mm_setzero_si128());
+        }
+        inline __m128i identifier_mask(__m128i x)
+        {
+            __m128i letters = in_range(_mm_or_si128(x, _mm_set1_epi8(0x20)), 'a', 'z');
+            __m128i digits = in_range(x, '0', '9');
+            return _mm_or_si128(_mm_or_si128(letters, digits), _mm_cmpeq_epi8(x, _mm_set1_epi8('_')));
+        }
+#endif
+#ifdef LINH_LEXER_AVX2
+        inline __m256i in_range(__m256i x, char lo, char hi)
+        {
+            __m256i shifted = _mm256_sub_epi8(x, _mm256_set1_epi8(lo));
+            return _mm256_cmpeq_epi8(_mm256_subs_epu8(shifted, _mm256_set1_epi8(static_cast<char>(hi - lo))), _mm256_setzero_si256());
+        }
+        inline __m256i identifier_mask(__m256i x)
+        {
+            __m256i letters = in_range(_mm256_or_si256(x, _mm256_set1_epi8(0x20)), 'a', 'z');
+            __m256i digits = in_range(x, '0', '9');
+            return _mm256_or_si256(_mm256_or_si256(letters, digits), _mm256_cmpeq_epi8(x, _mm256_set1_epi8('_')));
+        }
+#endif
+
+        // Số byte đầu là ký tự của identifier [A-Za-z0-9_]
+        size_t span_identifier(const char *p, size_t n)
+        {
+            size_t i = 0;
+#ifdef LINH_LEXER_AVX2
+            for (; i + 32 <= n; i += 32)
+            {
+                __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + i));
+                uint32_t stop = ~static_cast<uint32_t>(_mm256_movemask_epi8(identifier_mask(block)));
+                if (stop)
+                    return i + first_set_bit(stop);
+            }
+#endif
+#ifdef LINH_LEXER_SSE2
+            for (; i + 16 <= n; i += 16)
+            {
+                __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i));
+                uint32_t stop = ~static_cast<uint32_t>(_mm_movemask_epi8(identifier_mask(block))) & 0xFFFFu;
+                if (stop)
+                    return i + first_set_bit(stop);
+            }
+#endif
+            while (i < n && is_identifier_byte(static_cast<unsigned char>(p[i])))
+                ++i;
+            return i;
+        }
+
+        // Số byte đầu là chữ số [0-9]
+        size_t span_digits(const char *p, size_t n)
+        {
+            size_t i = 0;
+#ifdef LINH_LEXER_SSE2
+            for (; i + 16 <= n; i += 16)
+            {
+                __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i));
+                uint32_t stop = ~static_cast<uint32_t>(_mm_movemask_epi8(in_range(block, '0', '9'))) & 0xFFFFu;
+                if (stop)
+                    return i + first_set_bit(stop);
+            }
+#endif
+            while (i < n && p[i] >= '0' && p[i] <= '9')
+                ++i;
+            return i;
+        }
+
+        // Số byte trước lần xuất hiện đầu tiên của một trong a, b, c, d (không có thì trả n)
+        size_t find_any_of(const char *p, size_t n, char a, char b, char c, char d)
+        {
+            size_t i = 0;
+#ifdef LINH_LEXER_AVX2
+            const __m256i wa = _mm256_set1_epi8(a), wb = _mm256_set1_epi8(b), wc = _mm256_set1_epi8(c), wd = _mm256_set1_epi8(d);
+            for (; i + 32 <= n; i += 32)
+            {
+                __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + i));
+                __m256i hit = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(block, wa), _mm256_cmpeq_epi8(block, wb)),
+                                              _mm256_or_si256(_mm256_cmpeq_epi8(block, wc), _mm256_cmpeq_epi8(block, wd)));
+                uint32_t found = static_cast<uint32_t>(_mm256_movemask_epi8(hit));
+                if (found)
+                    return i + first_set_bit(found);
+            }
+#endif
+#ifdef LINH_LEXER_SSE2
+            const __m128i va = _mm_set1_epi8(a), vb = _mm_set1_epi8(b), vc = _mm_set1_epi8(c), vd = _mm_set1_epi8(d);
+            for (; i + 16 <= n; i += 16)
+            {
+                __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i));
+                __m128i hit = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(block, va), _mm_cmpeq_epi8(block, vb)),
+                                           _mm_or_si128(_mm_cmpeq_epi8(block, vc), _mm_cmpeq_epi8(block, vd)));
+                uint32_t found = static_cast<uint32_t>(_mm_movemask_epi8(hit));
+                if (found)
+                    return i + first_set_bit(found);
+            }
+#endif
+            for (; i < n; ++i)
+                if (p[i] == a || p[i] == b || p[i] == c || p[i] == d)
+                    return i;
+            return n;
+        }
+    }
+
+    // Nhận diện keyword không cấp phát: chia theo độ dài rồi ký tự đầu, mỗi nhánh chỉ so vài chuỗi.
+    // Không phải keyword thì trả IDENTIFIER ("id" cũng là identifier, không phải keyword).
+    TokenType Lexer::keyword_type(std::string_view text)
+    {
+        switch (text.size())
+        {
+        case 2:
+            switch (text[0])
+            {
+            case 'd':
+                if (text == "do")
+                    return TokenType::DO_KW;
+                break;
+            case 'i':
+                if (text == "if")
+                    return TokenType::IF_KW;
+                if (text == "is")
+                    return TokenType::IS_KW;
+                break;
+            case 'o':
+                if (text == "or")
+                    return TokenType::OR_KW;
+                break;
+            }
+            break;
+        case 3:
+            switch (text[0])
+            {
+            case 'a':
+                if (text == "any")
+                    return TokenType::ANY_KW;
+                if (text == "and")
+                    return TokenType::AND_KW;
+                break;
+            case 'f':
+                if (text == "for")
+                    return TokenType::FOR_KW;
+                break;
+            case 'i':
+                if (text == "int")
+                    return TokenType::INT_KW;
+                break;
+            case 'm':
+                if (text == "map")
+                    return TokenType::MAP_KW;
+                break;
+            case 'n':
+                if (text == "not")
+                    return TokenType::NOT_KW;
+                if (text == "new")
+                    return TokenType::NEW_KW;
+                break;
+            case 's':
+                if (text == "str")
+                    return TokenType::STR_KW;
+                if (text == "sol")
+                    return TokenType::SOL_KW;
+                break;
+            case 't':
+                if (text == "try")
+                    return TokenType::TRY_KW;
+                break;
+            case 'v':
+                if (text == "var")
+                    return TokenType::VAR_KW;
+                if (text == "vas")
+                    return TokenType::VAS_KW;
+                break;
+            }
+            break;
+        case 4:
+            switch (text[0])
+            {
+            case 'b':
+                if (text == "bool")
+                    return TokenType::BOOL_KW;
+                break;
+            case 'c':
+                if (text == "case")
+                    return TokenType::CASE_KW;
+                break;
+            case 'e':
+                if (text == "else")
+                    return TokenType::ELSE_KW;
+                break;
+            case 'f':
+                if (text == "func")
+                    return TokenType::FUNC_KW;
+                if (text == "from")
+                    return TokenType::FROM_KW;
+                break;
+            case 's':
+                if (text == "skip")
+                    return TokenType::SKIP_KW;
+                break;
+            case 't':
+                if (text == "true")
+                    return TokenType::TRUE_KW;
+                if (text == "type")
+                    return TokenType::TYPE_KW;
+                if (text == "this")
+                    return TokenType::THIS_KW;
+                break;
+            case 'u':
+                if (text == "uint")
+                    return TokenType::UINT_KW;
+                break;
+            case 'v':
+                if (text == "void")
+                    return TokenType::VOID_KW;
+                break;
+            }
+            break;
+        case 5:
+            switch (text[0])
+            {
+            case 'a':
+                if (text == "array")
+                    return TokenType::ARRAY_KW;
+                break;
+            case 'b':
+                if (text == "break")
+                    return TokenType::BREAK_KW;
+                break;
+            case 'c':
+                if (text == "const")
+                    return TokenType::CONST_KW;
+                if (text == "catch")
+                    return TokenType::CATCH_KW;
+                break;
+            case 'f':
+                if (text == "false")
+                    return TokenType::FALSE_KW;
+                if (text == "float")
+                    return TokenType::FLOAT_KW;
+                break;
+            case 'o':
+                if (text == "other")
+                    return TokenType::OTHER_KW;
+                break;
+            case 'p':
+                if (text == "print")
+                    return TokenType::PRINT_KW;
+                break;
+            case 't':
+                if (text == "throw")
+                    return TokenType::THROW_KW;
+                break;
+            case 'w':
+                if (text == "while")
+                    return TokenType::WHILE_KW;
+                break;
+            }
+            break;
+        case 6:
+            switch (text[0])
+            {
+            case 'd':
+                if (text == "delete")
+                    return TokenType::DELETE_KW;
+                break;
+            case 'i':
+                if (text == "import")
+                    return TokenType::IMPORT_KW;
+                break;
+            case 'r':
+                if (text == "return")
+                    return TokenType::RETURN_KW;
+                break;
+            case 's':
+                if (text == "switch")
+                    return TokenType::SWITCH_KW;
+                break;
+            }
+            break;
+        case 7:
+            switch (text[0])
+            {
+            case 'd':
+                if (text == "default")
+                    return TokenType::DEFAULT_KW;
+                break;
+            case 'f':
+                if (text == "finally")
+                    return TokenType::FINALLY_KW;
+                break;
+            }
+            break;
+        case 8:
+            switch (text[0])
+            {
+            case 'c':
+                if (text == "continue")
+                    return TokenType::CONTINUE_KW;
+                break;
+            }
+            break;
+        }
+        return TokenType::IDENTIFIER;
+    }
 
     Token::Token(TokenType type, std::string lexeme, LiteralValue literal, int line, int column_start)
         : type(type), lexeme(std::move(lexeme)), literal(std::move(literal)), line(line), column_start(column_start) {}
@@ -216,7 +554,29 @@ namespace Linh
         }
     }
 
-    Lexer::Lexer(std::string source) : m_source(std::move(source)) {}
+    Token TokenStream::token(size_t index) const
+    {
+        const TokenSpan &span = spans[index];
+        return Token(span.type, lexeme(index), literals[span.literal_index], span.line, span.column_start);
+    }
+
+    std::vector<Token> TokenStream::to_tokens() const
+    {
+        std::vector<Token> tokens;
+        tokens.reserve(spans.size());
+        for (size_t i = 0; i < spans.size(); ++i)
+            tokens.push_back(token(i));
+        return tokens;
+    }
+
+    Lexer::Lexer(std::string source) : Lexer(std::make_shared<const std::string>(std::move(source))) {}
+    Lexer::Lexer(std::shared_ptr<const std::string> source) : Lexer(source, 0, source->size()) {}
+    Lexer::Lexer(std::shared_ptr<const std::string> buffer, size_t offset, size_t length)
+        : m_buffer(std::move(buffer)), m_base(offset)
+    {
+        m_source = std::string_view(*m_buffer).substr(offset, length);
+        m_stream.source = m_buffer;
+    }
     bool Lexer::is_at_end() const { return m_current_pos >= m_source.length(); }
     char Lexer::advance()
     {
@@ -236,6 +596,11 @@ namespace Linh
             return '\0';
         return m_source[m_current_pos + 1];
     }
+    void Lexer::skip(size_t count)
+    {
+        m_current_pos += count;
+        m_current_col_scan += static_cast<int>(count);
+    }
     bool Lexer::match(char expected)
     {
         if (is_at_end() || m_source[m_current_pos] != expected)
@@ -246,18 +611,33 @@ namespace Linh
     }
     void Lexer::create_and_add_token(TokenType type, int line, int col_start)
     {
-        create_and_add_token(type, std::monostate{}, line, col_start);
+        m_stream.spans.push_back({type, static_cast<uint32_t>(m_base + m_start_lexeme),
+                                  static_cast<uint32_t>(m_current_pos - m_start_lexeme), line, col_start, 0});
+    }
+    void Lexer::create_and_add_token(TokenType type, LiteralValue literal_val, int line, int col_start)
+    {
+        create_and_add_token(type, line, col_start);
+        m_stream.spans.back().literal_index = static_cast<uint32_t>(m_stream.literals.size());
+        m_stream.literals.push_back(std::move(literal_val));
     }
-    void Lexer::create_and_add_token(TokenType type, const LiteralValue &literal_val, int line, int col_start)
+    // Token lỗi: lexeme là đoạn nguồn đang quét, thông báo nằm trong literal
+    void Lexer::add_error(const std::string &message, int line, int col_start)
     {
-        std::string text = m_source.substr(m_start_lexeme, m_current_pos - m_start_lexeme);
-        m_tokens.emplace_back(type, std::move(text), literal_val, line, col_start);
+        create_and_add_token(TokenType::ERROR, message, line, col_start);
     }
     void Lexer::handle_string_literal(char quote_char, int start_line, int start_col)
     {
         std::string value_str;
         while (peek() != quote_char && !is_at_end())
         {
+            // Chép một lèo đoạn không có ký tự đặc biệt (quote, escape, '&' nội suy, xuống dòng)
+            size_t run = find_any_of(m_source.data() + m_current_pos, m_source.size() - m_current_pos, quote_char, '\\', '&', '\n');
+            if (run > 0)
+            {
+                value_str.append(m_source.data() + m_current_pos, run);
+                skip(run);
+                continue;
+            }
             char current_char = peek();
             if (current_char == '\n')
             {
@@ -269,7 +649,7 @@ namespace Linh
             {
                 if (!value_str.empty())
                 {
-                    create_and_add_token(TokenType::STR, value_str, start_line, start_col);
+                    create_and_add_token(TokenType::STR, std::move(value_str), start_line, start_col);
                     value_str.clear();
                 }
                 // Đặt lại m_start_lexeme để INTERP_START có lexeme đúng
@@ -287,9 +667,9 @@ namespace Linh
                 int expr_start_line = m_current_line;
                 int expr_start_col = m_current_col_scan;
 
-                // Quét đến dấu đóng '}'
+                // Quét đến dấu đóng '}' (chỉ ghi nhận vị trí, không chép nội dung)
                 int brace_count = 1;
-                std::string expr_content;
+                size_t expr_start = m_current_pos;
                 while (!is_at_end() && brace_count > 0)
                 {
                     char ch = peek();
@@ -303,30 +683,36 @@ namespace Linh
                         if (brace_count == 0)
                             break;
                     }
-                    expr_content += advance();
+                    advance();
                 }
 
                 if (is_at_end())
                 {
-                    m_tokens.emplace_back(TokenType::ERROR, m_source.substr(m_start_lexeme, m_current_pos - m_start_lexeme), "Unterminated interpolation.", expr_start_line, expr_start_col);
+                    add_error("Unterminated interpolation.", expr_start_line, expr_start_col);
                     return;
                 }
 
                 // Tokenize nội dung biểu thức nội suy
-                if (!expr_content.empty())
+                if (m_current_pos > expr_start)
                 {
-                    // Tạo một Lexer tạm thời để tokenize nội dung biểu thức
-                    Lexer expr_lexer(expr_content);
-                    auto expr_tokens = expr_lexer.scan_tokens();
-                    
+                    // Lexer tạm thời quét đúng đoạn biểu thức trên cùng buffer
+                    Lexer expr_lexer(m_buffer, m_base + expr_start, m_current_pos - expr_start);
+                    TokenStream expr_stream = expr_lexer.scan();
+
                     // Thêm các token vào danh sách chính (bỏ qua EOF token cuối)
-                    for (size_t i = 0; i < expr_tokens.size() - 1; ++i)
+                    for (size_t i = 0; i + 1 < expr_stream.spans.size(); ++i)
                     {
-                        auto& token = expr_tokens[i];
+                        TokenSpan span = expr_stream.spans[i];
                         // Điều chỉnh vị trí token để phù hợp với vị trí trong chuỗi gốc
-                        token.line = expr_start_line;
-                        token.column_start = expr_start_col + token.column_start;
-                        m_tokens.push_back(token);
+                        span.line = expr_start_line;
+                        span.column_start = expr_start_col + span.column_start;
+                        if (span.literal_index != 0)
+                        {
+                            uint32_t literal_index = static_cast<uint32_t>(m_stream.literals.size());
+                            m_stream.literals.push_back(std::move(expr_stream.literals[span.literal_index]));
+                            span.literal_index = literal_index;
+                        }
+                        m_stream.spans.push_back(span);
                     }
                 }
 
@@ -385,25 +771,23 @@ namespace Linh
         }
         if (is_at_end())
         {
-            m_tokens.emplace_back(TokenType::ERROR, m_source.substr(m_start_lexeme, m_current_pos - m_start_lexeme), "Unterminated string.", start_line, start_col);
+            add_error("Unterminated string.", start_line, start_col);
             return;
         }
         advance();
-        create_and_add_token(TokenType::STR, value_str, start_line, start_col);
+        create_and_add_token(TokenType::STR, std::move(value_str), start_line, start_col);
     }
     void Lexer::handle_number_literal(int start_line, int start_col)
     {
-        while (isdigit(peek()))
-            advance();
+        skip(span_digits(m_source.data() + m_current_pos, m_source.size() - m_current_pos));
         bool is_float = false;
         if (peek() == '.' && isdigit(peek_next()))
         {
             is_float = true;
             advance();
-            while (isdigit(peek()))
-                advance();
+            skip(span_digits(m_source.data() + m_current_pos, m_source.size() - m_current_pos));
         }
-        std::string num_str = m_source.substr(m_start_lexeme, m_current_pos - m_start_lexeme);
+        std::string_view digits = m_source.substr(m_start_lexeme, m_current_pos - m_start_lexeme);
         // Kiểm tra hậu tố u/U cho uint
         bool is_uint = false;
         if ((peek() == 'u' || peek() == 'U') && !is_float)
@@ -411,6 +795,26 @@ namespace Linh
             is_uint = true;
             advance();
         }
+        // Số nguyên: from_chars đọc thẳng trên buffer, không tạo chuỗi; tràn số thì để stoll/stoull báo lỗi như cũ
+        if (!is_float)
+        {
+            uint64_t value = 0;
+            auto [end, ec] = std::from_chars(digits.data(), digits.data() + digits.size(), value);
+            if (ec == std::errc() && end == digits.data() + digits.size())
+            {
+                if (is_uint)
+                {
+                    create_and_add_token(TokenType::UINT, value, start_line, start_col);
+                    return;
+                }
+                if (value <= static_cast<uint64_t>(INT64_MAX))
+                {
+                    create_and_add_token(TokenType::INT, static_cast<int64_t>(value), start_line, start_col);
+                    return;
+                }
+            }
+        }
+        std::string num_str(digits);
         try
         {
             if (is_float)
@@ -425,18 +829,16 @@ namespace Linh
             std::string error_message = (is_float ? "Float" : (is_uint ? "Uint" : "Integer")) +
                                         std::string(" literal '") + num_str +
                                         "' out of range: " + oor.what();
-            m_tokens.emplace_back(TokenType::ERROR, num_str, error_message, start_line, start_col);
+            add_error(error_message, start_line, start_col);
+            m_stream.spans.back().length = static_cast<uint32_t>(digits.size()); // Lexeme lỗi không gồm hậu tố u
         }
     }
     void Lexer::handle_identifier(int start_line, int start_col)
     {
-        while (isalnum(peek()) || peek() == '_')
-            advance();
-        std::string text = m_source.substr(m_start_lexeme, m_current_pos - m_start_lexeme);
-        auto it = s_keywords.find(text);
-        if (it != s_keywords.end())
+        skip(span_identifier(m_source.data() + m_current_pos, m_source.size() - m_current_pos));
+        TokenType type = keyword_type(m_source.substr(m_start_lexeme, m_current_pos - m_start_lexeme));
+        if (type != TokenType::IDENTIFIER)
         {
-            TokenType type = it->second;
             if (type == TokenType::TRUE_KW)
                 create_and_add_token(type, true, start_line, start_col);
             else if (type == TokenType::FALSE_KW)
@@ -453,6 +855,13 @@ namespace Linh
     {
         while (!(peek() == '*' && peek_next() == '/') && !is_at_end())
         {
+            // Bỏ qua một lèo tới '*' hoặc xuống dòng kế tiếp
+            size_t run = find_any_of(m_source.data() + m_current_pos, m_source.size() - m_current_pos, '*', '\n', '*', '\n');
+            if (run > 0)
+            {
+                skip(run);
+                continue;
+            }
             if (peek() == '\n')
             {
                 m_current_line++;
@@ -462,7 +871,7 @@ namespace Linh
         }
         if (is_at_end())
         {
-            m_tokens.emplace_back(TokenType::ERROR, m_source.substr(m_start_lexeme, m_current_pos - m_start_lexeme), "Unterminated block comment.", start_line, start_col);
+            add_error("Unterminated block comment.", start_line, start_col);
             return;
         }
         advance();
@@ -470,153 +879,192 @@ namespace Linh
     }
     std::vector<Token> Lexer::scan_tokens()
     {
-        m_tokens.clear();
+        return scan().to_tokens();
+    }
+
+    TokenStream Lexer::scan()
+    {
+        m_stream.source = m_buffer;
+        m_stream.spans.clear();
+        m_stream.literals.resize(1);
+        m_stream.spans.reserve(m_source.size() / 4 + 1); // Ước lượng thô: trung bình vài ký tự một token
+        m_start_lexeme = m_current_pos = 0;
+        m_current_line = 1;
+        m_current_col_scan = 1;
         while (!is_at_end())
+            scan_token();
+        m_current_col_scan = 1;
+        m_start_lexeme = m_current_pos;
+        create_and_add_token(TokenType::END_OF_FILE, m_current_line, m_current_col_scan);
+        return std::move(m_stream);
+    }
+
+    bool Lexer::scan_more(std::vector<Token> &out)
+    {
+        if (m_finished)
+            return false;
+        // Chỉ giữ các span của lần quét này: bộ nhớ theo lô token, không theo cả file
+        m_stream.spans.clear();
+        m_stream.literals.resize(1);
+        while (!is_at_end() && m_stream.spans.empty())
+            scan_token();
+        if (m_stream.spans.empty())
         {
+            m_current_col_scan = 1;
             m_start_lexeme = m_current_pos;
-            int lexeme_start_line = m_current_line;
-            int lexeme_start_col = m_current_col_scan;
-            char c = advance();
-            switch (c)
+            create_and_add_token(TokenType::END_OF_FILE, m_current_line, m_current_col_scan);
+            m_finished = true;
+        }
+        for (size_t i = 0; i < m_stream.spans.size(); ++i)
+            out.push_back(m_stream.token(i));
+        return true;
+    }
+
+    void Lexer::scan_token()
+    {
+        m_start_lexeme = m_current_pos;
+        int lexeme_start_line = m_current_line;
+        int lexeme_start_col = m_current_col_scan;
+        char c = advance();
+        switch (c)
+        {
+        case '(':
+            create_and_add_token(TokenType::LPAREN, lexeme_start_line, lexeme_start_col);
+            break;
+        case ')':
+            create_and_add_token(TokenType::RPAREN, lexeme_start_line, lexeme_start_col);
+            break;
+        case '{':
+            create_and_add_token(TokenType::LBRACE, lexeme_start_line, lexeme_start_col);
+            break;
+        case '}':
+            create_and_add_token(TokenType::RBRACE, lexeme_start_line, lexeme_start_col);
+            break;
+        case '[':
+            create_and_add_token(TokenType::LBRACKET, lexeme_start_line, lexeme_start_col);
+            break;
+        case ']':
+            create_and_add_token(TokenType::RBRACKET, lexeme_start_line, lexeme_start_col);
+            break;
+        case ',':
+            create_and_add_token(TokenType::COMMA, lexeme_start_line, lexeme_start_col);
+            break;
+        case '.':
+            create_and_add_token(TokenType::DOT, lexeme_start_line, lexeme_start_col);
+            break;
+        case ';':
+            create_and_add_token(TokenType::SEMICOLON, lexeme_start_line, lexeme_start_col);
+            break;
+        case ':':
+            create_and_add_token(TokenType::COLON, lexeme_start_line, lexeme_start_col);
+            break;
+        case '%':
+            create_and_add_token(match('=') ? TokenType::PERCENT_ASSIGN : TokenType::PERCENT, lexeme_start_line, lexeme_start_col);
+            break;
+        case '#':
+            create_and_add_token(match('=') ? TokenType::HASH_ASSIGN : TokenType::HASH, lexeme_start_line, lexeme_start_col);
+            break;
+        case '!':
+            create_and_add_token(match('=') ? TokenType::NOT_EQ : TokenType::NOT, lexeme_start_line, lexeme_start_col);
+            break;
+        case '=':
+            create_and_add_token(match('=') ? TokenType::EQ_EQ : TokenType::ASSIGN, lexeme_start_line, lexeme_start_col);
+            break;
+        case '&':
+            if (match('&'))
+                create_and_add_token(TokenType::AND_LOGIC, lexeme_start_line, lexeme_start_col);
+            else
+                create_and_add_token(TokenType::AMP, lexeme_start_line, lexeme_start_col);
+            break;
+        case '|':
+            if (match('|'))
+                create_and_add_token(TokenType::OR_LOGIC, lexeme_start_line, lexeme_start_col);
+            else
+                create_and_add_token(TokenType::PIPE, lexeme_start_line, lexeme_start_col);
+            break;
+        case '^':
+            create_and_add_token(TokenType::CARET, lexeme_start_line, lexeme_start_col);
+            break;
+        case '~':
+            create_and_add_token(TokenType::TILDE, lexeme_start_line, lexeme_start_col);
+            break;
+        case '<':
+            if (match('<'))
+                create_and_add_token(TokenType::LT_LT, lexeme_start_line, lexeme_start_col);
+            else if (match('='))
+                create_and_add_token(TokenType::LT_EQ, lexeme_start_line, lexeme_start_col);
+            else
+                create_and_add_token(TokenType::LT, lexeme_start_line, lexeme_start_col);
+            break;
+        case '>':
+            if (match('>'))
+                create_and_add_token(TokenType::GT_GT, lexeme_start_line, lexeme_start_col);
+            else if (match('='))
+                create_and_add_token(TokenType::GT_EQ, lexeme_start_line, lexeme_start_col);
+            else
+                create_and_add_token(TokenType::GT, lexeme_start_line, lexeme_start_col);
+            break;
+        case '-':
+            if (match('-'))
+                create_and_add_token(TokenType::MINUS_MINUS, lexeme_start_line, lexeme_start_col);
+            else if (match('='))
+                create_and_add_token(TokenType::MINUS_ASSIGN, lexeme_start_line, lexeme_start_col);
+            else
+                create_and_add_token(TokenType::MINUS, lexeme_start_line, lexeme_start_col);
+            break;
+        case '+':
+            if (match('+'))
+                create_and_add_token(TokenType::PLUS_PLUS, lexeme_start_line, lexeme_start_col);
+            else if (match('='))
+                create_and_add_token(TokenType::PLUS_ASSIGN, lexeme_start_line, lexeme_start_col);
+            else
+                create_and_add_token(TokenType::PLUS, lexeme_start_line, lexeme_start_col);
+            break;
+        case '*':
+            if (match('*'))
+                create_and_add_token(TokenType::STAR_STAR, lexeme_start_line, lexeme_start_col);
+            else if (match('='))
+                create_and_add_token(TokenType::STAR_ASSIGN, lexeme_start_line, lexeme_start_col);
+            else
+                create_and_add_token(TokenType::STAR, lexeme_start_line, lexeme_start_col);
+            break;
+        case '/':
+            if (match('/'))
             {
-            case '(':
-                create_and_add_token(TokenType::LPAREN, lexeme_start_line, lexeme_start_col);
-                break;
-            case ')':
-                create_and_add_token(TokenType::RPAREN, lexeme_start_line, lexeme_start_col);
-                break;
-            case '{':
-                create_and_add_token(TokenType::LBRACE, lexeme_start_line, lexeme_start_col);
-                break;
-            case '}':
-                create_and_add_token(TokenType::RBRACE, lexeme_start_line, lexeme_start_col);
-                break;
-            case '[':
-                create_and_add_token(TokenType::LBRACKET, lexeme_start_line, lexeme_start_col);
-                break;
-            case ']':
-                create_and_add_token(TokenType::RBRACKET, lexeme_start_line, lexeme_start_col);
-                break;
-            case ',':
-                create_and_add_token(TokenType::COMMA, lexeme_start_line, lexeme_start_col);
-                break;
-            case '.':
-                create_and_add_token(TokenType::DOT, lexeme_start_line, lexeme_start_col);
-                break;
-            case ';':
-                create_and_add_token(TokenType::SEMICOLON, lexeme_start_line, lexeme_start_col);
-                break;
-            case ':':
-                create_and_add_token(TokenType::COLON, lexeme_start_line, lexeme_start_col);
-                break;
-            case '%':
-                create_and_add_token(match('=') ? TokenType::PERCENT_ASSIGN : TokenType::PERCENT, lexeme_start_line, lexeme_start_col);
-                break;
-            case '#':
-                create_and_add_token(match('=') ? TokenType::HASH_ASSIGN : TokenType::HASH, lexeme_start_line, lexeme_start_col);
-                break;
-            case '!':
-                create_and_add_token(match('=') ? TokenType::NOT_EQ : TokenType::NOT, lexeme_start_line, lexeme_start_col);
-                break;
-            case '=':
-                create_and_add_token(match('=') ? TokenType::EQ_EQ : TokenType::ASSIGN, lexeme_start_line, lexeme_start_col);
-                break;
-            case '&':
-                if (match('&'))
-                    create_and_add_token(TokenType::AND_LOGIC, lexeme_start_line, lexeme_start_col);
-                else
-                    create_and_add_token(TokenType::AMP, lexeme_start_line, lexeme_start_col);
-                break;
-            case '|':
-                if (match('|'))
-                    create_and_add_token(TokenType::OR_LOGIC, lexeme_start_line, lexeme_start_col);
-                else
-                    create_and_add_token(TokenType::PIPE, lexeme_start_line, lexeme_start_col);
-                break;
-            case '^':
-                create_and_add_token(TokenType::CARET, lexeme_start_line, lexeme_start_col);
-                break;
-            case '~':
-                create_and_add_token(TokenType::TILDE, lexeme_start_line, lexeme_start_col);
-                break;
-            case '<':
-                if (match('<'))
-                    create_and_add_token(TokenType::LT_LT, lexeme_start_line, lexeme_start_col);
-                else if (match('='))
-                    create_and_add_token(TokenType::LT_EQ, lexeme_start_line, lexeme_start_col);
-                else
-                    create_and_add_token(TokenType::LT, lexeme_start_line, lexeme_start_col);
-                break;
-            case '>':
-                if (match('>'))
-                    create_and_add_token(TokenType::GT_GT, lexeme_start_line, lexeme_start_col);
-                else if (match('='))
-                    create_and_add_token(TokenType::GT_EQ, lexeme_start_line, lexeme_start_col);
-                else
-                    create_and_add_token(TokenType::GT, lexeme_start_line, lexeme_start_col);
-                break;
-            case '-':
-                if (match('-'))
-                    create_and_add_token(TokenType::MINUS_MINUS, lexeme_start_line, lexeme_start_col);
-                else if (match('='))
-                    create_and_add_token(TokenType::MINUS_ASSIGN, lexeme_start_line, lexeme_start_col);
-                else
-                    create_and_add_token(TokenType::MINUS, lexeme_start_line, lexeme_start_col);
-                break;
-            case '+':
-                if (match('+'))
-                    create_and_add_token(TokenType::PLUS_PLUS, lexeme_start_line, lexeme_start_col);
-                else if (match('='))
-                    create_and_add_token(TokenType::PLUS_ASSIGN, lexeme_start_line, lexeme_start_col);
-                else
-                    create_and_add_token(TokenType::PLUS, lexeme_start_line, lexeme_start_col);
-                break;
-            case '*':
-                if (match('*'))
-                    create_and_add_token(TokenType::STAR_STAR, lexeme_start_line, lexeme_start_col);
-                else if (match('='))
-                    create_and_add_token(TokenType::STAR_ASSIGN, lexeme_start_line, lexeme_start_col);
-                else
-                    create_and_add_token(TokenType::STAR, lexeme_start_line, lexeme_start_col);
-                break;
-            case '/':
-                if (match('/'))
-                {
-                    while (peek() != '\n' && !is_at_end())
-                        advance();
-                }
-                else if (match('*'))
-                    handle_block_comment(lexeme_start_line, lexeme_start_col);
-                else if (match('='))
-                    create_and_add_token(TokenType::SLASH_ASSIGN, lexeme_start_line, lexeme_start_col);
-                else
-                    create_and_add_token(TokenType::SLASH, lexeme_start_line, lexeme_start_col);
-                break;
-            case ' ':
-            case '\r':
-            case '\t':
-                break;
-            case '\n':
-                m_current_line++;
-                m_current_col_scan = 1;
-                break;
-            case '"':
-            case '\'':
-            case '`':
-                handle_string_literal(c, lexeme_start_line, lexeme_start_col);
-                break;
-            default:
-                if (isdigit(c))
-                    handle_number_literal(lexeme_start_line, lexeme_start_col);
-                else if (isalpha(c) || c == '_')
-                    handle_identifier(lexeme_start_line, lexeme_start_col);
-                else
-                    m_tokens.emplace_back(TokenType::ERROR, std::string(1, c), "Unexpected character.", lexeme_start_line, lexeme_start_col);
-                break;
+                // Comment dòng: nhảy thẳng tới '\n' (memchr đã được tối ưu sẵn)
+                const void *newline = std::memchr(m_source.data() + m_current_pos, '\n', m_source.size() - m_current_pos);
+                skip(newline ? static_cast<const char *>(newline) - (m_source.data() + m_current_pos) : m_source.size() - m_current_pos);
             }
+            else if (match('*'))
+                handle_block_comment(lexeme_start_line, lexeme_start_col);
+            else if (match('='))
+                create_and_add_token(TokenType::SLASH_ASSIGN, lexeme_start_line, lexeme_start_col);
+            else
+                create_and_add_token(TokenType::SLASH, lexeme_start_line, lexeme_start_col);
+            break;
+        case ' ':
+        case '\r':
+        case '\t':
+            while (peek() == ' ' || peek() == '\t') // Thụt lề: bỏ cả dãy trong một lần
+                advance();
+            break;
+        case '\n':
+            m_current_line++;
+            m_current_col_scan = 1;
+            break;
+        case '"':
+        case '\'':
+        case '`':
+            handle_string_literal(c, lexeme_start_line, lexeme_start_col);
+            break;
+        default:
+            if (isdigit(c))
+                handle_number_literal(lexeme_start_line, lexeme_start_col);
+            else if (isalpha(c) || c == '_')
+                handle_identifier(lexeme_start_line, lexeme_start_col);
+            else
+                add_error("Unexpected character.", lexeme_start_line, lexeme_start_col);
+            break;
         }
-        m_current_col_scan = 1;
-        m_tokens.emplace_back(TokenType::END_OF_FILE, "", std::monostate{}, m_current_line, m_current_col_scan);
-        return m_tokens;
     }
 } // namespace Linh
\ No newline at end of file
@@ -2,6 +2,8 @@
 #define LINH_LEXER_HPP
 
 #include <string>
+#include <string_view>
+#include <memory>
 #include <vector>
 #include <variant>
 #include <unordered_map>
@@ -152,35 +154,76 @@ namespace Linh
         std::string to_string() const;
     };
 
+    // Token gọn: chỉ giữ vị trí trong buffer nguồn dùng chung, lexeme chỉ được tạo khi cần
+    struct TokenSpan
+    {
+        TokenType type;
+        uint32_t offset;        // Vị trí lexeme trong buffer nguồn
+        uint32_t length;
+        int line;
+        int column_start;
+        uint32_t literal_index; // 0 = không có literal, còn lại là index trong bảng literal
+    };
+
+    // Kết quả quét: một buffer nguồn bất biến (dùng chung, không chép) + token gọn + bảng literal
+    struct TokenStream
+    {
+        std::shared_ptr<const std::string> source;
+        std::vector<TokenSpan> spans;
+        std::vector<LiteralValue> literals{LiteralValue{}}; // literals[0] luôn là monostate
+
+        std::string_view lexeme_view(size_t index) const
+        {
+            const TokenSpan &span = spans[index];
+            return std::string_view(*source).substr(span.offset, span.length);
+        }
+        std::string lexeme(size_t index) const { return std::string(lexeme_view(index)); }
+        Token token(size_t index) const;
+        std::vector<Token> to_tokens() const; // Tạo Token đầy đủ cho parser
+    };
+
     class Lexer
     {
     public:
         explicit Lexer(std::string source);
+        explicit Lexer(std::shared_ptr<const std::string> source);
         std::vector<Token> scan_tokens();
+        TokenStream scan(); // Quét không chép lexeme
+        // Quét tiếp đến khi có thêm token (kể cả END_OF_FILE) và nối vào out; false khi đã hết
+        bool scan_more(std::vector<Token> &out);
 
     private:
+        // Lexer con cho biểu thức nội suy: quét một đoạn của cùng buffer
+        Lexer(std::shared_ptr<const std::string> buffer, size_t offset, size_t length);
+
+        void scan_token(); // Quét một lexeme bắt đầu tại m_current_pos
         bool is_at_end() const;
         char advance();
         char peek() const;
         char peek_next() const;
         bool match(char expected);
+        void skip(size_t count); // Bỏ qua count byte không chứa '\n' (đã quét bằng SIMD)
 
         void create_and_add_token(TokenType type, int line, int col_start);
-        void create_and_add_token(TokenType type, const LiteralValue &literal_val, int line, int col_start);
+        void create_and_add_token(TokenType type, LiteralValue literal_val, int line, int col_start);
+        void add_error(const std::string &message, int line, int col_start);
 
         void handle_string_literal(char quote_char, int start_line, int start_col);
         void handle_number_literal(int start_line, int start_col);
         void handle_identifier(int start_line, int start_col);
         void handle_block_comment(int start_line, int start_col);
 
-        const std::string m_source;
-        std::vector<Token> m_tokens;
+        std::shared_ptr<const std::string> m_buffer;
+        std::string_view m_source; // Đoạn đang quét trong m_buffer
+        size_t m_base = 0;         // Vị trí của m_source trong m_buffer
+        TokenStream m_stream;
         size_t m_start_lexeme = 0;
         size_t m_current_pos = 0;
         int m_current_line = 1;
         int m_current_col_scan = 1;
+        bool m_finished = false; // scan_more đã phát END_OF_FILE
 
-        static const std::unordered_map<std::string, TokenType> s_keywords;
+        static TokenType keyword_type(std::string_view text);
     };
 
 } // namespace Linh
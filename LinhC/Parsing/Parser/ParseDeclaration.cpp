@@ -13,7 +13,7 @@ namespace Linh
             return std::unique_ptr<AST::Expr>(new AST::UninitLiteralExpr(uninit_token));
         }
 
-        if (const AST::BaseTypeNode *base_type = dynamic_cast<const AST::BaseTypeNode *>(type_node))
+        if (const AST::BaseTypeNode *base_type = AST::node_cast<AST::BaseTypeNode>(type_node))
         {
             switch (base_type->type_keyword_token.type)
             {
@@ -62,29 +62,29 @@ namespace Linh
             }
             }
         }
-        else if (dynamic_cast<const AST::SizedIntegerTypeNode *>(type_node))
+        else if (AST::node_cast<AST::SizedIntegerTypeNode>(type_node))
         {
             Token zero_int_token(TokenType::INT, "0", static_cast<int64_t>(0), reference_token_for_pos.line, reference_token_for_pos.column_start);
             return std::unique_ptr<AST::Expr>(new AST::LiteralExpr(zero_int_token.literal));
         }
-        else if (dynamic_cast<const AST::SizedFloatTypeNode *>(type_node))
+        else if (AST::node_cast<AST::SizedFloatTypeNode>(type_node))
         {
             Token zero_float_token(TokenType::FLOAT_NUM, "0.0", 0.0, reference_token_for_pos.line, reference_token_for_pos.column_start);
             return std::unique_ptr<AST::Expr>(new AST::LiteralExpr(zero_float_token.literal));
         }
-        else if (dynamic_cast<const AST::MapTypeNode *>(type_node))
+        else if (AST::node_cast<AST::MapTypeNode>(type_node))
         {
             Token l_brace(TokenType::LBRACE, "{", std::monostate{}, reference_token_for_pos.line, reference_token_for_pos.column_start);
             Token r_brace(TokenType::RBRACE, "}", std::monostate{}, reference_token_for_pos.line, reference_token_for_pos.column_start);
             return std::unique_ptr<AST::Expr>(new AST::MapLiteralExpr(l_brace, std::vector<AST::MapEntryNode>{}, r_brace));
         }
-        else if (dynamic_cast<const AST::ArrayTypeNode *>(type_node))
+        else if (AST::node_cast<AST::ArrayTypeNode>(type_node))
         {
             Token l_bracket(TokenType::LBRACKET, "[", std::monostate{}, reference_token_for_pos.line, reference_token_for_pos.column_start);
             Token r_bracket(TokenType::RBRACKET, "]", std::monostate{}, reference_token_for_pos.line, reference_token_for_pos.column_start);
             return std::unique_ptr<AST::Expr>(new AST::ArrayLiteralExpr(l_bracket, std::vector<AST::ExprPtr>{}, r_bracket));
         }
-        else if (const AST::UnionTypeNode *union_type = dynamic_cast<const AST::UnionTypeNode *>(type_node))
+        else if (const AST::UnionTypeNode *union_type = AST::node_cast<AST::UnionTypeNode>(type_node))
         {
             if (!union_type->types.empty() && union_type->types[0] != nullptr)
             {
@@ -126,7 +126,7 @@ namespace Linh
             if (declared_type_node_opt.has_value() && declared_type_node_opt.value() != nullptr)
             {
                 const AST::TypeNode *actual_type_node = declared_type_node_opt.value().get();
-                if (const AST::BaseTypeNode *base_type = dynamic_cast<const AST::BaseTypeNode *>(actual_type_node))
+                if (const AST::BaseTypeNode *base_type = AST::node_cast<AST::BaseTypeNode>(actual_type_node))
                 {
                     if (base_type->type_keyword_token.type == TokenType::VOID_KW)
                     {
@@ -166,7 +166,7 @@ namespace Linh
                 if (declared_type_node_opt.has_value())
                 {
                     const AST::TypeNode *type_node_ptr = declared_type_node_opt.value().get();
-                    if (const AST::BaseTypeNode *base_type = dynamic_cast<const AST::BaseTypeNode *>(type_node_ptr))
+                    if (const AST::BaseTypeNode *base_type = AST::node_cast<AST::BaseTypeNode>(type_node_ptr))
                     {
                         if (base_type->type_keyword_token.type == TokenType::SOL_KW)
                         {
@@ -185,7 +185,7 @@ namespace Linh
         if ((keyword_token.type == TokenType::VAS_KW || keyword_token.type == TokenType::CONST_KW) &&
             !declared_type_node_opt.has_value() && initializer_expr)
         {
-            if (AST::UninitLiteralExpr *uninit_init = dynamic_cast<AST::UninitLiteralExpr *>(initializer_expr.get()))
+            if (AST::UninitLiteralExpr *uninit_init = AST::node_cast<AST::UninitLiteralExpr>(initializer_expr.get()))
             {
                 // Bỏ báo lỗi, cho phép vas/const = uninit mà không cần kiểu
                 // Token error_token = uninit_init->keyword;
@@ -248,7 +248,7 @@ namespace Linh
                     param_type_node = parse_type();
                     if (param_type_node.has_value() && param_type_node.value())
                     {
-                        if (const AST::BaseTypeNode *base_param_type = dynamic_cast<const AST::BaseTypeNode *>(param_type_node.value().get()))
+                        if (const AST::BaseTypeNode *base_param_type = AST::node_cast<AST::BaseTypeNode>(param_type_node.value().get()))
                         {
                             if (base_param_type->type_keyword_token.type == TokenType::VOID_KW)
                             {
@@ -268,7 +268,7 @@ namespace Linh
             return_type_node = parse_type();
             if (return_type_node.has_value() && return_type_node.value())
             {
-                if (const AST::BaseTypeNode *base_ret_type = dynamic_cast<const AST::BaseTypeNode *>(return_type_node.value().get()))
+                if (const AST::BaseTypeNode *base_ret_type = AST::node_cast<AST::BaseTypeNode>(return_type_node.value().get()))
                 {
                     // Cho phép func trả về uninit như một kiểu dữ liệu nguyên thủy
                     // if (base_ret_type->type_keyword_token.type == TokenType::SOL_KW)
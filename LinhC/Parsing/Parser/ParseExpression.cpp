@@ -17,23 +17,66 @@ namespace Linh
         return assignment();
     }
 
-    // --- Bitwise precedence: | ^ & << >> ---
-    // Correct precedence order:
-    // logical_or (lowest)
-    //   -> logical_and
-    //     -> bitwise_or (|)
-    //       -> bitwise_xor (^)
-    //         -> bitwise_and (&)
-    //           -> bitwise_shift (<<, >>)
-    //             -> comparison
-    //               -> term (+, -)
-    //                 -> factor (*, /, %, #)
-    //                   -> exponentiation (**)
-    //                     -> unary
+    // --- Toán tử hai ngôi: Pratt, tra bảng độ ưu tiên theo TokenType ---
+    // Thứ tự từ thấp đến cao (giữ đúng cây AST của chuỗi logical_or -> ... -> exponentiation cũ):
+    //   1. || or          (LogicalExpr)
+    //   2. && and         (LogicalExpr)
+    //   3. == !=
+    //   4. > >= < <= is
+    //   5. + -
+    //   6. * / % #
+    //   7. **             (kết hợp phải)
+    //   -> unary
+    // Toán tử bitwise (| ^ & << >>) chưa có trong cú pháp biểu thức, giống như trước.
+    namespace
+    {
+        struct BinaryRule
+        {
+            int precedence; // 0: không phải toán tử hai ngôi
+            bool right_assoc;
+            bool logical;
+        };
+
+        constexpr int LOWEST_BINARY_PRECEDENCE = 1;
+
+        BinaryRule binary_rule(TokenType type)
+        {
+            switch (type)
+            {
+            case TokenType::OR_LOGIC:
+            case TokenType::OR_KW:
+                return {1, false, true};
+            case TokenType::AND_LOGIC:
+            case TokenType::AND_KW:
+                return {2, false, true};
+            case TokenType::EQ_EQ:
+            case TokenType::NOT_EQ:
+                return {3, false, false};
+            case TokenType::GT:
+            case TokenType::GT_EQ:
+            case TokenType::LT:
+            case TokenType::LT_EQ:
+            case TokenType::IS_KW:
+                return {4, false, false};
+            case TokenType::MINUS:
+            case TokenType::PLUS:
+                return {5, false, false};
+            case TokenType::SLASH:
+            case TokenType::STAR:
+            case TokenType::PERCENT:
+            case TokenType::HASH:
+                return {6, false, false};
+            case TokenType::STAR_STAR:
+                return {7, true, false};
+            default:
+                return {0, false, false};
+            }
+        }
+    }
 
     AST::ExprPtr Parser::assignment()
     {
-        AST::ExprPtr expr = logical_or(); // Parse vế trái tiềm năng
+        AST::ExprPtr expr = binary_expression(LOWEST_BINARY_PRECEDENCE); // Parse vế trái tiềm năng
 
         // Kiểm tra các toán tử gán
         if (match({TokenType::ASSIGN, TokenType::PLUS_ASSIGN, TokenType::MINUS_ASSIGN,
@@ -44,7 +87,7 @@ namespace Linh
             AST::ExprPtr value = assignment();  // Parse vế phải (đệ quy, cho phép a = b = c)
 
             // Kiểm tra xem vế trái có phải là một lvalue hợp lệ không
-            if (AST::IdentifierExpr *identifier_lvalue = dynamic_cast<AST::IdentifierExpr *>(expr.get()))
+            if (AST::IdentifierExpr *identifier_lvalue = AST::node_cast<AST::IdentifierExpr>(expr.get()))
             {
                 // --- Allow assignment to any identifier (semantic will check declaration) ---
                 if (equals_op_token.type == TokenType::ASSIGN)
@@ -102,141 +145,22 @@ namespace Linh
         return expr; // Nếu không có toán tử gán, trả về biểu thức đã parse (vế trái)
     }
 
-    AST::ExprPtr Parser::logical_or()
-    {
-        // logical_and ( ( '||' | 'or' ) logical_and )*
-        AST::ExprPtr expr = logical_and();
-        while (match({TokenType::OR_LOGIC, TokenType::OR_KW}))
-        {
-            Token op = previous();
-            AST::ExprPtr right = logical_and();
-            expr = std::make_unique<AST::LogicalExpr>(std::move(expr), op, std::move(right));
-        }
-        return expr;
-    }
-
-    AST::ExprPtr Parser::logical_and()
-    {
-        // equality ( ( '&&' | 'and' ) equality )*
-        AST::ExprPtr expr = equality();
-        while (match({TokenType::AND_LOGIC, TokenType::AND_KW}))
-        {
-            Token op = previous();
-            AST::ExprPtr right = equality();
-            expr = std::make_unique<AST::LogicalExpr>(std::move(expr), op, std::move(right));
-        }
-        return expr;
-    }
-
-    AST::ExprPtr Parser::equality()
+    AST::ExprPtr Parser::binary_expression(int min_precedence)
     {
-        // comparison ( ( '==' | '!=' ) comparison )*
-        AST::ExprPtr expr = comparison();
-        while (match({TokenType::EQ_EQ, TokenType::NOT_EQ}))
-        {
-            Token op = previous();
-            AST::ExprPtr right = comparison();
-            expr = std::make_unique<AST::BinaryExpr>(std::move(expr), op, std::move(right));
-        }
-        return expr;
-    }
-
-    AST::ExprPtr Parser::bitwise_or()
-    {
-        AST::ExprPtr expr = bitwise_xor();
-        while (match({TokenType::PIPE}))
-        {
-            Token op = previous();
-            AST::ExprPtr right = bitwise_xor();
-            expr = std::make_unique<AST::BinaryExpr>(std::move(expr), op, std::move(right));
-        }
-        return expr;
-    }
-    AST::ExprPtr Parser::bitwise_xor()
-    {
-        AST::ExprPtr expr = bitwise_and();
-        while (match({TokenType::CARET}))
-        {
-            Token op = previous();
-            AST::ExprPtr right = bitwise_and();
-            expr = std::make_unique<AST::BinaryExpr>(std::move(expr), op, std::move(right));
-        }
-        return expr;
-    }
-    AST::ExprPtr Parser::bitwise_and()
-    {
-        AST::ExprPtr expr = bitwise_shift();
-        while (match({TokenType::AMP}))
-        {
-            Token op = previous();
-            AST::ExprPtr right = bitwise_shift();
-            expr = std::make_unique<AST::BinaryExpr>(std::move(expr), op, std::move(right));
-        }
-        return expr;
-    }
-    AST::ExprPtr Parser::bitwise_shift()
-    {
-        AST::ExprPtr expr = comparison();
-        while (match({TokenType::LT_LT, TokenType::GT_GT}))
-        {
-            Token op = previous();
-            AST::ExprPtr right = comparison();
-            expr = std::make_unique<AST::BinaryExpr>(std::move(expr), op, std::move(right));
-        }
-        return expr;
-    }
-
-    AST::ExprPtr Parser::comparison()
-    {
-        // term ( ( '>' | '>=' | '<' | '<=' | 'is' ) term )*
-        AST::ExprPtr expr = term();
-        while (match({TokenType::GT, TokenType::GT_EQ, TokenType::LT, TokenType::LT_EQ, TokenType::IS_KW}))
-        {
-            Token op = previous();
-            AST::ExprPtr right = term();
-            expr = std::make_unique<AST::BinaryExpr>(std::move(expr), op, std::move(right));
-        }
-        return expr;
-    }
-
-    AST::ExprPtr Parser::term()
-    {
-        // factor ( ( '-' | '+' ) factor )*
-        AST::ExprPtr expr = factor();
-        while (match({TokenType::MINUS, TokenType::PLUS}))
-        {
-            Token op = previous();
-            AST::ExprPtr right = factor();
-            expr = std::make_unique<AST::BinaryExpr>(std::move(expr), op, std::move(right));
-        }
-        return expr;
-    }
-
-    AST::ExprPtr Parser::factor()
-    {
-        // exponentiation ( ( '/' | '*' | '%' | '#' ) exponentiation )*
-        AST::ExprPtr expr = exponentiation();
-        while (match({TokenType::SLASH, TokenType::STAR, TokenType::PERCENT, TokenType::HASH}))
-        {
-            Token op = previous();
-            AST::ExprPtr right = exponentiation();
-            expr = std::make_unique<AST::BinaryExpr>(std::move(expr), op, std::move(right));
-        }
-        return expr;
-    }
-
-    AST::ExprPtr Parser::exponentiation()
-    {
-        // unary ( '**' unary )?  -- Để right-associative, cần đệ quy bên phải
-        // HOẶC unary ( '**' exponentiation )?
-        // Hiện tại: unary ('**' unary) -- sẽ là left-associative nếu dùng vòng lặp
-        // -> Sửa để hỗ trợ right-associativity cho '**'
+        // unary ( OP binary_expression(prec + 1 | prec nếu kết hợp phải) )*
+        // Toán tử cùng mức kết hợp trái được gom trong vòng lặp nên chuỗi dài không làm sâu đệ quy.
         AST::ExprPtr expr = unary();
-        if (match({TokenType::STAR_STAR}))
+        while (!is_at_end())
         {
-            Token op = previous();
-            AST::ExprPtr right = exponentiation();
-            expr = std::make_unique<AST::BinaryExpr>(std::move(expr), op, std::move(right));
+            const BinaryRule rule = binary_rule(m_tokens[m_current].type);
+            if (rule.precedence < min_precedence || rule.precedence == 0)
+                break;
+            Token op = advance();
+            AST::ExprPtr right = binary_expression(rule.right_assoc ? rule.precedence : rule.precedence + 1);
+            if (rule.logical)
+                expr = std::make_unique<AST::LogicalExpr>(std::move(expr), op, std::move(right));
+            else
+                expr = std::make_unique<AST::BinaryExpr>(std::move(expr), op, std::move(right));
         }
         return expr;
     }
@@ -256,13 +180,13 @@ namespace Linh
         {
             Token keyword_new = previous();
             AST::ExprPtr class_constructor_expr = call_or_member_access();
-            if (dynamic_cast<AST::IdentifierExpr *>(class_constructor_expr.get()) &&
-                !dynamic_cast<AST::CallExpr *>(class_constructor_expr.get()))
+            if (AST::node_cast<AST::IdentifierExpr>(class_constructor_expr.get()) &&
+                !AST::node_cast<AST::CallExpr>(class_constructor_expr.get()))
             {
                 Token dummy_rparen(TokenType::RPAREN, ")", std::monostate{}, keyword_new.line, keyword_new.column_start + 1);
                 class_constructor_expr = std::unique_ptr<AST::Expr>(new AST::CallExpr(std::move(class_constructor_expr), dummy_rparen, std::vector<AST::ExprPtr>{}));
             }
-            else if (!dynamic_cast<AST::CallExpr *>(class_constructor_expr.get()))
+            else if (!AST::node_cast<AST::CallExpr>(class_constructor_expr.get()))
             {
                 throw error(previous(), "Mong đợi một lời gọi constructor (ví dụ: MyClass() hoặc MyClass) sau 'new'.");
             }
@@ -482,7 +406,7 @@ namespace Linh
             {
                 is_likely_map = true;
             }
-            else if (m_current + 2 < m_tokens.size())
+            else if (has_token(m_current + 2))
             {
                 is_likely_map = true;
             }
@@ -612,6 +536,7 @@ namespace Linh
         if (match({TokenType::COLON})) {
             return_type = parse_type();
         }
+        consume(TokenType::LBRACE, "Thiếu '{' trước thân anonymous function.");
         std::unique_ptr<AST::BlockStmt> body = block();
         return std::make_unique<AST::FunctionExpr>(func_kw, std::move(params), std::move(return_type), std::move(body));
     }
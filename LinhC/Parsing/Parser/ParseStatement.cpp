@@ -162,7 +162,15 @@ namespace Linh
     AST::StmtPtr Parser::for_statement()
     {
         Token keyword_for = previous(); // FOR_KW
+
+        // for x in ... / for var x in ... (không có ngoặc)
+        if (check(TokenType::IDENTIFIER) || check(TokenType::VAR_KW))
+            return for_in_statement(keyword_for, false);
         consume(TokenType::LPAREN, "Thiếu '(' sau 'for'.");
+        // for (x in ...) / for (var x in ...)
+        if ((check(TokenType::IDENTIFIER) && is_in_keyword(m_current + 1)) ||
+            (check(TokenType::VAR_KW) && is_in_keyword(m_current + 2)))
+            return for_in_statement(keyword_for, true);
 
         AST::StmtPtr initializer_stmt = nullptr;
         if (check(TokenType::SEMICOLON))
@@ -211,7 +219,7 @@ namespace Linh
         if (increment_expr)
         {
             auto increment_as_stmt = std::unique_ptr<AST::Stmt>(new AST::ExpressionStmt(std::move(increment_expr)));
-            if (AST::BlockStmt *body_as_block = dynamic_cast<AST::BlockStmt *>(body_stmt.get()))
+            if (AST::BlockStmt *body_as_block = AST::node_cast<AST::BlockStmt>(body_stmt.get()))
             {
                 body_as_block->statements.push_back(std::move(increment_as_stmt));
             }
@@ -242,6 +250,21 @@ namespace Linh
         }
     }
 
+    AST::StmtPtr Parser::for_in_statement(Token keyword_for, bool has_paren)
+    {
+        // 'var' trước tên biến lặp là tùy chọn, biến lặp luôn là biến mới của vòng lặp
+        match({TokenType::VAR_KW});
+        Token var_name = consume(TokenType::IDENTIFIER, "Thiếu tên biến lặp sau 'for'.");
+        if (!is_in_keyword(m_current))
+            throw error(peek(), "Thiếu 'in' sau tên biến lặp.");
+        advance(); // 'in'
+        AST::ExprPtr iterable = expression();
+        if (has_paren)
+            consume(TokenType::RPAREN, "Thiếu ')' sau mệnh đề for.");
+        AST::StmtPtr body = statement(); // Body có thể là block hoặc câu lệnh đơn
+        return std::make_unique<AST::ForInStmt>(std::move(keyword_for), std::move(var_name), std::move(iterable), std::move(body));
+    }
+
     AST::StmtPtr Parser::switch_statement()
     {
         Token keyword_switch = previous(); // SWITCH_KW
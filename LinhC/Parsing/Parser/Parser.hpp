@@ -15,7 +15,13 @@ namespace Linh
     {
     public:
         explicit Parser(const std::vector<Token> &tokens);
+        // Parser lấy token dần từ lexer: chỉ giữ token của khai báo đang parse (dùng với parse_declaration)
+        explicit Parser(Lexer &lexer);
         AST::StmtList parse();
+        // Parse từng khai báo cấp cao nhất một (biên dịch kiểu streaming): gọi tới khi done().
+        // Trả về nullptr nếu khai báo này lỗi cú pháp (đã báo lỗi và synchronize).
+        AST::StmtPtr parse_declaration();
+        bool done() const { return is_at_end(); }
         bool had_error() const { return m_had_error; }
 
         class ParseError : public std::runtime_error
@@ -35,6 +41,10 @@ namespace Linh
         bool is_at_end() const;
         bool check(TokenType type) const;
         bool check_next(TokenType type) const;
+        bool has_token(size_t index) const; // Có token tại index (lexer lười sẽ quét thêm nếu cần)
+        bool is_in_keyword(size_t index) const; // 'in' chỉ là từ khoá trong đầu vòng for, ngoài đó là tên thường
+        void fill(size_t index) const;      // Chế độ lexer: quét đến khi có token tại index hoặc hết file
+        void release_consumed();            // Chế độ lexer: bỏ token đã parse, giữ lại previous()
         bool match(const std::vector<TokenType> &types);
         Token consume(TokenType type, const std::string &error_message);
         ParseError error(const Token &token, const std::string &message);
@@ -51,13 +61,7 @@ namespace Linh
         // --- Expression Parsing ---
         AST::ExprPtr expression();
         AST::ExprPtr assignment();
-        AST::ExprPtr logical_or();
-        AST::ExprPtr logical_and();
-        AST::ExprPtr equality();
-        AST::ExprPtr comparison();
-        AST::ExprPtr term();
-        AST::ExprPtr factor();
-        AST::ExprPtr exponentiation();
+        AST::ExprPtr binary_expression(int min_precedence); // Pratt: mọi toán tử hai ngôi có mức >= min_precedence
         AST::ExprPtr unary();
         AST::ExprPtr call_or_member_access();
         AST::ExprPtr primary();
@@ -67,12 +71,6 @@ namespace Linh
         AST::ExprPtr parse_interpolated_string(const Token &first_str_token);
         AST::ExprPtr parse_function_expression();
 
-        // --- Bitwise precedence ---
-        AST::ExprPtr bitwise_or();
-        AST::ExprPtr bitwise_xor();
-        AST::ExprPtr bitwise_and();
-        AST::ExprPtr bitwise_shift();
-
         // --- Declaration and Statement Parsing ---
         AST::StmtPtr declaration();
         AST::StmtPtr var_declaration(Token keyword_token);
@@ -83,6 +81,7 @@ namespace Linh
         AST::StmtPtr if_statement();
         AST::StmtPtr while_statement();
         AST::StmtPtr for_statement();
+        AST::StmtPtr for_in_statement(Token keyword_for, bool has_paren); // for x in ...
         AST::StmtPtr switch_statement();
         AST::StmtPtr return_statement();
         AST::StmtPtr break_statement();
@@ -94,6 +93,8 @@ namespace Linh
         std::unique_ptr<AST::BlockStmt> block();
         AST::StmtPtr expression_statement();
 
+        mutable std::vector<Token> m_owned; // Cửa sổ token khi parse bằng lexer (phải khai báo trước m_tokens)
+        Lexer *m_lexer = nullptr;
         const std::vector<Token> &m_tokens;
         size_t m_current = 0;
         bool m_had_error = false;
@@ -41,7 +41,40 @@ namespace Linh
         }
     }
 
+    Parser::Parser(Lexer &lexer) : m_lexer(&lexer), m_tokens(m_owned), m_current(0), m_had_error(false)
+    {
+#ifdef _DEBUG
+        std::cout << "PARSER_INIT: Parser initialized with a streaming lexer.\n";
+#endif
+    }
+
     // --- Utility Methods ---
+    void Parser::fill(size_t index) const
+    {
+        while (m_lexer && m_owned.size() <= index && m_lexer->scan_more(m_owned))
+        {
+        }
+    }
+
+    bool Parser::has_token(size_t index) const
+    {
+        fill(index);
+        return index < m_tokens.size();
+    }
+
+    bool Parser::is_in_keyword(size_t index) const
+    {
+        return has_token(index) && m_tokens[index].type == TokenType::IDENTIFIER && m_tokens[index].lexeme == "in";
+    }
+
+    void Parser::release_consumed()
+    {
+        if (!m_lexer || m_current <= 1)
+            return;
+        m_owned.erase(m_owned.begin(), m_owned.begin() + static_cast<std::ptrdiff_t>(m_current - 1));
+        m_current = 1;
+    }
+
     Token Parser::previous() const
     {
         if (m_current == 0)
@@ -56,6 +89,7 @@ namespace Linh
 
     Token Parser::peek() const
     {
+        fill(m_current);
         if (m_tokens.empty())
         {
             // std::cerr << "PARSER_UTIL_ERROR: peek() called on empty token list." << std::endl;
@@ -74,6 +108,7 @@ namespace Linh
 
     Token Parser::peek_next() const
     {
+        fill(m_current + 1);
         if (m_tokens.empty())
         {
             // std::cerr << "PARSER_UTIL_ERROR: peek_next() called on empty token list." << std::endl;
@@ -99,6 +134,7 @@ namespace Linh
 
     bool Parser::is_at_end() const
     {
+        fill(m_current);
         if (m_tokens.empty())
             return true;
         // Parser dừng khi token hiện tại là END_OF_FILE.
@@ -110,12 +146,12 @@ namespace Linh
         // Sửa: Nếu đã ở cuối file, chỉ trả về true nếu type là END_OF_FILE
         if (is_at_end())
             return type == TokenType::END_OF_FILE;
-        return peek().type == type;
+        return m_tokens[m_current].type == type; // Không chép Token như peek()
     }
 
     bool Parser::check_next(TokenType type) const
     {
-        if (is_at_end() || m_tokens[m_current + 1].type == TokenType::END_OF_FILE)
+        if (is_at_end() || !has_token(m_current + 1) || m_tokens[m_current + 1].type == TokenType::END_OF_FILE)
             return false;
         // peek_next() đã xử lý trường hợp m_current + 1 >= m_tokens.size()
         return peek_next().type == type;
@@ -205,40 +241,36 @@ namespace Linh
     // --- Main Parse Method ---
     AST::StmtList Parser::parse()
     {
-        // std::cout << "PARSER_MAIN: Bắt đầu parse()." << std::endl;
         AST::StmtList statements;
-        // m_had_error đã được khởi tạo là false trong constructor
-
         while (!is_at_end())
         {
-            // std::cout << "PARSER_MAIN: Vòng lặp chính, peek() = " << debug_token_info(peek()) << std::endl;
-            try
-            {
-                statements.push_back(declaration()); // declaration() là điểm bắt đầu cho mỗi câu lệnh/khai báo cấp cao nhất
-                // if (m_had_error) { // Nếu declaration() ném lỗi và được bắt bởi synchronize nội bộ (nếu có)
-                //    std::cout << "PARSER_MAIN: Lỗi đã xảy ra trong declaration, đã synchronize, tiếp tục." << std::endl;
-                // } else {
-                //    std::cout << "PARSER_MAIN: Đã thêm một declaration/statement vào AST. Tổng số hiện tại: " << statements.size() << std::endl;
-                // }
-            }
-            catch (const ParseError &) // ParseError đã được log và m_had_error đã được set bởi error()
-            {
-                // std::cout << "PARSER_MAIN: Bắt được ParseError từ declaration/statement. Gọi synchronize." << std::endl;
-                synchronize(); // Cố gắng phục hồi để parse các câu lệnh tiếp theo
-            }
-            catch (const std::exception &e_std) // Bắt các lỗi runtime không mong muốn khác từ logic Parser
-            {
-                std::cerr << "Lỗi hệ thống không mong muốn trong quá trình parse: " << e_std.what() << std::endl;
-                m_had_error = true; // Đảm bảo set cờ lỗi
-                if (!is_at_end())
-                { // Chỉ synchronize nếu chưa ở cuối
-                    // std::cout << "PARSER_MAIN: Bắt được std::exception. Gọi synchronize." << std::endl;
-                    synchronize();
-                }
-            }
+            if (AST::StmtPtr stmt = parse_declaration())
+                statements.push_back(std::move(stmt));
         }
-        // std::cout << "PARSER_MAIN: Kết thúc parse(). Tổng số câu lệnh AST: " << statements.size() << ". Trạng thái lỗi: " << (m_had_error ? "CÓ LỖI" : "KHÔNG CÓ LỖI") << std::endl;
         return statements;
     }
 
+    AST::StmtPtr Parser::parse_declaration()
+    {
+        release_consumed();
+        try
+        {
+            return declaration(); // declaration() là điểm bắt đầu cho mỗi câu lệnh/khai báo cấp cao nhất
+        }
+        catch (const ParseError &) // ParseError đã được log và m_had_error đã được set bởi error()
+        {
+            synchronize(); // Cố gắng phục hồi để parse các câu lệnh tiếp theo
+        }
+        catch (const std::exception &e_std) // Bắt các lỗi runtime không mong muốn khác từ logic Parser
+        {
+            std::cerr << "Lỗi hệ thống không mong muốn trong quá trình parse: " << e_std.what() << std::endl;
+            m_had_error = true; // Đảm bảo set cờ lỗi
+            if (!is_at_end())
+            { // Chỉ synchronize nếu chưa ở cuối
+                synchronize();
+            }
+        }
+        return nullptr;
+    }
+
 } // namespace Linh
\ No newline at end of file
@@ -5,51 +5,11 @@
 #include <unordered_set>                      // <--- add this line
 #include "../Parser/Parser.hpp"               // thêm dòng này
 #include "../../Bytecode/BytecodeEmitter.hpp" // Thêm dòng này để dùng BytecodeEmitter
+#include <algorithm>
 #include <chrono>
+#include <mutex>
 #include <sstream>
 
-// === Helper: kiểm tra subtype giữa hai type string (hỗ trợ array/map) ===
-static bool is_subtype_type_string(const std::string& sub, const std::string& super) {
-    if (sub == super) return true;
-    if (super == "any") return true;
-    // array<any> là supertype của mọi array
-    if (super == "array<any>" && sub.find("array<") == 0) return true;
-    // map<any,any> là supertype của mọi map
-    if (super == "map<any,any>" && sub.find("map<") == 0) return true;
-    // array<T>
-    if (sub.find("array<") == 0 && super.find("array<") == 0) {
-        auto get_inner = [](const std::string& s) -> std::string {
-            size_t l = s.find('<');
-            size_t r = s.rfind('>');
-            if (l == std::string::npos || r == std::string::npos || r <= l+1) return "any";
-            return s.substr(l+1, r-l-1);
-        };
-        return is_subtype_type_string(get_inner(sub), get_inner(super));
-    }
-    // map<K,V>
-    if (sub.find("map<") == 0 && super.find("map<") == 0) {
-        auto get_inner = [](const std::string& s) -> std::pair<std::string,std::string> {
-            size_t l = s.find('<');
-            size_t r = s.rfind('>');
-            if (l == std::string::npos || r == std::string::npos || r <= l+1) return {"any","any"};
-            std::string inside = s.substr(l+1, r-l-1);
-            size_t comma = inside.find(',');
-            if (comma == std::string::npos) return {inside, "any"};
-            std::string k = inside.substr(0, comma);
-            std::string v = inside.substr(comma+1);
-            // Trim
-            k.erase(0, k.find_first_not_of(" \t\n")); k.erase(k.find_last_not_of(" \t\n")+1);
-            v.erase(0, v.find_first_not_of(" \t\n")); v.erase(v.find_last_not_of(" \t\n")+1);
-            return {k, v};
-        };
-        auto [k1, v1] = get_inner(sub);
-        auto [k2, v2] = get_inner(super);
-        return is_subtype_type_string(k1, k2) && is_subtype_type_string(v1, v2);
-    }
-    // Có thể mở rộng cho union/option/tuple nếu cần
-    return false;
-}
-
 // Đặt helper vào đúng namespace và dùng Linh::ErrorStage::Semantic
 void push_semantic_error(std::vector<Linh::Error>& errors, int line, int col, const std::string& message) {
     std::ostringstream oss;
@@ -70,66 +30,37 @@ namespace Linh
         void SemanticAnalyzer::analyze(const AST::StmtList &stmts, bool reset_state)
         {
             auto start_time = std::chrono::high_resolution_clock::now();
+            expr_types.clear(); // Chỉ giữ kiểu của các câu lệnh vừa phân tích (emitter dùng ngay sau đó)
+            error_cache.clear();
             
             if (reset_state)
             {
-                var_scopes.clear();
-                global_functions.clear();
-                type_cache.clear();
-                error_cache.clear();
-                cache_hits = 0;
-                cache_misses = 0;
-                should_early_exit = false;
-                
-                begin_scope();
-                
+                begin_program();
+
                 if (parallel_analysis_enabled) {
                     // Parallel analysis for large codebases
-                    std::vector<std::future<std::vector<Linh::Error>>> futures;
-                    for (const auto &stmt : stmts) {
-                        if (stmt) {
-                            auto s = stmt.get();
-                            futures.push_back(std::async(std::launch::async, [this, s]() {
-                                std::vector<Linh::Error> local_errors;
-                                SemanticAnalyzer local_analyzer;
-                                local_analyzer.enable_caching(caching_enabled);
-                                local_analyzer.enable_early_exit(early_exit_enabled);
-                                local_analyzer.enable_parallel_analysis(false);
-                                try {
-                                    s->accept(&local_analyzer);
-                                    local_errors = local_analyzer.errors;
-                                } catch (...) {}
-                                return local_errors;
-                            }));
-                        }
-                    }
-                    
-                    // Collect results
-                    for (auto& future : futures) {
-                        auto local_errors = future.get();
-                        errors.insert(errors.end(), local_errors.begin(), local_errors.end());
-                    }
+                    analyze_parallel(stmts);
                 } else {
                     // Sequential analysis
                     for (const auto &stmt : stmts)
                     {
                         if (stmt && !should_early_exit)
-                            stmt->accept(this);
+                            visit(stmt);
                     }
                 }
-                end_scope();
+                end_program();
             }
             else
             {
                 // REPL mode: giữ lại scope toàn cục, không pop/push scope
-                if (var_scopes.empty())
+                if (!symbols.has_scope())
                 {
                     begin_scope(); // Đảm bảo luôn có scope ngoài cùng
                 }
                 for (const auto &stmt : stmts)
                 {
                     if (stmt && !should_early_exit)
-                        stmt->accept(this);
+                        visit(stmt);
                 }
             }
             
@@ -137,124 +68,247 @@ namespace Linh
             analysis_time_ms = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time).count();
         }
 
-        // Helper methods for optimization
-        std::string SemanticAnalyzer::get_expression_hash(AST::Expr* expr) {
-            if (!expr) return "null";
-            
-            std::ostringstream oss;
-            oss << expr;
-            
-            return oss.str();
+        void SemanticAnalyzer::begin_program()
+        {
+            symbols.reset_program();
+            error_cache.clear();
+            cache_hits = 0;
+            cache_misses = 0;
+            should_early_exit = false;
+
+            begin_scope();
         }
-        
-        std::string SemanticAnalyzer::get_error_key(const AST::Stmt* stmt, const std::string& error_type) {
-            if (!stmt) return "null:" + error_type;
-            std::ostringstream oss;
-            oss << stmt << ":" << error_type;
-            return oss.str();
+
+        void SemanticAnalyzer::analyze_statement(AST::Stmt *stmt)
+        {
+            expr_types.clear();
+            error_cache.clear();
+            if (stmt && !should_early_exit)
+                visit(stmt);
         }
-        std::string SemanticAnalyzer::get_error_key(const AST::Expr* expr, const std::string& error_type) {
-            if (!expr) return "null:" + error_type;
-            std::ostringstream oss;
-            oss << expr << ":" << error_type;
-            return oss.str();
+
+        void SemanticAnalyzer::end_program()
+        {
+            end_scope();
         }
-        bool SemanticAnalyzer::check_cached_error(const AST::Stmt* stmt, const std::string& error_type) {
-            if (!caching_enabled) return false;
-            std::string key = get_error_key(stmt, error_type);
-            auto it = error_cache.find(key);
-            if (it != error_cache.end()) { cache_hits++; return it->second; }
+
+        // Helper methods for optimization
+        bool SemanticAnalyzer::check_cached_error(const void *node, CachedCheck check) {
+            if (!caching_enabled || !node) return false;
+            auto it = error_cache.find(node);
+            if (it != error_cache.end() && (it->second & check)) { cache_hits++; return true; }
             cache_misses++;
             return false;
         }
-        bool SemanticAnalyzer::check_cached_error(const AST::Expr* expr, const std::string& error_type) {
-            if (!caching_enabled) return false;
-            std::string key = get_error_key(expr, error_type);
-            auto it = error_cache.find(key);
-            if (it != error_cache.end()) { cache_hits++; return it->second; }
-            cache_misses++;
-            return false;
+        void SemanticAnalyzer::cache_error(const void *node, CachedCheck check) {
+            if (!caching_enabled || !node) return;
+            error_cache[node] |= check;
         }
-        void SemanticAnalyzer::cache_error(const AST::Stmt* stmt, const std::string& error_type) {
-            if (!caching_enabled) return;
-            std::string key = get_error_key(stmt, error_type);
-            error_cache[key] = true;
+
+        // --- Phân tích song song ---
+        // 1. Các module file import ở cấp cao nhất được đọc + parse song song trên pool.
+        // 2. Thread chính đi qua các câu lệnh cấp cao nhất theo thứ tự như tuần tự, riêng khai báo hàm chỉ phân tích
+        //    phần khai báo (tên, tham số); thân hàm để dành.
+        // 3. Thân hàm được phân tích trên pool. Mỗi worker chép bảng symbol sau bước 2 (snapshot chỉ đọc của mọi khai
+        //    báo toàn cục) một lần, và hoàn lại mọi thay đổi của một thân hàm (nhật ký symbol) trước khi sang hàm khác.
+        // 4. Lỗi của thân hàm được chèn ngay sau lỗi của phần khai báo hàm đó: thứ tự lỗi không phụ thuộc lịch chạy.
+        // Khác phân tích tuần tự: thân hàm thấy cả khai báo toàn cục đứng sau nó (hàm gọi lẫn nhau được), và không
+        // thấy loại/kiểu mà thân hàm khác để lại trên cùng một tên.
+        void SemanticAnalyzer::analyze_parallel(const AST::StmtList &stmts)
+        {
+            if (!pool || pool_threads != analysis_threads)
+            {
+                pool = std::make_unique<WorkStealingPool>(analysis_threads);
+                pool_threads = analysis_threads;
+            }
+            preload_modules(stmts);
+
+            struct DeferredBody
+            {
+                AST::FunctionDeclStmt *stmt;
+                size_t error_position; // Số lỗi lúc phần khai báo hàm phân tích xong
+                std::vector<Linh::Error> errors;
+                std::vector<std::pair<AST::ExprId, std::string>> expr_types;
+            };
+            std::vector<DeferredBody> bodies;
+            for (const auto &stmt : stmts)
+            {
+                if (!stmt || should_early_exit)
+                    continue;
+                if (auto function = AST::node_cast<AST::FunctionDeclStmt>(stmt.get()))
+                {
+                    analyze_function_header(function);
+                    bodies.push_back({function, errors.size(), {}, {}});
+                }
+                else
+                {
+                    visit(stmt);
+                }
+            }
+            preloaded_modules.clear(); // Module không được import tới (vd. sau lỗi) thì bỏ
+            if (bodies.empty())
+                return;
+
+            std::vector<std::unique_ptr<SemanticAnalyzer>> contexts(pool->size());
+            std::vector<WorkStealingPool::Task> tasks;
+            tasks.reserve(bodies.size());
+            for (auto &body : bodies)
+            {
+                tasks.push_back([this, &body, &contexts](size_t worker)
+                                {
+                    auto &context = contexts[worker];
+                    if (!context)
+                    {
+                        context = std::make_unique<SemanticAnalyzer>();
+                        context->symbols = symbols; // Chỉ đọc bảng của thread chính (đang chờ run() xong)
+                        context->caching_enabled = caching_enabled;
+                        context->early_exit_enabled = early_exit_enabled;
+                    }
+                    context->errors.clear();
+                    context->expr_types.clear();
+                    context->error_cache.clear();
+                    uint32_t outer_session = context->symbols.begin_touch_log();
+                    context->analyze_function_body(body.stmt);
+                    context->symbols.rollback_touches(0);
+                    context->symbols.end_touch_log(outer_session);
+                    body.errors = std::move(context->errors);
+                    body.expr_types.assign(context->expr_types.begin(), context->expr_types.end()); });
+            }
+            pool->run(tasks);
+
+            std::vector<Linh::Error> merged;
+            size_t next = 0;
+            for (auto &body : bodies)
+            {
+                merged.insert(merged.end(), errors.begin() + next, errors.begin() + body.error_position);
+                next = body.error_position;
+                merged.insert(merged.end(), body.errors.begin(), body.errors.end());
+                for (auto &[id, type] : body.expr_types)
+                    expr_types[id] = std::move(type);
+            }
+            merged.insert(merged.end(), errors.begin() + next, errors.end());
+            errors = std::move(merged);
         }
-        void SemanticAnalyzer::cache_error(const AST::Expr* expr, const std::string& error_type) {
-            if (!caching_enabled) return;
-            std::string key = get_error_key(expr, error_type);
-            error_cache[key] = true;
+
+        std::string SemanticAnalyzer::module_path_of(const std::string &module_name)
+        {
+            std::string module_path = "Li/" + module_name;
+            if (module_path.find(".li") == std::string::npos)
+                module_path += ".li";
+            return module_path;
         }
-        
-        void SemanticAnalyzer::analyze_statement_parallel(AST::Stmt* stmt) {
-            if (!stmt) return;
-            
-            try {
-                stmt->accept(this);
-            } catch (...) {
-                // Handle exceptions in parallel processing
-            }
+
+        SemanticAnalyzer::LoadedModule SemanticAnalyzer::load_module(const std::string &module_path)
+        {
+            LoadedModule module;
+            std::ifstream mod_file(module_path);
+            if (!mod_file)
+                return module;
+            module.opened = true;
+            std::string line, mod_source;
+            while (std::getline(mod_file, line))
+                mod_source += line + "\n";
+            // Lex và parse module
+            Linh::Lexer mod_lexer(mod_source);
+            auto mod_tokens = mod_lexer.scan_tokens();
+            Linh::Parser mod_parser(mod_tokens);
+            module.ast = mod_parser.parse();
+            module.parse_error = mod_parser.had_error();
+            return module;
         }
-        
-        std::vector<Linh::Error> SemanticAnalyzer::merge_errors(const std::vector<std::vector<Linh::Error>>& error_lists) {
-            std::vector<Linh::Error> merged;
-            for (const auto& error_list : error_lists) {
-                merged.insert(merged.end(), error_list.begin(), error_list.end());
+
+        void SemanticAnalyzer::preload_modules(const AST::StmtList &stmts)
+        {
+            std::vector<std::string> paths;
+            for (const auto &stmt : stmts)
+            {
+                auto import = AST::node_cast<AST::ImportStmt>(stmt.get());
+                if (!import || import->module_name.lexeme.empty() || Linh::LiPM::package_exists(import->module_name.lexeme))
+                    continue;
+                std::string path = module_path_of(import->module_name.lexeme);
+                if (std::find(paths.begin(), paths.end(), path) == paths.end())
+                    paths.push_back(path);
             }
-            return merged;
+            if (paths.size() < 2)
+                return; // Một module thì đọc lúc gặp import như tuần tự, không có gì để chạy song song
+
+            std::vector<LoadedModule> loaded(paths.size());
+            std::vector<WorkStealingPool::Task> tasks;
+            tasks.reserve(paths.size());
+            for (size_t i = 0; i < paths.size(); ++i)
+                tasks.push_back([&loaded, &paths, i](size_t) { loaded[i] = load_module(paths[i]); });
+            pool->run(tasks);
+            for (size_t i = 0; i < paths.size(); ++i)
+                preloaded_modules.emplace(paths[i], std::move(loaded[i]));
         }
 
-        void SemanticAnalyzer::begin_scope()
+        void SemanticAnalyzer::begin_scope(bool loop_or_switch)
         {
-            var_scopes.push_back({});
+            symbols.begin_scope(loop_or_switch);
             // Đăng ký built-in function printf (1 tham số)
-            if (global_functions.count("printf") == 0)
+            SymbolId printf_id = symbols.intern("printf");
+            if (!symbols.info(printf_id).is_function)
             {
-                declare_function("printf", 1);
+                declare_function(printf_id, 1);
             }
         }
         void SemanticAnalyzer::end_scope()
         {
-            if (!var_scopes.empty())
-                var_scopes.pop_back();
+            symbols.end_scope();
+        }
+        void SemanticAnalyzer::declare_var(SymbolId id, VarKind kind /*= VarKind::None*/, StaticType type /*= {}*/)
+        {
+            symbols.declare(id);
+            SymbolInfo &info = symbols.info(id);
+            if (kind != VarKind::None)
+                info.kind = kind;
+            if (type.known())
+                info.type = type;
+        }
+        void SemanticAnalyzer::set_var_num_type(SymbolId id, const std::string &type)
+        {
+            symbols.info(id).num_type = type == "int" ? TypeTag::Int : type == "float" ? TypeTag::Float : TypeTag::Unknown;
+        }
+        void SemanticAnalyzer::record_expr_type(const AST::Expr *expr, const std::string &type)
+        {
+            if (expr && !type.empty())
+                expr_types[expr->id] = type;
         }
-        void SemanticAnalyzer::declare_var(const std::string &name, const std::string &kind /*= ""*/, const std::string &type /*= ""*/)
+        std::string SemanticAnalyzer::expr_type_of(const AST::Expr *expr) const
         {
-            if (!var_scopes.empty())
-                var_scopes.back()[name] = true;
-            if (!kind.empty())
-                var_kinds[name] = kind;
-            if (!type.empty())
-                var_types[name] = type;
+            if (!expr)
+                return std::string();
+            auto it = expr_types.find(expr->id);
+            return it != expr_types.end() ? it->second : std::string();
         }
-        bool SemanticAnalyzer::is_var_declared(const std::string &name)
+        bool SemanticAnalyzer::is_var_declared(SymbolId id)
         {
             // Nếu là package đã import, coi như đã khai báo
-            if (imported_packages.count(name) > 0)
-                return true;
-            for (auto it = var_scopes.rbegin(); it != var_scopes.rend(); ++it)
-            {
-                if (it->count(name))
-                    return true;
-            }
-            return false;
+            return symbols.info(id).imported_package || symbols.is_declared(id);
         }
-        void SemanticAnalyzer::declare_function(const std::string &name, size_t param_count /*= 0*/)
+        void SemanticAnalyzer::declare_function(SymbolId id, size_t param_count /*= 0*/)
         {
-            global_functions[name] = true;
-            function_param_counts[name] = param_count;
+            SymbolInfo &info = symbols.info(id);
+            info.is_function = true;
+            info.param_count = static_cast<int>(param_count);
         }
 
-        // Danh sách các hàm built-in hợp lệ
-        static const std::unordered_set<std::string> builtin_functions = {
-            "print", "input", "str", "int", "float", "bool", "len", "id", "type", "uint", "pow", "printf"};
-
-        bool SemanticAnalyzer::is_function_declared(const std::string &name)
+        bool SemanticAnalyzer::is_function_declared(SymbolId id)
         {
             // Nếu là hàm built-in thì luôn hợp lệ
-            if (builtin_functions.count(name))
-                return true;
-            return global_functions.count(name) > 0;
+            const SymbolInfo &info = symbols.info(id);
+            return info.builtin_function || info.is_function;
+        }
+
+        // Kiểu của toán hạng đơn giản: literal, hoặc biến đã ghi kiểu
+        StaticType SemanticAnalyzer::operand_type(AST::Expr *expr)
+        {
+            if (auto lit = AST::node_cast<AST::LiteralExpr>(expr))
+                return {literal_type(lit), 0};
+            if (auto id = AST::node_cast<AST::IdentifierExpr>(expr))
+                if (const SymbolInfo *info = symbols.find(id->name.lexeme))
+                    return info->type;
+            return {};
         }
 
         void SemanticAnalyzer::visitExpressionStmt(AST::ExpressionStmt *stmt)
@@ -262,13 +316,13 @@ namespace Linh
             if (should_early_exit) return;
             
             if (stmt->expression)
-                stmt->expression->accept(this);
+                visit(stmt->expression);
         }
         void SemanticAnalyzer::visitPrintStmt(AST::PrintStmt *stmt)
         {
             for (const auto& expr : stmt->expressions) {
                 if (expr) {
-                    expr->accept(this);
+                    visit(expr);
                 }
             }
         }
@@ -278,7 +332,7 @@ namespace Linh
             if (should_early_exit) return;
             
             // Check cached error
-            if (check_cached_error(static_cast<const AST::Stmt*>(stmt), "var_decl_error")) {
+            if (check_cached_error(stmt, CHECK_VAR_DECL)) {
                 return;
             }
             
@@ -287,6 +341,7 @@ namespace Linh
             bool value_is_sol = is_sol_expr(stmt->initializer);
 
             std::string kw = stmt->keyword.lexeme;
+            SymbolId name_id = symbols.intern(stmt->name.lexeme);
             int line = stmt->keyword.line;
             int col = stmt->keyword.column_start;
 
@@ -307,24 +362,24 @@ namespace Linh
                 }
             }
             // Kiểm tra trùng tên biến trong cùng scope
-            if (!var_scopes.empty() && var_scopes.back().count(stmt->name.lexeme))
+            if (symbols.declared_in_current(name_id))
             {
                 push_semantic_error(errors, stmt->name.line, stmt->name.column_start, "Variable '" + stmt->name.lexeme + "' redeclared in the same scope.");
             }
             // Kiểm tra trùng tên biến với tên hàm toàn cục
-            if (is_function_declared(stmt->name.lexeme))
+            if (is_function_declared(name_id))
             {
                 push_semantic_error(errors, stmt->name.line, stmt->name.column_start, "Variable '" + stmt->name.lexeme + "' redeclared as a function name.");
             }
 
             // Kiểm tra tham số hàm không trùng tên với biến toàn cục (scope ngoài cùng)
-            if (!var_scopes.empty() && var_scopes.front().count(stmt->name.lexeme))
+            if (symbols.declared_in_outermost(name_id))
             {
                 // Đã kiểm tra ở trên
             }
 
             // Lưu loại biến và kiểu biến (giản lược: chỉ lấy tên kiểu nếu có)
-            std::string kind = kw;
+            VarKind kind = kw == "const" ? VarKind::Const : kw == "vas" ? VarKind::Vas : VarKind::Var;
             std::string type;
             int bit_width = 0;
             std::string base_type_name;
@@ -332,11 +387,11 @@ namespace Linh
             int str_limit = -1;
             if (stmt->declared_type.has_value() && stmt->declared_type.value())
             {
-                auto *base = dynamic_cast<AST::BaseTypeNode *>(stmt->declared_type.value().get());
-                auto *sized_int = dynamic_cast<AST::SizedIntegerTypeNode *>(stmt->declared_type.value().get());
-                auto *sized_float = dynamic_cast<AST::SizedFloatTypeNode *>(stmt->declared_type.value().get());
-                auto *map_type = dynamic_cast<AST::MapTypeNode *>(stmt->declared_type.value().get());
-                auto *array_type = dynamic_cast<AST::ArrayTypeNode *>(stmt->declared_type.value().get());
+                auto *base = AST::node_cast<AST::BaseTypeNode>(stmt->declared_type.value().get());
+                auto *sized_int = AST::node_cast<AST::SizedIntegerTypeNode>(stmt->declared_type.value().get());
+                auto *sized_float = AST::node_cast<AST::SizedFloatTypeNode>(stmt->declared_type.value().get());
+                auto *map_type = AST::node_cast<AST::MapTypeNode>(stmt->declared_type.value().get());
+                auto *array_type = AST::node_cast<AST::ArrayTypeNode>(stmt->declared_type.value().get());
 
                 if (base)
                 {
@@ -391,24 +446,25 @@ namespace Linh
             }
             else if (stmt->initializer)
             {
-                if (auto lit = dynamic_cast<AST::LiteralExpr *>(stmt->initializer.get()))
+                if (auto lit = AST::node_cast<AST::LiteralExpr>(stmt->initializer.get()))
                 {
                     type = SemanticAnalyzer::get_linh_literal_type(lit);
                 }
                 // Nếu initializer là IdentifierExpr và nó là function đã khai báo
-                else if (auto id = dynamic_cast<AST::IdentifierExpr *>(stmt->initializer.get()))
+                else if (auto id = AST::node_cast<AST::IdentifierExpr>(stmt->initializer.get()))
                 {
-                    if (is_function_declared(id->name.lexeme)) {
+                    SymbolId init_id = symbols.intern(id->name.lexeme);
+                    if (is_function_declared(init_id)) {
                         type = "function";
-                        if (function_param_counts.count(id->name.lexeme))
-                            var_func_param_counts[stmt->name.lexeme] = function_param_counts[id->name.lexeme];
+                        if (symbols.info(init_id).param_count >= 0)
+                            symbols.info(name_id).var_func_params = symbols.info(init_id).param_count;
                     }
                 }
                 // Nếu initializer là anonymous function (FunctionExpr)
-                else if (auto fnexpr = dynamic_cast<AST::FunctionExpr *>(stmt->initializer.get()))
+                else if (auto fnexpr = AST::node_cast<AST::FunctionExpr>(stmt->initializer.get()))
                 {
                     type = "function";
-                    var_func_param_counts[stmt->name.lexeme] = fnexpr->params.size();
+                    symbols.info(name_id).var_func_params = static_cast<int>(fnexpr->params.size());
                 }
             }
             else
@@ -473,15 +529,15 @@ namespace Linh
                 }
             }
 
-            // Nếu có giới hạn str<index> thì lưu vào var_str_limit
+            // Nếu có giới hạn str<index> thì lưu vào symbol
             if (type == "str" && str_limit > 0)
             {
-                var_str_limit[stmt->name.lexeme] = str_limit;
+                symbols.info(name_id).str_limit = str_limit;
             }
             // Nếu có giới hạn str<index> và có initializer là LiteralExpr thì cắt chuỗi
             if (type == "str" && str_limit > 0 && stmt->initializer)
             {
-                if (auto lit = dynamic_cast<AST::LiteralExpr *>(stmt->initializer.get()))
+                if (auto lit = AST::node_cast<AST::LiteralExpr>(stmt->initializer.get()))
                 {
                     if (std::holds_alternative<std::string>(lit->value))
                     {
@@ -501,11 +557,17 @@ namespace Linh
                 push_semantic_error(errors, stmt->name.line, stmt->name.column_start, "Type '" + type + "' does not support template specification (e.g. '<...>').");
             }
 
-            declare_var(stmt->name.lexeme, kind, type);
+            declare_var(name_id, kind, symbols.type_from_name(type));
 
             // Recursively check initializer
             if (stmt->initializer)
-                stmt->initializer->accept(this);
+                visit(stmt->initializer);
+
+            // vas/const không đổi kiểu: kiểu khai báo, hoặc kiểu suy ra từ initializer
+            if (kw == "vas" || kw == "const")
+                set_var_num_type(name_id, type.empty() ? expr_type_of(stmt->initializer.get()) : type);
+            else
+                set_var_num_type(name_id, "");
         }
         void SemanticAnalyzer::visitBlockStmt(AST::BlockStmt *stmt)
         {
@@ -513,63 +575,130 @@ namespace Linh
             for (const auto &s : stmt->statements)
             {
                 if (s)
-                    s->accept(this);
+                    visit(s);
             }
             end_scope();
         }
         void SemanticAnalyzer::visitIfStmt(AST::IfStmt *stmt)
         {
             if (stmt->condition)
-                stmt->condition->accept(this);
+                visit(stmt->condition);
             if (stmt->then_branch)
-                stmt->then_branch->accept(this);
+                visit(stmt->then_branch);
             if (stmt->else_branch)
-                stmt->else_branch->accept(this);
+                visit(stmt->else_branch);
         }
         void SemanticAnalyzer::visitWhileStmt(AST::WhileStmt *stmt)
         {
             if (stmt->condition)
-                stmt->condition->accept(this);
+                visit(stmt->condition);
             // Đánh dấu scope là trong vòng lặp
-            begin_scope();
-            var_scopes.back()["__loop__"] = true;
+            begin_scope(true);
             if (stmt->body)
-                stmt->body->accept(this);
+                visit(stmt->body);
             end_scope();
         }
         void SemanticAnalyzer::visitDoWhileStmt(AST::DoWhileStmt *stmt)
         {
             if (stmt->body)
-                stmt->body->accept(this);
+                visit(stmt->body);
             if (stmt->condition)
-                stmt->condition->accept(this);
+                visit(stmt->condition);
+        }
+        void SemanticAnalyzer::visitForInStmt(AST::ForInStmt *stmt)
+        {
+            // range(...) chỉ hợp lệ trong for, nên kiểm tra các đối số ở đây
+            if (auto range_call = stmt->as_range_call())
+            {
+                if (range_call->arguments.empty() || range_call->arguments.size() > 3)
+                {
+                    push_semantic_error(errors, stmt->getLine(), stmt->getCol(), "range() expects 1 to 3 arguments (end | start, end | start, end, step).");
+                }
+                for (auto &arg : range_call->arguments)
+                    if (arg)
+                        visit(arg);
+            }
+            else if (stmt->iterable && !stmt->iterates_stdin())
+            {
+                visit(stmt->iterable);
+            }
+            // Biến lặp thuộc scope của vòng lặp
+            SymbolId var_id = symbols.intern(stmt->var_name.lexeme);
+            begin_scope(true);
+            declare_var(var_id, VarKind::Var);
+            // range(...) với mọi đối số int: biến lặp luôn là int
+            bool int_range = false;
+            if (auto range_call = stmt->as_range_call())
+            {
+                int_range = !range_call->arguments.empty();
+                for (auto &arg : range_call->arguments)
+                    int_range = int_range && expr_type_of(arg.get()) == "int";
+            }
+            set_var_num_type(var_id, int_range ? "int" : "");
+            if (stmt->body)
+                visit(stmt->body);
+            end_scope();
         }
+
         void SemanticAnalyzer::visitFunctionDeclStmt(AST::FunctionDeclStmt *stmt)
+        {
+            analyze_function_decl(stmt);
+        }
+
+        void SemanticAnalyzer::analyze_function_decl(AST::FunctionDeclStmt *stmt)
+        {
+            analyze_function_header(stmt);
+            analyze_function_body(stmt);
+        }
+
+        // Phần khai báo: tên hàm và danh sách tham số (phần phân tích song song giữ ở thread chính)
+        void SemanticAnalyzer::analyze_function_header(AST::FunctionDeclStmt *stmt)
         {
             // Kiểm tra trùng tên hàm với biến toàn cục (scope ngoài cùng)
-            if (!var_scopes.empty() && var_scopes.front().count(stmt->name.lexeme))
+            SymbolId function_id = symbols.intern(stmt->name.lexeme);
+            if (symbols.declared_in_outermost(function_id))
             {
                 push_semantic_error(errors, stmt->name.line, stmt->name.column_start, "Function '" + stmt->name.lexeme + "' redeclared as a variable name.");
             }
-            // Đăng ký tên hàm vào global_functions và lưu số lượng tham số
-            declare_function(stmt->name.lexeme, stmt->params.size());
+            // Đăng ký tên hàm và lưu số lượng tham số
+            declare_function(function_id, stmt->params.size());
 
             // Kiểm tra trùng tên tham số trong danh sách tham số
-            std::unordered_map<std::string, bool> param_names;
+            std::vector<SymbolId> param_ids;
+            param_ids.reserve(stmt->params.size());
             for (const auto &param : stmt->params)
             {
-                if (param_names.count(param.name.lexeme))
+                SymbolId param_id = symbols.intern(param.name.lexeme);
+                if (std::find(param_ids.begin(), param_ids.end(), param_id) != param_ids.end())
                 {
                     push_semantic_error(errors, param.name.line, param.name.column_start, "Parameter '" + param.name.lexeme + "' redeclared in parameter list.");
                 }
-                param_names[param.name.lexeme] = true;
+                param_ids.push_back(param_id);
             }
+        }
 
+        // Thân hàm: scope tham số, các câu lệnh và kiểm tra return
+        void SemanticAnalyzer::analyze_function_body(AST::FunctionDeclStmt *stmt)
+        {
             begin_scope();
             // Đăng ký tham số vào scope mới
-            for (const auto &param : stmt->params)
+            for (size_t i = 0; i < stmt->params.size(); ++i)
             {
-                declare_var(param.name.lexeme);
+                const auto &param = stmt->params[i];
+                SymbolId param_id = symbols.intern(param.name.lexeme);
+                declare_var(param_id);
+                // Tham số vas có kiểu int/float: kiểu cố định trong thân hàm
+                std::string param_type;
+                if (param.is_static && param.type.has_value() && param.type.value())
+                {
+                    if (auto *base = AST::node_cast<AST::BaseTypeNode>(param.type.value().get()))
+                        param_type = base->type_keyword_token.lexeme;
+                    else if (auto *sized_int = AST::node_cast<AST::SizedIntegerTypeNode>(param.type.value().get()))
+                        param_type = sized_int->base_type_keyword_token.lexeme;
+                    else if (auto *sized_float = AST::node_cast<AST::SizedFloatTypeNode>(param.type.value().get()))
+                        param_type = sized_float->base_type_keyword_token.lexeme;
+                }
+                set_var_num_type(param_id, param_type);
             }
             // Kiểm tra return trong hàm nếu có yêu cầu trả về giá trị
             bool has_return = false;
@@ -578,16 +707,16 @@ namespace Linh
                 // Duyệt các statement trong body để tìm return
                 for (const auto &s : stmt->body->statements)
                 {
-                    if (dynamic_cast<AST::ReturnStmt *>(s.get()))
+                    if (AST::node_cast<AST::ReturnStmt>(s.get()))
                         has_return = true;
                 }
-                stmt->body->accept(this);
+                visit(stmt->body);
             }
             // Giả sử stmt->return_type là optional<TypeNodePtr> và nullptr nếu không có
             if (stmt->return_type.has_value() && stmt->return_type.value() && !has_return)
             {
                 // --- Sửa: Không bắt buộc return nếu kiểu trả về là void hoặc uninit ---
-                auto *base = dynamic_cast<AST::BaseTypeNode *>(stmt->return_type.value().get());
+                auto *base = AST::node_cast<AST::BaseTypeNode>(stmt->return_type.value().get());
                 if (!base || (base->type_keyword_token.type != TokenType::VOID_KW && base->type_keyword_token.type != TokenType::SOL_KW))
                 {
                     push_semantic_error(errors, stmt->name.line, stmt->name.column_start, "Function '" + stmt->name.lexeme + "' must have a return statement.");
@@ -598,21 +727,12 @@ namespace Linh
         void SemanticAnalyzer::visitReturnStmt(AST::ReturnStmt *stmt)
         {
             if (stmt->value)
-                stmt->value->accept(this);
+                visit(stmt->value);
         }
         void SemanticAnalyzer::visitBreakStmt(AST::BreakStmt *stmt)
         {
             // Kiểm tra break ngoài vòng lặp hoặc switch
-            bool in_loop_or_switch = false;
-            for (auto it = var_scopes.rbegin(); it != var_scopes.rend(); ++it)
-            {
-                if (it->count("__loop__") || it->count("__switch__"))
-                {
-                    in_loop_or_switch = true;
-                    break;
-                }
-            }
-            if (!in_loop_or_switch)
+            if (!symbols.in_loop_or_switch())
             {
                 push_semantic_error(errors, stmt->getLine(), stmt->getCol(), "'break' statement not inside a loop or switch.");
             }
@@ -620,16 +740,7 @@ namespace Linh
         void SemanticAnalyzer::visitContinueStmt(AST::ContinueStmt *stmt)
         {
             // Kiểm tra continue ngoài vòng lặp hoặc switch
-            bool in_loop_or_switch = false;
-            for (auto it = var_scopes.rbegin(); it != var_scopes.rend(); ++it)
-            {
-                if (it->count("__loop__") || it->count("__switch__"))
-                {
-                    in_loop_or_switch = true;
-                    break;
-                }
-            }
-            if (!in_loop_or_switch)
+            if (!symbols.in_loop_or_switch())
             {
                 push_semantic_error(errors, stmt->getLine(), stmt->getCol(), "'continue' statement not inside a loop or switch.");
             }
@@ -637,17 +748,16 @@ namespace Linh
         void SemanticAnalyzer::visitSwitchStmt(AST::SwitchStmt *stmt)
         {
             if (stmt->expression_to_switch_on)
-                stmt->expression_to_switch_on->accept(this);
+                visit(stmt->expression_to_switch_on);
 
             // Đánh dấu scope là trong switch
-            begin_scope();
-            var_scopes.back()["__switch__"] = true;
+            begin_scope(true);
             for (const auto &c : stmt->cases)
             {
                 for (const auto &s : c.statements)
                 {
                     if (s)
-                        s->accept(this);
+                        visit(s);
                 }
             }
             end_scope();
@@ -655,37 +765,39 @@ namespace Linh
         void SemanticAnalyzer::visitDeleteStmt(AST::DeleteStmt *stmt)
         {
             if (stmt->expression_to_delete)
-                stmt->expression_to_delete->accept(this);
+                visit(stmt->expression_to_delete);
         }
         void SemanticAnalyzer::visitThrowStmt(AST::ThrowStmt *stmt)
         {
             if (stmt->expression)
-                stmt->expression->accept(this);
+                visit(stmt->expression);
         }
         void SemanticAnalyzer::visitTryStmt(AST::TryStmt *stmt)
         {
             if (stmt->try_block)
-                stmt->try_block->accept(this);
+                visit(stmt->try_block);
             for (const auto &c : stmt->catch_clauses)
             {
                 // --- Sửa tại đây: Đưa biến catch vào scope ---
                 if (c.exception_variable.has_value())
                 {
+                    SymbolId catch_id = symbols.intern(c.exception_variable.value().lexeme);
                     begin_scope();
-                    declare_var(c.exception_variable.value().lexeme);
+                    declare_var(catch_id);
+                    set_var_num_type(catch_id, "");
                     if (c.body)
-                        c.body->accept(this);
+                        visit(c.body);
                     end_scope();
                 }
                 else
                 {
                     if (c.body)
-                        c.body->accept(this);
+                        visit(c.body);
                 }
             }
             if (stmt->finally_block.has_value() && stmt->finally_block.value())
             {
-                stmt->finally_block.value()->accept(this);
+                visit(stmt->finally_block.value());
             }
         }
 
@@ -700,39 +812,47 @@ namespace Linh
                 if (Linh::LiPM::package_exists(module_name))
                 {
                     // This is a LiPM package, mark it as imported
-                    imported_packages.insert(module_name);
+                    symbols.info(symbols.intern(module_name)).imported_package = true;
                     return;
                 }
                 
                 // Fall back to file-based module import
-                std::string module_path = "Li/" + module_name;
-                if (module_path.find(".li") == std::string::npos)
-                    module_path += ".li";
-                std::ifstream mod_file(module_path);
-                if (!mod_file)
+                std::string module_path = module_path_of(module_name);
+                LoadedModule module;
+                auto preloaded = preloaded_modules.find(module_path);
+                if (preloaded != preloaded_modules.end())
+                {
+                    module = std::move(preloaded->second);
+                    preloaded_modules.erase(preloaded);
+                }
+                else
+                {
+                    module = load_module(module_path);
+                }
+                if (!module.opened)
                 {
                     push_semantic_error(errors, stmt->module_name.line, stmt->module_name.column_start, "Cannot open module file: " + module_path);
                     return;
                 }
-                std::string line, mod_source;
-                while (std::getline(mod_file, line))
-                    mod_source += line + "\n";
-                // Lex và parse module
-                Linh::Lexer mod_lexer(mod_source);
-                auto mod_tokens = mod_lexer.scan_tokens();
-                Linh::Parser mod_parser(mod_tokens);
-                auto mod_ast = mod_parser.parse();
-                if (mod_parser.had_error())
+                auto &mod_ast = module.ast;
+                if (module.parse_error)
                 {
                     push_semantic_error(errors, stmt->module_name.line, stmt->module_name.column_start, "Syntax error in module: " + module_path);
                     return;
                 }
                 // Phân tích semantic cho module (không reset state để giữ lại các hàm/biến)
+                // analyze() xoá expr_types, nên giữ lại kiểu của module đang phân tích
+                auto outer_expr_types = std::move(expr_types);
                 this->analyze(mod_ast, false);
 
                 // --- Sinh bytecode cho module và merge function table ---
+                // Khi phân tích song song, import trong thân hàm chạy trên worker: khoá phần dùng chung g_main_emitter
+                static std::mutex module_emit_mutex;
+                std::lock_guard<std::mutex> emit_lock(module_emit_mutex);
                 Linh::BytecodeEmitter mod_emitter;
+                mod_emitter.set_expr_types(&expr_types);
                 mod_emitter.emit(mod_ast);
+                expr_types = std::move(outer_expr_types);
                 // Giả sử bạn có một con trỏ emitter chính hoặc một biến toàn cục để merge
                 if (g_main_emitter)
                 {
@@ -752,37 +872,77 @@ namespace Linh
         }
 
         // ExprVisitor (only need to traverse, except UninitLiteralExpr)
-        std::any SemanticAnalyzer::visitBinaryExpr(AST::BinaryExpr *expr)
+        void SemanticAnalyzer::visitBinaryExpr(AST::BinaryExpr *expr)
         {
             if (expr->left)
-                expr->left->accept(this);
+                visit(expr->left);
             if (expr->right)
-                expr->right->accept(this);
-            return {};
+                visit(expr->right);
+
+            // Lan truyền kiểu số: int op int -> int, có float -> float, so sánh -> bool
+            std::string left_type = expr_type_of(expr->left.get());
+            std::string right_type = expr_type_of(expr->right.get());
+            bool numeric = (left_type == "int" || left_type == "float") && (right_type == "int" || right_type == "float");
+            if (!numeric)
+                return;
+            std::string arith_type = (left_type == "int" && right_type == "int") ? "int" : "float";
+            switch (expr->op.type)
+            {
+            case TokenType::PLUS:
+            case TokenType::MINUS:
+            case TokenType::STAR:
+            case TokenType::SLASH:
+            case TokenType::PERCENT:
+                record_expr_type(expr, arith_type);
+                break;
+            case TokenType::EQ_EQ:
+            case TokenType::NOT_EQ:
+            case TokenType::LT:
+            case TokenType::GT:
+            case TokenType::LT_EQ:
+            case TokenType::GT_EQ:
+                record_expr_type(expr, "bool");
+                break;
+            default:
+                break;
+            }
+            return;
         }
-        std::any SemanticAnalyzer::visitUnaryExpr(AST::UnaryExpr *expr)
+        void SemanticAnalyzer::visitUnaryExpr(AST::UnaryExpr *expr)
         {
             if (expr->right)
-                expr->right->accept(this);
-            return {};
+                visit(expr->right);
+            std::string operand_type = expr_type_of(expr->right.get());
+            if (expr->op.type == TokenType::MINUS && (operand_type == "int" || operand_type == "float"))
+                record_expr_type(expr, operand_type);
+            return;
         }
-        std::any SemanticAnalyzer::visitLiteralExpr(AST::LiteralExpr *) { return {}; }
-        std::any SemanticAnalyzer::visitGroupingExpr(AST::GroupingExpr *expr)
+        void SemanticAnalyzer::visitLiteralExpr(AST::LiteralExpr *expr)
+        {
+            std::string type = get_linh_literal_type(expr);
+            if (type == "int" || type == "float" || type == "bool")
+                record_expr_type(expr, type);
+            return;
+        }
+        void SemanticAnalyzer::visitGroupingExpr(AST::GroupingExpr *expr)
         {
             if (expr->expression)
-                expr->expression->accept(this);
-            return {};
+                visit(expr->expression);
+            record_expr_type(expr, expr_type_of(expr->expression.get()));
+            return;
         }
-        std::any SemanticAnalyzer::visitIdentifierExpr(AST::IdentifierExpr *expr)
+        void SemanticAnalyzer::visitIdentifierExpr(AST::IdentifierExpr *expr)
         {
+            SymbolId id = symbols.intern(expr->name.lexeme);
+            const SymbolInfo &info = symbols.info(id);
+            if (info.num_type == TypeTag::Int)
+                record_expr_type(expr, "int");
+            else if (info.num_type == TypeTag::Float)
+                record_expr_type(expr, "float");
             // Allow built-in functions and packages as identifiers without declaration
-            static const std::unordered_set<std::string> builtin_funcs = {
-                "input", "type", "str", "int", "float", "bool", "uint", "id"}; // Thêm "id"
-            static const std::unordered_set<std::string> builtin_packages = {
-                "math"}; // Built-in packages
-            if (builtin_funcs.count(expr->name.lexeme) || builtin_packages.count(expr->name.lexeme))
+            if (info.builtin_value || info.builtin_package)
             {
-                return {};
+                return;
             }
             // --- Sửa tại đây: Cho phép error.message nếu error đã khai báo ---
             const std::string &lex = expr->name.lexeme;
@@ -793,186 +953,151 @@ namespace Linh
                 std::string member = lex.substr(dot_pos + 1);
                 
                 // Check if this is a package constant (e.g., math.pi)
-                if (imported_packages.count(base) || base == "math")
+                SymbolId base_id = symbols.intern(base);
+                if (symbols.info(base_id).imported_package || base == "math")
                 {
                     // This is a package constant, check if it exists
                     if (Linh::LiPM::get_constant(base, member).index() != 0) // Not sol
                     {
-                        return {}; // Package constant exists, allow it
+                        return; // Package constant exists, allow it
                     }
                     else
                     {
                         push_semantic_error(errors, expr->name.line, expr->name.column_start, "Package '" + base + "' does not have constant '" + member + "'.");
-                        return {};
+                        return;
                     }
                 }
-                else if (is_var_declared(base))
+                else if (is_var_declared(base_id))
                 {
                     // Cho phép error.message nếu error đã khai báo
-                    return {};
+                    return;
                 }
             }
             // Ưu tiên kiểm tra hàm trước biến
-            if (is_function_declared(expr->name.lexeme))
+            if (is_function_declared(id))
             {
                 // Nếu là tên hàm, không báo lỗi dùng như biến (cho phép dùng tên hàm như giá trị hàm)
-                return {};
+                return;
             }
             // Kiểm tra biến đã khai báo chưa
-            if (!is_var_declared(expr->name.lexeme))
+            if (!is_var_declared(id))
             {
                 push_semantic_error(errors, expr->name.line, expr->name.column_start, "Variable '" + expr->name.lexeme + "' used before declaration.");
             }
-            return {};
+            return;
         }
-        std::any SemanticAnalyzer::visitAssignmentExpr(AST::AssignmentExpr *expr)
+        void SemanticAnalyzer::visitAssignmentExpr(AST::AssignmentExpr *expr)
         {
-            std::string name = expr->name.lexeme;
+            const std::string &name = expr->name.lexeme;
             if (!name.empty())
             {
+                SymbolId id = symbols.intern(name);
+                // operand_type() chỉ tra cứu (find), không thêm symbol mới nên tham chiếu info vẫn hợp lệ
+                SymbolInfo &info = symbols.info(id);
                 // Không cho phép gán lại cho const
-                if (var_kinds.count(name) && var_kinds[name] == "const")
+                if (info.kind == VarKind::Const)
                 {
                     push_semantic_error(errors, expr->name.line, expr->name.column_start, "Cannot assign to '" + name + "' because it is declared as 'const'.");
                 }
                 // Không cho phép đổi kiểu cho vas
-                else if (var_kinds.count(name) && var_kinds[name] == "vas" && var_types.count(name))
+                else if (info.kind == VarKind::Vas && info.type.known())
                 {
-                    std::string old_type = var_types[name];
-                    std::string new_type;
-                    // Nếu là literal thì lấy kiểu như cũ
+                    StaticType old_type = info.type;
+                    StaticType new_type;
+                    // Nếu là literal hoặc biến thì lấy kiểu như cũ
                     if (expr->value)
                     {
-                        if (auto lit = dynamic_cast<AST::LiteralExpr *>(expr->value.get()))
-                        {
-                            new_type = get_linh_literal_type(lit);
-                        }
-                        else if (auto id = dynamic_cast<AST::IdentifierExpr *>(expr->value.get()))
-                        {
-                            // Nếu gán từ biến khác, lấy kiểu của biến đó nếu có
-                            std::string rhs_name = id->name.lexeme;
-                            if (var_types.count(rhs_name))
-                                new_type = var_types[rhs_name];
-                        }
-                        else if (auto bin = dynamic_cast<AST::BinaryExpr *>(expr->value.get()))
+                        if (auto bin = AST::node_cast<AST::BinaryExpr>(expr->value.get()))
                         {
                             // Nếu là biểu thức nhị phân, thử lấy kiểu của vế trái hoặc phải nếu là literal/identifier
-                            std::string left_type, right_type;
-                            if (auto litl = dynamic_cast<AST::LiteralExpr *>(bin->left.get()))
-                                left_type = get_linh_literal_type(litl);
-                            else if (auto idl = dynamic_cast<AST::IdentifierExpr *>(bin->left.get()))
-                                if (var_types.count(idl->name.lexeme))
-                                    left_type = var_types[idl->name.lexeme];
-                            if (auto litr = dynamic_cast<AST::LiteralExpr *>(bin->right.get()))
-                                right_type = get_linh_literal_type(litr);
-                            else if (auto idr = dynamic_cast<AST::IdentifierExpr *>(bin->right.get()))
-                                if (var_types.count(idr->name.lexeme))
-                                    right_type = var_types[idr->name.lexeme];
+                            StaticType left_type = operand_type(bin->left.get());
+                            StaticType right_type = operand_type(bin->right.get());
                             // Ưu tiên lấy kiểu giống old_type nếu có
                             if (left_type == old_type)
                                 new_type = left_type;
                             else if (right_type == old_type)
                                 new_type = right_type;
-                            else if (!left_type.empty())
+                            else if (left_type.known())
                                 new_type = left_type;
-                            else if (!right_type.empty())
+                            else
                                 new_type = right_type;
                         }
+                        else
+                        {
+                            new_type = operand_type(expr->value.get());
+                        }
                         // Có thể mở rộng cho các loại biểu thức khác nếu cần
                     }
-                    if (!new_type.empty() && !old_type.empty() && !is_subtype_type_string(new_type, old_type))
+                    if (new_type.known() && !is_subtype(new_type, old_type))
                     {
-                        push_semantic_error(errors, expr->name.line, expr->name.column_start, "Cannot change type of 'vas' variable '" + name + "' from '" + old_type + "' to '" + new_type + "'.");
+                        push_semantic_error(errors, expr->name.line, expr->name.column_start, "Cannot change type of 'vas' variable '" + name + "' from '" + symbols.type_name(old_type) + "' to '" + symbols.type_name(new_type) + "'.");
                     }
                     // Nếu không xác định được kiểu mới (biểu thức phức tạp), không cho phép đổi kiểu
-                    if (new_type.empty() && expr->value)
+                    if (!new_type.known() && expr->value)
                     {
                         push_semantic_error(errors, expr->name.line, expr->name.column_start, "Cannot assign non-literal or unknown type to 'vas' variable '" + name + "'.");
                     }
                 }
-                // Nếu là var thì cho phép đổi kiểu (cập nhật lại var_types)
-                else if (var_kinds.count(name) && var_kinds[name] == "var" && var_types.count(name))
+                // Nếu là var thì cho phép đổi kiểu (cập nhật lại kiểu đã ghi)
+                else if (info.kind == VarKind::Var && info.type.known())
                 {
-                    std::string new_type;
+                    StaticType new_type;
                     if (expr->value)
                     {
-                        if (auto lit = dynamic_cast<AST::LiteralExpr *>(expr->value.get()))
+                        if (auto bin = AST::node_cast<AST::BinaryExpr>(expr->value.get()))
                         {
-                            new_type = get_linh_literal_type(lit);
+                            StaticType left_type = operand_type(bin->left.get());
+                            new_type = left_type.known() ? left_type : operand_type(bin->right.get());
                         }
-                        else if (auto id = dynamic_cast<AST::IdentifierExpr *>(expr->value.get()))
+                        else
                         {
-                            std::string rhs_name = id->name.lexeme;
-                            if (var_types.count(rhs_name))
-                                new_type = var_types[rhs_name];
-                        }
-                        else if (auto bin = dynamic_cast<AST::BinaryExpr *>(expr->value.get()))
-                        {
-                            std::string left_type, right_type;
-                            if (auto litl = dynamic_cast<AST::LiteralExpr *>(bin->left.get()))
-                                left_type = get_linh_literal_type(litl);
-                            else if (auto idl = dynamic_cast<AST::IdentifierExpr *>(bin->left.get()))
-                                if (var_types.count(idl->name.lexeme))
-                                    left_type = var_types[idl->name.lexeme];
-                            if (auto litr = dynamic_cast<AST::LiteralExpr *>(bin->right.get()))
-                                right_type = get_linh_literal_type(litr);
-                            else if (auto idr = dynamic_cast<AST::IdentifierExpr *>(bin->right.get()))
-                                if (var_types.count(idr->name.lexeme))
-                                    right_type = var_types[idr->name.lexeme];
-                            if (!left_type.empty())
-                                new_type = left_type;
-                            else if (!right_type.empty())
-                                new_type = right_type;
+                            new_type = operand_type(expr->value.get());
                         }
                     }
-                    if (!new_type.empty())
+                    if (new_type.known())
                     {
-                        var_types[name] = new_type;
+                        info.type = new_type;
                     }
                 }
                 // --- Cắt chuỗi khi gán lại cho biến kiểu str<index> ---
-                if (var_types.count(name) && var_types[name] == "str" && var_str_limit.count(name))
+                if (info.type.tag == TypeTag::Str && info.str_limit > 0 && expr->value)
                 {
-                    int str_limit = var_str_limit[name];
-                    if (str_limit > 0 && expr->value)
+                    if (auto lit = AST::node_cast<AST::LiteralExpr>(expr->value.get()))
                     {
-                        if (auto lit = dynamic_cast<AST::LiteralExpr *>(expr->value.get()))
+                        if (std::holds_alternative<std::string>(lit->value))
                         {
-                            if (std::holds_alternative<std::string>(lit->value))
+                            std::string val = std::get<std::string>(lit->value);
+                            if (static_cast<int>(val.size()) > info.str_limit)
                             {
-                                std::string val = std::get<std::string>(lit->value);
-                                if (static_cast<int>(val.size()) > str_limit)
-                                {
-                                    std::string cut_val = val.substr(0, str_limit);
-                                    lit->value = cut_val;
-                                }
+                                std::string cut_val = val.substr(0, info.str_limit);
+                                lit->value = cut_val;
                             }
                         }
                     }
                 }
             }
             if (expr->value)
-                expr->value->accept(this);
-            return {};
+                visit(expr->value);
+            return;
         }
-        std::any SemanticAnalyzer::visitLogicalExpr(AST::LogicalExpr *expr)
+        void SemanticAnalyzer::visitLogicalExpr(AST::LogicalExpr *expr)
         {
             if (expr->left)
-                expr->left->accept(this);
+                visit(expr->left);
             if (expr->right)
-                expr->right->accept(this);
-            return {};
+                visit(expr->right);
+            return;
         }
-        std::any SemanticAnalyzer::visitCallExpr(AST::CallExpr *expr)
+        void SemanticAnalyzer::visitCallExpr(AST::CallExpr *expr)
         {
             // Nếu callee là IdentifierExpr thì kiểm tra tên hàm
-            if (auto id = dynamic_cast<AST::IdentifierExpr *>(expr->callee.get()))
+            if (auto id = AST::node_cast<AST::IdentifierExpr>(expr->callee.get()))
             {
                 // --- BẮT LỖI printf('...') ---
                 if (id->name.lexeme == "printf" && !expr->arguments.empty())
                 {
                     auto *arg0 = expr->arguments[0].get();
-                    if (auto lit = dynamic_cast<AST::LiteralExpr *>(arg0))
+                    if (auto lit = AST::node_cast<AST::LiteralExpr>(arg0))
                     {
                         // Kiểm tra token.lexeme bắt đầu và kết thúc bằng dấu nháy đơn
                         const std::string &tok_lex = lit->token.lexeme;
@@ -986,7 +1111,7 @@ namespace Linh
                 if (id->name.lexeme == "bool" && expr->arguments.size() == 1) {
                     auto *arg0 = expr->arguments[0].get();
                     bool valid = false;
-                    if (auto lit = dynamic_cast<AST::LiteralExpr *>(arg0)) {
+                    if (auto lit = AST::node_cast<AST::LiteralExpr>(arg0)) {
                         if (std::holds_alternative<int64_t>(lit->value)) {
                             int64_t v = std::get<int64_t>(lit->value);
                             valid = (v == 0 || v == 1);
@@ -1000,17 +1125,26 @@ namespace Linh
                         push_semantic_error(errors, expr->getLine(), expr->getCol(), "Only literal 0, 1, 0.0, 1.0 are allowed for bool() conversion.");
                     }
                 }
+                // --- read_all(), read_line(), read_eof() không có đối số; read_bytes(n) có 1 ---
+                if (id->name.lexeme == "read_all" || id->name.lexeme == "read_line" || id->name.lexeme == "read_eof" || id->name.lexeme == "read_bytes")
+                {
+                    size_t expected = id->name.lexeme == "read_bytes" ? 1 : 0;
+                    if (expr->arguments.size() != expected)
+                    {
+                        push_semantic_error(errors, id->name.line, id->name.column_start, "Function '" + id->name.lexeme + "' called with wrong number of arguments (expected " + std::to_string(expected) + ", got " + std::to_string(expr->arguments.size()) + ").");
+                    }
+                }
                 // Allow built-in conversion functions without declaration
-                static const std::unordered_set<std::string> builtin_funcs = {
-                    "input", "type", "str", "int", "float", "bool", "uint", "id"}; // Thêm "id"
-                if (!builtin_funcs.count(id->name.lexeme))
+                SymbolId callee_id = symbols.intern(id->name.lexeme);
+                const SymbolInfo &callee = symbols.info(callee_id);
+                if (!callee.builtin_value)
                 {
                     // Nếu là function đã khai báo thì kiểm tra như cũ
-                    if (is_function_declared(id->name.lexeme)) {
-                        // Kiểm tra số lượng tham số khi gọi hàm (trừ input, type)
-                        if (id->name.lexeme != "input" && id->name.lexeme != "type" && function_param_counts.count(id->name.lexeme))
+                    if (is_function_declared(callee_id)) {
+                        // Kiểm tra số lượng tham số khi gọi hàm
+                        if (callee.param_count >= 0)
                         {
-                            size_t expected = function_param_counts[id->name.lexeme];
+                            size_t expected = static_cast<size_t>(callee.param_count);
                             size_t actual = expr->arguments.size();
                             if (expected != actual)
                             {
@@ -1018,11 +1152,13 @@ namespace Linh
                             }
                         }
                     } else {
-                        // Nếu là biến kiểu function object thì cho phép gọi như hàm
-                        if (var_types.count(id->name.lexeme) && var_types[id->name.lexeme] == "function") {
+                        // Nếu là biến kiểu function object thì cho phép gọi như hàm.
+                        // Biến chưa rõ kiểu (vd. closure trả về từ hàm khác) cũng cho gọi, VM sẽ kiểm tra lúc chạy
+                        if (callee.type.tag == TypeTag::Function ||
+                            (!callee.type.known() && is_var_declared(callee_id))) {
                             // Kiểm tra số lượng tham số nếu có thể
-                            if (var_func_param_counts.count(id->name.lexeme)) {
-                                size_t expected = var_func_param_counts[id->name.lexeme];
+                            if (callee.var_func_params >= 0) {
+                                size_t expected = static_cast<size_t>(callee.var_func_params);
                                 size_t actual = expr->arguments.size();
                                 if (expected != actual) {
                                     push_semantic_error(errors, id->name.line, id->name.column_start, "Function variable '" + id->name.lexeme + "' called with wrong number of arguments (expected " + std::to_string(expected) + ", got " + std::to_string(actual) + ").");
@@ -1036,61 +1172,61 @@ namespace Linh
                 }
             }
             if (expr->callee)
-                expr->callee->accept(this);
+                visit(expr->callee);
             for (const auto &arg : expr->arguments)
             {
                 if (arg)
-                    arg->accept(this);
+                    visit(arg);
             }
-            return {};
+            return;
         }
-        std::any SemanticAnalyzer::visitPostfixExpr(AST::PostfixExpr *expr)
+        void SemanticAnalyzer::visitPostfixExpr(AST::PostfixExpr *expr)
         {
             if (expr->operand)
-                expr->operand->accept(this);
-            return {};
+                visit(expr->operand);
+            return;
         }
-        std::any SemanticAnalyzer::visitUninitLiteralExpr(AST::UninitLiteralExpr *)
+        void SemanticAnalyzer::visitUninitLiteralExpr(AST::UninitLiteralExpr *)
         {
             // Nothing to do here
-            return {};
+            return;
         }
-        std::any SemanticAnalyzer::visitNewExpr(AST::NewExpr *expr)
+        void SemanticAnalyzer::visitNewExpr(AST::NewExpr *expr)
         {
             if (expr->class_constructor_call)
-                expr->class_constructor_call->accept(this);
-            return {};
+                visit(expr->class_constructor_call);
+            return;
         }
-        std::any SemanticAnalyzer::visitThisExpr(AST::ThisExpr *) { return {}; }
-        std::any SemanticAnalyzer::visitArrayLiteralExpr(AST::ArrayLiteralExpr *expr)
+        void SemanticAnalyzer::visitThisExpr(AST::ThisExpr *) { return; }
+        void SemanticAnalyzer::visitArrayLiteralExpr(AST::ArrayLiteralExpr *expr)
         {
             for (const auto &el : expr->elements)
             {
                 if (el)
-                    el->accept(this);
+                    visit(el);
             }
-            return {};
+            return;
         }
-        std::any SemanticAnalyzer::visitMapLiteralExpr(AST::MapLiteralExpr *expr)
+        void SemanticAnalyzer::visitMapLiteralExpr(AST::MapLiteralExpr *expr)
         {
             for (const auto &entry : expr->entries)
             {
                 if (entry.key)
-                    entry.key->accept(this);
+                    visit(entry.key);
                 if (entry.value)
-                    entry.value->accept(this);
+                    visit(entry.value);
             }
-            return {};
+            return;
         }
-        std::any SemanticAnalyzer::visitSubscriptExpr(AST::SubscriptExpr *expr)
+        void SemanticAnalyzer::visitSubscriptExpr(AST::SubscriptExpr *expr)
         {
             if (expr->object)
-                expr->object->accept(this);
+                visit(expr->object);
             if (expr->index)
-                expr->index->accept(this);
-            return {};
+                visit(expr->index);
+            return;
         }
-        std::any SemanticAnalyzer::visitInterpolatedStringExpr(AST::InterpolatedStringExpr *expr)
+        void SemanticAnalyzer::visitInterpolatedStringExpr(AST::InterpolatedStringExpr *expr)
         {
             for (const auto &part : expr->parts)
             {
@@ -1098,21 +1234,21 @@ namespace Linh
                 {
                     auto &e = std::get<AST::ExprPtr>(part);
                     if (e)
-                        e->accept(this);
+                        visit(e);
                 }
             }
-            return {};
+            return;
         }
-        std::any SemanticAnalyzer::visitMemberExpr(AST::MemberExpr *expr)
+        void SemanticAnalyzer::visitMemberExpr(AST::MemberExpr *expr)
         {
             // Kiểm tra xem object có phải là package đã import không
-            if (auto id = dynamic_cast<AST::IdentifierExpr *>(expr->object.get()))
+            if (auto id = AST::node_cast<AST::IdentifierExpr>(expr->object.get()))
             {
                 std::string package_name = id->name.lexeme;
                 std::string property_name = expr->property_token.lexeme;
                 
                 // Kiểm tra xem package có được import không hoặc là built-in package
-                if (imported_packages.count(package_name) > 0 || package_name == "math")
+                if (symbols.info(symbols.intern(package_name)).imported_package || package_name == "math")
                 {
 #ifdef _DEBUG
                     std::cerr << "[DEBUG] Found package: " << package_name << "." << property_name << std::endl;
@@ -1121,28 +1257,54 @@ namespace Linh
                     expr->is_package_constant = true;
                     expr->package_name = package_name;
                     expr->constant_name = property_name;
+                    // Hằng bất biến (math.pi) có kiểu cố định, emitter sẽ thay bằng literal
+                    if (Linh::LiPM::is_immutable_constant(package_name, property_name))
+                    {
+                        Value constant = Linh::LiPM::get_constant(package_name, property_name);
+                        if (std::holds_alternative<double>(constant))
+                            record_expr_type(expr, "float");
+                        else if (std::holds_alternative<int64_t>(constant))
+                            record_expr_type(expr, "int");
+                    }
                 }
             }
             
             // Vẫn gọi accept cho object để semantic analysis bình thường
             if (expr->object)
-                expr->object->accept(this);
-            return {};
+                visit(expr->object);
+            return;
         }
-        std::any SemanticAnalyzer::visitMethodCallExpr(AST::MethodCallExpr *expr)
+        void SemanticAnalyzer::visitMethodCallExpr(AST::MethodCallExpr *expr)
         {
             if (expr->object)
-                expr->object->accept(this);
+                visit(expr->object);
             for (const auto &arg : expr->arguments)
                 if (arg)
-                    arg->accept(this);
-            return {};
+                    visit(arg);
+            return;
         }
-        std::any SemanticAnalyzer::visitFunctionExpr(AST::FunctionExpr *expr)
+        void SemanticAnalyzer::visitFunctionExpr(AST::FunctionExpr *expr)
         {
             // Cho phép anonymous function expression, không cần kiểm tra gì đặc biệt
             // Có thể mở rộng kiểm tra tham số, return type nếu cần
-            return {};
+            return;
+        }
+
+        TypeTag SemanticAnalyzer::literal_type(const AST::LiteralExpr *lit)
+        {
+            if (!lit)
+                return TypeTag::Unknown;
+            if (std::holds_alternative<int64_t>(lit->value))
+                return TypeTag::Int;
+            if (std::holds_alternative<uint64_t>(lit->value))
+                return TypeTag::Uint;
+            if (std::holds_alternative<double>(lit->value))
+                return TypeTag::Float;
+            if (std::holds_alternative<std::string>(lit->value))
+                return TypeTag::Str;
+            if (std::holds_alternative<bool>(lit->value))
+                return TypeTag::Bool;
+            return TypeTag::Unknown;
         }
 
         // Helper: xác định kiểu literal cho Linh từ LiteralExpr
@@ -1170,7 +1332,7 @@ namespace Linh
         {
             if (!type.has_value() || !type.value())
                 return false;
-            auto *base = dynamic_cast<AST::BaseTypeNode *>(type.value().get());
+            auto *base = AST::node_cast<AST::BaseTypeNode>(type.value().get());
             return base && base->type_keyword_token.type == TokenType::SOL_KW;
         }
 
@@ -1178,7 +1340,7 @@ namespace Linh
         {
             if (!expr)
                 return false;
-            return dynamic_cast<AST::UninitLiteralExpr *>(expr.get()) != nullptr;
+            return AST::node_cast<AST::UninitLiteralExpr>(expr.get()) != nullptr;
         }
 
         // Semantic error retrieval
@@ -1,5 +1,7 @@
 #pragma once
 #include "../AST/ASTNode.hpp"
+#include "SymbolTable.hpp"
+#include "WorkStealingPool.hpp"
 #include "../../Error.hpp"
 #include "../../../LiPM/LiPM.hpp"
 #include <vector>
@@ -9,130 +11,156 @@
 #include <stack>
 #include <unordered_set>
 #include <memory>
-#include <future>
 
 namespace Linh
 {
     namespace Semantic
     {
 
-        class SemanticAnalyzer : public AST::StmtVisitor, public AST::ExprVisitor
+        class SemanticAnalyzer : public AST::TypedVisitor<SemanticAnalyzer>
         {
         public:
             std::vector<Linh::Error> errors;
 
             void analyze(const AST::StmtList &stmts, bool reset_state = true);
 
+            // Phân tích kiểu streaming: begin_program(), rồi analyze_statement() cho từng câu lệnh cấp cao nhất
+            // (AST của câu trước có thể đã bị giải phóng), cuối cùng end_program(). Kiểu biểu thức chỉ giữ cho câu vừa phân tích.
+            void begin_program();
+            void analyze_statement(AST::Stmt *stmt);
+            void end_program();
+
             // Optimization methods
             void enable_caching(bool enable = true) { caching_enabled = enable; }
             void enable_early_exit(bool enable = true) { early_exit_enabled = enable; }
-            void enable_parallel_analysis(bool enable = true) { parallel_analysis_enabled = enable; }
+            // Phân tích song song thân các hàm cấp cao nhất trên thread pool (threads = 0: theo số core), xem analyze_parallel()
+            void enable_parallel_analysis(bool enable = true, size_t threads = 0)
+            {
+                parallel_analysis_enabled = enable;
+                analysis_threads = threads;
+            }
             
             // Performance monitoring
             size_t get_analysis_time_ms() const { return analysis_time_ms; }
             size_t get_cache_hits() const { return cache_hits; }
             size_t get_cache_misses() const { return cache_misses; }
 
-            // StmtVisitor overrides
-            void visitExpressionStmt(AST::ExpressionStmt *stmt) override;
-            void visitPrintStmt(AST::PrintStmt *stmt) override;
-            void visitVarDeclStmt(AST::VarDeclStmt *stmt) override;
-            void visitBlockStmt(AST::BlockStmt *stmt) override;
-            void visitIfStmt(AST::IfStmt *stmt) override;
-            void visitWhileStmt(AST::WhileStmt *stmt) override;
-            void visitDoWhileStmt(AST::DoWhileStmt *stmt) override;
-            void visitFunctionDeclStmt(AST::FunctionDeclStmt *stmt) override;
-            void visitReturnStmt(AST::ReturnStmt *stmt) override;
-            void visitBreakStmt(AST::BreakStmt *stmt) override;
-            void visitContinueStmt(AST::ContinueStmt *stmt) override;
-            void visitSwitchStmt(AST::SwitchStmt *stmt) override;
-            void visitDeleteStmt(AST::DeleteStmt *stmt) override;
-            void visitThrowStmt(AST::ThrowStmt *stmt) override;
-            void visitTryStmt(AST::TryStmt *stmt) override;
-            void visitImportStmt(AST::ImportStmt *stmt) override;
-
-            // ExprVisitor overrides (only need UninitLiteralExpr for this rule)
-            std::any visitBinaryExpr(AST::BinaryExpr *expr) override;
-            std::any visitUnaryExpr(AST::UnaryExpr *expr) override;
-            std::any visitLiteralExpr(AST::LiteralExpr *expr) override;
-            std::any visitGroupingExpr(AST::GroupingExpr *expr) override;
-            std::any visitIdentifierExpr(AST::IdentifierExpr *expr) override;
-            std::any visitAssignmentExpr(AST::AssignmentExpr *expr) override;
-            std::any visitLogicalExpr(AST::LogicalExpr *expr) override;
-            std::any visitCallExpr(AST::CallExpr *expr) override;
-            std::any visitPostfixExpr(AST::PostfixExpr *expr) override;
-            std::any visitUninitLiteralExpr(AST::UninitLiteralExpr *expr) override;
-            std::any visitNewExpr(AST::NewExpr *expr) override;
-            std::any visitThisExpr(AST::ThisExpr *expr) override;
-            std::any visitArrayLiteralExpr(AST::ArrayLiteralExpr *expr) override;
-            std::any visitMapLiteralExpr(AST::MapLiteralExpr *expr) override;
-            std::any visitSubscriptExpr(AST::SubscriptExpr *expr) override;
-            std::any visitInterpolatedStringExpr(AST::InterpolatedStringExpr *expr) override;
-            std::any visitMemberExpr(AST::MemberExpr *expr) override;
-            std::any visitMethodCallExpr(AST::MethodCallExpr *expr) override;
-            std::any visitFunctionExpr(AST::FunctionExpr *expr) override;
+            // Stmt visitors (gọi qua TypedVisitor::visit)
+            void visitExpressionStmt(AST::ExpressionStmt *stmt);
+            void visitPrintStmt(AST::PrintStmt *stmt);
+            void visitVarDeclStmt(AST::VarDeclStmt *stmt);
+            void visitBlockStmt(AST::BlockStmt *stmt);
+            void visitIfStmt(AST::IfStmt *stmt);
+            void visitWhileStmt(AST::WhileStmt *stmt);
+            void visitDoWhileStmt(AST::DoWhileStmt *stmt);
+            void visitForInStmt(AST::ForInStmt *stmt);
+            void visitFunctionDeclStmt(AST::FunctionDeclStmt *stmt);
+            void visitReturnStmt(AST::ReturnStmt *stmt);
+            void visitBreakStmt(AST::BreakStmt *stmt);
+            void visitContinueStmt(AST::ContinueStmt *stmt);
+            void visitSwitchStmt(AST::SwitchStmt *stmt);
+            void visitDeleteStmt(AST::DeleteStmt *stmt);
+            void visitThrowStmt(AST::ThrowStmt *stmt);
+            void visitTryStmt(AST::TryStmt *stmt);
+            void visitImportStmt(AST::ImportStmt *stmt);
+
+            // Expr visitors (only need UninitLiteralExpr for this rule)
+            void visitBinaryExpr(AST::BinaryExpr *expr);
+            void visitUnaryExpr(AST::UnaryExpr *expr);
+            void visitLiteralExpr(AST::LiteralExpr *expr);
+            void visitGroupingExpr(AST::GroupingExpr *expr);
+            void visitIdentifierExpr(AST::IdentifierExpr *expr);
+            void visitAssignmentExpr(AST::AssignmentExpr *expr);
+            void visitLogicalExpr(AST::LogicalExpr *expr);
+            void visitCallExpr(AST::CallExpr *expr);
+            void visitPostfixExpr(AST::PostfixExpr *expr);
+            void visitUninitLiteralExpr(AST::UninitLiteralExpr *expr);
+            void visitNewExpr(AST::NewExpr *expr);
+            void visitThisExpr(AST::ThisExpr *expr);
+            void visitArrayLiteralExpr(AST::ArrayLiteralExpr *expr);
+            void visitMapLiteralExpr(AST::MapLiteralExpr *expr);
+            void visitSubscriptExpr(AST::SubscriptExpr *expr);
+            void visitInterpolatedStringExpr(AST::InterpolatedStringExpr *expr);
+            void visitMemberExpr(AST::MemberExpr *expr);
+            void visitMethodCallExpr(AST::MethodCallExpr *expr);
+            void visitFunctionExpr(AST::FunctionExpr *expr);
 
             const std::vector<Linh::Error> &get_errors() const;
 
+            // Kiểu số suy ra cho từng biểu thức ("int"/"float"/"bool"), emitter dùng để chọn opcode có kiểu
+            const std::unordered_map<AST::ExprId, std::string> &get_expr_types() const { return expr_types; }
+
         private:
             // Optimization flags
             bool caching_enabled = true;
             bool early_exit_enabled = true;
             bool parallel_analysis_enabled = false;
+            size_t analysis_threads = 0;
             
             // Performance tracking
             size_t analysis_time_ms = 0;
             size_t cache_hits = 0;
             size_t cache_misses = 0;
             
-            // Caching for type checking
-            std::unordered_map<std::string, std::string> type_cache; // expression_hash -> type
-            std::unordered_map<std::string, bool> error_cache; // error_key -> has_error
+            // Caching lỗi theo node: khoá là địa chỉ node, giá trị là bitmask các CachedCheck đã báo lỗi.
+            // Node nằm trong arena của từng câu lệnh (địa chỉ được dùng lại), nên cache chỉ sống trong một câu lệnh.
+            enum CachedCheck : uint32_t
+            {
+                CHECK_VAR_DECL = 1u << 0
+            };
+            std::unordered_map<const void *, uint32_t> error_cache;
             
             // Early exit tracking
             bool should_early_exit = false;
             
             // Helper methods for optimization
-            std::string get_expression_hash(AST::Expr* expr);
-            std::string get_error_key(const AST::Stmt* stmt, const std::string& error_type);
-            std::string get_error_key(const AST::Expr* expr, const std::string& error_type);
-            bool check_cached_error(const AST::Stmt* stmt, const std::string& error_type);
-            bool check_cached_error(const AST::Expr* expr, const std::string& error_type);
-            void cache_error(const AST::Stmt* stmt, const std::string& error_type);
-            void cache_error(const AST::Expr* expr, const std::string& error_type);
+            bool check_cached_error(const void *node, CachedCheck check);
+            void cache_error(const void *node, CachedCheck check);
+
+            void analyze_function_decl(AST::FunctionDeclStmt *stmt);
+            void analyze_function_header(AST::FunctionDeclStmt *stmt);
+            void analyze_function_body(AST::FunctionDeclStmt *stmt);
             
             // Parallel analysis helpers
-            void analyze_statement_parallel(AST::Stmt* stmt);
-            std::vector<Linh::Error> merge_errors(const std::vector<std::vector<Linh::Error>>& error_lists);
+            std::unique_ptr<WorkStealingPool> pool; // Tạo khi cần, giữ lại cho các lần analyze sau
+            size_t pool_threads = 0;                // Số thread đã yêu cầu khi tạo pool
+            void analyze_parallel(const AST::StmtList &stmts);
+
+            // Module file: đọc + lex + parse (không đụng trạng thái analyzer nên chạy được trên worker)
+            struct LoadedModule
+            {
+                bool opened = false;
+                bool parse_error = false;
+                AST::StmtList ast;
+            };
+            static std::string module_path_of(const std::string &module_name);
+            static LoadedModule load_module(const std::string &module_path);
+            std::unordered_map<std::string, LoadedModule> preloaded_modules; // Theo đường dẫn, đã parse sẵn trên pool
+            void preload_modules(const AST::StmtList &stmts);
 
             bool is_sol_type(const std::optional<AST::TypeNodePtr> &type);
             bool is_sol_expr(const AST::ExprPtr &expr);
 
-            // --- Quản lý scope ---
-            std::vector<std::unordered_map<std::string, bool>> var_scopes;
-            std::unordered_map<std::string, bool> global_functions;
-
-            // --- Bổ sung quản lý loại biến, kiểu biến, số lượng tham số hàm ---
-            std::unordered_map<std::string, std::string> var_types;        // tên biến -> kiểu
-            std::unordered_map<std::string, std::string> var_kinds;        // tên biến -> "vas"/"const"/"var"
-            std::unordered_map<std::string, size_t> function_param_counts; // tên hàm -> số lượng tham số
-            std::unordered_map<std::string, size_t> var_func_param_counts; // tên biến function object -> số lượng tham số
-
-            // --- Bổ sung quản lý str_limit cho từng biến kiểu str<index> ---
-            std::unordered_map<std::string, int> var_str_limit; // tên biến -> str_limit
+            // --- Bảng symbol: tên được intern thành id, scope/loại/kiểu/số tham số/str_limit lưu theo id ---
+            SymbolTable symbols;
 
-            // --- LiPM package management ---
-            std::unordered_set<std::string> imported_packages; // Track imported LiPM packages
+            // --- Suy luận kiểu tĩnh cho biểu thức số ---
+            std::unordered_map<AST::ExprId, std::string> expr_types;     // id biểu thức -> kiểu suy ra
+            void set_var_num_type(SymbolId id, const std::string &type); // "int"/"float", chuỗi khác thì xoá
+            void record_expr_type(const AST::Expr *expr, const std::string &type);
+            std::string expr_type_of(const AST::Expr *expr) const;
 
-            void begin_scope();
+            void begin_scope(bool loop_or_switch = false);
             void end_scope();
-            void declare_var(const std::string &name, const std::string &kind = "", const std::string &type = "");
-            bool is_var_declared(const std::string &name);
-            void declare_function(const std::string &name, size_t param_count = 0);
-            bool is_function_declared(const std::string &name);
+            void declare_var(SymbolId id, VarKind kind = VarKind::None, StaticType type = {});
+            bool is_var_declared(SymbolId id);
+            void declare_function(SymbolId id, size_t param_count = 0);
+            bool is_function_declared(SymbolId id);
+            StaticType operand_type(AST::Expr *expr); // Kiểu của literal hoặc biến đã biết kiểu, Unknown nếu không rõ
 
             // Helper: xác định kiểu literal cho Linh từ LiteralExpr
             static std::string get_linh_literal_type(const AST::LiteralExpr *lit);
+            static TypeTag literal_type(const AST::LiteralExpr *lit);
         };
 
     } // namespace Semantic
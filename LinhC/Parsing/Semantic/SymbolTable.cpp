@@ -0,0 +1,207 @@
+#include "SymbolTable.hpp"
+#include <unordered_set>
+
+namespace Linh
+{
+    namespace Semantic
+    {
+        namespace
+        {
+            // Danh sách các hàm built-in hợp lệ
+            const std::unordered_set<std::string_view> builtin_functions = {
+                "print", "input", "str", "int", "float", "bool", "len", "id", "type", "uint", "pow", "printf",
+                "read_all", "read_line", "read_bytes", "read_eof"};
+            // Built-in dùng như identifier mà không cần khai báo
+            const std::unordered_set<std::string_view> builtin_values = {
+                "input", "type", "str", "int", "float", "bool", "uint", "id",
+                "read_all", "read_line", "read_bytes", "read_eof"};
+            const std::unordered_set<std::string_view> builtin_packages = {"math"};
+
+            struct TypeNameEntry
+            {
+                std::string_view name;
+                TypeTag tag;
+            };
+            constexpr TypeNameEntry type_names[] = {
+                {"int", TypeTag::Int}, {"uint", TypeTag::Uint}, {"float", TypeTag::Float}, {"bool", TypeTag::Bool},
+                {"str", TypeTag::Str}, {"map", TypeTag::Map}, {"array", TypeTag::Array}, {"function", TypeTag::Function},
+                {"any", TypeTag::Any}, {"void", TypeTag::Void}, {"sol", TypeTag::Sol}};
+        }
+
+        SymbolTable::SymbolTable()
+        {
+            intern(""); // Id 0 là tên rỗng, StaticType::name mặc định trỏ vào đây
+        }
+
+        SymbolTable::SymbolTable(const SymbolTable &other)
+        {
+            *this = other;
+        }
+
+        SymbolTable &SymbolTable::operator=(const SymbolTable &other)
+        {
+            if (this == &other)
+                return *this;
+            // 'ids' giữ string_view trỏ vào 'names' của chính bảng này, nên phải dựng lại sau khi chép tên
+            names = other.names;
+            ids.clear();
+            ids.reserve(names.size());
+            SymbolId id = 0;
+            for (const auto &name : names)
+                ids.emplace(name, id++);
+            symbols = other.symbols;
+            scopes = other.scopes;
+            loop_or_switch_depth = other.loop_or_switch_depth;
+            touches.clear();
+            touch_sessions.assign(symbols.size(), 0);
+            current_session = 0;
+            last_session = 0;
+            return *this;
+        }
+
+        SymbolId SymbolTable::intern(std::string_view name)
+        {
+            auto it = ids.find(name);
+            if (it != ids.end())
+            {
+                if (current_session)
+                    touch(it->second);
+                return it->second;
+            }
+            SymbolId id = static_cast<SymbolId>(symbols.size());
+            names.emplace_back(name);
+            ids.emplace(names.back(), id);
+            SymbolInfo info;
+            info.builtin_function = builtin_functions.count(name) > 0;
+            info.builtin_value = builtin_values.count(name) > 0;
+            info.builtin_package = builtin_packages.count(name) > 0;
+            symbols.push_back(info);
+            touch_sessions.push_back(0);
+            if (current_session)
+                touch(id);
+            return id;
+        }
+
+        const SymbolInfo *SymbolTable::find(std::string_view name)
+        {
+            auto it = ids.find(name);
+            if (it == ids.end())
+                return nullptr;
+            if (current_session)
+                touch(it->second);
+            return &symbols[it->second];
+        }
+
+        void SymbolTable::begin_scope(bool loop_or_switch)
+        {
+            scopes.emplace_back();
+            scopes.back().loop_or_switch = loop_or_switch;
+            if (loop_or_switch)
+                ++loop_or_switch_depth;
+        }
+
+        void SymbolTable::end_scope()
+        {
+            if (scopes.empty())
+                return;
+            auto &scope = scopes.back();
+            bool outermost = scopes.size() == 1;
+            for (auto it = scope.declared.rbegin(); it != scope.declared.rend(); ++it)
+            {
+                symbols[it->id].top_depth = it->top_depth;
+                symbols[it->id].num_type = it->num_type;
+                if (outermost)
+                    symbols[it->id].in_outermost = false;
+            }
+            if (scope.loop_or_switch)
+                --loop_or_switch_depth;
+            scopes.pop_back();
+        }
+
+        void SymbolTable::clear_scopes()
+        {
+            while (!scopes.empty())
+                end_scope();
+        }
+
+        void SymbolTable::reset_program()
+        {
+            clear_scopes();
+            // Chương trình mới bắt đầu như với bảng vừa tạo: chỉ giữ tên đã intern và cờ built-in,
+            // không để loại/kiểu của chương trình trước ảnh hưởng tới lần phân tích sau với cùng analyzer.
+            for (auto &info : symbols)
+            {
+                SymbolInfo fresh;
+                fresh.builtin_function = info.builtin_function;
+                fresh.builtin_value = info.builtin_value;
+                fresh.builtin_package = info.builtin_package;
+                info = fresh;
+            }
+        }
+
+        void SymbolTable::declare(SymbolId id)
+        {
+            if (scopes.empty() || declared_in_current(id))
+                return;
+            int depth = static_cast<int>(scopes.size()) - 1;
+            scopes.back().declared.push_back({id, symbols[id].top_depth, symbols[id].num_type});
+            symbols[id].top_depth = depth;
+            if (depth == 0)
+                symbols[id].in_outermost = true;
+        }
+
+        bool SymbolTable::declared_in_current(SymbolId id) const
+        {
+            return !scopes.empty() && symbols[id].top_depth == static_cast<int>(scopes.size()) - 1;
+        }
+
+        uint32_t SymbolTable::begin_touch_log()
+        {
+            uint32_t previous = current_session;
+            current_session = ++last_session;
+            return previous;
+        }
+
+        void SymbolTable::end_touch_log(uint32_t previous)
+        {
+            current_session = previous;
+            if (!current_session)
+                touches.clear();
+        }
+
+        void SymbolTable::rollback_touches(size_t from)
+        {
+            // Đi ngược: với id ghi nhiều lần, lần ghi sớm nhất (trạng thái cũ nhất) được áp dụng sau cùng
+            for (size_t i = touches.size(); i > from; --i)
+                symbols[touches[i - 1].id] = touches[i - 1].before;
+        }
+
+        void SymbolTable::touch(SymbolId id)
+        {
+            if (!current_session || touch_sessions[id] == current_session)
+                return;
+            touch_sessions[id] = current_session;
+            touches.push_back({id, symbols[id]});
+        }
+
+        StaticType SymbolTable::type_from_name(std::string_view type_name)
+        {
+            if (type_name.empty())
+                return {};
+            for (const auto &entry : type_names)
+                if (entry.name == type_name)
+                    return {entry.tag, 0};
+            return {TypeTag::Named, intern(type_name)};
+        }
+
+        std::string SymbolTable::type_name(StaticType type) const
+        {
+            if (type.tag == TypeTag::Named)
+                return names[type.name];
+            for (const auto &entry : type_names)
+                if (entry.tag == type.tag)
+                    return std::string(entry.name);
+            return "";
+        }
+    } // namespace Semantic
+} // namespace Linh
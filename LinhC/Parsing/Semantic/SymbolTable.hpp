@@ -0,0 +1,166 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace Linh
+{
+    namespace Semantic
+    {
+        using SymbolId = uint32_t;
+
+        // --- Kiểu tĩnh của biến: enum nhỏ thay cho chuỗi "int"/"str"/... ---
+        // Unknown: chưa biết kiểu; Any là đỉnh của lattice (mọi kiểu đều là subtype của any).
+        // Named: tên kiểu khác (do người dùng viết), giữ symbol của tên để so sánh và in lỗi.
+        enum class TypeTag : uint8_t
+        {
+            Unknown,
+            Int,
+            Uint,
+            Float,
+            Bool,
+            Str,
+            Map,
+            Array,
+            Function,
+            Any,
+            Void,
+            Sol,
+            Named
+        };
+
+        struct StaticType
+        {
+            TypeTag tag = TypeTag::Unknown;
+            SymbolId name = 0; // Chỉ dùng khi tag == Named
+
+            bool known() const { return tag != TypeTag::Unknown; }
+            bool operator==(const StaticType &other) const { return tag == other.tag && name == other.name; }
+            bool operator!=(const StaticType &other) const { return !(*this == other); }
+        };
+
+        inline bool is_subtype(StaticType sub, StaticType super)
+        {
+            return sub == super || super.tag == TypeTag::Any;
+        }
+
+        enum class VarKind : uint8_t
+        {
+            None, // Không đổi loại đã ghi (tham số, biến catch)
+            Var,
+            Vas,
+            Const
+        };
+
+        // Thông tin theo tên, đánh chỉ số bằng SymbolId. Như các map theo tên trước đây, phần kiểu/loại/số tham số
+        // không gắn với scope: khai báo sau cùng của một tên ghi đè lên khai báo trước.
+        // Riêng num_type (emitter dựa vào để chọn opcode có kiểu) được trả lại giá trị của khai báo ngoài khi ra khỏi scope.
+        struct SymbolInfo
+        {
+            // Scope
+            int top_depth = -1;       // Scope trong cùng đang khai báo tên này (-1: chưa khai báo ở scope nào còn sống)
+            bool in_outermost = false; // Có khai báo ở scope ngoài cùng
+
+            VarKind kind = VarKind::None;
+            StaticType type;
+            TypeTag num_type = TypeTag::Unknown; // Int/Float nếu kiểu số cố định (vas/const/tham số vas/biến range)
+            int str_limit = 0;                   // > 0 nếu khai báo str<n>
+
+            bool is_function = false;   // Hàm người dùng đã khai báo
+            int param_count = -1;       // Số tham số của hàm (-1: chưa khai báo hàm)
+            int var_func_params = -1;   // Biến giữ function object: số tham số nếu biết
+            bool imported_package = false;
+
+            // Cờ tính một lần lúc intern
+            bool builtin_function = false; // print, len, ... (luôn coi là đã khai báo)
+            bool builtin_value = false;    // input, type, str, ... dùng như identifier không cần khai báo
+            bool builtin_package = false;  // math
+
+            bool operator==(const SymbolInfo &other) const
+            {
+                return top_depth == other.top_depth && in_outermost == other.in_outermost && kind == other.kind &&
+                       type == other.type && num_type == other.num_type && str_limit == other.str_limit &&
+                       is_function == other.is_function && param_count == other.param_count &&
+                       var_func_params == other.var_func_params && imported_package == other.imported_package &&
+                       builtin_function == other.builtin_function && builtin_value == other.builtin_value &&
+                       builtin_package == other.builtin_package;
+            }
+            bool operator!=(const SymbolInfo &other) const { return !(*this == other); }
+        };
+
+        // Bảng symbol: intern tên thành id (băm chuỗi một lần mỗi lần gặp tên), thông tin lưu trong vector theo id,
+        // scope là stack các (symbol, top_depth/num_type trước khi khai báo) để khôi phục khi ra khỏi scope.
+        class SymbolTable
+        {
+        public:
+            SymbolTable();
+            SymbolTable(const SymbolTable &other); // Chép bảng (snapshot cho worker), không chép nhật ký
+            SymbolTable &operator=(const SymbolTable &other);
+
+            SymbolId intern(std::string_view name);
+            const SymbolInfo *find(std::string_view name); // Chỉ tra cứu, không thêm tên mới (nullptr nếu chưa gặp)
+            const std::string &name(SymbolId id) const { return names[id]; }
+            SymbolInfo &info(SymbolId id) { return symbols[id]; }
+            const SymbolInfo &info(SymbolId id) const { return symbols[id]; }
+
+            // --- Scope ---
+            void begin_scope(bool loop_or_switch = false);
+            void end_scope();
+            void clear_scopes();
+            void reset_program(); // Bỏ mọi scope và thông tin đã ghi theo tên (chỉ giữ tên đã intern và cờ built-in)
+            bool has_scope() const { return !scopes.empty(); }
+            size_t scope_depth() const { return scopes.size(); }
+            void declare(SymbolId id);                    // Khai báo trong scope hiện tại
+            bool is_declared(SymbolId id) const { return symbols[id].top_depth >= 0; }
+            bool declared_in_current(SymbolId id) const;  // Đã khai báo trong scope trong cùng
+            bool declared_in_outermost(SymbolId id) const { return !scopes.empty() && symbols[id].in_outermost; }
+            bool in_loop_or_switch() const { return loop_or_switch_depth > 0; }
+
+            // --- Kiểu ---
+            StaticType type_from_name(std::string_view type_name); // "int" -> Int, "" -> Unknown, tên lạ -> Named
+            std::string type_name(StaticType type) const;
+
+            // --- Nhật ký symbol đã dùng (phân tích song song hoàn lại thay đổi của một thân hàm) ---
+            // Trong một phiên ghi, lần đầu một symbol được intern/find thì lưu lại trạng thái của nó lúc đó.
+            // Mọi đọc/ghi của analyzer đều đi qua id lấy từ intern, nên nhật ký phủ hết những gì một hàm phụ thuộc.
+            // Phiên lồng nhau (hàm trong hàm) dùng chung nhật ký: phiên ngoài thấy cả mục của phiên trong.
+            struct Touch
+            {
+                SymbolId id;
+                SymbolInfo before;
+            };
+            uint32_t begin_touch_log();              // Mở phiên mới, trả về phiên đang mở trước đó (0: không có)
+            void end_touch_log(uint32_t previous);   // Đóng phiên, mở lại phiên trước; hết phiên thì xoá nhật ký
+            void touch(SymbolId id);                 // Ghi id vào nhật ký nếu đang ghi (gọi trước khi sửa info ngoài analyzer)
+            void rollback_touches(size_t from); // Trả các symbol ghi trong nhật ký từ vị trí 'from' về trạng thái trước
+
+        private:
+            struct Shadowed
+            {
+                SymbolId id;
+                int top_depth;    // top_depth trước khai báo trong scope này
+                TypeTag num_type; // num_type của khai báo ngoài bị che
+            };
+            struct Scope
+            {
+                std::vector<Shadowed> declared;
+                bool loop_or_switch = false;
+            };
+
+            std::deque<std::string> names; // deque: string_view trong 'ids' trỏ vào đây, không bị dời khi thêm
+            std::unordered_map<std::string_view, SymbolId> ids;
+            std::vector<SymbolInfo> symbols;
+            std::vector<Scope> scopes;
+            int loop_or_switch_depth = 0;
+
+            std::vector<Touch> touches;
+            std::vector<uint32_t> touch_sessions; // Theo id: phiên gần nhất đã ghi id này
+            uint32_t current_session = 0;
+            uint32_t last_session = 0;
+        };
+    } // namespace Semantic
+} // namespace Linh
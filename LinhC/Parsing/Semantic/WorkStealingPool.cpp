@@ -0,0 +1,121 @@
+#include "WorkStealingPool.hpp"
+#include <algorithm>
+
+namespace Linh
+{
+    namespace Semantic
+    {
+        WorkStealingPool::WorkStealingPool(size_t threads)
+        {
+            if (threads == 0)
+                threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+            for (size_t i = 0; i < threads; ++i)
+                queues.push_back(std::make_unique<Queue>());
+            workers.reserve(threads);
+            for (size_t i = 0; i < threads; ++i)
+                workers.emplace_back([this, i]() { worker_loop(i); });
+        }
+
+        WorkStealingPool::~WorkStealingPool()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            wake.notify_all();
+            for (auto &worker : workers)
+                worker.join();
+        }
+
+        void WorkStealingPool::run(std::vector<Task> &tasks)
+        {
+            if (tasks.empty())
+                return;
+            pending = tasks.size();
+            // Chia đoạn liền nhau: các việc gần nhau (thường cùng vùng AST) nằm trên cùng worker
+            size_t count = queues.size();
+            for (size_t i = 0; i < count; ++i)
+            {
+                size_t begin = tasks.size() * i / count;
+                size_t end = tasks.size() * (i + 1) / count;
+                std::lock_guard<std::mutex> lock(queues[i]->mutex);
+                for (size_t t = begin; t < end; ++t)
+                    queues[i]->tasks.push_back(&tasks[t]);
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                ++generation;
+            }
+            wake.notify_all();
+
+            std::exception_ptr failure;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                done.wait(lock, [this]() { return pending.load() == 0; });
+                failure = error;
+                error = nullptr;
+            }
+            if (failure)
+                std::rethrow_exception(failure);
+        }
+
+        void WorkStealingPool::worker_loop(size_t index)
+        {
+            size_t seen = 0;
+            for (;;)
+            {
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    wake.wait(lock, [this, seen]() { return stopping || generation != seen; });
+                    if (stopping)
+                        return;
+                    seen = generation;
+                }
+                while (Task *task = pop_or_steal(index))
+                {
+                    try
+                    {
+                        (*task)(index);
+                    }
+                    catch (...)
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        if (!error)
+                            error = std::current_exception();
+                    }
+                    if (pending.fetch_sub(1) == 1)
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        done.notify_all();
+                    }
+                }
+            }
+        }
+
+        WorkStealingPool::Task *WorkStealingPool::pop_or_steal(size_t index)
+        {
+            {
+                Queue &own = *queues[index];
+                std::lock_guard<std::mutex> lock(own.mutex);
+                if (!own.tasks.empty())
+                {
+                    Task *task = own.tasks.back();
+                    own.tasks.pop_back();
+                    return task;
+                }
+            }
+            for (size_t offset = 1; offset < queues.size(); ++offset)
+            {
+                Queue &victim = *queues[(index + offset) % queues.size()];
+                std::lock_guard<std::mutex> lock(victim.mutex);
+                if (!victim.tasks.empty())
+                {
+                    Task *task = victim.tasks.front();
+                    victim.tasks.pop_front();
+                    return task;
+                }
+            }
+            return nullptr;
+        }
+    } // namespace Semantic
+} // namespace Linh
@@ -0,0 +1,56 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Linh
+{
+    namespace Semantic
+    {
+        // --- Thread pool work-stealing cho phân tích song song ---
+        // Mỗi worker có hàng đợi riêng: lấy việc ở đuôi hàng của mình, hết việc thì lấy trộm ở đầu hàng của worker khác.
+        // run() chia đều danh sách việc thành các đoạn liền nhau cho từng worker và chỉ trả về khi mọi việc đã xong.
+        // Task nhận chỉ số worker đang chạy nó để dùng dữ liệu riêng của worker (không cần khoá).
+        class WorkStealingPool
+        {
+        public:
+            using Task = std::function<void(size_t worker)>;
+
+            explicit WorkStealingPool(size_t threads = 0); // 0: theo số core
+            ~WorkStealingPool();
+            WorkStealingPool(const WorkStealingPool &) = delete;
+            WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+
+            size_t size() const { return workers.size(); }
+            void run(std::vector<Task> &tasks); // Ném lại exception đầu tiên (nếu có) sau khi mọi task kết thúc
+
+        private:
+            struct Queue
+            {
+                std::mutex mutex;
+                std::deque<Task *> tasks;
+            };
+
+            std::vector<std::thread> workers;
+            std::vector<std::unique_ptr<Queue>> queues;
+
+            std::mutex mutex;
+            std::condition_variable wake; // Có lượt việc mới hoặc dừng pool
+            std::condition_variable done; // pending về 0
+            size_t generation = 0;
+            bool stopping = false;
+            std::atomic<size_t> pending{0};
+            std::exception_ptr error;
+
+            void worker_loop(size_t index);
+            Task *pop_or_steal(size_t index);
+        };
+    } // namespace Semantic
+} // namespace Linh
@@ -25,6 +25,8 @@
 #include <fstream>
 #include <sstream>
 #include <string> // For std::string
+#include <algorithm>
+#include <cstdlib>
 // utf 8
 #ifdef _WIN32
 #include <windows.h>
@@ -44,12 +46,15 @@ void force_console_utf8()
 #endif
 }
 
+// analysis_jobs < 0: biên dịch streaming, phân tích tuần tự từng câu lệnh.
+// analysis_jobs >= 0: parse cả file rồi phân tích thân hàm song song trên analysis_jobs thread (0: theo số core).
 void runSource(const std::string &source_code,
                Linh::Semantic::SemanticAnalyzer *sema_ptr = nullptr,
                Linh::BytecodeEmitter *emitter_ptr = nullptr,
-               Linh::LiVM *vm_ptr = nullptr);
+               Linh::LiVM *vm_ptr = nullptr,
+               int analysis_jobs = -1);
 
-void runFile(const std::string &filename)
+void runFile(const std::string &filename, int analysis_jobs = -1)
 {
     std::ifstream file(filename);
     if (!file)
@@ -64,7 +69,7 @@ void runFile(const std::string &filename)
     {
         source += line + "\n";
     }
-    runSource(source, nullptr, nullptr, nullptr);
+    runSource(source, nullptr, nullptr, nullptr, analysis_jobs);
 }
 
 // Đặt biến này vào đúng namespace Linh::Semantic để tránh lỗi linker
@@ -77,29 +82,78 @@ namespace Semantic {
 void runSource(const std::string &source_code,
                Linh::Semantic::SemanticAnalyzer *sema_ptr,
                Linh::BytecodeEmitter *emitter_ptr,
-               Linh::LiVM *vm_ptr)
+               Linh::LiVM *vm_ptr,
+               int analysis_jobs)
 {
     std::cout << "--- Source Code Being Parsed ---\n"
               << source_code << "\n--------------------------------\n";
 
     Linh::Lexer lexer(source_code);
-    std::vector<Linh::Token> tokens = lexer.scan_tokens();
-    Linh::Parser parser(tokens);
-    Linh::AST::StmtList ast = parser.parse();
-    if (parser.had_error())
+    bool parse_failed = false;
+
+    Linh::BytecodeEmitter emitter;
+    Linh::Semantic::g_main_emitter = &emitter; // Đặt emitter chính trước khi semantic để import có thể merge
+    Linh::Semantic::SemanticAnalyzer sema;
+    emitter.set_expr_types(&sema.get_expr_types());
+
+    if (analysis_jobs >= 0)
+    {
+        // Phân tích song song (-j N): thân hàm được phân tích trên thread pool với bảng symbol của cả chương trình,
+        // nên cần parse hết file trước (không streaming). Khác tuần tự: thân hàm thấy cả khai báo cấp cao nhất
+        // đứng sau nó, vd. hai hàm gọi lẫn nhau (xem Li/parallel_forward_call.li).
+        std::vector<Linh::Token> tokens = lexer.scan_tokens();
+        Linh::Parser parser(tokens);
+        Linh::AST::Arena ast_arena;
+        Linh::AST::ArenaScope ast_arena_scope(ast_arena);
+        Linh::AST::StmtList stmts = parser.parse();
+        parse_failed = parser.had_error();
+        if (!parse_failed)
+        {
+            sema.enable_parallel_analysis(true, static_cast<size_t>(analysis_jobs));
+            sema.analyze(stmts);
+            emitter.begin_program();
+            if (sema.errors.empty())
+            {
+                emitter.predeclare_functions(stmts);
+                for (const auto &stmt : stmts)
+                    emitter.emit_statement(stmt.get());
+            }
+        }
+    }
+    else
     {
+        // Biên dịch streaming: mỗi khai báo cấp cao nhất được lex, parse, phân tích, emit rồi giải phóng ngay
+        // (AST nằm trong arena riêng của nó, parser chỉ giữ token của khai báo đang parse), nên bộ nhớ token/AST
+        // tối đa chỉ bằng khai báo lớn nhất chứ không phải cả file. Chỉ chuỗi nguồn là O(file).
+        // Sau lỗi cú pháp/semantic vẫn parse tiếp để báo hết lỗi cú pháp, nhưng không phân tích/emit nữa.
+        Linh::Parser parser(lexer);
+        sema.begin_program();
+        emitter.begin_program();
+        while (!parser.done())
+        {
+            Linh::AST::Arena ast_arena(4 * 1024); // Khai báo trước stmt để huỷ sau cùng
+            Linh::AST::ArenaScope ast_arena_scope(ast_arena);
+            Linh::AST::StmtPtr stmt = parser.parse_declaration();
+            if (!stmt || parser.had_error())
+                continue;
+            sema.analyze_statement(stmt.get());
+            if (sema.errors.empty())
+                emitter.emit_statement(stmt.get());
+        }
+        sema.end_program();
+        parse_failed = parser.had_error();
+    }
+    if (parse_failed)
+    {
+        Linh::Semantic::g_main_emitter = nullptr;
 #ifdef _DEBUG
         std::cerr << "Lỗi cú pháp, dừng thực thi." << std::endl;
 #endif
         return;
     }
-
-    Linh::BytecodeEmitter emitter;
-    Linh::Semantic::g_main_emitter = &emitter; // Đặt emitter chính trước khi semantic để import có thể merge
-    Linh::Semantic::SemanticAnalyzer sema;
-    sema.analyze(ast);
     if (!sema.errors.empty())
     {
+        Linh::Semantic::g_main_emitter = nullptr;
 #ifdef _DEBUG
         for (const auto &err : sema.errors)
         {
@@ -109,7 +163,7 @@ void runSource(const std::string &source_code,
 #endif
         return;
     }
-    emitter.emit(ast);
+    emitter.end_program();
     Linh::Semantic::g_main_emitter = nullptr; // Đặt lại sau khi xong
 
     // --- Debug: In ra danh sách function sau khi merge ---
@@ -138,7 +192,7 @@ void runSource(const std::string &source_code,
     vm.set_functions(vm_functions);
     // --- Kết thúc chuyển đổi ---
 
-    vm.run(emitter.get_chunk());
+    vm.run(emitter.get_chunk(), emitter.get_exception_table());
 
     // --- Debug: print VM stack and variables after execution (optional)
 #ifdef _DEBUG
@@ -168,7 +222,15 @@ int main(int argc, char **argv)
             std::cout << "Website: " << web << "\n";
             return 0;
         }
-        runFile(argv[1]);
+        // -j N / --jobs N: phân tích semantic song song trên N thread (0: theo số core)
+        int analysis_jobs = -1;
+        int file_arg = 1;
+        if ((arg1 == "-j" || arg1 == "--jobs") && argc > 3)
+        {
+            analysis_jobs = std::max(0, std::atoi(argv[2]));
+            file_arg = 3;
+        }
+        runFile(argv[file_arg], analysis_jobs);
     }
     else
     {
@@ -81,6 +81,8 @@ namespace Linh
             // Chỉ parse và emit cho dòng vừa nhập
             Linh::Lexer lexer(full_stmt);
             auto tokens = lexer.scan_tokens();
+            Linh::AST::Arena ast_arena; // AST của từng lần nhập, huỷ sau stmts
+            Linh::AST::ArenaScope ast_arena_scope(ast_arena);
             Linh::Parser parser(tokens);
             auto stmts = parser.parse();
 
@@ -101,6 +103,7 @@ namespace Linh
                 continue;
             }
 
+            emitter.set_expr_types(&analyzer.get_expr_types());
             emitter.emit(stmts);
             // Cập nhật function table (giữ lại các hàm đã khai báo trước đó)
             auto new_funcs = emitter.get_functions();
@@ -121,7 +124,7 @@ namespace Linh
             const auto &chunk = emitter.get_chunk();
             // Trước khi chạy, khôi phục biến toàn cục
             vm.set_global_variables(global_vars);
-            vm.run(chunk);
+            vm.run(chunk, emitter.get_exception_table());
             // Sau khi chạy, lưu lại biến toàn cục
             global_vars = vm.get_global_variables();
         }